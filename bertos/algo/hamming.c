@@ -0,0 +1,132 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Hamming ECC for NAND pages.
+ *
+ * The ECC of a data block is made of:
+ * - line parity: the XOR of the indexes of the bytes with odd parity,
+ *   and the XOR of their complements;
+ * - column parity: the XOR of the positions of the bits set in the
+ *   XOR of all the bytes, and the XOR of their complements.
+ *
+ * A single flipped bit changes every index with its complement, so the
+ * syndrome gives its byte and bit position directly.
+ */
+
+#include "hamming.h"
+
+#include <cfg/macros.h>
+
+INLINE uint8_t parity8(uint8_t b)
+{
+	b ^= b >> 4;
+	b ^= b >> 2;
+	b ^= b >> 1;
+	return b & 1;
+}
+
+static int bitCount(uint8_t b)
+{
+	int n;
+
+	for (n = 0; b; n++)
+		b &= b - 1;
+	return n;
+}
+
+/**
+ * Compute the ECC of HAMMING_BLOCK_SIZE bytes of \a buf
+ * in the HAMMING_ECC_SIZE bytes of \a ecc.
+ */
+void hamming_compute(const void *buf, uint8_t *ecc)
+{
+	const uint8_t *data = (const uint8_t *)buf;
+	uint8_t line = 0, line_c = 0;
+	uint8_t all = 0;
+	uint8_t col = 0, col_c = 0;
+
+	for (int i = 0; i < HAMMING_BLOCK_SIZE; i++)
+	{
+		all ^= data[i];
+		if (parity8(data[i]))
+		{
+			line ^= i;
+			line_c ^= ~i;
+		}
+	}
+
+	for (int bit = 0; bit < 8; bit++)
+	{
+		if (all & BV(bit))
+		{
+			col ^= bit;
+			col_c ^= ~bit & 0x07;
+		}
+	}
+
+	ecc[0] = ~line;
+	ecc[1] = ~line_c;
+	ecc[2] = ~(col << 5 | col_c << 2);
+}
+
+/**
+ * Check HAMMING_BLOCK_SIZE bytes of \a buf against the ECC \a read_ecc,
+ * read along with them, correcting them if possible.
+ *
+ * \param buf       the data block.
+ * \param read_ecc  the ECC stored with the data.
+ * \param calc_ecc  the ECC computed on \a buf by hamming_compute().
+ * \return HAMMING_OK, HAMMING_CORRECTED or HAMMING_ERROR.
+ */
+int hamming_correct(void *buf, const uint8_t *read_ecc, const uint8_t *calc_ecc)
+{
+	uint8_t s0 = read_ecc[0] ^ calc_ecc[0];
+	uint8_t s1 = read_ecc[1] ^ calc_ecc[1];
+	uint8_t s2 = (read_ecc[2] ^ calc_ecc[2]) & 0xFC;
+	uint8_t col = s2 >> 5, col_c = (s2 >> 2) & 0x07;
+
+	if (!s0 && !s1 && !s2)
+		return HAMMING_OK;
+
+	/* Every index changed along with its complement: data bit error */
+	if ((s0 ^ s1) == 0xFF && (col ^ col_c) == 0x07)
+	{
+		((uint8_t *)buf)[s0] ^= BV(col);
+		return HAMMING_CORRECTED;
+	}
+
+	/* A single bit error in the ECC itself */
+	if (bitCount(s0) + bitCount(s1) + bitCount(s2) == 1)
+		return HAMMING_CORRECTED;
+
+	return HAMMING_ERROR;
+}
@@ -0,0 +1,67 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Hamming ECC for NAND pages.
+ *
+ * Every HAMMING_BLOCK_SIZE bytes of data get HAMMING_ECC_SIZE bytes of
+ * ECC: any single bit error is corrected, any double bit error is
+ * detected. The ECC is stored inverted, so an erased block of data
+ * (all 0xFF) matches its erased ECC.
+ *
+ * $WIZ$ module_name = "hamming"
+ */
+
+#ifndef ALGO_HAMMING_H
+#define ALGO_HAMMING_H
+
+#include <cfg/compiler.h>
+
+#define HAMMING_BLOCK_SIZE  256 ///< Data bytes protected by one ECC.
+#define HAMMING_ECC_SIZE      3 ///< ECC bytes for each data block.
+
+/**
+ * \name Values returned by hamming_correct().
+ * \{
+ */
+#define HAMMING_OK          0   ///< No errors.
+#define HAMMING_CORRECTED   1   ///< A single bit error has been corrected.
+#define HAMMING_ERROR     (-1)  ///< Uncorrectable error.
+/** \} */
+
+void hamming_compute(const void *buf, uint8_t *ecc);
+int hamming_correct(void *buf, const uint8_t *read_ecc, const uint8_t *calc_ecc);
+
+int hamming_testSetup(void);
+int hamming_testRun(void);
+int hamming_testTearDown(void);
+
+#endif /* ALGO_HAMMING_H */
@@ -0,0 +1,144 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Hamming ECC test.
+ *
+ * Every single bit error, in data and ECC, must be corrected; double
+ * bit errors must be detected.
+ */
+
+#include "hamming.h"
+
+#include <cfg/test.h>
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t data[HAMMING_BLOCK_SIZE];
+static uint8_t orig[HAMMING_BLOCK_SIZE];
+
+static int checkBlock(void)
+{
+	uint8_t ecc[HAMMING_ECC_SIZE], calc[HAMMING_ECC_SIZE];
+	int i, j;
+
+	hamming_compute(orig, ecc);
+
+	memcpy(data, orig, sizeof(data));
+	hamming_compute(data, calc);
+	if (hamming_correct(data, ecc, calc) != HAMMING_OK)
+		return -1;
+
+	/* Single bit errors in data */
+	for (i = 0; i < HAMMING_BLOCK_SIZE * 8; i++)
+	{
+		data[i / 8] ^= BV(i % 8);
+		hamming_compute(data, calc);
+		if (hamming_correct(data, ecc, calc) != HAMMING_CORRECTED
+		 || memcmp(data, orig, sizeof(data)))
+			return -1;
+	}
+
+	/* Single bit errors in ECC */
+	for (i = 0; i < HAMMING_ECC_SIZE * 8; i++)
+	{
+		uint8_t bad_ecc[HAMMING_ECC_SIZE];
+
+		memcpy(bad_ecc, ecc, sizeof(bad_ecc));
+		bad_ecc[i / 8] ^= BV(i % 8);
+		hamming_compute(data, calc);
+		/* The two lower bits of the last byte are unused */
+		if (hamming_correct(data, bad_ecc, calc) != (i >= 18 || i < 16 ? HAMMING_CORRECTED : HAMMING_OK)
+		 || memcmp(data, orig, sizeof(data)))
+			return -1;
+	}
+
+	/* Double bit errors in data */
+	for (j = 0; j < 200; j++)
+	{
+		int b1 = rand() % (HAMMING_BLOCK_SIZE * 8);
+		int b2 = rand() % (HAMMING_BLOCK_SIZE * 8);
+
+		if (b1 == b2)
+			continue;
+		memcpy(data, orig, sizeof(data));
+		data[b1 / 8] ^= BV(b1 % 8);
+		data[b2 / 8] ^= BV(b2 % 8);
+		hamming_compute(data, calc);
+		if (hamming_correct(data, ecc, calc) != HAMMING_ERROR)
+			return -1;
+	}
+	return 0;
+}
+
+int hamming_testRun(void)
+{
+	uint8_t ecc[HAMMING_ECC_SIZE];
+	int i;
+
+	/* Erased data matches erased ECC */
+	memset(orig, 0xFF, sizeof(orig));
+	hamming_compute(orig, ecc);
+	if (ecc[0] != 0xFF || ecc[1] != 0xFF || ecc[2] != 0xFF)
+		return -1;
+	if (checkBlock())
+		return -1;
+
+	for (i = 0; i < 10; i++)
+	{
+		for (int j = 0; j < HAMMING_BLOCK_SIZE; j++)
+			orig[j] = rand();
+		if (checkBlock())
+		{
+			kputs("Hamming ECC test failed\n");
+			return -1;
+		}
+	}
+
+	kputs("Hamming ECC test OK\n");
+	return 0;
+}
+
+int hamming_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int hamming_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(hamming);
@@ -41,6 +41,7 @@
 #include "hw/hw_led.h"
 
 #include "cfg/cfg_context_switch.h"
+#include "cfg/cfg_proc.h"
 #include <cfg/debug.h>
 
 #include <cpu/irq.h>
@@ -54,6 +55,12 @@ static Serial out;
 
 #include <kern/proc.h>
 
+#if CONFIG_KERN_PRI_BITMAP
+	#define READY_QUEUE "bitmap"
+#else
+	#define READY_QUEUE "list"
+#endif
+
 #define PROC_STACK_SIZE	   KERN_MINSTACKSIZE
 
 static PROC_DEFINE_STACK(hp_stack, PROC_STACK_SIZE);
@@ -128,7 +135,8 @@ void NORETURN context_switch(void)
 
 		#if CONFIG_USE_HP_TIMER
 			kfile_printf(&out.fd,
-				"Switch: %lu.%lu usec\n\r",
+				"Switch (%s): %lu.%lu usec\n\r",
+				READY_QUEUE,
 				hptime_to_us((end - start)),
 				hptime_to_us((end - start) * 1000) % 1000);
 		#endif
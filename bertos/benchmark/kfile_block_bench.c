@@ -0,0 +1,106 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief KFile over KBlock streaming benchmark.
+ */
+
+#include "kfile_block_bench.h"
+
+#include "cfg/cfg_kfile_block_bench.h"
+#include <cfg/debug.h>
+
+#include <drv/timer.h>
+
+#include <io/kblock_posix.h>
+#include <io/kfile_block.h>
+
+#include <stdio.h>
+
+#define BENCH_SIZE  ((long)CONFIG_KFILE_BLOCK_BENCH_BLOCKS * CONFIG_KFILE_BLOCK_BENCH_BLK_SIZE)
+
+static uint8_t page[CONFIG_KFILE_BLOCK_BENCH_BLK_SIZE];
+static uint8_t stream_bufs[CONFIG_KFILE_BLOCK_BENCH_BLK_SIZE * CONFIG_KFILE_BLOCK_BENCH_BUFS];
+static uint8_t chunk[CONFIG_KFILE_BLOCK_BENCH_CHUNK];
+
+static KBlockPosix dev;
+static KFileBlockStream stream;
+static KFileBlock fb;
+
+/* Return the KB/s for a whole file transfer */
+static unsigned long bench_run(bool write)
+{
+	ticks_t start, elapsed;
+	long len = 0;
+	size_t done;
+
+	kfile_seek(&fb.fd, 0, KSM_SEEK_SET);
+	start = timer_clock();
+	do
+	{
+		if (write)
+			done = kfile_write(&fb.fd, chunk, sizeof(chunk));
+		else
+			done = kfile_read(&fb.fd, chunk, sizeof(chunk));
+		len += done;
+	}
+	while (done);
+	kfile_flush(&fb.fd);
+	elapsed = MAX(timer_clock() - start, (ticks_t)1);
+
+	ASSERT(len == BENCH_SIZE);
+	return (unsigned long)(len / 1024 * TIMER_TICKS_PER_SEC / elapsed);
+}
+
+void kfile_block_bench(void)
+{
+	FILE *fp = tmpfile();
+	unsigned long wr, rd;
+
+	ASSERT(fp);
+	fseek(fp, BENCH_SIZE - 1, SEEK_SET);
+	fputc(0, fp);
+
+	kputs("mode    write KB/s  read KB/s\n");
+
+	kblockposix_init(&dev, fp, false, page, CONFIG_KFILE_BLOCK_BENCH_BLK_SIZE, CONFIG_KFILE_BLOCK_BENCH_BLOCKS);
+	kfileblock_init(&fb, &dev.b);
+	wr = bench_run(true);
+	rd = bench_run(false);
+	kprintf("plain   %10lu  %9lu\n", wr, rd);
+
+	kblockposix_init(&dev, fp, false, page, CONFIG_KFILE_BLOCK_BENCH_BLK_SIZE, CONFIG_KFILE_BLOCK_BENCH_BLOCKS);
+	kfileblock_initStream(&fb, &dev.b, &stream, stream_bufs, CONFIG_KFILE_BLOCK_BENCH_BUFS);
+	wr = bench_run(true);
+	rd = bench_run(false);
+	kprintf("stream  %10lu  %9lu\n", wr, rd);
+
+	kfile_close(&fb.fd);
+}
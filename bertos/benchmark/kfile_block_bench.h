@@ -0,0 +1,56 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief KFile over KBlock streaming benchmark.
+ *
+ * Writes and reads back a POSIX file through kfile_block, in
+ * CONFIG_KFILE_BLOCK_BENCH_CHUNK bytes pieces, through the same
+ * buffered KBlock first with the plain KFile interface, then in
+ * streaming mode, and prints the throughput of both.
+ * Runs on the emulator only.
+ *
+ * $WIZ$ module_name = "kfile_block_bench"
+ * $WIZ$ module_depends = "kfile_block", "kfile_posix", "timer", "debug"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_kfile_block_bench.h"
+ */
+
+#ifndef BENCHMARK_KFILE_BLOCK_BENCH_H
+#define BENCHMARK_KFILE_BLOCK_BENCH_H
+
+/**
+ * Run the benchmark and print the results with kprintf().
+ *
+ * The timer must have been initialized, and the kernel too if
+ * CONFIG_KFILE_BLOCK_STREAM_ASYNC is enabled.
+ */
+void kfile_block_bench(void);
+
+#endif /* BENCHMARK_KFILE_BLOCK_BENCH_H */
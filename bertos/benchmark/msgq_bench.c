@@ -0,0 +1,101 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Message queue throughput benchmark.
+ */
+
+#include "msgq_bench.h"
+
+#include "cfg/cfg_msgq_bench.h"
+#include <cfg/debug.h>
+
+#include <drv/timer.h>
+
+#include <kern/msg.h>
+#include <kern/proc.h>
+#include <kern/sem.h>
+
+#define PROC_STACK_SIZE  (KERN_MINSTACKSIZE * 2)
+
+static PROC_DEFINE_STACK(consumer_stack, PROC_STACK_SIZE);
+
+static uint8_t slots[CONFIG_MSGQ_BENCH_SLOTS][CONFIG_MSGQ_BENCH_MSG_SIZE];
+static MsgQueue queue;
+static CountSemaphore done;
+
+static void consumer(void)
+{
+	uint8_t msg[CONFIG_MSGQ_BENCH_MSG_SIZE];
+	long i;
+
+	for (i = 0; i < CONFIG_MSGQ_BENCH_MSGS; i++)
+		msgq_recv(&queue, msg);
+	csem_release(&done);
+}
+
+/*
+ * Send all the messages, \a size bytes each, and return the number
+ * of messages per second.
+ */
+static unsigned long bench_run(size_t size)
+{
+	uint8_t msg[CONFIG_MSGQ_BENCH_MSG_SIZE] = { 0 };
+	struct Process *p;
+	ticks_t start, elapsed;
+	long i;
+
+	msgq_init(&queue, slots, size, CONFIG_MSGQ_BENCH_SLOTS);
+	p = proc_new(consumer, NULL, sizeof(consumer_stack), consumer_stack);
+	#if CONFIG_KERN_PRI
+		proc_setPri(p, proc_current()->link.pri - 1);
+	#else
+		(void)p;
+	#endif
+
+	start = timer_clock();
+	for (i = 0; i < CONFIG_MSGQ_BENCH_MSGS; i++)
+		msgq_send(&queue, msg);
+	csem_obtain(&done);
+	elapsed = MAX(timer_clock() - start, (ticks_t)1);
+
+	return (unsigned long)CONFIG_MSGQ_BENCH_MSGS * TIMER_TICKS_PER_SEC / elapsed;
+}
+
+void msgq_bench(void)
+{
+	size_t size;
+
+	csem_init(&done, 0);
+
+	kputs("bytes  msg/s\n");
+	for (size = 4; size <= CONFIG_MSGQ_BENCH_MSG_SIZE; size *= 2)
+		kprintf("%5u  %lu\n", (unsigned)size, bench_run(size));
+}
@@ -0,0 +1,55 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Message queue throughput benchmark.
+ *
+ * A producer sends CONFIG_MSGQ_BENCH_MSGS messages to a lower priority
+ * consumer through a MsgQueue, and the number of messages per second is
+ * printed for growing message sizes. The difference between the sizes
+ * is the cost of copying the messages in and out of the queue, the
+ * rest is the cost of the two context switches per message.
+ *
+ * $WIZ$ module_name = "msgq_bench"
+ * $WIZ$ module_depends = "kern", "msg", "timer", "debug"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_msgq_bench.h"
+ */
+
+#ifndef BENCHMARK_MSGQ_BENCH_H
+#define BENCHMARK_MSGQ_BENCH_H
+
+/**
+ * Run the benchmark and print the results with kprintf().
+ *
+ * The kernel and the timer must have been initialized.
+ */
+void msgq_bench(void);
+
+#endif /* BENCHMARK_MSGQ_BENCH_H */
@@ -0,0 +1,73 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Process spawn/exit benchmark.
+ */
+
+#include "proc_spawn.h"
+
+#include "cfg/cfg_proc_spawn.h"
+#include <cfg/debug.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+
+static volatile bool exited;
+
+static void child(void)
+{
+	exited = true;
+}
+
+void proc_spawn_bench(void)
+{
+	ticks_t start, elapsed;
+	long i;
+
+	start = timer_clock();
+	for (i = 0; i < CONFIG_PROC_SPAWN_CYCLES; i++)
+	{
+		exited = false;
+		if (!proc_new(child, NULL, CONFIG_PROC_SPAWN_STACK_SIZE, NULL))
+		{
+			kprintf("out of memory after %ld processes\n", i);
+			return;
+		}
+		while (!exited)
+			proc_yield();
+	}
+	elapsed = MAX(timer_clock() - start, (ticks_t)1);
+
+	kprintf("stack pool %s: %lu spawn/exit per second\n",
+		CONFIG_KERN_STACK_POOL ? "on" : "off",
+		(unsigned long)CONFIG_PROC_SPAWN_CYCLES * TIMER_TICKS_PER_SEC / elapsed);
+}
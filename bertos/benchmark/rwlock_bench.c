@@ -0,0 +1,143 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Read/write lock throughput benchmark.
+ */
+
+#include "rwlock_bench.h"
+
+#include "cfg/cfg_rwlock_bench.h"
+#include <cfg/debug.h>
+
+#include <cpu/irq.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+#include <kern/sem.h>
+
+#define PROC_STACK_SIZE  (KERN_MINSTACKSIZE * 2)
+
+static cpu_stack_t stacks[CONFIG_RWLOCK_BENCH_READERS][PROC_STACK_SIZE / sizeof(cpu_stack_t)];
+static unsigned long ops[CONFIG_RWLOCK_BENCH_READERS];
+static int table[CONFIG_RWLOCK_BENCH_TABLE];
+
+static RWLock rwlock;
+static Semaphore mutex;
+static bool use_rwlock;
+static volatile bool stop;
+static volatile int running;
+
+static int scan(int from, int to)
+{
+	int sum = 0;
+
+	while (from < to)
+		sum += table[from++];
+	return sum;
+}
+
+static void reader(void)
+{
+	int id = (int)(ssize_t)proc_currentUserData();
+	int sum;
+
+	while (!stop)
+	{
+		if (use_rwlock)
+			rwlock_readObtain(&rwlock);
+		else
+			sem_obtain(&mutex);
+
+		/* Wait for something in the middle of the critical section */
+		sum = scan(0, CONFIG_RWLOCK_BENCH_TABLE / 2);
+		proc_yield();
+		sum += scan(CONFIG_RWLOCK_BENCH_TABLE / 2, CONFIG_RWLOCK_BENCH_TABLE);
+
+		if (use_rwlock)
+			rwlock_readRelease(&rwlock);
+		else
+			sem_release(&mutex);
+
+		ASSERT(sum == CONFIG_RWLOCK_BENCH_TABLE);
+		ops[id]++;
+	}
+	PROC_ATOMIC(running--);
+}
+
+/*
+ * Run \a readers readers for CONFIG_RWLOCK_BENCH_TIME ms and
+ * return the number of scans per second.
+ */
+static unsigned long bench_run(int readers)
+{
+	unsigned long total = 0;
+	int i;
+
+	stop = false;
+	running = readers;
+	for (i = 0; i < readers; i++)
+	{
+		ops[i] = 0;
+		proc_new(reader, (void *)(ssize_t)i, sizeof(stacks[i]), stacks[i]);
+	}
+
+	timer_delay(CONFIG_RWLOCK_BENCH_TIME);
+	stop = true;
+	while (running)
+		proc_yield();
+
+	for (i = 0; i < readers; i++)
+		total += ops[i];
+	return total * 1000 / CONFIG_RWLOCK_BENCH_TIME;
+}
+
+void rwlock_bench(void)
+{
+	unsigned long rw_ops, sem_ops;
+	int i;
+
+	for (i = 0; i < CONFIG_RWLOCK_BENCH_TABLE; i++)
+		table[i] = 1;
+	rwlock_init(&rwlock);
+	sem_init(&mutex);
+
+	kputs("readers  rwlock op/s  mutex op/s\n");
+	for (i = 1; i <= CONFIG_RWLOCK_BENCH_READERS; i++)
+	{
+		use_rwlock = true;
+		rw_ops = bench_run(i);
+		use_rwlock = false;
+		sem_ops = bench_run(i);
+
+		kprintf("%7d  %11lu  %10lu\n", i, rw_ops, sem_ops);
+	}
+}
@@ -0,0 +1,56 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Read/write lock throughput benchmark.
+ *
+ * A growing number of readers scan a shared table, giving up the CPU
+ * in the middle of each scan as if they were waiting for some I/O.
+ * The table is protected first by a RWLock, then by a Semaphore, and
+ * the number of completed scans per second is printed for each run:
+ * with the Semaphore the readers are serialized, with the RWLock the
+ * throughput grows with the number of readers.
+ *
+ * $WIZ$ module_name = "rwlock_bench"
+ * $WIZ$ module_depends = "kern", "semaphores", "timer", "debug"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_rwlock_bench.h"
+ */
+
+#ifndef BENCHMARK_RWLOCK_BENCH_H
+#define BENCHMARK_RWLOCK_BENCH_H
+
+/**
+ * Run the benchmark and print the results with kprintf().
+ *
+ * The kernel and the timer must have been initialized.
+ */
+void rwlock_bench(void);
+
+#endif /* BENCHMARK_RWLOCK_BENCH_H */
@@ -63,5 +63,50 @@
  */
 #define CONFIG_BATTFS_SHUFFLE_FREE_PAGES 0
 
+/**
+ * Set to 1 to enable the page array checkpoint.
+ * A snapshot of the page allocation array is saved on a separate
+ * block device at sync and umount time, and mount loads it instead
+ * of reading the header of every disk page.
+ * The snapshot is invalidated before the first change to the disk,
+ * so after a power loss mount falls back to the full scan.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_BATTFS_CHECKPOINT 0
+
+/**
+ * Set to 1 to enable wear leveling.
+ * Keeps an erase count for every disk page in a table supplied
+ * with battfs_wearInit(), uses the least worn free pages first and
+ * lets battfs_wearLevel() move cold data away from little worn pages.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_BATTFS_WEAR_LEVELING 0
+
+/**
+ * Number of free pages, starting from the oldest one, among which
+ * the least worn is chosen for every page write.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_BATTFS_WEAR_WINDOW 8
+
+/**
+ * Erase count difference between the most worn free page and the
+ * least worn page in use above which cold data is moved.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_BATTFS_WEAR_THRESHOLD 32
+
+/**
+ * Maximum write amplification due to cold data moves, as a percentage
+ * of the pages written by the user.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ * $WIZ$ max = 100
+ */
+#define CONFIG_BATTFS_WEAR_AMPLIFICATION 10
+
 
 #endif /* BATTFS */
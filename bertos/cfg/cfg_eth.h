@@ -62,5 +62,27 @@
  */
 #define CONFIG_PHY_CHIP     DAVICOM_DM9161A
 
+/**
+ * Zero-copy interface.
+ *
+ * Received frames are handed to the upper layer in the DMA buffers and
+ * frames to transmit are sent straight from the caller buffers, which are
+ * given back when the transmission is complete. Replaces the copying
+ * eth_putFrame()/eth_getFrame() interface.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_ETH_ZEROCOPY  0
+
+/**
+ * Receive DMA buffers that can be lent to the upper layer at the same
+ * time in zero-copy mode. Frames received over this limit are copied,
+ * so that the hardware is never left without buffers.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_ETH_RX_LENT   16
+
 
 #endif /* CFG_ETH_H */
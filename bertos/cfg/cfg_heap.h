@@ -45,6 +45,32 @@
  */
 #define CONFIG_HEAP_MALLOC     1
 
+/**
+ * Serve small heap_malloc() requests from per size class free lists.
+ *
+ * Blocks of each class are carved in batches from the heap and recycled
+ * in O(1) when freed, keeping small allocations out of the way of the
+ * big ones. Larger requests go through the usual first-fit allocator.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_HEAP_SLAB       0
+
+/**
+ * Number of size classes; class n holds blocks of
+ * (n + 1) * sizeof(MemChunk) bytes, including the malloc header.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_HEAP_SLAB_CLASSES  8
+
+/**
+ * Number of blocks carved from the heap when a size class runs empty.
+ * Bigger batches make refills rarer but park more memory in the classes.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_HEAP_SLAB_BATCH    8
+
 #endif /* CFG_HEAP_H */
 
 
@@ -61,4 +61,74 @@
  */
 #define HTTP_DEFAULT_PAGE      "index.htm"
 
+/**
+ * Number of worker processes serving the clients.
+ *
+ * With workers, http_poll() only accepts the connections and queues them,
+ * so that up to CONFIG_HTTP_WORKERS clients are served concurrently.
+ * Set to 0 to serve each client from http_poll() itself.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_HTTP_WORKERS    0
+
+/**
+ * Stack size of each worker process.
+ * The CGI handlers run on this stack.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_HTTP_WORKER_STACK  (KERN_MINSTACKSIZE * 4)
+
+/**
+ * Accepted connections waiting for a free worker.
+ * When the queue is full http_poll() blocks.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_HTTP_ACCEPT_QUEUE  4
+
+/**
+ * Persistent connections idle timeout in ms.
+ *
+ * A connection is kept open after a response whose length is known, and
+ * closed when no request arrives within this time.
+ * Set to 0 to close the connection after each response.
+ * Needs LWIP_SO_RCVTIMEO.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_HTTP_KEEPALIVE_TIMEOUT  0
+
+/**
+ * Maximum number of requests served on a persistent connection.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_HTTP_KEEPALIVE_MAX  100
+
+/**
+ * Request buffer size of each connection.
+ * Requests with longer headers and body are refused.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 64
+ */
+#define CONFIG_HTTP_REQ_SIZE   512
+
+/**
+ * Slots of the hash tables the CGI table is compiled into.
+ * Should be at least twice the number of entries of the CGI table; when
+ * they do not fit the table is walked linearly.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 2
+ */
+#define CONFIG_HTTP_CGI_SLOTS  32
+
 #endif /* CFG_HTTP_H */
@@ -0,0 +1,61 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Configuration file for the KFile over KBlock module.
+ */
+
+#ifndef CFG_KFILE_BLOCK_H
+#define CFG_KFILE_BLOCK_H
+
+/**
+ * Enable the streaming mode (kfileblock_initStream()): reads fetch the
+ * following blocks in advance and sequential writes are gathered in
+ * whole blocks, using a double or triple buffer.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_KFILE_BLOCK_STREAM  0
+
+/**
+ * Transfer the blocks of streams in a kernel process, while the caller
+ * goes on with the buffered data.
+ * Without it, read-ahead loads all the buffers with a single transfer.
+ * $WIZ$ type = "boolean"
+ * $WIZ$ conditional_deps = "kernel", "semaphores", "signal"
+ */
+#define CONFIG_KFILE_BLOCK_STREAM_ASYNC  0
+
+/**
+ * Stack size of the stream worker process.
+ * $WIZ$ type = "int"
+ */
+#define CONFIG_KFILE_BLOCK_STREAM_STACK  KERN_MINSTACKSIZE
+
+#endif /* CFG_KFILE_BLOCK_H */
@@ -1139,6 +1139,18 @@
 #define DEFAULT_THREAD_PRIO             1
 #endif
 
+/**
+ * Number of semaphores available to lwIP (see sys_sem_new()).
+ *
+ * Every netconn needs its own semaphore, plus a few more used by the
+ * sockets layer.
+ *
+ * $WIZ$ type = "int"; min = 4
+ */
+#ifndef SYS_SEM_POOL_SIZE
+#define SYS_SEM_POOL_SIZE               16
+#endif
+
 /**
  * DEFAULT_RAW_RECVMBOX_SIZE: The mailbox size for the incoming packets on a
  * NETCONN_RAW. The queue size value itself is platform-dependent, but is passed
@@ -44,4 +44,12 @@
  */
 #define CONFIG_KERN_MONITOR 0
 
+/**
+ * Per process CPU time and context switch accounting.
+ *
+ * Reads the high precision timer at each context switch.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_KERN_MONITOR_STATS 0
+
 #endif /*  CFG_MONITOR_H */
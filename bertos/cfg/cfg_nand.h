@@ -82,6 +82,43 @@
  */
 #define CONFIG_NAND_NUM_REMAP_BLOCKS  128
 
+/**
+ * Software ECC
+ *
+ * Compute a Hamming ECC for every 256 bytes of a page in software and
+ * correct single bit errors on read, instead of relying on the
+ * controller ECC. The ECC is written in the same program operation of
+ * the page data.
+ *
+ * $WIZ$ type = "boolean"
+ * $WIZ$ conditional_deps = "hamming"
+ */
+#define CONFIG_NAND_SW_ECC           0
+
+/**
+ * Cache operations
+ *
+ * Use cache program and sequential cache read to transfer a page while
+ * the chip is programming or loading the next one.
+ * Enable only if the chip supports ONFI cache operations.
+ * Page programs use it only with CONFIG_NAND_SW_ECC.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_NAND_CACHE_OPS        0
+
+/**
+ * Persistent remap table
+ *
+ * Save the bad block remap table in the last block of the NAND, so that
+ * initialization reads it back instead of scanning the blocks.
+ * The last block is no longer available for bad block remapping.
+ *
+ * $WIZ$ type = "boolean"
+ * $WIZ$ conditional_deps = "crc16"
+ */
+#define CONFIG_NAND_REMAP_TABLE      0
+
 /**
  * NAND operations timeout
  *
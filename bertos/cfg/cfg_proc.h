@@ -80,6 +80,28 @@
  */
 #define CONFIG_KERN_PRI_INHERIT 0
 
+/**
+ * Bitmap-indexed ready queue: one FIFO per priority level plus a bitmap
+ * of the non-empty levels, so that enqueue, dispatch and priority changes
+ * run in constant time.
+ *
+ * Useful with many processes; with only a few of them the default sorted
+ * list is smaller and just as fast.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_KERN_PRI_BITMAP 0
+
+/**
+ * Number of priority levels of the bitmap ready queue (max 32).
+ *
+ * Priorities from -levels/2 to levels/2 - 1 get their own level, values
+ * outside this range share the lowest or the highest level.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 2
+ * $WIZ$ max = 32
+ */
+#define CONFIG_KERN_PRI_LEVELS 32
+
 /**
  * Dynamic memory allocation for processes.
  * $WIZ$ type = "boolean"
@@ -94,6 +116,27 @@
  */
 #define CONFIG_KERN_HEAP_SIZE 2048L
 
+/**
+ * Recycle the stacks allocated by the kernel.
+ *
+ * The stack (and PCB) of an exited process is kept in a pool, sorted by
+ * size, and reused by the next proc_new() asking for a stack of the same
+ * size, without going through the heap. The pool gives the stacks back
+ * to the heap only when the heap runs out of memory.
+ *
+ * Needs CONFIG_KERN_HEAP.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_KERN_STACK_POOL 0
+
+/**
+ * Number of different stack sizes kept by the stack pool.
+ * Stacks of other sizes are given back to the heap.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_KERN_STACK_POOL_SIZES 4
+
 /**
  * Module logging level.
  *
@@ -44,4 +44,13 @@
  */
 #define CONFIG_KERN_SEMAPHORES  0
 
+/**
+ * Wake up the processes waiting on semaphores and read/write locks
+ * in priority order instead of FIFO order.
+ *
+ * Needs CONFIG_KERN_PRI.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_KERN_SEM_PRI_ORDER  0
+
 #endif /*  CFG_SEM_H */
@@ -66,5 +66,22 @@
  */
 #define CONFIG_SYSLOG_BUFSIZE 256
 
+/**
+ * Number of messages waiting to be sent.
+ * Messages logged when all of them are in use are dropped.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_SYSLOG_RING    8
+
+/**
+ * Stack size of the process sending the messages.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_SYSLOG_STACK   (KERN_MINSTACKSIZE * 4)
+
 
 #endif /* CFG_SYSLOG_H */
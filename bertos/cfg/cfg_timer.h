@@ -58,6 +58,49 @@
  */
 #define CONFIG_TIMER_EVENTS  1
 
+/**
+ * Keep asynchronous timers in a hierarchical timing wheel instead of
+ * a sorted list.
+ *
+ * Inserting and aborting a timer become O(1) and the work done by each
+ * timer interrupt is bounded, which pays off with many armed timers.
+ * Costs CONFIG_TIMER_WHEEL_LEVELS << CONFIG_TIMER_WHEEL_BITS list heads
+ * of RAM.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_TIMER_WHEEL  0
+
+/**
+ * Number of bits of the expire tick resolved by each wheel level.
+ * Every level has 1 << CONFIG_TIMER_WHEEL_BITS slots.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ * $WIZ$ max = 8
+ */
+#define CONFIG_TIMER_WHEEL_BITS  4
+
+/**
+ * Number of wheel levels.
+ * Timers expiring more than
+ * 1 << (CONFIG_TIMER_WHEEL_LEVELS * CONFIG_TIMER_WHEEL_BITS) ticks in the
+ * future are parked in an overflow list and rescanned once per wheel turn.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ * $WIZ$ max = 8
+ */
+#define CONFIG_TIMER_WHEEL_LEVELS  4
+
+/**
+ * Tickless mode: program the hardware timer for the next timer
+ * expiry (or the end of the running process quantum) instead of
+ * taking an interrupt at every tick. The system clock is caught up
+ * from the hardware counter when the interrupt fires or when it is read.
+ *
+ * Needs hardware support (TIMER_HW_TICKLESS).
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_TIMER_TICKLESS  0
+
 /**
  * Support hi-res timer_usleep().
  * $WIZ$ type = "boolean"
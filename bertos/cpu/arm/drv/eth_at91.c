@@ -58,6 +58,8 @@
 #include <drv/timer.h>
 #include <drv/eth.h>
 
+#include <kern/proc.h>
+
 #include <mware/event.h>
 
 #include <string.h>
@@ -69,12 +71,14 @@
 
 /* Silent Doxygen bug... */
 #ifndef __doxygen__
+#if !CONFIG_ETH_ZEROCOPY
 /*
  * NOTE: this buffer should be declared as 'volatile' because it is read by the
  * hardware. However, this is accessed only via memcpy() that should guarantee
  * coherency when copying from/to buffers.
  */
 static uint8_t tx_buf[EMAC_TX_BUFFERS * EMAC_TX_BUFSIZ] ALIGNED(8);
+#endif
 static volatile BufDescriptor tx_buf_tab[EMAC_TX_DESCRIPTORS] ALIGNED(8);
 
 /*
@@ -86,8 +90,22 @@ static uint8_t rx_buf[EMAC_RX_BUFFERS * EMAC_RX_BUFSIZ] ALIGNED(8);
 static volatile BufDescriptor rx_buf_tab[EMAC_RX_DESCRIPTORS] ALIGNED(8);
 #endif
 
+#if CONFIG_ETH_ZEROCOPY
+/* Receive buffers lent to the upper layer */
+STATIC_ASSERT(EMAC_RX_BUFFERS <= 32);
+static uint32_t rx_lent;
+
+/*
+ * Transmit ring: frames are queued at tx_head and collected at tx_tail,
+ * each one taking tx_cnt descriptors.
+ */
+static void *tx_ctx[EMAC_TX_DESCRIPTORS];
+static int tx_cnt[EMAC_TX_DESCRIPTORS];
+static int tx_head, tx_tail, tx_free;
+#else
 static int tx_buf_idx;
 static int tx_buf_offset;
+#endif
 static int rx_buf_idx;
 
 static Event recv_wait, send_wait;
@@ -108,7 +126,13 @@ static DECLARE_ISR(emac_irqHandler)
 	if (isr & EMAC_TX_INTS)
 	{
 		if (isr & BV(EMAC_TCOMP))
+		{
 			event_do(&send_wait);
+			#if CONFIG_ETH_ZEROCOPY
+				/* Sent frames are collected by the receiving process too */
+				event_do(&recv_wait);
+			#endif
+		}
 		EMAC_TSR = EMAC_TX_INTS;
 	}
 	AIC_EOICR = 0;
@@ -268,12 +292,20 @@ static void emac_start(void)
 
 	for (i = 0; i < EMAC_TX_DESCRIPTORS; i++)
 	{
-		addr = (uint32_t)(tx_buf + (i * EMAC_TX_BUFSIZ));
-		tx_buf_tab[i].addr = addr & BUF_ADDRMASK;
+		#if !CONFIG_ETH_ZEROCOPY
+			addr = (uint32_t)(tx_buf + (i * EMAC_TX_BUFSIZ));
+			tx_buf_tab[i].addr = addr & BUF_ADDRMASK;
+		#endif
 		tx_buf_tab[i].stat = TXS_USED;
 	}
 	tx_buf_tab[EMAC_TX_DESCRIPTORS - 1].stat = TXS_USED | TXS_WRAP;
 
+	#if CONFIG_ETH_ZEROCOPY
+		rx_lent = 0;
+		tx_head = tx_tail = 0;
+		tx_free = EMAC_TX_DESCRIPTORS;
+	#endif
+
 	/* Tell the EMAC where to find the descriptors. */
 	EMAC_RBQP = (uint32_t)rx_buf_tab;
 	EMAC_TBQP = (uint32_t)tx_buf_tab;
@@ -288,6 +320,8 @@ static void emac_start(void)
 	EMAC_NCR |= BV(EMAC_TE) | BV(EMAC_RE) | BV(EMAC_WESTAT);
 }
 
+#if !CONFIG_ETH_ZEROCOPY
+
 ssize_t eth_putFrame(const uint8_t *buf, size_t len)
 {
 	size_t wr_len;
@@ -332,6 +366,18 @@ ssize_t eth_send(const uint8_t *buf, size_t len)
 	return len;
 }
 
+#endif /* !CONFIG_ETH_ZEROCOPY */
+
+/* Buffer filled by the EMAC, not lent to the upper layer */
+INLINE bool rxFilled(int idx)
+{
+	#if CONFIG_ETH_ZEROCOPY
+		if (rx_lent & BV32(idx))
+			return false;
+	#endif
+	return rx_buf_tab[idx].addr & RXBUF_OWNERSHIP;
+}
+
 static void eth_buf_realign(int idx)
 {
 	/* Empty buffer found. Realign. */
@@ -348,7 +394,7 @@ static size_t __eth_getFrameLen(void)
 
 skip:
 	/* Skip empty buffers */
-	while ((n > 0) && !(rx_buf_tab[rx_buf_idx].addr & RXBUF_OWNERSHIP))
+	while ((n > 0) && !rxFilled(rx_buf_idx))
 	{
 		if (++rx_buf_idx >= EMAC_RX_BUFFERS)
 			rx_buf_idx = 0;
@@ -360,7 +406,7 @@ skip:
 		return 0;
 	}
 	/* Search the start of frame and cleanup fragments */
-	while ((n > 0) && (rx_buf_tab[rx_buf_idx].addr & RXBUF_OWNERSHIP) &&
+	while ((n > 0) && rxFilled(rx_buf_idx) &&
 			!(rx_buf_tab[rx_buf_idx].stat & RXS_SOF))
 	{
 		rx_buf_tab[rx_buf_idx].addr &= ~RXBUF_OWNERSHIP;
@@ -378,7 +424,7 @@ skip:
 restart:
 	while (n > 0)
 	{
-		if (UNLIKELY(!(rx_buf_tab[idx].addr & RXBUF_OWNERSHIP)))
+		if (UNLIKELY(!rxFilled(idx)))
 		{
 			/* Empty buffer found. Realign. */
 			eth_buf_realign(idx);
@@ -401,6 +447,128 @@ restart:
 	return 0;
 }
 
+#if CONFIG_ETH_ZEROCOPY
+
+INLINE bool txDone(void)
+{
+	return tx_free < EMAC_TX_DESCRIPTORS && (tx_buf_tab[tx_tail].stat & TXS_USED);
+}
+
+int eth_rxGet(EthBuf *buf, int count)
+{
+	size_t len;
+	int n, i;
+
+	while (1)
+	{
+		/* Wait for a frame, or for a sent frame to collect */
+		while (!(len = __eth_getFrameLen()))
+		{
+			if (txDone())
+				return 0;
+			event_wait(&recv_wait);
+		}
+
+		/* Lend the buffers, dropping frames that do not fit buf */
+		n = DIV_ROUNDUP(len, EMAC_RX_BUFSIZ);
+		for (i = 0; i < n; i++)
+		{
+			if (n <= count)
+			{
+				buf[i].data = rx_buf + rx_buf_idx * EMAC_RX_BUFSIZ;
+				buf[i].len = MIN(len - i * EMAC_RX_BUFSIZ, (size_t)EMAC_RX_BUFSIZ);
+				PROC_ATOMIC(rx_lent |= BV32(rx_buf_idx));
+			}
+			else
+				rx_buf_tab[rx_buf_idx].addr &= ~RXBUF_OWNERSHIP;
+			if (++rx_buf_idx >= EMAC_RX_BUFFERS)
+				rx_buf_idx = 0;
+		}
+		if (LIKELY(n <= count))
+			return n;
+		LOG_INFO("frame too long\n");
+	}
+}
+
+void eth_rxPut(const uint8_t *data)
+{
+	int idx = (data - rx_buf) / EMAC_RX_BUFSIZ;
+
+	ASSERT(idx >= 0 && idx < EMAC_RX_BUFFERS);
+	ASSERT(rx_lent & BV32(idx));
+
+	PROC_ATOMIC(
+		rx_buf_tab[idx].addr &= ~RXBUF_OWNERSHIP;
+		rx_lent &= ~BV32(idx);
+	);
+}
+
+int eth_txPut(const EthBuf *buf, int count, void *ctx)
+{
+	int i, idx;
+
+	ASSERT(ctx);
+	ASSERT(count > 0 && count <= MIN(ETH_FRAME_BUFS, EMAC_TX_DESCRIPTORS));
+
+	proc_forbid();
+	if (count > tx_free)
+	{
+		proc_permit();
+		return -1;
+	}
+
+	/* Hand over the first descriptor last, the EMAC may be running */
+	for (i = count - 1; i >= 0; i--)
+	{
+		idx = (tx_head + i) % EMAC_TX_DESCRIPTORS;
+		tx_buf_tab[idx].addr = (uint32_t)buf[i].data;
+		tx_buf_tab[idx].stat = (buf[i].len & TXS_LENGTH_FRAME) |
+			((i == count - 1) ? TXS_LAST_BUFF : 0) |
+			((idx == EMAC_TX_DESCRIPTORS - 1) ? TXS_WRAP : 0);
+	}
+	tx_ctx[tx_head] = ctx;
+	tx_cnt[tx_head] = count;
+	tx_head = (tx_head + count) % EMAC_TX_DESCRIPTORS;
+	tx_free -= count;
+	EMAC_NCR |= BV(EMAC_TSTART);
+	proc_permit();
+
+	return 0;
+}
+
+void *eth_txGet(bool wait)
+{
+	void *ctx;
+	int i, idx;
+
+	while (!txDone())
+	{
+		if (!wait || tx_free == EMAC_TX_DESCRIPTORS)
+			return NULL;
+		event_wait(&send_wait);
+	}
+
+	/*
+	 * The EMAC marks only the first descriptor of a sent frame as used:
+	 * mark the others too, so that they are not sent again.
+	 */
+	proc_forbid();
+	ctx = tx_ctx[tx_tail];
+	for (i = 0; i < tx_cnt[tx_tail]; i++)
+	{
+		idx = (tx_tail + i) % EMAC_TX_DESCRIPTORS;
+		tx_buf_tab[idx].stat = TXS_USED |
+			((idx == EMAC_TX_DESCRIPTORS - 1) ? TXS_WRAP : 0);
+	}
+	tx_free += tx_cnt[tx_tail];
+	tx_tail = (tx_tail + tx_cnt[tx_tail]) % EMAC_TX_DESCRIPTORS;
+	proc_permit();
+
+	return ctx;
+}
+
+#else /* !CONFIG_ETH_ZEROCOPY */
+
 size_t eth_getFrameLen(void)
 {
 	size_t len;
@@ -467,6 +635,8 @@ ssize_t eth_recv(uint8_t *buf, size_t len)
 	return len ? eth_getFrame(buf, len) : 0;
 }
 
+#endif /* CONFIG_ETH_ZEROCOPY */
+
 int eth_init()
 {
 	cpu_flags_t flags;
@@ -39,11 +39,18 @@
 #ifndef ETH_AT91_H
 #define ETH_AT91_H
 
+#include "cfg/cfg_eth.h"
+
 #include <cpu/types.h>
 
-#define EMAC_TX_BUFSIZ          1518  //!!! Don't change this
-#define EMAC_TX_BUFFERS         1     //!!! Don't change this
-#define EMAC_TX_DESCRIPTORS     EMAC_TX_BUFFERS
+#if CONFIG_ETH_ZEROCOPY
+	/* Frames are sent straight from the caller buffers */
+	#define EMAC_TX_DESCRIPTORS     16
+#else
+	#define EMAC_TX_BUFSIZ          1518  //!!! Don't change this
+	#define EMAC_TX_BUFFERS         1     //!!! Don't change this
+	#define EMAC_TX_DESCRIPTORS     EMAC_TX_BUFFERS
+#endif
 
 #define EMAC_RX_BUFFERS         32    //!!! Don't change this
 #define EMAC_RX_BUFSIZ          128   //!!! Don't change this
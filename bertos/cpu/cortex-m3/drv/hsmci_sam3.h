@@ -79,6 +79,15 @@ INLINE void hsmci_setBusWidth(size_t len)
 	HSMCI_SDCR = (sdcsel << HSMCI_SDCR_SDCBUS_SHIFT) & HSMCI_SDCR_SDCBUS_MASK;
 }
 
+/**
+ * Set the number of blocks of the next multiple block transfer,
+ * call it after hsmci_read() or hsmci_write().
+ */
+INLINE void hsmci_setBlockCount(size_t count)
+{
+	HSMCI_BLKR = (HSMCI_BLKR & ~HSMCI_BLKR_BCNT_MASK) | (count & HSMCI_BLKR_BCNT_MASK);
+}
+
 void hsmci_readResp(uint32_t *resp, size_t len);
 bool hsmci_sendCmd(uint8_t index, uint32_t argument, uint32_t reply_type);
 
@@ -129,7 +129,8 @@ void nand_sendCommand(Nand *chip,
 		| cmd2 << 10;
 
 	// Check for commands transferring data
-	if (cmd1 == NAND_CMD_WRITE_1 || cmd1 == NAND_CMD_READ_1 || cmd1 == NAND_CMD_READID)
+	if (cmd1 == NAND_CMD_WRITE_1 || cmd1 == NAND_CMD_READ_1 || cmd1 == NAND_CMD_READID
+			|| cmd1 == NAND_CMD_READ_CACHE_SEQ || cmd1 == NAND_CMD_READ_CACHE_END)
 		cmd_val |= NFC_CMD_NFCEN;
 
 	// Check for commands writing data
@@ -694,6 +694,90 @@ static size_t sd_SdWriteDirect(KBlock *b, block_idx_t idx, const void *buf, size
 }
 
 
+static int sd_stopTransmission(Sd *sd)
+{
+	if (hsmci_sendCmd(12, 0, HSMCI_CMDR_RSPTYP_R1B | HSMCI_CMDR_TRCMD_STOP_DATA))
+	{
+		LOG_ERR("STOP_TRANSMISSION: %lx\n", HSMCI_SR);
+		sd->status |= SD_STATUS_ERROR;
+		return -1;
+	}
+
+	HSMCI_CHECK_BUSY();
+	hsmci_readResp(&(sd->status), 1);
+	LOG_INFOB(dump("STOP_TRANSMISSION", &(sd->status), 1););
+
+	return 0;
+}
+
+static block_idx_t sd_SdReadBlocks(KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	ASSERT(buf);
+	ASSERT(!((uint32_t)buf & 0x3));
+
+	Sd *sd = SD_CAST(b);
+	LOG_INFO("reading %ld blocks from block %ld\n", count, idx);
+
+	hsmci_waitTransfer();
+	hsmci_read(buf, count * sd->b.blk_size / 4, sd->b.blk_size);
+	hsmci_setBlockCount(count);
+
+	if (hsmci_sendCmd(18, idx * sd->b.blk_size, HSMCI_CMDR_RSPTYP_48_BIT |
+			BV(HSMCI_CMDR_TRDIR) | HSMCI_CMDR_TRCMD_START_DATA | HSMCI_CMDR_TRTYP_MULTIPLE))
+	{
+		LOG_ERR("MULTI_BLK_READ: %lx\n", HSMCI_SR);
+		return 0;
+	}
+
+	hsmci_readResp(&(sd->status), 1);
+
+	LOG_INFOB(dump("MULTI_BLK_READ", &(sd->status), 1););
+	LOG_INFO("State[%d]\n", SD_GET_STATE(sd->status));
+
+	if (sd->status & SD_STATUS_READY)
+	{
+		hsmci_waitTransfer();
+		if (sd_stopTransmission(sd) == 0)
+			return count;
+	}
+	return 0;
+}
+
+static block_idx_t sd_SdWriteBlocks(KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	ASSERT(buf);
+	ASSERT(!((uint32_t)buf & 0x3));
+
+	Sd *sd = SD_CAST(b);
+	const uint32_t *_buf = (const uint32_t *)buf;
+	LOG_INFO("writing %ld blocks from block %ld\n", count, idx);
+
+	hsmci_waitTransfer();
+	hsmci_write(_buf, count * sd->b.blk_size / 4, sd->b.blk_size);
+	hsmci_setBlockCount(count);
+
+	if (hsmci_sendCmd(25, idx * sd->b.blk_size, HSMCI_CMDR_RSPTYP_48_BIT |
+						HSMCI_CMDR_TRCMD_START_DATA | HSMCI_CMDR_TRTYP_MULTIPLE))
+	{
+		LOG_ERR("MULTI_BLK_WRITE: %lx\n", HSMCI_SR);
+		return 0;
+	}
+
+	hsmci_readResp(&(sd->status), 1);
+
+	LOG_INFOB(dump("MULTI_BLK_WR", &(sd->status), 1););
+	LOG_INFO("State[%d]\n", SD_GET_STATE(sd->status));
+
+	if (sd->status & SD_STATUS_READY)
+	{
+		hsmci_waitTransfer();
+		if (sd_stopTransmission(sd) == 0)
+			return count;
+	}
+	return 0;
+}
+
+
 static int sd_SdError(KBlock *b)
 {
 	Sd *sd = SD_CAST(b);
@@ -796,6 +880,8 @@ static const KBlockVTable sd_unbuffered_vt =
 {
 	.readDirect = sd_SdReadDirect,
 	.writeDirect = sd_SdWriteDirect,
+	.readBlocks = sd_SdReadBlocks,
+	.writeBlocks = sd_SdWriteBlocks,
 
 	.error = sd_SdError,
 	.clearerr = sd_SdClearerr,
@@ -805,6 +891,8 @@ static const KBlockVTable sd_buffered_vt =
 {
 	.readDirect = sd_SdReadDirect,
 	.writeDirect = sd_SdWriteDirect,
+	.readBlocks = sd_SdReadBlocks,
+	.writeBlocks = sd_SdWriteBlocks,
 
 	.readBuf = kblock_swReadBuf,
 	.writeBuf = kblock_swWriteBuf,
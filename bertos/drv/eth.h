@@ -125,6 +125,63 @@ INLINE bool eth_addrCmp(const uint8_t *addr1, const uint8_t *addr2)
 			(addr1[5] ^ addr2[5]));
 }
 
+#if CONFIG_ETH_ZEROCOPY
+
+/** Maximum number of buffers of a frame in the zero-copy interface. */
+#define ETH_FRAME_BUFS  16
+
+/**
+ * A buffer holding a piece of a frame.
+ */
+typedef struct EthBuf
+{
+	uint8_t *data;
+	size_t len;
+} EthBuf;
+
+/**
+ * Lend the buffers of the next received frame.
+ *
+ * Waits until a frame is received or a transmission is complete: in the
+ * latter case returns 0, so that the caller can collect the transmitted
+ * frames with eth_txGet().
+ *
+ * \param buf    filled with the DMA buffers holding the frame, in order
+ * \param count  size of \a buf, at least ETH_FRAME_BUFS
+ * \return number of buffers of the frame.
+ *
+ * Every buffer must be given back with eth_rxPut().
+ */
+int eth_rxGet(EthBuf *buf, int count);
+
+/**
+ * Give back the receive buffer holding \a data to the hardware.
+ */
+void eth_rxPut(const uint8_t *data);
+
+/**
+ * Queue a frame for transmission, without copying it.
+ *
+ * \param buf    the buffers holding the frame, in order
+ * \param count  number of buffers
+ * \param ctx    not NULL, returned by eth_txGet() once the frame has been sent
+ * \return 0 on success, -1 if there is no room for the frame.
+ *
+ * The buffers must not be changed until the frame has been sent.
+ */
+int eth_txPut(const EthBuf *buf, int count, void *ctx);
+
+/**
+ * Collect the oldest transmitted frame.
+ *
+ * \param wait  if true and frames are being sent, wait for the oldest.
+ * \return the \a ctx of the frame passed to eth_txPut(), or NULL if no
+ *         frame has been sent.
+ */
+void *eth_txGet(bool wait);
+
+#else /* !CONFIG_ETH_ZEROCOPY */
+
 ssize_t eth_putFrame(const uint8_t *buf, size_t len);
 void eth_sendFrame(void);
 
@@ -134,6 +191,8 @@ ssize_t eth_getFrame(uint8_t *buf, size_t len);
 ssize_t eth_send(const uint8_t *buf, size_t len);
 ssize_t eth_recv(uint8_t *buf, size_t len);
 
+#endif /* CONFIG_ETH_ZEROCOPY */
+
 int eth_init(void);
 
 #endif /* DRV_ETH_H */
@@ -45,7 +45,13 @@
 * to detect formatted blocks and an index for bad block remapping (struct
 * RemapInfo).
 *
-* The ECC for each page is written in the spare area too.
+* The ECC for each page is written in the spare area too. It can be
+* computed by the NAND controller or in software (CONFIG_NAND_SW_ECC):
+* the software Hamming ECC corrects single bit errors every 256 bytes.
+*
+* With CONFIG_NAND_REMAP_TABLE the remap table is also saved in the
+* last block of the NAND after the first scan: the next initializations
+* read a single page.
 *
 * Works only in 8 bit data mode and NAND parameters are not
 * detected at run-time, but hand-configured in cfg_nand.h.
@@ -63,6 +69,13 @@
 #include <struct/heap.h>
 #include <string.h> // memset
 
+#if CONFIG_NAND_SW_ECC
+	#include <algo/hamming.h>
+#endif
+#if CONFIG_NAND_REMAP_TABLE
+	#include <algo/crc.h>
+#endif
+
 
 /*
  * Remap info written in the first page of each block.
@@ -92,6 +105,17 @@ struct RemapInfo
  */
 #define NAND_ECC_NWORDS        (CONFIG_NAND_DATA_SIZE / 256)
 
+#if CONFIG_NAND_SW_ECC
+	/*
+	 * Where the software ECC is stored in the spare area: the first bytes
+	 * are left for the bad block mark.
+	 */
+	#define NAND_ECC_OFFSET    2
+
+	STATIC_ASSERT(NAND_ECC_OFFSET + CONFIG_NAND_DATA_SIZE / HAMMING_BLOCK_SIZE * HAMMING_ECC_SIZE
+		<= CONFIG_NAND_SPARE_SIZE - sizeof(struct RemapInfo));
+#endif
+
 // Total page size (user data + spare) in bytes
 #define NAND_PAGE_SIZE         (CONFIG_NAND_DATA_SIZE + CONFIG_NAND_SPARE_SIZE)
 
@@ -101,6 +125,17 @@ struct RemapInfo
 // Number of usable blocks, and index of first remapping block
 #define NAND_NUM_USER_BLOCKS   (CONFIG_NAND_NUM_BLOCK - CONFIG_NAND_NUM_REMAP_BLOCKS)
 
+#if CONFIG_NAND_REMAP_TABLE
+	// Block holding the remap table, and end of remapping blocks
+	#define NAND_TABLE_BLOCK   (CONFIG_NAND_NUM_BLOCK - 1)
+	#define NAND_REMAP_END     NAND_TABLE_BLOCK
+
+	// Fixed tag to detect the remap table
+	#define NAND_TABLE_TAG     0x7ab1e3ed
+#else
+	#define NAND_REMAP_END     CONFIG_NAND_NUM_BLOCK
+#endif
+
 // ONFI NAND status codes
 #define NAND_STATUS_READY  BV(6)
 #define NAND_STATUS_ERROR  BV(0)
@@ -203,7 +238,7 @@ bool nand_getDevId(Nand *chip, uint8_t dev_id[5])
 		return false;
 	}
 
-	memcpy(dev_id, nand_dataBuffer(chip), sizeof(dev_id));
+	memcpy(dev_id, nand_dataBuffer(chip), 5);
 	return true;
 }
 
@@ -231,41 +266,110 @@ static bool nand_readPage(Nand *chip, uint32_t page, uint16_t offset)
 }
 
 
+#if CONFIG_NAND_CACHE_OPS
+
 /*
- * Read page data and ECC, checking for errors.
- * TODO: fix errors with ECC when possible.
+ * Sequential cache read: get the page loaded by the previous read command
+ * while the chip loads the next one, unless \a last is true.
+ * A sequence starts with nand_readPage() on its first page.
  */
-static bool nand_read(Nand *chip, uint32_t page, void *buf, uint16_t offset, uint16_t size)
+static bool nand_readCache(Nand *chip, bool last)
 {
-	struct RemapInfo remap_info;
-	uint32_t remapped_page = PAGE(chip->block_map[BLOCK(page)]) + PAGE_IN_BLOCK(page);
+	nand_sendCommand(chip, last ? NAND_CMD_READ_CACHE_END : NAND_CMD_READ_CACHE_SEQ, 0, 0, 0, 0);
+
+	nand_waitReadyBusy(chip, CONFIG_NAND_TMOUT);
+	if (!nand_waitTransferComplete(chip, CONFIG_NAND_TMOUT))
+	{
+		LOG_ERR("nand: cache read timeout\n");
+		chip->status |= NAND_ERR_RD_TMOUT;
+		return false;
+	}
+
+	return true;
+}
+
+#endif
 
-	//LOG_INFO("nand_read: page=%ld, offset=%d, size=%d\n", page, offset, size);
+
+/*
+ * Translate a page in the user partition to the page actually
+ * holding its data.
+ */
+static uint32_t remapPage(Nand *chip, uint32_t page)
+{
+	uint32_t remapped_page = PAGE(chip->block_map[BLOCK(page)]) + PAGE_IN_BLOCK(page);
 
 	if (page != remapped_page)
-	{
-		LOG_INFO("nand_read: remapped block: blk %d->%d, pg %ld->%ld\n",
+		LOG_INFO("nand: remapped block: blk %d->%d, pg %ld->%ld\n",
 				BLOCK(page), chip->block_map[BLOCK(page)], page, remapped_page);
-		page = remapped_page;
-	}
 
-	if (!nand_readPage(chip, page, 0))
-		return false;
+	return remapped_page;
+}
 
-	memcpy(buf, (char *)nand_dataBuffer(chip) + offset, size);
+
+/*
+ * Copy page data from nand_dataBuffer(), just loaded with a whole page,
+ * checking for errors.
+ */
+static bool nand_readBuffer(Nand *chip, void *buf, uint16_t offset, uint16_t size)
+{
+	uint8_t *nand_buf = (uint8_t *)nand_dataBuffer(chip);
+	struct RemapInfo remap_info;
 
 	/*
-	 * Check for ECC hardware status only if a valid RemapInfo structure is found.
+	 * Check ECC only if a valid RemapInfo structure is found.
 	 * That guarantees the page is written by us and a valid ECC is present.
 	 */
-	memcpy(&remap_info, (char *)buf + NAND_REMAP_TAG_OFFSET, sizeof(remap_info));
-	if (remap_info.tag == NAND_REMAP_TAG && !nand_checkEcc(chip))
+	memcpy(&remap_info, nand_buf + CONFIG_NAND_DATA_SIZE + NAND_REMAP_TAG_OFFSET, sizeof(remap_info));
+	if (remap_info.tag == NAND_REMAP_TAG)
 	{
-		chip->status |= NAND_ERR_ECC;
-		return false;
+	#if CONFIG_NAND_SW_ECC
+		// Only the ECC blocks holding the requested data are checked
+		uint16_t i = offset / HAMMING_BLOCK_SIZE;
+		uint16_t end = (offset + size + HAMMING_BLOCK_SIZE - 1) / HAMMING_BLOCK_SIZE;
+		uint8_t ecc[HAMMING_ECC_SIZE];
+
+		for (; i < end; i++)
+		{
+			uint8_t *data = nand_buf + i * HAMMING_BLOCK_SIZE;
+			const uint8_t *read_ecc = nand_buf + CONFIG_NAND_DATA_SIZE + NAND_ECC_OFFSET + i * HAMMING_ECC_SIZE;
+
+			hamming_compute(data, ecc);
+			switch (hamming_correct(data, read_ecc, ecc))
+			{
+			case HAMMING_CORRECTED:
+				LOG_INFO("nand: bit error corrected\n");
+				chip->corrected++;
+				break;
+			case HAMMING_ERROR:
+				LOG_ERR("nand: uncorrectable ECC error\n");
+				chip->status |= NAND_ERR_ECC;
+				return false;
+			}
+		}
+	#else
+		if (!nand_checkEcc(chip))
+		{
+			chip->status |= NAND_ERR_ECC;
+			return false;
+		}
+	#endif
 	}
-	else
-		return true;
+
+	memcpy(buf, nand_buf + offset, size);
+	return true;
+}
+
+
+/*
+ * Read page data and ECC, checking for errors.
+ */
+static bool nand_read(Nand *chip, uint32_t page, void *buf, uint16_t offset, uint16_t size)
+{
+	//LOG_INFO("nand_read: page=%ld, offset=%d, size=%d\n", page, offset, size);
+
+	return nand_readPage(chip, remapPage(chip, page), 0)
+		&& nand_readBuffer(chip, buf, offset, size);
 }
 
 
@@ -273,8 +377,12 @@ static bool nand_read(Nand *chip, uint32_t page, void *buf, uint16_t offset, uin
  * Write data stored in nand_dataBuffer() to a NAND page, starting at a given offset.
  * Usually offset will be 0 to write data or CONFIG_NAND_DATA_SIZE to write the spare
  * area.
+ *
+ * With \a cache the page is programmed with a cache program operation:
+ * the function returns as soon as the chip can accept the next page.
+ * The last page of a sequence must be written without.
  */
-static bool nand_writePage(Nand *chip, uint32_t page, uint16_t offset)
+static bool nand_writePage(Nand *chip, uint32_t page, uint16_t offset, bool cache)
 {
 	uint32_t cycle0;
 	uint32_t cycle1234;
@@ -292,7 +400,7 @@ static bool nand_writePage(Nand *chip, uint32_t page, uint16_t offset)
 		return false;
 	}
 
-	nand_sendCommand(chip, NAND_CMD_WRITE_2, 0, 0, 0, 0);
+	nand_sendCommand(chip, cache ? NAND_CMD_CACHE_PROGRAM : NAND_CMD_WRITE_2, 0, 0, 0, 0);
 
 	nand_waitReadyBusy(chip, CONFIG_NAND_TMOUT);
 
@@ -307,11 +415,47 @@ static bool nand_writePage(Nand *chip, uint32_t page, uint16_t offset)
 }
 
 
+#if CONFIG_NAND_SW_ECC
+
+/*
+ * Write data, ECC and remap block info with a single program operation.
+ *
+ * \param page   the page to be written
+ * \param cache  true to use a cache program operation, see nand_writePage()
+ */
+static bool nand_write(Nand *chip, uint32_t page, const void *buf, size_t size, bool cache)
+{
+	struct RemapInfo remap_info;
+	uint8_t *nand_buf = (uint8_t *)nand_dataBuffer(chip);
+	uint8_t *spare = nand_buf + CONFIG_NAND_DATA_SIZE;
+	int i;
+
+	ASSERT(size <= CONFIG_NAND_DATA_SIZE);
+
+	// Data
+	memset(nand_buf, 0xff, NAND_PAGE_SIZE);
+	memcpy(nand_buf, buf, size);
+
+	// ECC
+	for (i = 0; i < CONFIG_NAND_DATA_SIZE / HAMMING_BLOCK_SIZE; i++)
+		hamming_compute(nand_buf + i * HAMMING_BLOCK_SIZE, spare + NAND_ECC_OFFSET + i * HAMMING_ECC_SIZE);
+
+	// Remap info
+	remap_info.tag = NAND_REMAP_TAG;
+	remap_info.mapped_blk = BLOCK(page);
+	memcpy(spare + NAND_REMAP_TAG_OFFSET, &remap_info, sizeof(remap_info));
+
+	return nand_writePage(chip, remapPage(chip, page), 0, cache);
+}
+
+#else
+
 /*
  * Write data, ECC and remap block info.
  *
  * \param page           the page to be written
- * \parma original_page  if different from page, it's the page that's being remapped
+ * \param cache          ignored: the page is programmed twice, so no cache
+ *                       program operation can be used
  *
  * Implementation note for SAM3 NFC controller:
  * according to datasheet to get ECC computed by hardware is sufficient
@@ -320,22 +464,18 @@ static bool nand_writePage(Nand *chip, uint32_t page, uint16_t offset)
  * spare data in one write, at this point the last ECC_PR is correct and
  * ECC data can be written in the spare area with a second program operation.
  */
-static bool nand_write(Nand *chip, uint32_t page, const void *buf, size_t size)
+static bool nand_write(Nand *chip, uint32_t page, const void *buf, size_t size, UNUSED_ARG(bool, cache))
 {
 	struct RemapInfo remap_info;
 	uint32_t *nand_buf = (uint32_t *)nand_dataBuffer(chip);
-	uint32_t remapped_page = PAGE(chip->block_map[BLOCK(page)]) + PAGE_IN_BLOCK(page);
+	uint32_t remapped_page = remapPage(chip, page);
 
 	ASSERT(size <= CONFIG_NAND_DATA_SIZE);
 
-	if (page != remapped_page)
-		LOG_INFO("nand_write: remapped block: blk %d->%d, pg %ld->%ld\n",
-				BLOCK(page), chip->block_map[BLOCK(page)], page, remapped_page);
-
 	// Data
 	memset(nand_buf, 0xff, NAND_PAGE_SIZE);
 	memcpy(nand_buf, buf, size);
-	if (!nand_writePage(chip, remapped_page, 0))
+	if (!nand_writePage(chip, remapped_page, 0, false))
 		return false;
 
 	// ECC
@@ -347,9 +487,11 @@ static bool nand_write(Nand *chip, uint32_t page, const void *buf, size_t size)
 	remap_info.mapped_blk = BLOCK(page);
 	memcpy((char *)nand_buf + NAND_REMAP_TAG_OFFSET, &remap_info, sizeof(remap_info));
 
-	return nand_writePage(chip, remapped_page, CONFIG_NAND_DATA_SIZE);
+	return nand_writePage(chip, remapped_page, CONFIG_NAND_DATA_SIZE, false);
 }
 
+#endif
+
 
 /*
  * Check if the given block is marked bad: ONFI standard mandates
@@ -406,7 +548,7 @@ static bool setMapping(Nand *chip, uint32_t src_blk, uint32_t dest_blk)
 	remap_info->tag = NAND_REMAP_TAG;
 	remap_info->mapped_blk = src_blk;
 
-	return nand_writePage(chip, PAGE(dest_blk), CONFIG_NAND_DATA_SIZE + NAND_REMAP_TAG_OFFSET);
+	return nand_writePage(chip, PAGE(dest_blk), CONFIG_NAND_DATA_SIZE + NAND_REMAP_TAG_OFFSET, false);
 }
 
 
@@ -418,7 +560,7 @@ static uint16_t getFreeRemapBlock(Nand *chip)
 {
 	int blk;
 
-	for (blk = chip->remap_start; blk < CONFIG_NAND_NUM_BLOCK; blk++)
+	for (blk = chip->remap_start; blk < NAND_REMAP_END; blk++)
 	{
 		if (blockIsGood(chip, blk))
 		{
@@ -441,6 +583,112 @@ static bool chipIsMarked(Nand *chip)
 }
 
 
+#if CONFIG_NAND_REMAP_TABLE
+
+/*
+ * Remap table header, followed by pairs of bad block and remapping block
+ * and by the CRC16 of all of them.
+ */
+struct RemapTable
+{
+	uint32_t tag;          // Magic number to detect a valid table
+	uint16_t remap_start;  // First unused remap block
+	uint16_t count;        // Number of remapped blocks
+};
+
+STATIC_ASSERT(sizeof(struct RemapTable) + CONFIG_NAND_NUM_REMAP_BLOCKS * 2 * sizeof(uint16_t)
+	+ sizeof(uint16_t) <= CONFIG_NAND_DATA_SIZE);
+
+/*
+ * Load the block map from the remap table.
+ * Return false if the table is missing or damaged.
+ */
+static bool loadRemapTable(Nand *chip)
+{
+	uint8_t *buf = (uint8_t *)nand_dataBuffer(chip);
+	struct RemapTable table;
+	uint16_t pair[2];
+	uint16_t crc;
+	size_t size;
+	int i;
+
+	if (!nand_readPage(chip, PAGE(NAND_TABLE_BLOCK), 0))
+		return false;
+
+	memcpy(&table, buf, sizeof(table));
+	if (table.tag != NAND_TABLE_TAG || table.count > CONFIG_NAND_NUM_REMAP_BLOCKS)
+		return false;
+
+	size = sizeof(table) + table.count * sizeof(pair);
+	memcpy(&crc, buf + size, sizeof(crc));
+	if (crc != crc16(0, buf, size))
+	{
+		LOG_WARN("nand: remap table damaged\n");
+		return false;
+	}
+
+	for (i = 0; i < table.count; i++)
+	{
+		memcpy(pair, buf + sizeof(table) + i * sizeof(pair), sizeof(pair));
+		if (pair[0] >= NAND_NUM_USER_BLOCKS || pair[1] < NAND_NUM_USER_BLOCKS || pair[1] >= NAND_REMAP_END)
+			return false;
+		chip->block_map[pair[0]] = pair[1];
+	}
+	chip->remap_start = table.remap_start;
+
+	LOG_INFO("nand: remap table loaded, %d remapped blocks\n", table.count);
+	return true;
+}
+
+/*
+ * Save the block map in the remap table.
+ */
+static void saveRemapTable(Nand *chip)
+{
+	uint8_t *buf = (uint8_t *)nand_dataBuffer(chip);
+	struct RemapTable table;
+	uint16_t pair[2];
+	uint16_t crc;
+	size_t size;
+	int b;
+
+	// The last block may be in use on NANDs formatted without the table
+	if (chip->remap_start > NAND_TABLE_BLOCK || !blockIsGood(chip, NAND_TABLE_BLOCK))
+	{
+		LOG_WARN("nand: no room for the remap table\n");
+		return;
+	}
+
+	if (nand_blockErase(chip, NAND_TABLE_BLOCK))
+		return;
+
+	memset(buf, 0xff, NAND_PAGE_SIZE);
+
+	table.tag = NAND_TABLE_TAG;
+	table.remap_start = chip->remap_start;
+	table.count = 0;
+	for (b = 0; b < NAND_NUM_USER_BLOCKS; b++)
+	{
+		if (chip->block_map[b] != b)
+		{
+			pair[0] = b;
+			pair[1] = chip->block_map[b];
+			memcpy(buf + sizeof(table) + table.count++ * sizeof(pair), pair, sizeof(pair));
+		}
+	}
+	memcpy(buf, &table, sizeof(table));
+
+	size = sizeof(table) + table.count * sizeof(pair);
+	crc = crc16(0, buf, size);
+	memcpy(buf + size, &crc, sizeof(crc));
+
+	if (nand_writePage(chip, PAGE(NAND_TABLE_BLOCK), 0, false))
+		LOG_INFO("nand: remap table saved, %d remapped blocks\n", table.count);
+}
+
+#endif /* CONFIG_NAND_REMAP_TABLE */
+
+
 /*
  * Initialize NAND (format). Scan NAND for factory marked bad blocks.
  * All found bad blocks are remapped to the remap partition: each
@@ -455,6 +703,15 @@ static void initBlockMap(Nand *chip)
 		chip->block_map[b] = b;
 	chip->remap_start = NAND_NUM_USER_BLOCKS;
 
+#if CONFIG_NAND_REMAP_TABLE
+	if (loadRemapTable(chip))
+		return;
+
+	// Start over with a clean map
+	for (b = 0; b < CONFIG_NAND_NUM_BLOCK; b++)
+		chip->block_map[b] = b;
+#endif
+
 	if (chipIsMarked(chip))
 	{
 		LOG_INFO("nand: found initialized NAND, searching for remapped blocks\n");
@@ -499,6 +756,10 @@ static void initBlockMap(Nand *chip)
 			LOG_INFO("nand: no bad block founds, marked NAND\n");
 		}
 	}
+
+#if CONFIG_NAND_REMAP_TABLE
+	saveRemapTable(chip);
+#endif
 }
 
 
@@ -533,6 +794,9 @@ void nand_ruinSomeBlocks(Nand *chip)
 
 	LOG_INFO("nand: erasing mark\n");
 	nand_blockErase(chip, NAND_NUM_USER_BLOCKS);
+#if CONFIG_NAND_REMAP_TABLE
+	nand_blockErase(chip, NAND_TABLE_BLOCK);
+#endif
 
 	for (i = 0; i < countof(bads); i++)
 	{
@@ -541,7 +805,7 @@ void nand_ruinSomeBlocks(Nand *chip)
 
 		LOG_INFO("nand: marking page %d as bad\n", PAGE(bads[i]));
 		memset(nand_dataBuffer(chip), 0, CONFIG_NAND_SPARE_SIZE);
-		nand_writePage(chip, PAGE(bads[i]), CONFIG_NAND_DATA_SIZE);
+		nand_writePage(chip, PAGE(bads[i]), CONFIG_NAND_DATA_SIZE, false);
 	}
 }
 
@@ -576,6 +840,8 @@ static bool commonInit(Nand *chip, struct Heap *heap, unsigned chip_select)
 
 static size_t nand_writeDirect(struct KBlock *kblk, block_idx_t idx, const void *buf, size_t offset, size_t size)
 {
+	Nand *chip = NAND_CAST(kblk);
+
 	ASSERT(offset <= NAND_BLOCK_SIZE);
 	ASSERT(offset % CONFIG_NAND_DATA_SIZE == 0);
 	ASSERT(size <= NAND_BLOCK_SIZE);
@@ -583,13 +849,15 @@ static size_t nand_writeDirect(struct KBlock *kblk, block_idx_t idx, const void
 
 	LOG_INFO("nand_writeDirect: idx=%ld offset=%d size=%d\n", idx, offset, size);
 
-	nand_blockErase(NAND_CAST(kblk), idx);
+	nand_blockErase(chip, idx);
 
 	while (offset < size)
 	{
 		uint32_t page = PAGE(idx) + (offset / CONFIG_NAND_DATA_SIZE);
+		// Pipeline the program of all pages but the last one
+		bool cache = CONFIG_NAND_CACHE_OPS && offset + CONFIG_NAND_DATA_SIZE < size;
 
-		if (!nand_write(NAND_CAST(kblk), page, buf, CONFIG_NAND_DATA_SIZE))
+		if (!nand_write(chip, page, buf, CONFIG_NAND_DATA_SIZE, cache))
 			break;
 
 		offset += CONFIG_NAND_DATA_SIZE;
@@ -602,29 +870,55 @@ static size_t nand_writeDirect(struct KBlock *kblk, block_idx_t idx, const void
 
 static size_t nand_readDirect(struct KBlock *kblk, block_idx_t idx, void *buf, size_t offset, size_t size)
 {
-	uint32_t page;
+	Nand *chip = NAND_CAST(kblk);
+	uint32_t page = PAGE(idx) + (offset / CONFIG_NAND_DATA_SIZE);
 	size_t   read_size;
 	size_t   read_offset;
 	size_t   nread = 0;
+	bool     ok;
+#if CONFIG_NAND_CACHE_OPS
+	// Pipeline the reads if more than one page is needed
+	uint32_t last = PAGE(idx) + ((offset + size - 1) / CONFIG_NAND_DATA_SIZE);
+	bool     cached = size && last > page;
+#endif
 
 	ASSERT(offset < NAND_BLOCK_SIZE);
 	ASSERT(size <= NAND_BLOCK_SIZE);
 
 	LOG_INFO("nand_readDirect: idx=%ld offset=%d size=%d\n", idx, offset, size);
 
+#if CONFIG_NAND_CACHE_OPS
+	if (cached && !nand_readPage(chip, remapPage(chip, page), 0))
+		return 0;
+#endif
+
 	while (nread < size)
 	{
-		page        = PAGE(idx) + (offset / CONFIG_NAND_DATA_SIZE);
 		read_offset = offset % CONFIG_NAND_DATA_SIZE;
-		read_size   = MIN(size, CONFIG_NAND_DATA_SIZE - read_offset);
+		read_size   = MIN(size - nread, CONFIG_NAND_DATA_SIZE - read_offset);
+
+	#if CONFIG_NAND_CACHE_OPS
+		if (cached)
+			ok = nand_readCache(chip, page == last)
+				&& nand_readBuffer(chip, (char *)buf + nread, read_offset, read_size);
+		else
+	#endif
+			ok = nand_read(chip, page, (char *)buf + nread, read_offset, read_size);
 
-		if (!nand_read(NAND_CAST(kblk), page, (char *)buf + nread, read_offset, read_size))
+		if (!ok)
 			break;
 
+		page++;
 		offset += read_size;
 		nread  += read_size;
 	}
 
+#if CONFIG_NAND_CACHE_OPS
+	// Leave cache read mode if the sequence has been interrupted
+	if (cached && nread < size)
+		chipReset(chip);
+#endif
+
 	return nread;
 }
 
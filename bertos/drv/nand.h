@@ -79,6 +79,9 @@
 #define NAND_CMD_ERASE_2              0xD0
 #define NAND_CMD_STATUS               0x70
 #define NAND_CMD_RESET                0xFF
+#define NAND_CMD_CACHE_PROGRAM        0x15
+#define NAND_CMD_READ_CACHE_SEQ       0x31
+#define NAND_CMD_READ_CACHE_END       0x3F
 
 
 /**
@@ -93,6 +96,10 @@ typedef struct Nand
 
 	uint16_t *block_map;    // For bad blocks remapping
 	uint16_t  remap_start;  // First unused remap block
+
+#if CONFIG_NAND_SW_ECC
+	uint32_t  corrected;    // Bit errors corrected by ECC
+#endif
 } Nand;
 
 /*
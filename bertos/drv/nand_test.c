@@ -0,0 +1,226 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief NAND driver test, on the emulated NAND.
+ *
+ * Checks bad block remapping and the persistent remap table across
+ * reboots, data integrity with cache operations and ECC correction of
+ * injected bit flips.
+ *
+ * $test$: cp bertos/cfg/cfg_nand.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_NAND_PAGES_PER_BLOCK" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_PAGES_PER_BLOCK 16" >> $cfgdir/cfg_nand.h
+ * $test$: echo  "#undef CONFIG_NAND_NUM_BLOCK" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_NUM_BLOCK 64" >> $cfgdir/cfg_nand.h
+ * $test$: echo  "#undef CONFIG_NAND_NUM_REMAP_BLOCKS" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_NUM_REMAP_BLOCKS 8" >> $cfgdir/cfg_nand.h
+ * $test$: echo  "#undef CONFIG_NAND_SW_ECC" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_SW_ECC 1" >> $cfgdir/cfg_nand.h
+ * $test$: echo  "#undef CONFIG_NAND_CACHE_OPS" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_CACHE_OPS 1" >> $cfgdir/cfg_nand.h
+ * $test$: echo  "#undef CONFIG_NAND_REMAP_TABLE" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_REMAP_TABLE 1" >> $cfgdir/cfg_nand.h
+ */
+
+#include "nand.h"
+
+#include <emul/nand_emul.h>
+#include <struct/heap.h>
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_SIZE   (CONFIG_NAND_DATA_SIZE * CONFIG_NAND_PAGES_PER_BLOCK)
+#define PAGE_SIZE    (CONFIG_NAND_DATA_SIZE + CONFIG_NAND_SPARE_SIZE)
+#define USER_BLOCKS  (CONFIG_NAND_NUM_BLOCK - CONFIG_NAND_NUM_REMAP_BLOCKS)
+#define TEST_BLOCKS  8
+#define PAGE(blk)    ((uint32_t)(blk) * CONFIG_NAND_PAGES_PER_BLOCK)
+
+/* Pipelined transfers must beat a page program or read at a time */
+#define T_WRITE_PLAIN  (CONFIG_NAND_PAGES_PER_BLOCK * (PAGE_SIZE / 40 + 250))
+#define T_READ_PLAIN   (CONFIG_NAND_PAGES_PER_BLOCK * (PAGE_SIZE / 40 + 25))
+
+static HEAP_DEFINE_BUF(heap_buf, 1024);
+static Heap heap;
+static Nand chip;
+
+static uint8_t data[TEST_BLOCKS][BLOCK_SIZE];
+static uint8_t buf[BLOCK_SIZE];
+
+static void boot(void)
+{
+	heap_init(&heap, heap_buf, sizeof(heap_buf));
+	memset(&nand_emul_stats, 0, sizeof(nand_emul_stats));
+	ASSERT(nand_initUnbuffered(&chip, &heap, 0));
+}
+
+static int checkBlocks(void)
+{
+	for (int b = 0; b < TEST_BLOCKS; b++)
+	{
+		if (kblock_read(&chip.fd, b, buf, 0, BLOCK_SIZE) != BLOCK_SIZE
+		 || memcmp(buf, data[b], BLOCK_SIZE))
+			return -1;
+	}
+	return 0;
+}
+
+static int remapTable(void)
+{
+	uint16_t map[CONFIG_NAND_NUM_BLOCK];
+
+	nand_emulErase();
+	nand_emulMarkBad(2);
+	nand_emulMarkBad(5);
+	nand_emulMarkBad(USER_BLOCKS + 1);
+
+	boot();
+	kprintf("First boot: %lu page reads\n", nand_emul_stats.reads);
+	if (chip.block_map[2] != USER_BLOCKS
+	 || chip.block_map[5] != USER_BLOCKS + 2
+	 || chip.block_map[3] != 3)
+		return -1;
+	memcpy(map, chip.block_map, sizeof(map));
+
+	boot();
+	kprintf("Second boot: %lu page reads\n", nand_emul_stats.reads);
+	if (nand_emul_stats.reads != 1 || memcmp(map, chip.block_map, sizeof(map)))
+		return -1;
+
+	/* A damaged table is rebuilt scanning the remap area */
+	nand_emulFlipBit(PAGE(CONFIG_NAND_NUM_BLOCK - 1), 6, 0);
+	boot();
+	if (nand_emul_stats.reads <= 1 || memcmp(map, chip.block_map, sizeof(map)))
+		return -1;
+	boot();
+	if (nand_emul_stats.reads != 1 || memcmp(map, chip.block_map, sizeof(map)))
+		return -1;
+
+	return 0;
+}
+
+static int cacheOps(void)
+{
+	unsigned long t;
+
+	for (int b = 0; b < TEST_BLOCKS; b++)
+		for (int i = 0; i < BLOCK_SIZE; i++)
+			data[b][i] = rand();
+
+	t = nand_emul_stats.time_us;
+	for (int b = 0; b < TEST_BLOCKS; b++)
+		if (kblock_write(&chip.fd, b, data[b], 0, BLOCK_SIZE) != BLOCK_SIZE)
+			return -1;
+	t = (nand_emul_stats.time_us - t) / TEST_BLOCKS;
+	kprintf("Block write: %lu us, %d us without cache program\n", t, T_WRITE_PLAIN + 2000);
+	if (t >= T_WRITE_PLAIN + 2000)
+		return -1;
+
+	t = nand_emul_stats.time_us;
+	if (checkBlocks())
+		return -1;
+	t = (nand_emul_stats.time_us - t) / TEST_BLOCKS;
+	kprintf("Block read: %lu us, %d us without cache read\n", t, T_READ_PLAIN);
+	if (t >= T_READ_PLAIN)
+		return -1;
+
+	/* Partial reads, across pages */
+	if (kblock_read(&chip.fd, 1, buf, 1000, 5000) != 5000
+	 || memcmp(buf, &data[1][1000], 5000))
+		return -1;
+
+	/* Data survives a reboot */
+	boot();
+	return checkBlocks();
+}
+
+static int bitFlips(void)
+{
+	/* One bit error every 256 bytes of a page, in the remapped block too */
+	for (int i = 0; i < CONFIG_NAND_DATA_SIZE; i += 256)
+	{
+		nand_emulFlipBit(PAGE(3) + 1, i + rand() % 256, rand() % 8);
+		nand_emulFlipBit(PAGE(chip.block_map[5]), i + rand() % 256, rand() % 8);
+	}
+	/* And in the spare area */
+	nand_emulFlipBit(PAGE(4), CONFIG_NAND_DATA_SIZE + 3, 1);
+
+	chip.corrected = 0;
+	if (checkBlocks())
+		return -1;
+	kprintf("Corrected %ld bit errors\n", (long)chip.corrected);
+	if (chip.corrected != 2 * CONFIG_NAND_DATA_SIZE / 256 + 1)
+		return -1;
+
+	/* Two errors in the same 256 bytes can't be corrected */
+	nand_emulFlipBit(PAGE(6), 10, 0);
+	nand_emulFlipBit(PAGE(6), 20, 0);
+	if (kblock_read(&chip.fd, 6, buf, 0, BLOCK_SIZE) == BLOCK_SIZE
+	 || !(kblock_error(&chip.fd) & NAND_ERR_ECC))
+		return -1;
+	kblock_clearerr(&chip.fd);
+
+	/* The other pages of the block are still readable */
+	if (kblock_read(&chip.fd, 6, buf, CONFIG_NAND_DATA_SIZE, BLOCK_SIZE - CONFIG_NAND_DATA_SIZE)
+			!= BLOCK_SIZE - CONFIG_NAND_DATA_SIZE
+	 || memcmp(buf, &data[6][CONFIG_NAND_DATA_SIZE], BLOCK_SIZE - CONFIG_NAND_DATA_SIZE))
+		return -1;
+
+	return 0;
+}
+
+int nand_testRun(void)
+{
+	if (remapTable() || cacheOps() || bitFlips())
+	{
+		kputs("NAND test failed\n");
+		return -1;
+	}
+
+	kputs("NAND test OK\n");
+	return 0;
+}
+
+int nand_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int nand_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(nand);
@@ -111,7 +111,7 @@ static int16_t sd_waitR1(Sd *sd)
 	return EOF;
 }
 
-static int16_t sd_sendCommand(Sd *sd, uint8_t cmd, uint32_t param, uint8_t crc)
+static void sd_putCommand(Sd *sd, uint8_t cmd, uint32_t param, uint8_t crc)
 {
 	KFile *fd = sd->ch;
 	/* The 7th bit of command must be a 1 */
@@ -124,7 +124,11 @@ static int16_t sd_sendCommand(Sd *sd, uint8_t cmd, uint32_t param, uint8_t crc)
 	kfile_putc((param) & 0xFF, fd);
 
 	kfile_putc(crc, fd);
+}
 
+static int16_t sd_sendCommand(Sd *sd, uint8_t cmd, uint32_t param, uint8_t crc)
+{
+	sd_putCommand(sd, cmd, param, crc);
 	return sd_waitR1(sd);
 }
 
@@ -273,6 +277,40 @@ static size_t sd_SpiReadDirect(struct KBlock *b, block_idx_t idx, void *buf, siz
 		return size;
 }
 
+/*
+ * Wait for the end of the busy state the card signals holding
+ * the data line low.
+ */
+static bool sd_waitReady(Sd *sd)
+{
+	ticks_t start = timer_clock();
+	do
+	{
+		if (kfile_getc(sd->ch) == 0xff)
+			return true;
+
+		cpu_relax();
+	}
+	while (timer_clock() - start < SD_BUSY_TIMEOUT);
+
+	LOG_ERR("sd_waitReady timeout\n");
+	return false;
+}
+
+static bool sd_setDefaultBlockLen(Sd *sd)
+{
+	if (sd->hw->tranfer_len != SD_DEFAULT_BLOCKLEN)
+	{
+		if ((sd->status = sd_setBlockLen(sd, SD_DEFAULT_BLOCKLEN)))
+		{
+			LOG_ERR("setBlockLen failed: %08lX\n", sd->status);
+			return false;
+		}
+		sd->hw->tranfer_len = SD_DEFAULT_BLOCKLEN;
+	}
+	return true;
+}
+
 #define SD_WRITE_SINGLEBLOCK 0x58
 #define SD_DATA_ACCEPTED     0x05
 
@@ -284,15 +322,8 @@ static size_t sd_SpiWriteDirect(KBlock *b, block_idx_t idx, const void *buf, siz
 	ASSERT(size == SD_DEFAULT_BLOCKLEN);
 
 	LOG_INFO("writing block %ld\n", idx);
-	if (sd->hw->tranfer_len != SD_DEFAULT_BLOCKLEN)
-	{
-		if ((sd->status = sd_setBlockLen(sd, SD_DEFAULT_BLOCKLEN)))
-		{
-			LOG_ERR("setBlockLen failed: %08lX\n", sd->status);
-			return 0;
-		}
-		sd->hw->tranfer_len = SD_DEFAULT_BLOCKLEN;
-	}
+	if (!sd_setDefaultBlockLen(sd))
+		return 0;
 
 	SD_SELECT(sd);
 
@@ -323,6 +354,106 @@ static size_t sd_SpiWriteDirect(KBlock *b, block_idx_t idx, const void *buf, siz
 	return SD_DEFAULT_BLOCKLEN;
 }
 
+#define SD_READ_MULTIBLOCK   0x52
+#define SD_WRITE_MULTIBLOCK  0x59
+#define SD_STOP_TRANSMISSION 0x4C
+#define SD_MULTI_STARTTOKEN  0xFC
+#define SD_MULTI_STOPTOKEN   0xFD
+
+static block_idx_t sd_SpiReadBlocks(KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	Sd *sd = SD_CAST(b);
+	uint8_t *data = (uint8_t *)buf;
+	block_idx_t i;
+
+	LOG_INFO("reading %ld blocks from block %ld\n", count, idx);
+	if (!sd_setDefaultBlockLen(sd))
+		return 0;
+
+	SD_SELECT(sd);
+
+	sd->status = sd_sendCommand(sd, SD_READ_MULTIBLOCK, idx * SD_DEFAULT_BLOCKLEN, 0);
+
+	if (sd->status)
+	{
+		LOG_ERR("read multiple block failed: %08lX\n", sd->status);
+		sd_select(sd, false);
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (!sd_getBlock(sd, data, SD_DEFAULT_BLOCKLEN))
+		{
+			LOG_ERR("read multiple block failed reading block %ld\n", idx + i);
+			break;
+		}
+		data += SD_DEFAULT_BLOCKLEN;
+	}
+
+	/*
+	 * The byte following the stop command is still data,
+	 * skip it before waiting for the response.
+	 */
+	sd_putCommand(sd, SD_STOP_TRANSMISSION, 0, 0);
+	kfile_getc(sd->ch);
+	sd_waitR1(sd);
+	sd_waitReady(sd);
+	sd_select(sd, false);
+
+	return i;
+}
+
+static block_idx_t sd_SpiWriteBlocks(KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	Sd *sd = SD_CAST(b);
+	KFile *fd = sd->ch;
+	const uint8_t *data = (const uint8_t *)buf;
+	block_idx_t i;
+
+	LOG_INFO("writing %ld blocks from block %ld\n", count, idx);
+	if (!sd_setDefaultBlockLen(sd))
+		return 0;
+
+	SD_SELECT(sd);
+
+	sd->status = sd_sendCommand(sd, SD_WRITE_MULTIBLOCK, idx * SD_DEFAULT_BLOCKLEN, 0);
+
+	if (sd->status)
+	{
+		LOG_ERR("write multiple block failed: %08lX\n", sd->status);
+		sd_select(sd, false);
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		kfile_putc(SD_MULTI_STARTTOKEN, fd);
+		kfile_write(fd, data, SD_DEFAULT_BLOCKLEN);
+		/* send fake crc */
+		kfile_putc(0, fd);
+		kfile_putc(0, fd);
+
+		uint8_t dataresp = kfile_getc(fd);
+		if ((dataresp & 0x1f) != SD_DATA_ACCEPTED)
+		{
+			LOG_ERR("write block %ld failed: %02X\n", idx + i, dataresp);
+			break;
+		}
+		if (!sd_waitReady(sd))
+			break;
+		data += SD_DEFAULT_BLOCKLEN;
+	}
+
+	kfile_putc(SD_MULTI_STOPTOKEN, fd);
+	/* The card goes busy one byte after the stop token */
+	kfile_getc(fd);
+	sd_waitReady(sd);
+	sd_select(sd, false);
+
+	return i;
+}
+
 static int sd_SpiError(KBlock *b)
 {
 	Sd *sd = SD_CAST(b);
@@ -431,6 +562,8 @@ static const KBlockVTable sd_unbuffered_vt =
 {
 	.readDirect = sd_SpiReadDirect,
 	.writeDirect = sd_SpiWriteDirect,
+	.readBlocks = sd_SpiReadBlocks,
+	.writeBlocks = sd_SpiWriteBlocks,
 
 	.error = sd_SpiError,
 	.clearerr = sd_SpiClearerr,
@@ -440,6 +573,8 @@ static const KBlockVTable sd_buffered_vt =
 {
 	.readDirect = sd_SpiReadDirect,
 	.writeDirect = sd_SpiWriteDirect,
+	.readBlocks = sd_SpiReadBlocks,
+	.writeBlocks = sd_SpiWriteBlocks,
 
 	.readBuf = kblock_swReadBuf,
 	.writeBuf = kblock_swWriteBuf,
@@ -53,6 +53,7 @@
 #include <cpu/power.h> // cpu_relax()
 
 #include <kern/proc_p.h> // proc_decQuantun()
+#include <kern/trace.h>
 
 /*
  * Include platform-specific binding code if we're hosted.
@@ -78,6 +79,10 @@
 	#error CONFIG_WATCHDOG must be set to either 0 or 1 in config.h
 #endif
 
+#if CONFIG_TIMER_TICKLESS && !defined(TIMER_HW_TICKLESS)
+	#error CONFIG_TIMER_TICKLESS is not supported by this timer hardware
+#endif
+
 #if CONFIG_WATCHDOG
 	#include <drv/wdt.h>
 #endif
@@ -109,14 +114,105 @@
 /// Master system clock (1 tick accuracy)
 volatile ticks_t _clock;
 
+#if CONFIG_TIMER_TICKLESS
+
+/// Tick at which the next timer interrupt has been programmed.
+static ticks_t timer_deadline;
+
+/**
+ * Bring the system clock up to date with the hardware counter.
+ *
+ * In tickless mode the timer interrupt does not run at each tick,
+ * so the clock is caught up whenever it is read.
+ *
+ * \note Call with interrupts disabled.
+ */
+void timer_sync(void)
+{
+	ticks_t elapsed = timer_hw_elapsed();
+
+	_clock += elapsed;
+
+	/* Charge the elapsed ticks to the running process quantum. */
+	while (elapsed-- > 0 && preempt_quantum())
+		proc_decQuantum();
+}
+
+/**
+ * Program the next timer interrupt \a ticks ticks after the current one.
+ */
+INLINE void timer_program(ticks_t ticks)
+{
+	ticks = MINMAX((ticks_t)1, ticks, (ticks_t)TIMER_HW_MAX_TICKS);
+	timer_deadline = _clock + ticks;
+	timer_hw_setNext(ticks);
+}
+
+/**
+ * Make the timer interrupt fire when the running process quantum expires.
+ *
+ * The interrupt only counts the quantum while other processes are ready,
+ * so the scheduler calls this when the ready list stops being empty.
+ *
+ * \note Call with interrupts disabled.
+ */
+void timer_armQuantum(void)
+{
+	ticks_t next;
+
+	timer_sync();
+	next = MAX((ticks_t)preempt_quantum(), (ticks_t)1);
+	if (_clock + next - timer_deadline < 0)
+		timer_program(next);
+}
+
+#endif /* CONFIG_TIMER_TICKLESS */
+
 
 #if CONFIG_TIMER_EVENTS
 
+/* Fallback for project configurations older than the timing wheel */
+#ifndef CONFIG_TIMER_WHEEL
+	#define CONFIG_TIMER_WHEEL 0
+#endif
+
+#if CONFIG_TIMER_WHEEL
+
+#define TIMER_WHEEL_SLOTS  (1 << CONFIG_TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK   (TIMER_WHEEL_SLOTS - 1)
+
+/// Wheel slot of \a tick at \a level.
+#define TIMER_WHEEL_INDEX(tick, level) \
+	(((uint32_t)(tick) >> ((level) * CONFIG_TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK)
+
+/* The wheel span must be a positive ticks_t interval. */
+STATIC_ASSERT(CONFIG_TIMER_WHEEL_LEVELS * CONFIG_TIMER_WHEEL_BITS < sizeof(ticks_t) * CPU_BITS_PER_CHAR);
+
+/**
+ * Hierarchical timing wheel holding the active asynchronous timers.
+ *
+ * Level 0 has one slot per tick. Each slot of level n covers
+ * 1 << (n * CONFIG_TIMER_WHEEL_BITS) ticks and its timers are
+ * redistributed (cascaded) to the lower levels every time level
+ * n - 1 completes a turn. Timers that do not fit the wheel span
+ * wait in the overflow list until the top level wraps.
+ */
+REGISTER static struct TimerWheel
+{
+	ticks_t clock;     ///< Next tick to be processed.
+	List slot[CONFIG_TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	List overflow;
+} timers_wheel;
+
+#else /* !CONFIG_TIMER_WHEEL */
+
 /**
  * List of active asynchronous timers.
  */
 REGISTER static List timers_queue;
 
+#endif /* !CONFIG_TIMER_WHEEL */
+
 /**
  * This function really does the job. It adds \a timer to \a queue.
  * \see timer_add for details.
@@ -149,6 +245,170 @@ INLINE void timer_addToList(Timer *timer, List *queue)
 	INSERT_BEFORE(&timer->link, &node->link);
 }
 
+#if CONFIG_TIMER_WHEEL
+
+/**
+ * Put \a timer in the wheel slot matching its expiration time.
+ */
+static void timer_wheelInsert(Timer *timer)
+{
+	ticks_t delta = timer->tick - timers_wheel.clock;
+	int level;
+
+	/* Already expired: process it with the next tick. */
+	if (delta < 0)
+	{
+		ADDTAIL(&timers_wheel.slot[0][TIMER_WHEEL_INDEX(timers_wheel.clock, 0)], &timer->link);
+		return;
+	}
+
+	for (level = 0; level < CONFIG_TIMER_WHEEL_LEVELS; level++)
+	{
+		if ((uint32_t)delta < (UINT32_C(1) << ((level + 1) * CONFIG_TIMER_WHEEL_BITS)))
+		{
+			ADDTAIL(&timers_wheel.slot[level][TIMER_WHEEL_INDEX(timer->tick, level)], &timer->link);
+			return;
+		}
+	}
+
+	ADDTAIL(&timers_wheel.overflow, &timer->link);
+}
+
+/**
+ * Redistribute all the timers of \a slot on the wheel.
+ */
+static void timer_wheelCascade(List *slot)
+{
+	Node *node = slot->head.succ;
+	Node *next;
+
+	/*
+	 * Detach the whole chain first, since timers may be put back
+	 * in this very slot. The chain stays terminated by the tail
+	 * sentinel of the slot.
+	 */
+	LIST_INIT(slot);
+	while ((next = node->succ))
+	{
+		timer_wheelInsert((Timer *)node);
+		node = next;
+	}
+}
+
+/**
+ * Add \a timer to the timing wheel.
+ * \see timer_add for details.
+ */
+INLINE void timer_wheelAdd(Timer *timer)
+{
+	/* Inserting timers twice causes mayhem. */
+	ASSERT(timer->magic != TIMER_MAGIC_ACTIVE);
+	DB(timer->magic = TIMER_MAGIC_ACTIVE;)
+
+	timer_wheelInsert(timer);
+}
+
+#if CONFIG_TIMER_TICKLESS
+/**
+ * Return a lower bound of the ticks left before the wheel has
+ * something to do, or \a max if it is empty.
+ *
+ * For each level, this is the first tick at which a non empty slot
+ * is reached (level 0) or cascaded (upper levels).
+ */
+static ticks_t timer_wheelNext(ticks_t max)
+{
+	ticks_t next = max;
+	uint32_t base;
+	int level, shift, i;
+
+	for (level = 0; level <= CONFIG_TIMER_WHEEL_LEVELS; level++)
+	{
+		shift = level * CONFIG_TIMER_WHEEL_BITS;
+		/* First tick of this level not processed yet */
+		base = ((uint32_t)timers_wheel.clock + (UINT32_C(1) << shift) - 1) >> shift;
+
+		if (level == CONFIG_TIMER_WHEEL_LEVELS)
+		{
+			/* The overflow list is rescanned when the top level wraps */
+			if (!LIST_EMPTY(&timers_wheel.overflow))
+				next = MIN(next, (ticks_t)(base << shift) - _clock);
+			break;
+		}
+
+		for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		{
+			if (!LIST_EMPTY(&timers_wheel.slot[level][(base + i) & TIMER_WHEEL_MASK]))
+			{
+				next = MIN(next, (ticks_t)((base + i) << shift) - _clock);
+				break;
+			}
+		}
+	}
+	return next;
+}
+#endif /* CONFIG_TIMER_TICKLESS */
+
+/**
+ * Process all the ticks elapsed since the last call and trigger
+ * the expired timers.
+ *
+ * Each tick costs at most one cascade per level, regardless
+ * of the number of active timers. In tickless mode the ticks
+ * with nothing to do are skipped, so catching up after a long
+ * idle time costs as much as the ticks that have work.
+ */
+INLINE void timer_wheelPoll(void)
+{
+	Timer *timer;
+	List *slot;
+	int level;
+
+	while (timer_clock() - timers_wheel.clock >= 0)
+	{
+		#if CONFIG_TIMER_TICKLESS
+		{
+			/* Jump to the first tick with something to do, at most now + 1 */
+			ticks_t now = timer_clock();
+			ticks_t next = _clock + timer_wheelNext(now + 1 - _clock);
+
+			if (next - timers_wheel.clock > 0)
+			{
+				timers_wheel.clock = next;
+				continue;
+			}
+		}
+		#endif
+
+		/* Cascade the upper levels whenever the lower one wraps */
+		for (level = 1; level < CONFIG_TIMER_WHEEL_LEVELS; level++)
+		{
+			if (TIMER_WHEEL_INDEX(timers_wheel.clock, level - 1))
+				break;
+			timer_wheelCascade(&timers_wheel.slot[level][TIMER_WHEEL_INDEX(timers_wheel.clock, level)]);
+		}
+
+		if (level == CONFIG_TIMER_WHEEL_LEVELS
+			&& !TIMER_WHEEL_INDEX(timers_wheel.clock, CONFIG_TIMER_WHEEL_LEVELS - 1))
+			timer_wheelCascade(&timers_wheel.overflow);
+
+		/* All the timers left in the current slot expire now */
+		slot = &timers_wheel.slot[0][TIMER_WHEEL_INDEX(timers_wheel.clock, 0)];
+		while ((timer = (Timer *)list_remHead(slot)))
+		{
+			DB(timer->magic = TIMER_MAGIC_INACTIVE;)
+			KTRACE(TRACE_TIMER_FIRE, timer, 0);
+
+			/* Execute the associated event */
+			event_do(&timer->expire);
+		}
+
+		timers_wheel.clock++;
+	}
+}
+
+#endif /* CONFIG_TIMER_WHEEL */
+
 /**
  * Add the specified timer to the software timer service queue.
  * When the delay indicated by the timer expires, the timer
@@ -159,10 +419,22 @@ INLINE void timer_addToList(Timer *timer, List *queue)
 void timer_add(Timer *timer)
 {
 	ATOMIC(
+		timer_sync();
+
 		/* Calculate expiration time for this timer */
 		timer->tick = _clock + timer->_delay;
 
-		timer_addToList(timer, &timers_queue);
+		#if CONFIG_TIMER_WHEEL
+			timer_wheelAdd(timer);
+		#else
+			timer_addToList(timer, &timers_queue);
+		#endif
+
+		#if CONFIG_TIMER_TICKLESS
+			/* Wake up earlier if this timer expires first */
+			if (timer->tick - timer_deadline < 0)
+				timer_program(timer->tick - _clock);
+		#endif
 	);
 }
 
@@ -201,6 +473,7 @@ INLINE void timer_poll(List *queue)
 		/* Retreat the expired timer */
 		REMOVE(&timer->link);
 		DB(timer->magic = TIMER_MAGIC_INACTIVE;)
+		KTRACE(TRACE_TIMER_FIRE, timer, 0);
 
 		/* Execute the associated event */
 		event_do(&timer->expire);
@@ -346,6 +619,35 @@ void timer_delayHp(hptime_t delay)
 }
 #endif /* CONFIG_TIMER_UDELAY */
 
+#if CONFIG_TIMER_TICKLESS
+/**
+ * Program the timer interrupt for the first event to come: the next
+ * timer expiry or the end of the running process quantum.
+ */
+static void timer_reprogram(void)
+{
+	ticks_t next = TIMER_HW_MAX_TICKS;
+
+	#if CONFIG_TIMER_EVENTS
+		#if CONFIG_TIMER_WHEEL
+			next = timer_wheelNext(next);
+		#else
+			Timer *timer = (Timer *)LIST_HEAD(&timers_queue);
+			if (timer->link.succ)
+				next = MIN(next, timer->tick - _clock);
+		#endif
+	#endif
+
+	#if CONFIG_KERN && CONFIG_KERN_PREEMPT
+		/* Time sharing needs a tick when the quantum expires */
+		if (proc_current() && !SCHED_EMPTY())
+			next = MIN(next, (ticks_t)preempt_quantum());
+	#endif
+
+	timer_program(next);
+}
+#endif /* CONFIG_TIMER_TICKLESS */
+
 /**
  * Timer interrupt handler. Find soft timers expired and
  * trigger corresponding events.
@@ -369,20 +671,35 @@ DEFINE_TIMER_ISR
 		return;
 
 	TIMER_STROBE_ON;
+	KTRACE(TRACE_IRQ_ENTER, NULL, 0);
 
-	/* Update the master ms counter */
-	++_clock;
+	#if CONFIG_TIMER_TICKLESS
+		/* Catch up with all the ticks elapsed since the last interrupt */
+		timer_sync();
+	#else
+		/* Update the master ms counter */
+		++_clock;
 
-	/* Update the current task's quantum (if enabled). */
-	proc_decQuantum();
+		/* Update the current task's quantum (if enabled). */
+		proc_decQuantum();
+	#endif
 
 	#if CONFIG_TIMER_EVENTS
-		timer_poll(&timers_queue);
+		#if CONFIG_TIMER_WHEEL
+			timer_wheelPoll();
+		#else
+			timer_poll(&timers_queue);
+		#endif
+	#endif
+
+	#if CONFIG_TIMER_TICKLESS
+		timer_reprogram();
 	#endif
 
 	/* Perform hw IRQ handling */
 	timer_hw_irq();
 
+	KTRACE(TRACE_IRQ_EXIT, NULL, 0);
 	TIMER_STROBE_OFF;
 }
 
@@ -397,14 +714,30 @@ void timer_init(void)
 		MOD_CHECK(irq);
 	#endif
 
-	#if CONFIG_TIMER_EVENTS
-		LIST_INIT(&timers_queue);
-	#endif
-
 	TIMER_STROBE_INIT;
 
 	_clock = 0;
 
+	#if CONFIG_TIMER_EVENTS
+		#if CONFIG_TIMER_WHEEL
+		{
+			int level, i;
+
+			for (level = 0; level < CONFIG_TIMER_WHEEL_LEVELS; level++)
+				for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+					LIST_INIT(&timers_wheel.slot[level][i]);
+			LIST_INIT(&timers_wheel.overflow);
+			timers_wheel.clock = _clock;
+		}
+		#else
+			LIST_INIT(&timers_queue);
+		#endif
+	#endif
+
+	#if CONFIG_TIMER_TICKLESS
+		timer_deadline = _clock + 1;
+	#endif
+
 	timer_hw_init();
 
 	MOD_INIT(timer);
@@ -99,8 +99,20 @@ STATIC_ASSERT(sizeof(hptime_t) == SIZEOF_HPTIME_T);
 	#error Obosolete config option CONFIG_TIMER_DISABLE_EVENTS.  Use CONFIG_TIMER_EVENTS
 #endif
 
+/* Fallback for project configurations older than the tickless mode */
+#ifndef CONFIG_TIMER_TICKLESS
+	#define CONFIG_TIMER_TICKLESS 0
+#endif
+
 extern volatile ticks_t _clock;
 
+#if CONFIG_TIMER_TICKLESS
+	void timer_sync(void);
+	void timer_armQuantum(void);
+#else
+	#define timer_sync() do {} while (0)
+#endif
+
 #define TIMER_AFTER(x, y) ((long)(y) - (long)(x) < 0)
 #define TIMER_BEFORE(x, y) TIMER_AFTER(y, x)
 
@@ -136,7 +148,10 @@ INLINE ticks_t timer_clock(void)
 {
 	ticks_t result;
 
-	ATOMIC(result = _clock);
+	ATOMIC(
+		timer_sync();
+		result = _clock;
+	);
 
 	return result;
 }
@@ -150,9 +165,31 @@ INLINE ticks_t timer_clock(void)
  */
 INLINE ticks_t timer_clock_unlocked(void)
 {
+	/* Catching up the clock must not race with the timer interrupt */
+	#if CONFIG_TIMER_TICKLESS
+		ATOMIC(timer_sync());
+	#endif
 	return _clock;
 }
 
+/**
+ * Free running high resolution clock [hp timer units], for timestamping.
+ *
+ * Most hardware counters only span a single tick, those are extended
+ * with the system clock. The result wraps around at 32 bits.
+ *
+ * \note Call with interrupts disabled.
+ */
+INLINE uint32_t timer_hpclock_unlocked(void)
+{
+	if ((uint32_t)TIMER_HW_CNT <= TIMER_HW_HPTICKS_PER_SEC / TIMER_TICKS_PER_SEC)
+		return (uint32_t)timer_clock_unlocked()
+			* (TIMER_HW_HPTICKS_PER_SEC / TIMER_TICKS_PER_SEC)
+			+ timer_hw_hpread();
+	else
+		return (uint32_t)timer_hw_hpread();
+}
+
 
 /** Convert \a ms [ms] to ticks. */
 INLINE ticks_t ms_to_ticks(mtime_t ms)
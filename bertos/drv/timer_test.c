@@ -178,6 +178,94 @@ static void synctimer_test(void)
 	}
 }
 
+#define STRESS_TIMERS     2000
+#define STRESS_MAX_DELAY  1000
+
+static Timer stress_timers[STRESS_TIMERS];
+static bool stress_aborted[STRESS_TIMERS];
+static volatile bool stress_fired[STRESS_TIMERS];
+static volatile int stress_count;
+static volatile int stress_errors;
+static ticks_t stress_last;
+
+static void stress_test_hook(iptr_t _timer)
+{
+	Timer *timer = (Timer *)(void *)_timer;
+	ticks_t now = timer_clock_unlocked();
+
+	/* Timers must never expire early or out of order. */
+	if (now - timer->tick < 0 || now - stress_last < 0)
+		stress_errors++;
+	#if !CONFIG_TIMER_TICKLESS
+		/* With a periodic tick they expire exactly on time. */
+		if (now != timer->tick)
+			stress_errors++;
+	#endif
+	stress_last = now;
+
+	stress_fired[timer - stress_timers] = true;
+	stress_count++;
+}
+
+/*
+ * Arm a lot of timers with pseudo-random delays, abort some of them
+ * and check that all the others expire on their own tick.
+ */
+static int timer_test_stress(void)
+{
+	uint32_t seed = 0xdeadbeef;
+	int i, expected = 0;
+	ticks_t start;
+
+	kprintf("Stress test with %d timers\n", STRESS_TIMERS);
+	stress_count = 0;
+	stress_errors = 0;
+	stress_last = timer_clock();
+
+	for (i = 0; i < STRESS_TIMERS; ++i)
+	{
+		Timer *timer = &stress_timers[i];
+
+		seed = seed * 1103515245 + 12345;
+		timer_setDelay(timer, 1 + (seed >> 16) % (STRESS_MAX_DELAY - 1));
+		timer_setSoftint(timer, stress_test_hook, (iptr_t)timer);
+		stress_fired[i] = false;
+		timer_add(timer);
+	}
+
+	/* Abort a fifth of the timers that are still far from expiring */
+	for (i = 0; i < STRESS_TIMERS; ++i)
+	{
+		stress_aborted[i] = (i % 5 == 0) && stress_timers[i]._delay >= ms_to_ticks(200);
+		if (stress_aborted[i])
+			timer_abort(&stress_timers[i]);
+		else
+			expected++;
+	}
+
+	start = timer_clock();
+	while (stress_count < expected
+		&& timer_clock() - start < STRESS_MAX_DELAY + ms_to_ticks(1000))
+		wdt_reset();
+
+	/* Let any wrongly armed timer expire */
+	timer_delay(100);
+
+	for (i = 0; i < STRESS_TIMERS; ++i)
+	{
+		if (stress_fired[i] == stress_aborted[i])
+		{
+			kprintf("Timer %d (delay %ld) %s\n", i, (long)stress_timers[i]._delay,
+				stress_aborted[i] ? "fired after abort" : "never fired");
+			stress_errors++;
+		}
+	}
+
+	kprintf("Stress test: %d/%d timers fired, %d errors\n",
+		stress_count, expected, stress_errors);
+	return stress_errors ? -1 : 0;
+}
+
 int timer_testSetup(void)
 {
 	IRQ_ENABLE;
@@ -194,7 +282,7 @@ int timer_testRun(void)
 	timer_test_async();
 	timer_test_poll();
 	synctimer_test();
-	return 0;
+	return timer_test_stress();
 }
 
 int timer_testTearDown(void)
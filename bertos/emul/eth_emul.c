@@ -0,0 +1,452 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Ethernet controller simulator for the ethernet driver.
+ *
+ * The driver half follows eth_sam3.c, so that the work done by the CPU
+ * for each frame is the same as on the target; the hardware half moves
+ * the frames between the rings and the wire.
+ */
+
+#include "eth_emul.h"
+
+#include "cfg/cfg_eth.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
+#include <drv/eth.h>
+
+#include <kern/proc.h>
+
+#include <mware/event.h>
+
+#include <string.h>
+
+/* Receive buffer flags */
+#define RX_OWN   BV(0)  // Filled by the hardware, owned by the driver
+#define RX_SOF   BV(1)  // Start of frame
+#define RX_EOF   BV(2)  // End of frame
+
+/* Transmit descriptor flags */
+#define TX_USED  BV(0)  // Owned by the driver
+#define TX_LAST  BV(1)  // Last buffer of the frame
+
+#if CONFIG_ETH_ZEROCOPY
+	#define TX_DESCRIPTORS  ETH_EMUL_TX_DESCRIPTORS
+#else
+	#define TX_DESCRIPTORS  1
+#endif
+
+typedef struct RxDescriptor
+{
+	uint8_t flags;
+	uint16_t len;      // Frame length, in the last buffer
+} RxDescriptor;
+
+typedef struct TxDescriptor
+{
+	const uint8_t *addr;
+	uint16_t len;
+	uint8_t flags;
+} TxDescriptor;
+
+EthEmulStats eth_emul_stats;
+
+static uint8_t rx_buf[ETH_EMUL_RX_BUFFERS * ETH_EMUL_RX_BUFSIZ];
+static RxDescriptor rx_tab[ETH_EMUL_RX_BUFFERS];
+static TxDescriptor tx_tab[TX_DESCRIPTORS];
+
+static int rx_buf_idx;   // Next buffer read by the driver
+static int rx_hw_idx;    // Next buffer filled by the hardware
+static int tx_hw_idx;    // Next descriptor sent by the hardware
+
+static Event recv_wait, send_wait;
+
+#define RX_NEXT(idx)  (((idx) + 1) % ETH_EMUL_RX_BUFFERS)
+
+/*
+ * Hardware side.
+ */
+
+/**
+ * Receive \a frame from the wire.
+ *
+ * \return 0 on success, -1 if the frame has been dropped because the
+ *         controller is out of receive buffers.
+ */
+int eth_emulRxFrame(const uint8_t *frame, size_t len)
+{
+	int n = DIV_ROUNDUP(len, ETH_EMUL_RX_BUFSIZ);
+	int i, idx;
+
+	ASSERT(len > 0 && len <= ETH_FRAME_LEN);
+
+	/* The controller stops at the first buffer it does not own */
+	for (i = 0, idx = rx_hw_idx; i < n; i++, idx = RX_NEXT(idx))
+	{
+		if (rx_tab[idx].flags & RX_OWN)
+		{
+			eth_emul_stats.rx_dropped++;
+			return -1;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		memcpy(rx_buf + rx_hw_idx * ETH_EMUL_RX_BUFSIZ, frame + i * ETH_EMUL_RX_BUFSIZ,
+			MIN(len - i * ETH_EMUL_RX_BUFSIZ, (size_t)ETH_EMUL_RX_BUFSIZ));
+		rx_tab[rx_hw_idx].len = len;
+		rx_tab[rx_hw_idx].flags = RX_OWN | (i == 0 ? RX_SOF : 0) | (i == n - 1 ? RX_EOF : 0);
+		rx_hw_idx = RX_NEXT(rx_hw_idx);
+	}
+	eth_emul_stats.rx_frames++;
+	event_do(&recv_wait);
+
+	return 0;
+}
+
+/**
+ * Send the oldest queued frame on the wire, copying it to \a frame.
+ *
+ * \return the frame length, 0 if no frame is queued.
+ */
+size_t eth_emulTxFrame(uint8_t *frame, size_t size)
+{
+	int first = tx_hw_idx;
+	size_t len = 0;
+
+	if (tx_tab[first].flags & TX_USED)
+		return 0;
+
+	for (;;)
+	{
+		TxDescriptor *d = &tx_tab[tx_hw_idx];
+
+		ASSERT(!(d->flags & TX_USED));
+		ASSERT(len + d->len <= size);
+		memcpy(frame + len, d->addr, d->len);
+		len += d->len;
+		tx_hw_idx = (tx_hw_idx + 1) % TX_DESCRIPTORS;
+		if (d->flags & TX_LAST)
+			break;
+	}
+	/* Like the EMAC, only the first descriptor of the frame is marked */
+	tx_tab[first].flags |= TX_USED;
+	eth_emul_stats.tx_frames++;
+
+	event_do(&send_wait);
+	#if CONFIG_ETH_ZEROCOPY
+		event_do(&recv_wait);
+	#endif
+
+	return len;
+}
+
+/**
+ * \return the number of receive buffers owned by the hardware.
+ */
+int eth_emulRxFree(void)
+{
+	int i, n = 0;
+
+	for (i = 0; i < ETH_EMUL_RX_BUFFERS; i++)
+		if (!(rx_tab[i].flags & RX_OWN))
+			n++;
+	return n;
+}
+
+/*
+ * Driver side.
+ */
+
+static void rxRelease(int idx)
+{
+	rx_tab[idx].flags = 0;
+}
+
+#if CONFIG_ETH_ZEROCOPY
+
+static uint32_t rx_lent;         // Buffers lent to the upper layer
+
+static void *tx_ctx[TX_DESCRIPTORS];
+static int tx_cnt[TX_DESCRIPTORS];
+static int tx_head, tx_tail, tx_free;
+
+INLINE bool rxReady(void)
+{
+	return (rx_tab[rx_buf_idx].flags & RX_OWN) && !(rx_lent & BV32(rx_buf_idx));
+}
+
+INLINE bool txDone(void)
+{
+	return tx_free < TX_DESCRIPTORS && (tx_tab[tx_tail].flags & TX_USED);
+}
+
+int eth_rxGet(EthBuf *buf, int count)
+{
+	int idx, n, i;
+	size_t len;
+
+	for (;;)
+	{
+		while (!rxReady())
+		{
+			if (txDone())
+				return 0;
+			event_wait(&recv_wait);
+		}
+
+		proc_forbid();
+		ASSERT(rx_tab[rx_buf_idx].flags & RX_SOF);
+		for (idx = rx_buf_idx, n = 1; !(rx_tab[idx].flags & RX_EOF); idx = RX_NEXT(idx))
+			n++;
+		len = rx_tab[idx].len;
+
+		for (i = 0; i < n; i++)
+		{
+			if (n <= count)
+			{
+				buf[i].data = rx_buf + rx_buf_idx * ETH_EMUL_RX_BUFSIZ;
+				buf[i].len = MIN(len - i * ETH_EMUL_RX_BUFSIZ, (size_t)ETH_EMUL_RX_BUFSIZ);
+				rx_lent |= BV32(rx_buf_idx);
+			}
+			else
+				rxRelease(rx_buf_idx);
+			rx_buf_idx = RX_NEXT(rx_buf_idx);
+		}
+		proc_permit();
+
+		if (n <= count)
+			return n;
+	}
+}
+
+void eth_rxPut(const uint8_t *data)
+{
+	int idx = (data - rx_buf) / ETH_EMUL_RX_BUFSIZ;
+
+	ASSERT(idx >= 0 && idx < ETH_EMUL_RX_BUFFERS);
+	ASSERT(rx_lent & BV32(idx));
+
+	PROC_ATOMIC(
+		rxRelease(idx);
+		rx_lent &= ~BV32(idx);
+	);
+}
+
+int eth_txPut(const EthBuf *buf, int count, void *ctx)
+{
+	int i;
+
+	ASSERT(ctx);
+	ASSERT(count > 0 && count <= MIN(ETH_FRAME_BUFS, TX_DESCRIPTORS));
+
+	proc_forbid();
+	if (count > tx_free)
+	{
+		proc_permit();
+		return -1;
+	}
+
+	/* Hand over the first descriptor last, the controller may be running */
+	for (i = count - 1; i >= 0; i--)
+	{
+		TxDescriptor *d = &tx_tab[(tx_head + i) % TX_DESCRIPTORS];
+
+		d->addr = buf[i].data;
+		d->len = buf[i].len;
+		d->flags = (i == count - 1) ? TX_LAST : 0;
+	}
+	tx_ctx[tx_head] = ctx;
+	tx_cnt[tx_head] = count;
+	tx_head = (tx_head + count) % TX_DESCRIPTORS;
+	tx_free -= count;
+	proc_permit();
+
+	return 0;
+}
+
+void *eth_txGet(bool wait)
+{
+	void *ctx;
+	int i;
+
+	while (!txDone())
+	{
+		if (!wait || tx_free == TX_DESCRIPTORS)
+			return NULL;
+		event_wait(&send_wait);
+	}
+
+	proc_forbid();
+	ctx = tx_ctx[tx_tail];
+	for (i = 0; i < tx_cnt[tx_tail]; i++)
+		tx_tab[(tx_tail + i) % TX_DESCRIPTORS].flags = TX_USED;
+	tx_free += tx_cnt[tx_tail];
+	tx_tail = (tx_tail + tx_cnt[tx_tail]) % TX_DESCRIPTORS;
+	proc_permit();
+
+	return ctx;
+}
+
+#else /* !CONFIG_ETH_ZEROCOPY */
+
+static uint8_t tx_buf[ETH_FRAME_LEN];
+static size_t tx_buf_offset;
+static size_t rx_frame_len, rx_frame_pos;
+
+ssize_t eth_putFrame(const uint8_t *buf, size_t len)
+{
+	size_t wr_len;
+
+	if (UNLIKELY(!len))
+		return -1;
+
+	/* Check if the transmit buffer is available */
+	while (!(tx_tab[0].flags & TX_USED))
+		event_wait(&send_wait);
+
+	wr_len = MIN(len, sizeof(tx_buf) - tx_buf_offset);
+	memcpy(tx_buf + tx_buf_offset, buf, wr_len);
+	tx_buf_offset += wr_len;
+	eth_emul_stats.copied += wr_len;
+
+	return wr_len;
+}
+
+void eth_sendFrame(void)
+{
+	tx_tab[0].addr = tx_buf;
+	tx_tab[0].len = tx_buf_offset;
+	tx_tab[0].flags = TX_LAST;
+	tx_buf_offset = 0;
+}
+
+ssize_t eth_send(const uint8_t *buf, size_t len)
+{
+	if (UNLIKELY(!len))
+		return -1;
+
+	len = eth_putFrame(buf, len);
+	eth_sendFrame();
+
+	return len;
+}
+
+size_t eth_getFrameLen(void)
+{
+	int idx;
+
+	if (rx_frame_len)
+		return rx_frame_len - rx_frame_pos;
+
+	/* Wait for a frame */
+	while (!(rx_tab[rx_buf_idx].flags & RX_OWN))
+		event_wait(&recv_wait);
+
+	ASSERT(rx_tab[rx_buf_idx].flags & RX_SOF);
+	for (idx = rx_buf_idx; !(rx_tab[idx].flags & RX_EOF); idx = RX_NEXT(idx))
+		;
+	rx_frame_len = rx_tab[idx].len;
+	rx_frame_pos = 0;
+
+	return rx_frame_len;
+}
+
+ssize_t eth_getFrame(uint8_t *buf, size_t len)
+{
+	size_t rd_len = 0;
+
+	if (UNLIKELY(!len))
+		return -1;
+
+	while (rd_len < len && rx_frame_pos < rx_frame_len)
+	{
+		size_t offset = rx_frame_pos % ETH_EMUL_RX_BUFSIZ;
+		size_t size = MIN(MIN(len - rd_len, ETH_EMUL_RX_BUFSIZ - offset),
+				rx_frame_len - rx_frame_pos);
+
+		memcpy(buf + rd_len, rx_buf + rx_buf_idx * ETH_EMUL_RX_BUFSIZ + offset, size);
+		rd_len += size;
+		rx_frame_pos += size;
+
+		/* Give back the buffers read */
+		if (rx_frame_pos % ETH_EMUL_RX_BUFSIZ == 0 || rx_frame_pos == rx_frame_len)
+		{
+			rxRelease(rx_buf_idx);
+			rx_buf_idx = RX_NEXT(rx_buf_idx);
+		}
+	}
+	if (rx_frame_pos == rx_frame_len)
+		rx_frame_len = 0;
+	eth_emul_stats.copied += rd_len;
+
+	return rd_len;
+}
+
+ssize_t eth_recv(uint8_t *buf, size_t len)
+{
+	if (UNLIKELY(!len))
+		return -1;
+	len = MIN(len, eth_getFrameLen());
+	return len ? eth_getFrame(buf, len) : 0;
+}
+
+#endif /* CONFIG_ETH_ZEROCOPY */
+
+int eth_init(void)
+{
+	int i;
+
+	memset(rx_tab, 0, sizeof(rx_tab));
+	rx_buf_idx = rx_hw_idx = 0;
+
+	for (i = 0; i < TX_DESCRIPTORS; i++)
+		tx_tab[i].flags = TX_USED;
+	tx_hw_idx = 0;
+
+	#if CONFIG_ETH_ZEROCOPY
+		rx_lent = 0;
+		tx_head = tx_tail = 0;
+		tx_free = TX_DESCRIPTORS;
+	#else
+		tx_buf_offset = 0;
+		rx_frame_len = rx_frame_pos = 0;
+	#endif
+
+	memset(&eth_emul_stats, 0, sizeof(eth_emul_stats));
+	event_initGeneric(&recv_wait);
+	event_initGeneric(&send_wait);
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Ethernet controller simulator for the ethernet driver.
+ *
+ * Implements drv/eth.h on a simulated DMA controller, modelled after the
+ * Atmel EMAC: frames are received in a ring of small buffers, each owned
+ * either by the hardware or by the driver, and transmitted from a ring of
+ * descriptors pointing to the frame pieces.
+ *
+ * The wire is driven by the test program: eth_emulRxFrame() makes the
+ * controller receive a frame, eth_emulTxFrame() makes it send the oldest
+ * queued one.
+ */
+
+#ifndef EMUL_ETH_EMUL_H
+#define EMUL_ETH_EMUL_H
+
+#include <cfg/compiler.h>
+
+#define ETH_EMUL_RX_BUFFERS   32
+#define ETH_EMUL_RX_BUFSIZ   128
+#define ETH_EMUL_TX_DESCRIPTORS  16
+
+/**
+ * Ethernet simulator counters.
+ */
+typedef struct EthEmulStats
+{
+	unsigned long rx_frames;   ///< Frames received.
+	unsigned long rx_dropped;  ///< Frames lost for lack of receive buffers.
+	unsigned long tx_frames;   ///< Frames sent.
+	unsigned long copied;      ///< Bytes copied by the driver.
+} EthEmulStats;
+
+extern EthEmulStats eth_emul_stats;
+
+int eth_emulRxFrame(const uint8_t *frame, size_t len);
+size_t eth_emulTxFrame(uint8_t *frame, size_t size);
+int eth_emulRxFree(void);
+
+#endif /* EMUL_ETH_EMUL_H */
@@ -0,0 +1,273 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief RAM backed NAND simulator for the NAND driver.
+ *
+ * Commands are decoded as sent by nand_sendCommand(): data is moved
+ * between the controller buffer, returned by nand_dataBuffer(), and the
+ * page register of the chip. Cache operations use a second register,
+ * as in ONFI chips.
+ */
+
+#include "nand_emul.h"
+
+#include <drv/nand.h>
+#include <cfg/debug.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PAGE_SIZE   (CONFIG_NAND_DATA_SIZE + CONFIG_NAND_SPARE_SIZE)
+#define NUM_PAGES   ((uint32_t)CONFIG_NAND_NUM_BLOCK * CONFIG_NAND_PAGES_PER_BLOCK)
+
+/*
+ * Timings of a typical 2 KiB page SLC NAND, in microseconds.
+ */
+#define T_READ      25    // Page load to the register
+#define T_PROG     250    // Page program
+#define T_ERASE   2000    // Block erase
+#define T_CBSY       3    // Cache register transfer
+#define T_XFER      (PAGE_SIZE / 40)  // Bus transfer of a page, 25 ns per byte
+
+#define STATUS_READY  BV(6)
+#define STATUS_ERROR  BV(0)
+
+NandEmulStats nand_emul_stats;
+
+static uint8_t *array;                   // The NAND array
+static uint8_t ctrl_buf[PAGE_SIZE];     // Controller data buffer
+static uint8_t page_reg[PAGE_SIZE];     // Chip page register
+static uint8_t cache_reg[PAGE_SIZE];    // Chip cache register
+static uint32_t cur_page;                // Page of the last read or program
+static uint16_t cur_col;
+static uint8_t status = STATUS_READY;
+static unsigned long array_busy;         // Time when the array is ready again
+
+static uint8_t *page_ptr(uint32_t page)
+{
+	ASSERT(page < NUM_PAGES);
+	return array + page * PAGE_SIZE;
+}
+
+/* Wait for the array to be ready */
+static void waitArray(void)
+{
+	nand_emul_stats.time_us = MAX(nand_emul_stats.time_us, array_busy);
+}
+
+static void program(const uint8_t *data)
+{
+	uint8_t *dst = page_ptr(cur_page);
+
+	for (int i = 0; i < PAGE_SIZE; i++)
+		dst[i] &= data[i];
+	nand_emul_stats.programs++;
+}
+
+static void loadPage(uint32_t page)
+{
+	memcpy(page_reg, page_ptr(page), PAGE_SIZE);
+	nand_emul_stats.reads++;
+}
+
+/* Move the register content to the controller, starting from column col */
+static void transferOut(const uint8_t *reg, uint16_t col)
+{
+	memcpy(ctrl_buf, reg + col, PAGE_SIZE - col);
+	nand_emul_stats.time_us += T_XFER;
+}
+
+/**
+ * Erase the whole chip, factory bad blocks included.
+ */
+void nand_emulErase(void)
+{
+	if (!array)
+	{
+		array = (uint8_t *)malloc(NUM_PAGES * PAGE_SIZE);
+		ASSERT(array);
+	}
+	memset(array, 0xff, NUM_PAGES * PAGE_SIZE);
+	memset(&nand_emul_stats, 0, sizeof(nand_emul_stats));
+	array_busy = 0;
+}
+
+/**
+ * Mark \a block as a factory bad block.
+ */
+void nand_emulMarkBad(uint16_t block)
+{
+	page_ptr(block * CONFIG_NAND_PAGES_PER_BLOCK)[CONFIG_NAND_DATA_SIZE] = 0;
+}
+
+/**
+ * Flip \a bit of byte \a offset of \a page, spare area included.
+ */
+void nand_emulFlipBit(uint32_t page, uint16_t offset, uint8_t bit)
+{
+	ASSERT(offset < PAGE_SIZE);
+	page_ptr(page)[offset] ^= BV(bit);
+}
+
+
+bool nand_waitReadyBusy(UNUSED_ARG(Nand *, chip), UNUSED_ARG(time_t, timeout))
+{
+	return true;
+}
+
+bool nand_waitTransferComplete(UNUSED_ARG(Nand *, chip), UNUSED_ARG(time_t, timeout))
+{
+	return true;
+}
+
+void nand_sendCommand(UNUSED_ARG(Nand *, chip),
+		uint32_t cmd1, uint32_t cmd2,
+		int num_cycles, uint32_t cycle0, uint32_t cycle1234)
+{
+	if (num_cycles == 5)
+	{
+		cur_page = cycle1234 >> 8;
+		cur_col = cycle0 | (cycle1234 & 0xf) << 8;
+		ASSERT(cur_col < PAGE_SIZE);
+	}
+
+	switch (cmd1)
+	{
+	case NAND_CMD_RESET:
+		array_busy = nand_emul_stats.time_us;
+		status = STATUS_READY;
+		break;
+
+	case NAND_CMD_STATUS:
+		break;
+
+	case NAND_CMD_READID:
+		memcpy(ctrl_buf, "\x2c\xd3\x90\x2e\x64", 5);
+		break;
+
+	case NAND_CMD_ERASE_1:
+	{
+		uint32_t first = cycle1234 - cycle1234 % CONFIG_NAND_PAGES_PER_BLOCK;
+
+		ASSERT(cmd2 == NAND_CMD_ERASE_2 && num_cycles == 3);
+		waitArray();
+		memset(page_ptr(first), 0xff, CONFIG_NAND_PAGES_PER_BLOCK * PAGE_SIZE);
+		nand_emul_stats.erases++;
+		nand_emul_stats.time_us += T_ERASE;
+		array_busy = nand_emul_stats.time_us;
+		status = STATUS_READY;
+		break;
+	}
+
+	case NAND_CMD_READ_1:
+		ASSERT(cmd2 == NAND_CMD_READ_2 && num_cycles == 5);
+		waitArray();
+		loadPage(cur_page);
+		nand_emul_stats.time_us += T_READ;
+		array_busy = nand_emul_stats.time_us;
+		transferOut(page_reg, cur_col);
+		break;
+
+	case NAND_CMD_READ_CACHE_SEQ:
+	case NAND_CMD_READ_CACHE_END:
+		/* Output the last loaded page while loading the next one */
+		waitArray();
+		memcpy(cache_reg, page_reg, PAGE_SIZE);
+		nand_emul_stats.time_us += T_CBSY;
+		if (cmd1 == NAND_CMD_READ_CACHE_SEQ)
+		{
+			loadPage(++cur_page);
+			array_busy = nand_emul_stats.time_us + T_READ;
+		}
+		transferOut(cache_reg, 0);
+		break;
+
+	case NAND_CMD_WRITE_1:
+		/* Data goes from the controller to the page register */
+		ASSERT(num_cycles == 5);
+		memset(page_reg, 0xff, PAGE_SIZE);
+		memcpy(page_reg + cur_col, ctrl_buf, PAGE_SIZE - cur_col);
+		nand_emul_stats.time_us += T_XFER;
+		break;
+
+	case NAND_CMD_WRITE_2:
+		waitArray();
+		program(page_reg);
+		nand_emul_stats.time_us += T_PROG;
+		array_busy = nand_emul_stats.time_us;
+		status = STATUS_READY;
+		break;
+
+	case NAND_CMD_CACHE_PROGRAM:
+		/* Program from the cache register, accept new data right away */
+		waitArray();
+		memcpy(cache_reg, page_reg, PAGE_SIZE);
+		program(cache_reg);
+		nand_emul_stats.time_us += T_CBSY;
+		array_busy = nand_emul_stats.time_us + T_PROG;
+		status = STATUS_READY;
+		break;
+
+	default:
+		ASSERT(0);
+	}
+}
+
+uint8_t nand_getChipStatus(UNUSED_ARG(Nand *, chip))
+{
+	return status;
+}
+
+void *nand_dataBuffer(UNUSED_ARG(Nand *, chip))
+{
+	return ctrl_buf;
+}
+
+/*
+ * No controller ECC: pages are checked by the software ECC.
+ */
+bool nand_checkEcc(UNUSED_ARG(Nand *, chip))
+{
+	return true;
+}
+
+void nand_computeEcc(UNUSED_ARG(Nand *, chip),
+		UNUSED_ARG(const void *, buf), UNUSED_ARG(size_t, size), uint32_t *ecc, size_t ecc_size)
+{
+	memset(ecc, 0xff, ecc_size * sizeof(*ecc));
+}
+
+void nand_hwInit(UNUSED_ARG(Nand *, chip))
+{
+	if (!array)
+		nand_emulErase();
+}
@@ -0,0 +1,67 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief RAM backed NAND simulator for the NAND driver.
+ *
+ * Implements the hardware functions of drv/nand.h on a NAND chip kept
+ * in memory, sized as configured in cfg_nand.h. Programming only
+ * clears bits, like on a real chip, and the chip content survives
+ * nand_init() calls, so that a reboot can be simulated.
+ *
+ * Chip timings are simulated too: the time the host would spend in
+ * each operation, including overlapping in cache operations, is
+ * accumulated in NandEmulStats.
+ */
+
+#ifndef EMUL_NAND_EMUL_H
+#define EMUL_NAND_EMUL_H
+
+#include <cfg/compiler.h>
+
+/**
+ * NAND simulator counters.
+ */
+typedef struct NandEmulStats
+{
+	unsigned long reads;      ///< Pages loaded from the array.
+	unsigned long programs;   ///< Program operations.
+	unsigned long erases;     ///< Block erases.
+	unsigned long time_us;    ///< Simulated host time, in microseconds.
+} NandEmulStats;
+
+extern NandEmulStats nand_emul_stats;
+
+void nand_emulErase(void);
+void nand_emulMarkBad(uint16_t block);
+void nand_emulFlipBit(uint32_t page, uint16_t offset, uint8_t bit);
+
+#endif /* EMUL_NAND_EMUL_H */
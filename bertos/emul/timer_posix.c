@@ -47,6 +47,46 @@
 // Forward declaration for the user interrupt server routine.
 void timer_isr(int);
 
+#if CONFIG_TIMER_TICKLESS
+
+/// Length of a tick in hptime units.
+#define TIMER_HW_TICK_HPTIME  (HPTIME_TICKS_PER_SECOND / TIMER_TICKS_PER_SEC)
+
+/// High precision time of the last tick accounted in the system clock.
+static hptime_t timer_hw_last;
+
+/**
+ * Return the number of ticks elapsed since the previous call.
+ */
+INLINE ticks_t timer_hw_elapsed(void)
+{
+	ticks_t elapsed = (ticks_t)((hptime_get() - timer_hw_last) / TIMER_HW_TICK_HPTIME);
+
+	timer_hw_last += (hptime_t)elapsed * TIMER_HW_TICK_HPTIME;
+	return elapsed;
+}
+
+/**
+ * Fire the next timer interrupt \a ticks ticks after the last
+ * accounted one.
+ */
+INLINE void timer_hw_setNext(ticks_t ticks)
+{
+	struct itimerval itv;
+	hptime_t now = hptime_get();
+	hptime_t at = timer_hw_last + (hptime_t)ticks * TIMER_HW_TICK_HPTIME;
+	/* A zero it_value would disarm the timer */
+	hptime_t delay = MAX(at - now, (hptime_t)1);
+
+	itv.it_interval.tv_sec = 0;
+	itv.it_interval.tv_usec = 0;
+	itv.it_value.tv_sec = delay / HPTIME_TICKS_PER_SECOND;
+	itv.it_value.tv_usec = (delay % HPTIME_TICKS_PER_SECOND) * 1000000 / HPTIME_TICKS_PER_SECOND;
+	setitimer(ITIMER_REAL, &itv, NULL);
+}
+
+#endif /* CONFIG_TIMER_TICKLESS */
+
 /// HW dependent timer initialization.
 static void timer_hw_init(void)
 {
@@ -64,12 +104,22 @@ static void timer_hw_init(void)
 		sigaction(SIGALRM, &sa, NULL);
 	#endif // CONFIG_KERN_IRQ
 
+#if CONFIG_TIMER_TICKLESS
+	// One shot: the first interrupt reprograms the timer as needed.
+	static const struct itimerval itv =
+	{
+		{ 0, 0 },                             /* it_interval */
+		{ 0, 1000000 / TIMER_TICKS_PER_SEC }  /* it_value */
+	};
+	timer_hw_last = hptime_get();
+#else
 	// Setup POSIX realtime timer to interrupt every 1/TIMER_TICKS_PER_SEC.
 	static const struct itimerval itv =
 	{
 		{ 0, 1000000 / TIMER_TICKS_PER_SEC }, /* it_interval */
 		{ 0, 1000000 / TIMER_TICKS_PER_SEC }  /* it_value */
 	};
+#endif
 	setitimer(ITIMER_REAL, &itv, NULL);
 }
 
@@ -84,9 +134,4 @@ static void timer_hw_cleanup(void)
 	signal(SIGALRM, SIG_DFL);
 }
 
-INLINE hptime_t timer_hw_hpread(void)
-{
-	return hptime_get();
-}
-
 #define timer_hw_triggered() (true)
@@ -52,7 +52,18 @@
 /// Frequency of the hardware high-precision timer.
 #define TIMER_HW_HPTICKS_PER_SEC  HPTIME_TICKS_PER_SECOND
 
+INLINE hptime_t timer_hw_hpread(void)
+{
+	return hptime_get();
+}
+
 /// Not needed.
 #define timer_hw_irq() do {} while (0)
 
+/// The interval timer can be reprogrammed for the tickless mode.
+#define TIMER_HW_TICKLESS  1
+
+/// Longest interval that can be programmed with timer_hw_setNext().
+#define TIMER_HW_MAX_TICKS  (TIMER_TICKS_PER_SEC * 60)
+
 #endif /* DRV_TIMER_POSIX_H */
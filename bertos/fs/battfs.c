@@ -50,6 +50,12 @@
 
 #include <string.h> /* memset, memmove */
 
+/**
+ * Flag stored in the fill field of hole pages.
+ * \see BattFsPageHeader.hole
+ */
+#define FILL_HOLE 0x8000
+
 #if LOG_LEVEL >= LOG_LVL_INFO
 static void dumpPageArray(struct BattFsSuper *disk)
 {
@@ -74,7 +80,7 @@ INLINE void battfs_to_disk(struct BattFsPageHeader *hdr, uint8_t *buf)
 	buf[0] = hdr->inode;
 
 	buf[1] = hdr->fill;
-	buf[2] = hdr->fill >> 8;
+	buf[2] = (hdr->fill | (hdr->hole ? FILL_HOLE : 0)) >> 8;
 
 	buf[3] = hdr->pgoff;
 	buf[4] = hdr->pgoff >> 8;
@@ -106,7 +112,8 @@ INLINE void disk_to_battfs(uint8_t *buf, struct BattFsPageHeader *hdr)
 {
 	STATIC_ASSERT(BATTFS_HEADER_LEN == 12);
 	hdr->inode = buf[0];
-	hdr->fill = buf[2] << 8 | buf[1];
+	hdr->fill = (buf[2] << 8 | buf[1]) & ~FILL_HOLE;
+	hdr->hole = buf[2] & (FILL_HOLE >> 8);
 	hdr->pgoff = buf[4] << 8 | buf[3];
 	hdr->seq = (seq_t)buf[9] << 32 | (seq_t)buf[8] << 24 | (seq_t)buf[7] << 16 | buf[6] << 8 | buf[5];
 	hdr->fcs = buf[11] << 8 | buf[10];
@@ -127,6 +134,217 @@ static fcs_t computeFcs(struct BattFsPageHeader *hdr)
 	return cks;
 }
 
+#if CONFIG_BATTFS_CHECKPOINT
+
+#define CKPT_MAGIC 0x4B434642UL /* "BFCK" */
+
+/*
+ * Checkpoint layout, little-endian, starting from block 0 of the
+ * checkpoint device:
+ * - header: magic, generation, page count, free_page_start, free_bytes;
+ * - the page allocation array, 2 bytes per page;
+ * - trailer: generation again and the FCS of all the previous bytes.
+ *
+ * The generation is the count of page headers written, so it identifies
+ * the disk state the checkpoint was taken from. The first header write
+ * after a save clears the magic, and the header is written last: a torn
+ * checkpoint write leaves it invalid or the generations mismatching,
+ * and the checkpoint is discarded.
+ */
+
+static void put16(uint8_t *buf, uint16_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+}
+
+static void put32(uint8_t *buf, uint32_t val)
+{
+	put16(buf, val);
+	put16(buf + 2, val >> 16);
+}
+
+static uint16_t get16(const uint8_t *buf)
+{
+	return buf[1] << 8 | buf[0];
+}
+
+static uint32_t get32(const uint8_t *buf)
+{
+	return (uint32_t)get16(buf + 2) << 16 | get16(buf);
+}
+
+/**
+ * Transfer \a size bytes between \a buf and address \a *addr of the
+ * checkpoint device, updating \a *addr and \a fcs.
+ * \return true if ok, false on device errors.
+ */
+static bool ckptTransfer(struct BattFsSuper *disk, disk_size_t *addr, void *_buf, size_t size, fcs_t *fcs, bool write)
+{
+	KBlock *ckpt = disk->ckpt;
+	uint8_t *buf = (uint8_t *)_buf;
+
+	if (write && fcs)
+		rotating_update(buf, size, fcs);
+
+	while (size)
+	{
+		block_idx_t idx = *addr / ckpt->blk_size;
+		size_t offset = *addr % ckpt->blk_size;
+		size_t len = MIN(size, ckpt->blk_size - offset);
+
+		if (write ? kblock_write(ckpt, idx, buf, offset, len) != len
+			: kblock_read(ckpt, idx, buf, offset, len) != len)
+			return false;
+
+		*addr += len;
+		buf += len;
+		size -= len;
+	}
+
+	if (!write && fcs)
+		rotating_update(_buf, buf - (uint8_t *)_buf, fcs);
+	return true;
+}
+
+/**
+ * Load the page allocation array from the checkpoint of \a disk.
+ * \return true if a valid checkpoint has been loaded, false if
+ *         the disk has to be scanned.
+ */
+static bool ckptLoad(struct BattFsSuper *disk)
+{
+	uint8_t buf[32];
+	disk_size_t addr = 0;
+	fcs_t fcs;
+
+	disk->hdr_gen = 0;
+	disk->ckpt_valid = false;
+	if (!disk->ckpt)
+		return false;
+
+	ASSERT(kblock_partialWrite(disk->ckpt));
+	ASSERT((disk_size_t)disk->ckpt->blk_size * disk->ckpt->blk_cnt
+		>= BATTFS_CKPT_SIZE(disk->dev->blk_cnt));
+
+	rotating_init(&fcs);
+	if (!ckptTransfer(disk, &addr, buf, BATTFS_CKPT_HDR_LEN, &fcs, false))
+		return false;
+
+	/* Keep on counting even if the checkpoint is not usable */
+	disk->hdr_gen = get32(&buf[4]);
+	if (get32(&buf[0]) != CKPT_MAGIC
+	 || get16(&buf[8]) != disk->dev->blk_cnt
+	 || get16(&buf[10]) > disk->dev->blk_cnt)
+	{
+		LOG_INFO("No valid checkpoint\n");
+		return false;
+	}
+	disk->free_page_start = get16(&buf[10]);
+	disk->free_bytes = get32(&buf[12]);
+
+	for (pgcnt_t page = 0; page < disk->dev->blk_cnt; page += sizeof(buf) / 2)
+	{
+		pgcnt_t cnt = MIN((pgcnt_t)(sizeof(buf) / 2), (pgcnt_t)(disk->dev->blk_cnt - page));
+
+		if (!ckptTransfer(disk, &addr, buf, cnt * 2, &fcs, false))
+			return false;
+		for (pgcnt_t i = 0; i < cnt; i++)
+			disk->page_array[page + i] = get16(&buf[i * 2]);
+	}
+
+	if (!ckptTransfer(disk, &addr, buf, 4, &fcs, false)
+	 || !ckptTransfer(disk, &addr, buf + 4, 2, NULL, false))
+		return false;
+
+	if (get32(&buf[0]) != disk->hdr_gen || get16(&buf[4]) != fcs
+	 || disk->free_bytes > disk->disk_size)
+	{
+		LOG_INFO("Stale checkpoint, gen %ld\n", (long)disk->hdr_gen);
+		return false;
+	}
+
+	LOG_INFO("Checkpoint gen %ld loaded\n", (long)disk->hdr_gen);
+	disk->ckpt_valid = true;
+	return true;
+}
+
+/**
+ * Save the page allocation array of \a disk in its checkpoint.
+ * \return true if ok, false on device errors.
+ */
+static bool ckptSave(struct BattFsSuper *disk)
+{
+	uint8_t hdr[BATTFS_CKPT_HDR_LEN];
+	uint8_t buf[32];
+	disk_size_t addr = BATTFS_CKPT_HDR_LEN;
+	fcs_t fcs;
+
+	if (!disk->ckpt || disk->ckpt_valid)
+		return true;
+
+	put32(&hdr[0], CKPT_MAGIC);
+	put32(&hdr[4], disk->hdr_gen);
+	put16(&hdr[8], disk->dev->blk_cnt);
+	put16(&hdr[10], disk->free_page_start);
+	put32(&hdr[12], disk->free_bytes);
+
+	rotating_init(&fcs);
+	rotating_update(hdr, sizeof(hdr), &fcs);
+
+	for (pgcnt_t page = 0; page < disk->dev->blk_cnt; page += sizeof(buf) / 2)
+	{
+		pgcnt_t cnt = MIN((pgcnt_t)(sizeof(buf) / 2), (pgcnt_t)(disk->dev->blk_cnt - page));
+
+		for (pgcnt_t i = 0; i < cnt; i++)
+			put16(&buf[i * 2], disk->page_array[page + i]);
+		if (!ckptTransfer(disk, &addr, buf, cnt * 2, &fcs, true))
+			return false;
+	}
+
+	put32(&buf[0], disk->hdr_gen);
+	rotating_update(buf, 4, &fcs);
+	put16(&buf[4], fcs);
+	if (!ckptTransfer(disk, &addr, buf, BATTFS_CKPT_TRAILER_LEN, NULL, true)
+	 || kblock_flush(disk->ckpt) != 0)
+		return false;
+
+	/* Commit */
+	addr = 0;
+	if (!ckptTransfer(disk, &addr, hdr, sizeof(hdr), NULL, true)
+	 || kblock_flush(disk->ckpt) != 0)
+		return false;
+
+	LOG_INFO("Checkpoint gen %ld saved\n", (long)disk->hdr_gen);
+	disk->ckpt_valid = true;
+	return true;
+}
+
+/**
+ * Invalidate the checkpoint of \a disk.
+ * Must be called before any change to the disk reaches the device.
+ * \return true if ok, false on device errors.
+ */
+static bool ckptInvalidate(struct BattFsSuper *disk)
+{
+	uint8_t magic[4] = { 0, 0, 0, 0 };
+	disk_size_t addr = 0;
+
+	if (!disk->ckpt_valid)
+		return true;
+
+	if (!ckptTransfer(disk, &addr, magic, sizeof(magic), NULL, true)
+	 || kblock_flush(disk->ckpt) != 0)
+	{
+		LOG_ERR("invalidating checkpoint\n");
+		return false;
+	}
+	disk->ckpt_valid = false;
+	return true;
+}
+
+#endif /* CONFIG_BATTFS_CHECKPOINT */
+
 /**
  * Read header of \a page in \a hdr.
  * \return true on success, false otherwise.
@@ -157,6 +375,12 @@ static bool writeHdr(struct BattFsSuper *disk, pgcnt_t page, struct BattFsPageHe
 {
 	uint8_t buf[BATTFS_HEADER_LEN];
 
+	#if CONFIG_BATTFS_CHECKPOINT
+		if (!ckptInvalidate(disk))
+			return false;
+		disk->hdr_gen++;
+	#endif
+
 	#warning FIXME:refactor computeFcs to save time and stack
 	hdr->fcs = computeFcs(hdr);
 	/* Fill buffer */
@@ -356,12 +580,7 @@ static bool fillPageArray(struct BattFsSuper *disk, pgoff_t *filelen_table)
 }
 
 
-/**
- * Initialize and mount disk described by
- * \a disk.
- * \return false on errors, true otherwise.
- */
-bool battfs_mount(struct BattFsSuper *disk, struct KBlock *dev, pgcnt_t *page_array, size_t array_size)
+static bool mount(struct BattFsSuper *disk, struct KBlock *dev, pgcnt_t *page_array, size_t array_size)
 {
 	pgoff_t filelen_table[BATTFS_MAX_FILES];
 
@@ -372,6 +591,7 @@ bool battfs_mount(struct BattFsSuper *disk, struct KBlock *dev, pgcnt_t *page_ar
 	ASSERT(disk->dev->blk_size > BATTFS_HEADER_LEN);
 	/* Fill page_size with the usable space */
 	disk->data_size = disk->dev->blk_size - BATTFS_HEADER_LEN;
+	ASSERT(disk->data_size < FILL_HOLE);
 	ASSERT(disk->dev->blk_cnt);
 	ASSERT(disk->dev->blk_cnt < PAGE_UNSET_SENTINEL - 1);
 	ASSERT(page_array);
@@ -380,28 +600,40 @@ bool battfs_mount(struct BattFsSuper *disk, struct KBlock *dev, pgcnt_t *page_ar
 
 	memset(filelen_table, 0, BATTFS_MAX_FILES * sizeof(pgoff_t));
 
-	disk->free_bytes = 0;
 	disk->disk_size = (disk_size_t)disk->data_size * disk->dev->blk_cnt;
 
-	/* Count pages per file */
-	if (!countDiskFilePages(disk, filelen_table))
+	#if CONFIG_BATTFS_WEAR_LEVELING
+		disk->wear = NULL;
+	#endif
+
+	#if CONFIG_BATTFS_CHECKPOINT
+	/* Skip the disk scan if a valid checkpoint is available */
+	if (!ckptLoad(disk))
+	#endif
 	{
-		LOG_ERR("counting file pages\n");
-		return false;
-	}
+		disk->free_bytes = 0;
 
-	/* Once here, we have filelen_table filled with file lengths */
+		/* Count pages per file */
+		if (!countDiskFilePages(disk, filelen_table))
+		{
+			LOG_ERR("counting file pages\n");
+			return false;
+		}
 
-	/* Fill page array with sentinel */
-	for (pgcnt_t page = 0; page < disk->dev->blk_cnt; page++)
-		disk->page_array[page] = PAGE_UNSET_SENTINEL;
+		/* Once here, we have filelen_table filled with file lengths */
 
-	/* Fill page allocation array using filelen_table */
-	if (!fillPageArray(disk, filelen_table))
-	{
-		LOG_ERR("filling page array\n");
-		return false;
+		/* Fill page array with sentinel */
+		for (pgcnt_t page = 0; page < disk->dev->blk_cnt; page++)
+			disk->page_array[page] = PAGE_UNSET_SENTINEL;
+
+		/* Fill page allocation array using filelen_table */
+		if (!fillPageArray(disk, filelen_table))
+		{
+			LOG_ERR("filling page array\n");
+			return false;
+		}
 	}
+	disk->free_head = disk->free_page_start;
 	#if LOG_LEVEL >= LOG_LVL_INFO
 		dumpPageArray(disk);
 	#endif
@@ -418,6 +650,37 @@ bool battfs_mount(struct BattFsSuper *disk, struct KBlock *dev, pgcnt_t *page_ar
 	return true;
 }
 
+/**
+ * Initialize and mount disk described by
+ * \a disk.
+ * \return false on errors, true otherwise.
+ */
+bool battfs_mount(struct BattFsSuper *disk, struct KBlock *dev, pgcnt_t *page_array, size_t array_size)
+{
+	#if CONFIG_BATTFS_CHECKPOINT
+		disk->ckpt = NULL;
+	#endif
+	return mount(disk, dev, page_array, array_size);
+}
+
+#if CONFIG_BATTFS_CHECKPOINT
+/**
+ * Initialize and mount disk described by \a disk, using
+ * the page array checkpoint stored on \a ckpt.
+ * The disk is scanned only if the checkpoint is missing or stale.
+ * \a ckpt must be at least BATTFS_CKPT_SIZE(dev->blk_cnt) bytes big.
+ * \note The checkpoint is checked against the count of page headers
+ *       written, no disk page is read: it does not see the changes made
+ *       while mounted with battfs_mount(), erase \a ckpt after them.
+ * \return false on errors, true otherwise.
+ */
+bool battfs_mountCheckpoint(struct BattFsSuper *disk, struct KBlock *dev, struct KBlock *ckpt, pgcnt_t *page_array, size_t array_size)
+{
+	disk->ckpt = ckpt;
+	return mount(disk, dev, page_array, array_size);
+}
+#endif
+
 /**
  * Check the filesystem.
  * \return true if ok, false on errors.
@@ -512,6 +775,105 @@ static int battfs_fileclose(struct KFile *fd)
 
 #define NO_SPACE PAGE_UNSET_SENTINEL
 
+/**
+ * \return the position following \a pos in the free pages FIFO
+ * of \a disk, wrapping around at the end of the page array.
+ */
+INLINE pgcnt_t nextFreePos(struct BattFsSuper *disk, pgcnt_t pos)
+{
+	return ((block_idx_t)pos + 1 >= disk->dev->blk_cnt) ? disk->free_page_start : pos + 1;
+}
+
+/**
+ * Advance the free pages FIFO head of \a disk.
+ */
+INLINE void nextFreeHead(struct BattFsSuper *disk)
+{
+	disk->free_head = nextFreePos(disk, disk->free_head);
+}
+
+#if CONFIG_BATTFS_WEAR_LEVELING
+
+/*
+ * Every page written by the user earns CONFIG_BATTFS_WEAR_AMPLIFICATION
+ * credits, a cold data move costs WEAR_MOVE_COST.
+ */
+#define WEAR_MOVE_COST   100
+#define WEAR_CREDIT_MAX  (WEAR_MOVE_COST * 16)
+
+/**
+ * Increase the erase count of \a page.
+ * When a count is about to overflow all of them are halved, keeping
+ * the relative wear of pages.
+ */
+static void wearCount(struct BattFsSuper *disk, pgcnt_t page)
+{
+	if (disk->wear[page] == (wear_t)-1)
+	{
+		for (pgcnt_t i = 0; i < disk->dev->blk_cnt; i++)
+			disk->wear[i] /= 2;
+	}
+	disk->wear[page]++;
+}
+
+#endif /* CONFIG_BATTFS_WEAR_LEVELING */
+
+/**
+ * \return the page at the head of the free pages FIFO of \a disk.
+ * With wear leveling the least worn among the first
+ * CONFIG_BATTFS_WEAR_WINDOW free pages is moved to the head
+ * and accounted as written.
+ */
+static pgcnt_t headFreePage(struct BattFsSuper *disk)
+{
+	#if CONFIG_BATTFS_WEAR_LEVELING
+	if (disk->wear)
+	{
+		pgcnt_t best = disk->free_head, pos = disk->free_head;
+		pgcnt_t n = MIN((pgcnt_t)CONFIG_BATTFS_WEAR_WINDOW,
+			(pgcnt_t)(disk->dev->blk_cnt - disk->free_page_start));
+
+		while (--n)
+		{
+			pos = nextFreePos(disk, pos);
+			if (disk->wear[disk->page_array[pos]] < disk->wear[disk->page_array[best]])
+				best = pos;
+		}
+		if (best != disk->free_head)
+			SWAP(disk->page_array[best], disk->page_array[disk->free_head]);
+
+		wearCount(disk, disk->page_array[disk->free_head]);
+		disk->wear_credit = MIN(disk->wear_credit + CONFIG_BATTFS_WEAR_AMPLIFICATION, WEAR_CREDIT_MAX);
+	}
+	#endif
+	return disk->page_array[disk->free_head];
+}
+
+/**
+ * Take the page at the head of the free pages FIFO and
+ * move it at the end of the used pages, in O(1).
+ * The page that was at free_page_start is swapped in the slot just
+ * behind the new head: it jumps to the FIFO tail, so allocations
+ * change the order in which the free pages are reused.
+ */
+static pgcnt_t takeFreePage(struct BattFsSuper *disk)
+{
+	pgcnt_t new_page = headFreePage(disk);
+
+	disk->page_array[disk->free_head] = disk->page_array[disk->free_page_start];
+	disk->page_array[disk->free_page_start++] = new_page;
+	nextFreeHead(disk);
+	return new_page;
+}
+
+/**
+ * Insert a free page of \a disk at position \a new_pos of the page
+ * allocation array, as a new page of file \a inode.
+ * Taking the free page is O(1), but making room for it moves the
+ * entries of all the files following \a inode and updates the open
+ * ones: appending to a file costs as much as the pages after it.
+ * \return the new page, NO_SPACE if the disk is full.
+ */
 static pgcnt_t allocateNewPage(struct BattFsSuper *disk, pgcnt_t new_pos, inode_t inode)
 {
 	if (SPACE_OVER(disk))
@@ -520,8 +882,9 @@ static pgcnt_t allocateNewPage(struct BattFsSuper *disk, pgcnt_t new_pos, inode_
 		return NO_SPACE;
 	}
 
-	LOG_INFO("Getting new page %d, pos %d\n", disk->page_array[disk->free_page_start], new_pos);
-	pgcnt_t new_page = disk->page_array[disk->free_page_start++];
+	pgcnt_t new_page = takeFreePage(disk);
+	LOG_INFO("Getting new page %d, pos %d\n", new_page, new_pos);
+	/* Only the pages of the following files are moved */
 	memmove(&disk->page_array[new_pos + 1], &disk->page_array[new_pos], (disk->free_page_start - new_pos - 1) * sizeof(pgcnt_t));
 
 	Node *n;
@@ -548,16 +911,37 @@ static pgcnt_t renewPage(struct BattFsSuper *disk, pgcnt_t old_pos)
 		return NO_SPACE;
 	}
 
-	/* Get a free page */
-	pgcnt_t new_page = disk->page_array[disk->free_page_start];
-	movePages(disk, disk->free_page_start + 1, -1);
-
-	/* Insert previous page in free blocks list */
+	/*
+	 * Get a free page and insert previous page in
+	 * its place, at the tail of free pages FIFO.
+	 */
+	pgcnt_t new_page = headFreePage(disk);
 	LOG_INFO("Setting page %d as free\n", old_pos);
-	disk->page_array[disk->dev->blk_cnt - 1] = old_pos;
+	disk->page_array[disk->free_head] = old_pos;
+	nextFreeHead(disk);
 	return new_page;
 }
 
+/**
+ * Write \a size zeros in \a page of \a disk, starting from \a offset.
+ * \return true if ok, false on disk write errors.
+ */
+static bool zeroFill(struct BattFsSuper *disk, pgcnt_t page, pgaddr_t offset, pgaddr_t size)
+{
+	static const uint8_t zeros[64];
+
+	while (size)
+	{
+		pgaddr_t len = MIN(size, (pgaddr_t)sizeof(zeros));
+
+		if (kblock_write(disk->dev, page, zeros, offset, len) != len)
+			return false;
+		offset += len;
+		size -= len;
+	}
+	return true;
+}
+
 /**
  * Write to file \a fd \a size bytes from \a buf.
  * \return The number of bytes written.
@@ -583,6 +967,8 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 
 	if (fd->seek_pos > fd->size)
 	{
+		bool sparse = fdb->mode & BATTFS_SPARSE;
+
 		if (!readHdr(disk, fdb->start[fdb->max_off], &curr_hdr))
 		{
 			fdb->errors |= BATTFS_DISK_READ_ERR;
@@ -605,27 +991,35 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 				return total_write;
 			}
 
-			kblock_copy(disk->dev, fdb->start[fdb->max_off], new_page);
+			/* Hole data is meaningless */
+			if (!curr_hdr.hole)
+				kblock_copy(disk->dev, fdb->start[fdb->max_off], new_page);
 			fdb->start[fdb->max_off] = new_page;
 		}
 		else
 			new_page = fdb->start[fdb->max_off];
 
-		/* Fill unused space of first page with 0s */
-		uint8_t dummy = 0;
-		// TODO: write in blocks to speed up things
-		pgaddr_t zero_bytes = MIN(fd->seek_pos - fd->size, (kfile_off_t)(disk->data_size - curr_hdr.fill));
-		while (zero_bytes--)
+		/* A hole can only be extended as a hole */
+		if (curr_hdr.hole && !sparse)
 		{
-			if (kblock_write(disk->dev, new_page, &dummy, curr_hdr.fill, 1) != 1)
+			if (!zeroFill(disk, new_page, 0, curr_hdr.fill))
 			{
 				fdb->errors |= BATTFS_DISK_WRITE_ERR;
 				return total_write;
 			}
-			curr_hdr.fill++;
-			fd->size++;
-			disk->free_bytes--;
+			curr_hdr.hole = false;
 		}
+
+		/* Fill unused space of first page with 0s */
+		pgaddr_t zero_bytes = MIN(fd->seek_pos - fd->size, (kfile_off_t)(disk->data_size - curr_hdr.fill));
+		if (!curr_hdr.hole && !zeroFill(disk, new_page, curr_hdr.fill, zero_bytes))
+		{
+			fdb->errors |= BATTFS_DISK_WRITE_ERR;
+			return total_write;
+		}
+		curr_hdr.fill += zero_bytes;
+		fd->size += zero_bytes;
+		disk->free_bytes -= zero_bytes;
 		curr_hdr.seq++;
 		if (!writeHdr(disk, new_page, &curr_hdr))
 		{
@@ -650,20 +1044,21 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 			}
 
 
-			// TODO: write in blocks to speed up things
-			/* Fill page buffer with 0 to avoid filling unused pages with garbage */
-			for (pgaddr_t off = 0; off < disk->data_size; off++)
+			/*
+			 * Fill page buffer with 0 to avoid filling unused pages with garbage.
+			 * Holes are not written at all, they read as zeros.
+			 */
+			if (!sparse && !zeroFill(disk, new_page, 0, disk->data_size))
 			{
-				if (kblock_write(disk->dev, new_page, &dummy, off, 1) != 1)
-				{
-					fdb->errors |= BATTFS_DISK_WRITE_ERR;
-					return total_write;
-				}
+				fdb->errors |= BATTFS_DISK_WRITE_ERR;
+				return total_write;
 			}
 			curr_hdr.inode = fdb->inode;
 			curr_hdr.pgoff = ++fdb->max_off;
 			curr_hdr.fill = zero_bytes;
 			curr_hdr.seq = 0;
+			curr_hdr.hole = sparse;
+			fdb->holes |= sparse;
 
 			if (!writeHdr(disk, new_page, &curr_hdr))
 			{
@@ -699,6 +1094,7 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 			curr_hdr.pgoff = pg_offset;
 			curr_hdr.fill = 0;
 			curr_hdr.seq = 0;
+			curr_hdr.hole = false;
 			fdb->max_off = pg_offset;
 		}
 		else
@@ -721,7 +1117,7 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 				}
 
 				LOG_INFO("Re-writing page %d to %d\n", fdb->start[pg_offset], new_page);
-				if (kblock_copy(disk->dev, fdb->start[pg_offset], new_page) != 0)
+				if (!curr_hdr.hole && kblock_copy(disk->dev, fdb->start[pg_offset], new_page) != 0)
 				{
 					fdb->errors |= BATTFS_DISK_WRITE_ERR;
 					return total_write;
@@ -735,6 +1131,20 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 			}
 
 			curr_hdr.seq++;
+
+			/* Writing in a hole: the rest of the page must read as zeros */
+			if (curr_hdr.hole)
+			{
+				pgaddr_t end = addr_offset + wr_len;
+
+				if (!zeroFill(disk, new_page, 0, addr_offset)
+				 || (end < curr_hdr.fill && !zeroFill(disk, new_page, end, curr_hdr.fill - end)))
+				{
+					fdb->errors |= BATTFS_DISK_WRITE_ERR;
+					return total_write;
+				}
+				curr_hdr.hole = false;
+			}
 		}
 		//LOG_INFO("writing to buffer for page %d, offset %d, size %d\n", disk->curr_page, addr_offset, wr_len);
 		if (kblock_write(disk->dev, new_page, buf, addr_offset, wr_len) != wr_len)
@@ -793,9 +1203,23 @@ static size_t battfs_read(struct KFile *fd, void *_buf, size_t size)
 		addr_offset = fd->seek_pos % disk->data_size;
 		read_len = MIN(size, (size_t)(disk->data_size - addr_offset));
 
+		bool hole = false;
+		if (fdb->holes)
+		{
+			BattFsPageHeader hdr;
+			if (!readHdr(disk, fdb->start[pg_offset], &hdr))
+			{
+				fdb->errors |= BATTFS_DISK_READ_ERR;
+				return total_read;
+			}
+			hole = hdr.hole;
+		}
+
 		//LOG_INFO("reading from page %d, offset %d, size %d\n", fdb->start[pg_offset], addr_offset, read_len);
-		/* Read from disk */
-		if (kblock_read(disk->dev, fdb->start[pg_offset], buf, addr_offset, read_len) != read_len)
+		/* Read from disk, holes read as zeros */
+		if (hole)
+			memset(buf, 0, read_len);
+		else if (kblock_read(disk->dev, fdb->start[pg_offset], buf, addr_offset, read_len) != read_len)
 		{
 			fdb->errors |= BATTFS_DISK_READ_ERR;
 			return total_read;
@@ -865,10 +1289,10 @@ bool battfs_fileExists(BattFsSuper *disk, inode_t inode)
 
 /**
  * Count size of file \a inode on \a disk, starting at pointer \a start
- * in disk->page_array. Size is written in \a size.
- * \return true if all s ok, false on disk read errors.
+ * in disk->page_array. \a holes is set if some pages are holes.
+ * \return the file size, EOF on disk read errors.
  */
-static file_size_t countFileSize(BattFsSuper *disk, pgcnt_t *start, inode_t inode)
+static file_size_t countFileSize(BattFsSuper *disk, pgcnt_t *start, inode_t inode, bool *holes)
 {
 	file_size_t size = 0;
 	BattFsPageHeader hdr;
@@ -878,7 +1302,10 @@ static file_size_t countFileSize(BattFsSuper *disk, pgcnt_t *start, inode_t inod
 		if (!readHdr(disk, *start++, &hdr))
 			return EOF;
 		if (hdr.fcs == computeFcs(&hdr) && hdr.inode == inode)
+		{
 			size += hdr.fill;
+			*holes |= hdr.hole;
+		}
 		else
 			break;
 	}
@@ -932,6 +1359,7 @@ bool battfs_fileopen(BattFsSuper *disk, BattFs *fd, inode_t inode, filemode_t mo
 		hdr.pgoff = 0;
 		hdr.fill = 0;
 		hdr.seq = 0;
+		hdr.hole = false;
 		if (!writeHdr(disk, disk->page_array[start_pos], &hdr))
 		{
 			fd->errors |= BATTFS_DISK_WRITE_ERR;
@@ -942,7 +1370,7 @@ bool battfs_fileopen(BattFsSuper *disk, BattFs *fd, inode_t inode, filemode_t mo
 	LOG_INFO("Start pos %d\n", start_pos);
 
 	/* Fill file size */
-	if ((fd->fd.size = countFileSize(disk, fd->start, inode)) == EOF)
+	if ((fd->fd.size = countFileSize(disk, fd->start, inode, &fd->holes)) == EOF)
 	{
 		fd->errors |= BATTFS_DISK_READ_ERR;
 		return false;
@@ -982,6 +1410,93 @@ bool battfs_fileopen(BattFsSuper *disk, BattFs *fd, inode_t inode, filemode_t mo
 }
 
 
+/**
+ * Write all pending changes of \a disk to the device and,
+ * if enabled, save the page array checkpoint.
+ * \return true if ok, false on errors.
+ */
+bool battfs_sync(struct BattFsSuper *disk)
+{
+	if (kblock_flush(disk->dev) != 0)
+		return false;
+
+	#if CONFIG_BATTFS_CHECKPOINT
+		if (!ckptSave(disk))
+		{
+			LOG_ERR("saving checkpoint\n");
+			return false;
+		}
+	#endif
+	return true;
+}
+
+#if CONFIG_BATTFS_WEAR_LEVELING
+/**
+ * Enable wear leveling on mounted \a disk.
+ * \a erase_count must have room for an erase count for every disk page.
+ * It is updated as pages are written: to keep track of wear across
+ * reboots, save it before power off and pass it again after mount,
+ * otherwise clear it.
+ */
+void battfs_wearInit(struct BattFsSuper *disk, wear_t *erase_count, size_t size)
+{
+	ASSERT(erase_count);
+	ASSERT(size >= disk->dev->blk_cnt * sizeof(wear_t));
+
+	disk->wear = erase_count;
+	disk->wear_credit = 0;
+}
+
+/**
+ * Move cold data of \a disk, if needed.
+ * Call it in idle time: if the wear gap is over CONFIG_BATTFS_WEAR_THRESHOLD,
+ * the least worn page in use is copied on the most worn free page, and
+ * can then be used for the files that are written more often.
+ * Moves are limited to CONFIG_BATTFS_WEAR_AMPLIFICATION percent of the
+ * pages written by the user.
+ * \return 1 if a page has been moved, 0 if there is nothing to do,
+ *         EOF on errors.
+ */
+int battfs_wearLevel(struct BattFsSuper *disk)
+{
+	BattFsPageHeader hdr;
+	pgcnt_t cold = 0, hot = disk->free_page_start;
+	pgcnt_t old_page, new_page;
+
+	if (!disk->wear || !disk->free_page_start || SPACE_OVER(disk)
+	 || disk->wear_credit < WEAR_MOVE_COST)
+		return 0;
+
+	for (pgcnt_t pos = 1; pos < disk->free_page_start; pos++)
+		if (disk->wear[disk->page_array[pos]] < disk->wear[disk->page_array[cold]])
+			cold = pos;
+	for (pgcnt_t pos = hot + 1; pos < disk->dev->blk_cnt; pos++)
+		if (disk->wear[disk->page_array[pos]] > disk->wear[disk->page_array[hot]])
+			hot = pos;
+
+	old_page = disk->page_array[cold];
+	new_page = disk->page_array[hot];
+	if (disk->wear[new_page] - disk->wear[old_page] <= CONFIG_BATTFS_WEAR_THRESHOLD)
+		return 0;
+
+	LOG_INFO("Moving cold page %d to %d\n", old_page, new_page);
+	if (!readHdr(disk, old_page, &hdr)
+	 || kblock_copy(disk->dev, old_page, new_page) != 0)
+		return EOF;
+
+	/* The new copy wins on the old one at mount */
+	hdr.seq++;
+	if (!writeHdr(disk, new_page, &hdr))
+		return EOF;
+
+	disk->page_array[cold] = new_page;
+	disk->page_array[hot] = old_page;
+	wearCount(disk, new_page);
+	disk->wear_credit -= WEAR_MOVE_COST;
+	return 1;
+}
+#endif /* CONFIG_BATTFS_WEAR_LEVELING */
+
 /**
  * Umount \a disk.
  */
@@ -997,8 +1512,16 @@ bool battfs_umount(struct BattFsSuper *disk)
 		res += battfs_fileclose(&file->fd);
 	}
 
+	if (!battfs_sync(disk))
+		res = EOF;
+
+	#if CONFIG_BATTFS_CHECKPOINT
+		if (disk->ckpt && kblock_close(disk->ckpt) != 0)
+			res = EOF;
+	#endif
+
 	/* Close disk */
-	return (kblock_flush(disk->dev) == 0) && (kblock_close(disk->dev) == 0) && (res == 0);
+	return (kblock_close(disk->dev) == 0) && (res == 0);
 }
 
 #if UNIT_TEST
@@ -1013,6 +1536,7 @@ void battfs_writeTestBlock(KBlock *dev, pgcnt_t page, inode_t inode, seq_t seq,
 	hdr.fill = fill;
 	hdr.pgoff = pgoff;
 	hdr.seq = seq;
+	hdr.hole = false;
 	hdr.fcs = computeFcs(&hdr);
 
 	battfs_to_disk(&hdr, buf);
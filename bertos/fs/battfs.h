@@ -44,6 +44,8 @@
 #ifndef FS_BATTFS_H
 #define FS_BATTFS_H
 
+#include "cfg/cfg_battfs.h"
+
 #include <cfg/compiler.h> // uintXX_t; STATIC_ASSERT
 #include <cpu/types.h> // CPU_BITS_PER_CHAR
 #include <algo/rotating_hash.h>
@@ -51,6 +53,10 @@
 #include <io/kfile.h>
 #include <io/kblock.h>
 
+#ifndef CONFIG_BATTFS_WEAR_LEVELING
+	#define CONFIG_BATTFS_WEAR_LEVELING 0
+#endif
+
 typedef uint16_t fill_t;    ///< Type for keeping trace of space filled inside a page
 typedef fill_t   pgaddr_t;  ///< Type for addressing space inside a page
 typedef uint16_t pgcnt_t;   ///< Type for counting pages on disk
@@ -58,6 +64,7 @@ typedef pgcnt_t  pgoff_t;   ///< Type for counting pages inside a file
 typedef uint8_t  inode_t;   ///< Type for file inodes
 typedef uint64_t  seq_t;    ///< Type for page seq number, at least 40bits wide.
 typedef rotating_t fcs_t;   ///< Type for header FCS.
+typedef uint16_t wear_t;    ///< Type for page erase counts.
 
 
 /**
@@ -83,6 +90,12 @@ typedef struct BattFsPageHeader
 	 */
 	seq_t    seq;
 
+	/**
+	 * True if page data has never been written:
+	 * the first \a fill bytes of the page read as zeros.
+	 */
+	bool hole;
+
 	/**
 	 * FCS (Frame Check Sequence) of the page header.
 	 */
@@ -113,6 +126,24 @@ typedef struct BattFsPageHeader
 
 typedef uint32_t disk_size_t; ///< Type for disk sizes.
 
+/**
+ * Size of the checkpoint header once saved on disk.
+ */
+#define BATTFS_CKPT_HDR_LEN 16
+
+/**
+ * Size of the checkpoint trailer once saved on disk.
+ */
+#define BATTFS_CKPT_TRAILER_LEN 6
+
+/**
+ * Bytes needed to store the checkpoint of a disk with \a pages pages.
+ * The checkpoint device passed to battfs_mountCheckpoint() must be at
+ * least this big.
+ */
+#define BATTFS_CKPT_SIZE(pages) \
+	(BATTFS_CKPT_HDR_LEN + (disk_size_t)(pages) * 2 + BATTFS_CKPT_TRAILER_LEN)
+
 /**
  * Context used to describe a disk.
  * This context structure will be used to access disk.
@@ -129,6 +160,11 @@ typedef struct BattFsSuper
 	 * must have enough space for page_count elements.
 	 * Is used by the filesystem to represent
 	 * the entire disk in memory.
+	 * Used pages are kept ordered by (inode, pgoff), so files are
+	 * found with a binary search and the array costs only 2 bytes
+	 * per page. Adding a page to a file moves the entries of the
+	 * following files: appending to the last file is O(1), appending
+	 * to a file in the middle is linear in the pages that follow it.
 	 */
 	pgcnt_t *page_array;
 
@@ -138,10 +174,28 @@ typedef struct BattFsSuper
 	 */
 	pgcnt_t free_page_start;
 
+	/**
+	 * Position in page array of the next free page to use.
+	 * Free pages are used as a circular FIFO, from free_head
+	 * to the end of the array and then from free_page_start.
+	 */
+	pgcnt_t free_head;
+
 	disk_size_t disk_size;   ///< Size of the disk, in bytes (page_count * page_size).
 	disk_size_t free_bytes;  ///< Free space on the disk.
 
 	List file_opened_list;       ///< List used to keep trace of open files.
+
+#if CONFIG_BATTFS_CHECKPOINT
+	KBlock *ckpt;            ///< Device holding the page array checkpoint, NULL if none.
+	uint32_t hdr_gen;        ///< Page headers written, the generation of the checkpoint.
+	bool ckpt_valid;         ///< True if the checkpoint on disk matches the disk state.
+#endif
+
+#if CONFIG_BATTFS_WEAR_LEVELING
+	wear_t *wear;            ///< Erase count of every disk page, NULL if wear leveling is off.
+	int wear_credit;         ///< Budget for cold data moves, in hundredths of page.
+#endif
 	/* TODO add other fields. */
 } BattFsSuper;
 
@@ -160,6 +214,7 @@ typedef int32_t file_size_t; ///< Type for file sizes.
 #define BATTFS_CREATE BV(0)  ///< Create file if does not exist
 #define BATTFS_RD     BV(1)  ///< Open file for reading
 #define BATTFS_WR     BV(2)  ///< Open file fir writing
+#define BATTFS_SPARSE BV(3)  ///< Leave holes instead of writing zeros when writing past EOF
 /*/}*/
 
 
@@ -187,6 +242,7 @@ typedef struct BattFs
 	filemode_t mode;    ///< File open mode
 	pgcnt_t *start;     ///< Pointer to page_array file start position.
 	pgcnt_t max_off;    ///< Max page offset allocated for the file.
+	bool holes;         ///< True if some file pages are holes.
 	int errors;         ///< File status/errors
 } BattFs;
 
@@ -206,7 +262,16 @@ INLINE BattFs * BATTFS_CAST(KFile *fd)
 }
 
 bool battfs_mount(struct BattFsSuper *disk, struct KBlock *dev, pgcnt_t *page_array, size_t array_size);
+#if CONFIG_BATTFS_CHECKPOINT
+bool battfs_mountCheckpoint(struct BattFsSuper *disk, struct KBlock *dev, struct KBlock *ckpt, pgcnt_t *page_array, size_t array_size);
+#endif
 bool battfs_fsck(struct BattFsSuper *disk);
+bool battfs_sync(struct BattFsSuper *disk);
+
+#if CONFIG_BATTFS_WEAR_LEVELING
+void battfs_wearInit(struct BattFsSuper *disk, wear_t *erase_count, size_t size);
+int battfs_wearLevel(struct BattFsSuper *disk);
+#endif
 bool battfs_umount(struct BattFsSuper *disk);
 
 bool battfs_fileExists(BattFsSuper *disk, inode_t inode);
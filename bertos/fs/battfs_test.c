@@ -31,11 +31,18 @@
  *
  * \brief BattFS Test.
  *
+ * $test$: cp bertos/cfg/cfg_battfs.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_BATTFS_WEAR_LEVELING" >> $cfgdir/cfg_battfs.h
+ * $test$: echo "#define CONFIG_BATTFS_WEAR_LEVELING 1" >> $cfgdir/cfg_battfs.h
+ * $test$: echo  "#undef BATTFS_LOG_LEVEL" >> $cfgdir/cfg_battfs.h
+ * $test$: echo "#define BATTFS_LOG_LEVEL LOG_LVL_WARN" >> $cfgdir/cfg_battfs.h
+ *
  * \author Francesco Sacchi <batt@develer.com>
  */
 
 #include <fs/battfs.h>
 #include <io/kblock_posix.h>
+#include <io/kblock_ram.h>
 
 #include <cfg/debug.h>
 #include <cfg/test.h>
@@ -43,6 +50,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define FILE_SIZE 32768
 #define PAGE_SIZE 128
@@ -57,6 +65,9 @@ const char test_filename[]="battfs_disk.bin";
 
 static uint8_t page_buffer[PAGE_SIZE];
 static pgcnt_t page_array[PAGE_COUNT];
+#if CONFIG_BATTFS_CHECKPOINT
+static uint8_t ckpt_buffer[1024];
+#endif
 
 static void testCheck(BattFsSuper *disk, pgcnt_t *reference)
 {
@@ -1070,6 +1081,561 @@ static void openAllFiles(BattFsSuper *disk)
 	TRACEMSG("22: passed\n");
 }
 
+#if CONFIG_BATTFS_CHECKPOINT
+
+static void ckptWriteFiles(BattFsSuper *disk, int delta)
+{
+	BattFs fd;
+	uint32_t buf[DATA_SIZE / sizeof(uint32_t) * 3];
+
+	for (inode_t i = 0; i < N_FILES; i++)
+	{
+		for (uint32_t j = 0; j < countof(buf); j++)
+			buf[j] = j + i + delta;
+
+		ASSERT(battfs_fileopen(disk, &fd, i, BATTFS_CREATE));
+		ASSERT(kfile_write(&fd.fd, buf, sizeof(buf)) == sizeof(buf));
+		ASSERT(kfile_close(&fd.fd) == 0);
+		ASSERT(kfile_error(&fd.fd) == 0);
+	}
+}
+
+static void ckptCheckFiles(BattFsSuper *disk, int delta)
+{
+	BattFs fd;
+	uint32_t buf[DATA_SIZE / sizeof(uint32_t) * 3];
+
+	for (inode_t i = 0; i < N_FILES; i++)
+	{
+		memset(buf, 0, sizeof(buf));
+		ASSERT(battfs_fileopen(disk, &fd, i, 0));
+		ASSERT(fd.fd.size == sizeof(buf));
+		ASSERT(kfile_read(&fd.fd, buf, sizeof(buf)) == sizeof(buf));
+		for (uint32_t j = 0; j < countof(buf); j++)
+			ASSERT(buf[j] == j + i + delta);
+		ASSERT(kfile_close(&fd.fd) == 0);
+	}
+}
+
+/* Print the mount time of the disk in \a test_filename with and without its checkpoint */
+static void ckptTimeMount(BattFsSuper *disk, const char *what)
+{
+	KBlockPosix f;
+	KBlockRam ckpt;
+	clock_t t;
+
+	FILE *fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	t = clock();
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+	t = clock() - t;
+	kprintf("%s disk, mount without checkpoint: %ld us\n", what, (long)(t * 1000000 / CLOCKS_PER_SEC));
+	ASSERT(battfs_umount(disk));
+
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	t = clock();
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	t = clock() - t;
+	kprintf("%s disk, mount with checkpoint: %ld us\n", what, (long)(t * 1000000 / CLOCKS_PER_SEC));
+	ASSERT(disk->ckpt_valid);
+	ASSERT(battfs_umount(disk));
+}
+
+static void ckptMount(BattFsSuper *disk)
+{
+	pgcnt_t ref[PAGE_COUNT];
+	KBlockPosix f;
+	KBlockRam ckpt;
+
+	TRACEMSG("23: mount using page array checkpoint\n");
+	ASSERT(BATTFS_CKPT_SIZE(PAGE_COUNT) <= sizeof(ckpt_buffer));
+
+	FILE *fpt = fopen(test_filename, "w+");
+	for (int i = 0; i < FILE_SIZE; i++)
+		fputc(0xff, fpt);
+	memset(ckpt_buffer, 0xff, sizeof(ckpt_buffer));
+
+	/* No checkpoint yet: the disk is scanned, umount saves it */
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	ASSERT(!disk->ckpt_valid);
+	ASSERT(battfs_umount(disk));
+
+	/* Loading the checkpoint reads no disk page, even if all are free */
+	ckptTimeMount(disk, "Empty");
+
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	ASSERT(disk->ckpt_valid);
+	ckptWriteFiles(disk, 0);
+	ASSERT(!disk->ckpt_valid);
+	ASSERT(battfs_fsck(disk));
+	memcpy(ref, page_array, sizeof(ref));
+	ASSERT(battfs_umount(disk));
+
+	ckptTimeMount(disk, "Used");
+
+	/* The checkpoint matches the full scan */
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+	ASSERT(memcmp(ref, page_array, sizeof(ref)) == 0);
+	ASSERT(battfs_umount(disk));
+
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	ASSERT(disk->ckpt_valid);
+	ASSERT(memcmp(ref, page_array, sizeof(ref)) == 0);
+	ASSERT(battfs_fsck(disk));
+	ckptCheckFiles(disk, 0);
+
+	/* Reading does not invalidate the checkpoint */
+	ASSERT(disk->ckpt_valid);
+	ASSERT(battfs_umount(disk));
+
+	TRACEMSG("23: passed\n");
+}
+
+static void ckptPowerLoss(BattFsSuper *disk)
+{
+	pgcnt_t ref[PAGE_COUNT];
+	KBlockPosix f;
+	KBlockRam ckpt;
+	uint32_t gen;
+
+	TRACEMSG("24: checkpoint and power loss\n");
+
+	/* Change the files and lose power without umounting */
+	FILE *fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	ASSERT(disk->ckpt_valid);
+	gen = disk->hdr_gen;
+	ckptWriteFiles(disk, 1);
+	ASSERT(!disk->ckpt_valid);
+	ASSERT(disk->hdr_gen > gen);
+	memcpy(ref, page_array, sizeof(ref));
+	fclose(fpt);
+
+	/* The stale checkpoint is discarded */
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	ASSERT(!disk->ckpt_valid);
+	ASSERT(battfs_fsck(disk));
+	ckptCheckFiles(disk, 1);
+
+	/* Sync saves a new checkpoint, the next change invalidates it */
+	ASSERT(battfs_sync(disk));
+	ASSERT(disk->ckpt_valid);
+	ckptWriteFiles(disk, 2);
+	ASSERT(!disk->ckpt_valid);
+	memcpy(ref, page_array, sizeof(ref));
+	fclose(fpt);
+
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	ASSERT(!disk->ckpt_valid);
+	ASSERT(battfs_fsck(disk));
+	ckptCheckFiles(disk, 2);
+	memcpy(ref, page_array, sizeof(ref));
+	ASSERT(battfs_umount(disk));
+
+	/* A corrupted checkpoint is discarded too */
+	ckpt_buffer[BATTFS_CKPT_HDR_LEN + 3] ^= 0x5a;
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	ASSERT(!disk->ckpt_valid);
+	ASSERT(memcmp(ref, page_array, sizeof(ref)) == 0);
+	ASSERT(battfs_fsck(disk));
+	ckptCheckFiles(disk, 2);
+	ASSERT(battfs_umount(disk));
+	ASSERT(disk->ckpt_valid);
+
+	/* After changes made without the checkpoint, erasing it forces the scan */
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+	ckptWriteFiles(disk, 3);
+	ASSERT(battfs_umount(disk));
+	ASSERT(!disk->ckpt);
+	memset(ckpt_buffer, 0xff, sizeof(ckpt_buffer));
+
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	kblockram_init(&ckpt, ckpt_buffer, sizeof(ckpt_buffer), PAGE_SIZE, false, false);
+	ASSERT(battfs_mountCheckpoint(disk, &f.b, &ckpt.b, page_array, sizeof(page_array)));
+	ASSERT(!disk->ckpt_valid);
+	ASSERT(battfs_fsck(disk));
+	ckptCheckFiles(disk, 3);
+	ASSERT(battfs_umount(disk));
+
+	TRACEMSG("24: passed\n");
+}
+
+#endif /* CONFIG_BATTFS_CHECKPOINT */
+
+static void appendLarge(BattFsSuper *disk)
+{
+	BattFs fd[3];
+	KBlockPosix f;
+	uint8_t buf[64];
+	kfile_off_t size = 0;
+	clock_t t;
+
+	TRACEMSG("25: append and rewrite throughput on a large file\n");
+
+	FILE *fpt = fopen(test_filename, "w+");
+	for (int i = 0; i < FILE_SIZE; i++)
+		fputc(0xff, fpt);
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+
+	/* The big file is followed by other files */
+	for (inode_t i = 0; i < countof(fd); i++)
+		ASSERT(battfs_fileopen(disk, &fd[i], i, BATTFS_CREATE));
+	ASSERT(kfile_write(&fd[2].fd, "tail", 4) == 4);
+
+	t = clock();
+	/* Leave a couple of free pages for rewriting */
+	while (disk->free_page_start < PAGE_COUNT - 2)
+	{
+		for (unsigned i = 0; i < sizeof(buf); i++)
+			buf[i] = size + i;
+		ASSERT(kfile_write(&fd[1].fd, buf, sizeof(buf)) == sizeof(buf));
+		size += sizeof(buf);
+	}
+	t = clock() - t;
+	kprintf("Appended %ld bytes: %ld bytes/s\n", (long)size,
+		(long)(t ? size * CLOCKS_PER_SEC / t : 0));
+
+	/* Rewrite the beginning of the file, renewing its pages */
+	t = clock();
+	for (int i = 0; i < 1000; i++)
+	{
+		ASSERT(kfile_seek(&fd[1].fd, (i % 8) * DATA_SIZE, KSM_SEEK_SET) == (i % 8) * DATA_SIZE);
+		ASSERT(kfile_read(&fd[1].fd, buf, sizeof(buf)) == sizeof(buf));
+		ASSERT(kfile_seek(&fd[1].fd, (i % 8) * DATA_SIZE, KSM_SEEK_SET) == (i % 8) * DATA_SIZE);
+		ASSERT(kfile_write(&fd[1].fd, buf, sizeof(buf)) == sizeof(buf));
+	}
+	t = clock() - t;
+	kprintf("Rewrote 1000 pages: %ld pages/s\n", (long)(t ? 1000L * CLOCKS_PER_SEC / t : 0));
+
+	for (inode_t i = 0; i < countof(fd); i++)
+		ASSERT(kfile_close(&fd[i].fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+	ASSERT(battfs_fsck(disk));
+
+	ASSERT(battfs_fileopen(disk, &fd[1], 1, 0));
+	ASSERT(fd[1].fd.size == size);
+	for (kfile_off_t pos = 0; pos < size; pos += sizeof(buf))
+	{
+		ASSERT(kfile_read(&fd[1].fd, buf, sizeof(buf)) == sizeof(buf));
+		for (unsigned i = 0; i < sizeof(buf); i++)
+			ASSERT(buf[i] == (uint8_t)(pos + i));
+	}
+	ASSERT(kfile_close(&fd[1].fd) == 0);
+
+	ASSERT(battfs_fileopen(disk, &fd[2], 2, 0));
+	ASSERT(kfile_read(&fd[2].fd, buf, sizeof(buf)) == 4);
+	ASSERT(memcmp(buf, "tail", 4) == 0);
+	ASSERT(kfile_close(&fd[2].fd) == 0);
+	ASSERT(battfs_umount(disk));
+
+	TRACEMSG("25: passed\n");
+}
+
+#define WEAR_PAGES       64
+#define WEAR_COLD_FILES   4
+#define WEAR_COLD_PAGES  10
+#define WEAR_WRITES   20000
+
+static uint8_t wear_disk[(WEAR_PAGES + 1) * PAGE_SIZE];
+static wear_t wear_table[WEAR_PAGES];
+
+/*
+ * Rewrite a small hot file over and over on a disk mostly filled
+ * by cold files, then report the erase count distribution.
+ * \return the difference between the most and the least worn page.
+ */
+static int wearSimulation(BattFsSuper *disk, bool level)
+{
+	KBlockRam ram;
+	BattFs fd;
+	uint8_t buf[DATA_SIZE];
+	unsigned hist[8];
+	long total = 0;
+	int moves = 0;
+	wear_t min = (wear_t)-1, max = 0;
+
+	memset(wear_disk, 0xff, sizeof(wear_disk));
+	memset(wear_table, 0, sizeof(wear_table));
+	kblockram_init(&ram, wear_disk, sizeof(wear_disk), PAGE_SIZE, true, false);
+	ASSERT(battfs_mount(disk, &ram.b, page_array, sizeof(page_array)));
+	battfs_wearInit(disk, wear_table, sizeof(wear_table));
+
+	for (inode_t i = 1; i <= WEAR_COLD_FILES; i++)
+	{
+		ASSERT(battfs_fileopen(disk, &fd, i, BATTFS_CREATE));
+		memset(buf, i, sizeof(buf));
+		for (int j = 0; j < WEAR_COLD_PAGES; j++)
+			ASSERT(kfile_write(&fd.fd, buf, sizeof(buf)) == sizeof(buf));
+		ASSERT(kfile_close(&fd.fd) == 0);
+	}
+
+	ASSERT(battfs_fileopen(disk, &fd, 0, BATTFS_CREATE));
+	for (int i = 0; i < WEAR_WRITES; i++)
+	{
+		memset(buf, i, sizeof(buf));
+		ASSERT(kfile_seek(&fd.fd, 0, KSM_SEEK_SET) == 0);
+		ASSERT(kfile_write(&fd.fd, buf, sizeof(buf)) == sizeof(buf));
+		ASSERT(kfile_flush(&fd.fd) == 0);
+
+		/* Idle time */
+		if (level)
+		{
+			int res = battfs_wearLevel(disk);
+			ASSERT(res != EOF);
+			moves += res;
+		}
+	}
+	ASSERT(kfile_close(&fd.fd) == 0);
+	ASSERT(battfs_fsck(disk));
+
+	for (pgcnt_t page = 0; page < WEAR_PAGES; page++)
+	{
+		min = MIN(min, wear_table[page]);
+		max = MAX(max, wear_table[page]);
+		total += wear_table[page];
+	}
+	memset(hist, 0, sizeof(hist));
+	for (pgcnt_t page = 0; page < WEAR_PAGES; page++)
+		hist[(wear_table[page] - min) * countof(hist) / (max - min + 1)]++;
+
+	kprintf("Wear leveling %s: %d moves, erase count min %d max %d avg %ld\n",
+		level ? "on" : "off", moves, min, max, total / WEAR_PAGES);
+	for (unsigned i = 0; i < countof(hist); i++)
+		kprintf("  %5ld-%5ld: %d pages\n",
+			(long)min + (long)i * (max - min + 1) / countof(hist),
+			(long)min + (long)(i + 1) * (max - min + 1) / countof(hist) - 1, hist[i]);
+
+	/* Write amplification cap */
+	ASSERT((long)moves * 100 <= (total - moves) * CONFIG_BATTFS_WEAR_AMPLIFICATION);
+	ASSERT(battfs_umount(disk));
+
+	/* Data survives the moves */
+	kblockram_init(&ram, wear_disk, sizeof(wear_disk), PAGE_SIZE, true, false);
+	ASSERT(battfs_mount(disk, &ram.b, page_array, sizeof(page_array)));
+	ASSERT(battfs_fsck(disk));
+	for (inode_t i = 0; i <= WEAR_COLD_FILES; i++)
+	{
+		ASSERT(battfs_fileopen(disk, &fd, i, 0));
+		ASSERT(fd.fd.size == (kfile_off_t)(i ? WEAR_COLD_PAGES : 1) * DATA_SIZE);
+		ASSERT(kfile_read(&fd.fd, buf, sizeof(buf)) == sizeof(buf));
+		for (unsigned j = 0; j < sizeof(buf); j++)
+			ASSERT(buf[j] == (uint8_t)(i ? i : WEAR_WRITES - 1));
+		ASSERT(kfile_close(&fd.fd) == 0);
+	}
+	ASSERT(battfs_umount(disk));
+
+	return max - min;
+}
+
+static void wearLeveling(BattFsSuper *disk)
+{
+	TRACEMSG("26: wear leveling simulation\n");
+	ASSERT(wearSimulation(disk, true) < wearSimulation(disk, false) / 4);
+	TRACEMSG("26: passed\n");
+}
+
+#define EXTEND_GAP  (DATA_SIZE * 40 + 10)
+
+static void checkZeros(BattFs *fd, kfile_off_t from, kfile_off_t to)
+{
+	uint8_t buf[32];
+
+	ASSERT(kfile_seek(&fd->fd, from, KSM_SEEK_SET) == from);
+	while (from < to)
+	{
+		size_t len = MIN((kfile_off_t)sizeof(buf), to - from);
+
+		memset(buf, 0xaa, sizeof(buf));
+		ASSERT(kfile_read(&fd->fd, buf, len) == len);
+		for (size_t i = 0; i < len; i++)
+			ASSERT(buf[i] == 0);
+		from += len;
+	}
+}
+
+/*
+ * Extend a file well past EOF on an unbuffered disk, then check
+ * the gap reads as zeros, also after writing in the middle of it.
+ */
+static void extendFile(BattFsSuper *disk, filemode_t mode)
+{
+	KBlockPosix f;
+	BattFs fd;
+	uint8_t buf[4];
+	clock_t t;
+
+	FILE *fpt = fopen(test_filename, "w+");
+	for (int i = 0; i < FILE_SIZE; i++)
+		fputc(0xff, fpt);
+	kblockposix_init(&f, fpt, false, NULL, PAGE_SIZE, PAGE_COUNT);
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+	ASSERT(battfs_fileopen(disk, &fd, 0, BATTFS_CREATE | mode));
+	ASSERT(kfile_write(&fd.fd, "abc", 3) == 3);
+
+	t = clock();
+	ASSERT(kfile_seek(&fd.fd, EXTEND_GAP, KSM_SEEK_SET) == EXTEND_GAP);
+	ASSERT(kfile_write(&fd.fd, "xyz", 3) == 3);
+	t = clock() - t;
+	kprintf("Extend by %d bytes%s: %ld us\n", EXTEND_GAP, (mode & BATTFS_SPARSE) ? " (sparse)" : "",
+		(long)(t * 1000000 / CLOCKS_PER_SEC));
+
+	if (!(mode & BATTFS_SPARSE))
+	{
+		static const uint8_t zero;
+
+		/* Baseline: write the same zeros one byte per call, as the old fill did */
+		t = clock();
+		for (kfile_off_t pos = 3; pos < EXTEND_GAP; pos++)
+			ASSERT(kblock_write(&f.b, fd.start[pos / DATA_SIZE], &zero, pos % DATA_SIZE, 1) == 1);
+		t = clock() - t;
+		kprintf("Extend by %d bytes (byte loop): %ld us\n", EXTEND_GAP,
+			(long)(t * 1000000 / CLOCKS_PER_SEC));
+	}
+
+	ASSERT(fd.fd.size == EXTEND_GAP + 3);
+	checkZeros(&fd, 3, EXTEND_GAP);
+
+	/* Write in the middle of the gap */
+	ASSERT(kfile_seek(&fd.fd, DATA_SIZE * 5 + 7, KSM_SEEK_SET) == DATA_SIZE * 5 + 7);
+	ASSERT(kfile_write(&fd.fd, "hole", 4) == 4);
+	ASSERT(kfile_close(&fd.fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, false, NULL, PAGE_SIZE, PAGE_COUNT);
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_fileopen(disk, &fd, 0, 0));
+	ASSERT(fd.fd.size == EXTEND_GAP + 3);
+	ASSERT(fd.holes == !!(mode & BATTFS_SPARSE));
+
+	ASSERT(kfile_read(&fd.fd, buf, 3) == 3);
+	ASSERT(memcmp(buf, "abc", 3) == 0);
+	checkZeros(&fd, 3, DATA_SIZE * 5 + 7);
+	ASSERT(kfile_read(&fd.fd, buf, 4) == 4);
+	ASSERT(memcmp(buf, "hole", 4) == 0);
+	checkZeros(&fd, DATA_SIZE * 5 + 11, EXTEND_GAP);
+	ASSERT(kfile_read(&fd.fd, buf, 4) == 3);
+	ASSERT(memcmp(buf, "xyz", 3) == 0);
+
+	ASSERT(kfile_close(&fd.fd) == 0);
+	ASSERT(battfs_umount(disk));
+}
+
+static void sparseExtend(BattFsSuper *disk)
+{
+	TRACEMSG("27: extend files past EOF\n");
+	extendFile(disk, 0);
+	extendFile(disk, BATTFS_SPARSE);
+	TRACEMSG("27: passed\n");
+}
+
+#define SCALE_PAGE_SIZE    32
+#define SCALE_DATA_SIZE    (SCALE_PAGE_SIZE - BATTFS_HEADER_LEN)
+#define SCALE_PAGES      4096
+#define SCALE_REWRITES   2000
+#define SCALE_APPENDS     200
+
+static uint8_t scale_disk[(SCALE_PAGES + 1) * SCALE_PAGE_SIZE];
+static pgcnt_t scale_array[SCALE_PAGES];
+
+/*
+ * On a RAM disk of \a pages pages, time the rewrite of a page of
+ * file 0 and the append of pages to it, with file 1 filling
+ * \a tail_pages pages after it.
+ */
+static void scaleRun(BattFsSuper *disk, pgcnt_t pages, pgcnt_t tail_pages)
+{
+	KBlockRam ram;
+	BattFs fd[2];
+	uint8_t buf[SCALE_DATA_SIZE];
+	clock_t t;
+
+	memset(scale_disk, 0xff, sizeof(scale_disk));
+	kblockram_init(&ram, scale_disk, (pages + 1) * SCALE_PAGE_SIZE, SCALE_PAGE_SIZE, true, false);
+	ASSERT(battfs_mount(disk, &ram.b, scale_array, pages * sizeof(pgcnt_t)));
+
+	for (inode_t i = 0; i < countof(fd); i++)
+		ASSERT(battfs_fileopen(disk, &fd[i], i, BATTFS_CREATE));
+	memset(buf, 0x55, sizeof(buf));
+	ASSERT(kfile_write(&fd[0].fd, buf, sizeof(buf)) == sizeof(buf));
+	for (pgcnt_t i = 0; i < tail_pages; i++)
+		ASSERT(kfile_write(&fd[1].fd, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(kfile_flush(&fd[1].fd) == 0);
+
+	/* Every flushed rewrite takes a free page and releases the old one */
+	t = clock();
+	for (int i = 0; i < SCALE_REWRITES; i++)
+	{
+		ASSERT(kfile_seek(&fd[0].fd, 0, KSM_SEEK_SET) == 0);
+		ASSERT(kfile_write(&fd[0].fd, buf, 1) == 1);
+		ASSERT(kfile_flush(&fd[0].fd) == 0);
+	}
+	t = clock() - t;
+	kprintf("%5d free pages: rewrite %ld ns/page\n", disk->dev->blk_cnt - disk->free_page_start,
+		(long)(t * (1000000000 / CLOCKS_PER_SEC) / SCALE_REWRITES));
+
+	/* Every append moves the page array entries of file 1 */
+	ASSERT(kfile_seek(&fd[0].fd, 0, KSM_SEEK_END) == SCALE_DATA_SIZE);
+	t = clock();
+	for (int i = 0; i < SCALE_APPENDS; i++)
+		ASSERT(kfile_write(&fd[0].fd, buf, sizeof(buf)) == sizeof(buf));
+	t = clock() - t;
+	kprintf("%5d pages after: append %ld ns/page\n", tail_pages,
+		(long)(t * (1000000000 / CLOCKS_PER_SEC) / SCALE_APPENDS));
+
+	for (inode_t i = 0; i < countof(fd); i++)
+		ASSERT(kfile_close(&fd[i].fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+}
+
+/*
+ * Taking and releasing a free page costs the same on a small and on a
+ * large disk. Inserting a page in a file still moves the page array
+ * entries of the following files: that cost grows with their size.
+ */
+static void pageCostScaling(BattFsSuper *disk)
+{
+	TRACEMSG("28: page allocation cost on small and large disks\n");
+	scaleRun(disk, SCALE_PAGES / 8, 0);
+	scaleRun(disk, SCALE_PAGES, 0);
+	scaleRun(disk, SCALE_PAGES, SCALE_PAGES * 3 / 4);
+	TRACEMSG("28: passed\n");
+}
 
 int battfs_testRun(void)
 {
@@ -1095,6 +1661,14 @@ int battfs_testRun(void)
 	endOfSpace(&disk);
 	multipleFilesRW(&disk);
 	openAllFiles(&disk);
+#if CONFIG_BATTFS_CHECKPOINT
+	ckptMount(&disk);
+	ckptPowerLoss(&disk);
+#endif
+	appendLarge(&disk);
+	wearLeveling(&disk);
+	sparseExtend(&disk);
+	pageCostScaling(&disk);
 
 	kprintf("All tests passed!\n");
 
@@ -0,0 +1,654 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Log-structured, crash-safe key/value store on a KBlock device.
+ *
+ * Each half of the device starts with a header: magic, generation and
+ * CRC16 of both. The header of a half is valid only while the half is
+ * in use: when both are valid a compaction was in progress, and the
+ * half with the lower generation holds the records not copied yet.
+ *
+ * Records follow the header:
+ * - type (set or remove), key length, value length (2 bytes);
+ * - key and value;
+ * - CRC16 of all the previous bytes, seeded with the half generation:
+ *   stale records left by a previous use of the half do not match.
+ *
+ * All fields are little-endian.
+ */
+
+#include "kvstore.h"
+
+#include "cfg/cfg_kvstore.h"
+
+#define LOG_LEVEL   KVSTORE_LOG_LEVEL
+#define LOG_FORMAT  KVSTORE_LOG_FORMAT
+#include <cfg/log.h>
+#include <cfg/debug.h>
+
+#include <algo/crc.h>
+
+#include <string.h> /* memset, memcmp, strlen */
+
+#define KV_MAGIC      0x3153564BUL /* "KVS1" */
+#define KV_HALF_HDR   10
+#define KV_REC_HDR    4
+#define KV_REC_CRC    2
+#define KV_NO_ADDR    ((kv_addr_t)-1)
+
+#define KV_SET        'S'
+#define KV_REMOVE     'R'
+
+#define REC_SIZE(key_len, val_len)  ((kv_addr_t)KV_REC_HDR + (key_len) + (val_len) + KV_REC_CRC)
+
+static void put16(uint8_t *buf, uint16_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+}
+
+static void put32(uint8_t *buf, uint32_t val)
+{
+	put16(buf, val);
+	put16(buf + 2, val >> 16);
+}
+
+static uint16_t get16(const uint8_t *buf)
+{
+	return buf[1] << 8 | buf[0];
+}
+
+static uint32_t get32(const uint8_t *buf)
+{
+	return (uint32_t)get16(buf + 2) << 16 | get16(buf);
+}
+
+INLINE kv_addr_t halfBase(KvStore *kv, uint8_t half)
+{
+	return half * kv->half_size;
+}
+
+/**
+ * Read \a size bytes at byte address \a addr of the store device.
+ */
+static bool kvRead(KvStore *kv, kv_addr_t addr, void *_buf, size_t size)
+{
+	uint8_t *buf = (uint8_t *)_buf;
+
+	while (size)
+	{
+		size_t offset = addr % kv->dev->blk_size;
+		size_t len = MIN(size, kv->dev->blk_size - offset);
+
+		if (kblock_read(kv->dev, addr / kv->dev->blk_size, buf, offset, len) != len)
+			return false;
+		addr += len;
+		buf += len;
+		size -= len;
+	}
+	return true;
+}
+
+/**
+ * Write \a size bytes at byte address \a addr of the store device.
+ */
+static bool kvWrite(KvStore *kv, kv_addr_t addr, const void *_buf, size_t size)
+{
+	const uint8_t *buf = (const uint8_t *)_buf;
+
+	while (size)
+	{
+		size_t offset = addr % kv->dev->blk_size;
+		size_t len = MIN(size, kv->dev->blk_size - offset);
+
+		if (kblock_write(kv->dev, addr / kv->dev->blk_size, buf, offset, len) != len)
+			return false;
+		addr += len;
+		buf += len;
+		size -= len;
+	}
+	return true;
+}
+
+static uint16_t genCrc(uint32_t gen)
+{
+	uint8_t buf[4];
+
+	put32(buf, gen);
+	return crc16(0, buf, sizeof(buf));
+}
+
+/**
+ * Write the header of \a half, valid with generation \a gen
+ * or invalid if \a gen is 0.
+ */
+static bool writeHalfHdr(KvStore *kv, uint8_t half, uint32_t gen)
+{
+	uint8_t buf[KV_HALF_HDR];
+
+	memset(buf, 0, sizeof(buf));
+	if (gen)
+	{
+		put32(&buf[0], KV_MAGIC);
+		put32(&buf[4], gen);
+		put16(&buf[8], crc16(0, buf, 8));
+	}
+	return kvWrite(kv, halfBase(kv, half), buf, sizeof(buf))
+		&& kblock_flush(kv->dev) == 0;
+}
+
+/**
+ * \return the generation of \a half, 0 if its header is not valid.
+ */
+static uint32_t readHalfHdr(KvStore *kv, uint8_t half)
+{
+	uint8_t buf[KV_HALF_HDR];
+
+	if (!kvRead(kv, halfBase(kv, half), buf, sizeof(buf))
+	 || get32(&buf[0]) != KV_MAGIC
+	 || crc16(0, buf, 8) != get16(&buf[8]))
+		return 0;
+	return get32(&buf[4]);
+}
+
+/**
+ * Read the record at offset \a off of \a half: its header in \a hdr and
+ * its key in \a key.
+ * If \a gen is not 0, the record CRC is checked against it.
+ * \return the record size, 0 if there is no valid record.
+ */
+static kv_addr_t readRecord(KvStore *kv, uint8_t half, uint32_t gen, kv_addr_t off, uint8_t *hdr, char *key)
+{
+	kv_addr_t addr = halfBase(kv, half) + off;
+	kv_addr_t size;
+	uint8_t buf[32];
+	uint16_t crc;
+
+	if (off + REC_SIZE(0, 0) > kv->half_size
+	 || !kvRead(kv, addr, hdr, KV_REC_HDR)
+	 || (hdr[0] != KV_SET && hdr[0] != KV_REMOVE)
+	 || !hdr[1] || hdr[1] > CONFIG_KVSTORE_KEY_LEN)
+		return 0;
+
+	size = REC_SIZE(hdr[1], get16(&hdr[2]));
+	if (off + size > kv->half_size
+	 || !kvRead(kv, addr + KV_REC_HDR, key, hdr[1]))
+		return 0;
+
+	if (gen)
+	{
+		crc = crc16(genCrc(gen), hdr, KV_REC_HDR);
+		crc = crc16(crc, key, hdr[1]);
+		addr += KV_REC_HDR + hdr[1];
+		for (uint16_t len = get16(&hdr[2]); len; )
+		{
+			uint16_t chunk = MIN(len, (uint16_t)sizeof(buf));
+
+			if (!kvRead(kv, addr, buf, chunk))
+				return 0;
+			crc = crc16(crc, buf, chunk);
+			addr += chunk;
+			len -= chunk;
+		}
+		if (!kvRead(kv, addr, buf, KV_REC_CRC) || get16(buf) != crc)
+			return 0;
+	}
+	return size;
+}
+
+/**
+ * Append a record at the head of the active half.
+ * The value is taken from \a val or, if it is NULL, from
+ * device address \a val_addr.
+ */
+static bool appendRecord(KvStore *kv, uint8_t type, const char *key, uint8_t key_len,
+	const void *val, kv_addr_t val_addr, uint16_t val_len)
+{
+	kv_addr_t addr = halfBase(kv, kv->active) + kv->head;
+	uint8_t buf[32];
+	uint16_t crc;
+
+	ASSERT(kv->head + REC_SIZE(key_len, val_len) <= kv->half_size);
+
+	buf[0] = type;
+	buf[1] = key_len;
+	put16(&buf[2], val_len);
+	crc = crc16(genCrc(kv->gen), buf, KV_REC_HDR);
+	crc = crc16(crc, key, key_len);
+	if (!kvWrite(kv, addr, buf, KV_REC_HDR)
+	 || !kvWrite(kv, addr + KV_REC_HDR, key, key_len))
+		return false;
+	addr += KV_REC_HDR + key_len;
+
+	if (val)
+	{
+		crc = crc16(crc, val, val_len);
+		if (!kvWrite(kv, addr, val, val_len))
+			return false;
+		addr += val_len;
+	}
+	else
+	{
+		for (uint16_t len = val_len; len; )
+		{
+			uint16_t chunk = MIN(len, (uint16_t)sizeof(buf));
+
+			if (!kvRead(kv, val_addr, buf, chunk)
+			 || !kvWrite(kv, addr, buf, chunk))
+				return false;
+			crc = crc16(crc, buf, chunk);
+			val_addr += chunk;
+			addr += chunk;
+			len -= chunk;
+		}
+	}
+
+	put16(buf, crc);
+	if (!kvWrite(kv, addr, buf, KV_REC_CRC))
+		return false;
+
+	kv->head += REC_SIZE(key_len, val_len);
+	return true;
+}
+
+static const void *entryKey(const void *data, uint8_t *key_length)
+{
+	const KvEntry *e = (const KvEntry *)data;
+
+	*key_length = e->key_len;
+	return e->key;
+}
+
+static KvEntry *findEntry(KvStore *kv, const char *key, uint8_t key_len)
+{
+	const KvEntry *e = (const KvEntry *)ht_find(&kv->index, key, key_len);
+
+	/* Get a non const pointer without casting constness away */
+	return e ? &kv->entries[e - kv->entries] : NULL;
+}
+
+/**
+ * Rebuild the index of \a kv, dropping removed keys.
+ */
+static void rebuildIndex(KvStore *kv)
+{
+	int cnt = 0;
+
+	ht_init(&kv->index);
+	for (int i = 0; i < kv->entry_cnt; i++)
+	{
+		if (kv->entries[i].addr == KV_NO_ADDR)
+			continue;
+
+		kv->entries[cnt] = kv->entries[i];
+		ht_insert(&kv->index, &kv->entries[cnt++]);
+	}
+	kv->entry_cnt = cnt;
+}
+
+/**
+ * Add \a key to the index of \a kv, as removed.
+ * \return the new index entry, NULL if there is no room for it.
+ */
+static KvEntry *newEntry(KvStore *kv, const char *key, uint8_t key_len)
+{
+	KvEntry *e;
+
+	if (kv->entry_cnt >= CONFIG_KVSTORE_KEYS)
+	{
+		rebuildIndex(kv);
+		if (kv->entry_cnt >= CONFIG_KVSTORE_KEYS)
+		{
+			LOG_ERR("Too many keys\n");
+			return NULL;
+		}
+	}
+
+	e = &kv->entries[kv->entry_cnt++];
+	e->addr = KV_NO_ADDR;
+	e->val_len = 0;
+	e->key_len = key_len;
+	memcpy(e->key, key, key_len);
+	ht_insert(&kv->index, e);
+	return e;
+}
+
+/**
+ * Account the record of \a e, if any, as no more in use.
+ */
+static void dropRecord(KvStore *kv, KvEntry *e)
+{
+	kv_addr_t size;
+
+	if (e->addr == KV_NO_ADDR)
+		return;
+
+	size = REC_SIZE(e->key_len, e->val_len);
+	kv->live -= size;
+	if (kv->compacting && e->addr / kv->half_size != kv->active)
+		kv->pending -= size;
+	e->addr = KV_NO_ADDR;
+}
+
+/**
+ * Load the index from the records of \a half.
+ * \return the end of the records.
+ */
+static kv_addr_t replay(KvStore *kv, uint8_t half, uint32_t gen)
+{
+	kv_addr_t off = KV_HALF_HDR;
+	kv_addr_t size;
+	uint8_t hdr[KV_REC_HDR];
+	char key[CONFIG_KVSTORE_KEY_LEN];
+	KvEntry *e;
+
+	while ((size = readRecord(kv, half, gen, off, hdr, key)))
+	{
+		e = findEntry(kv, key, hdr[1]);
+		if (hdr[0] == KV_SET)
+		{
+			if (!e)
+				e = newEntry(kv, key, hdr[1]);
+			if (e)
+			{
+				e->addr = halfBase(kv, half) + off;
+				e->val_len = get16(&hdr[2]);
+			}
+		}
+		else if (e)
+			e->addr = KV_NO_ADDR;
+
+		off += size;
+	}
+	LOG_INFO("Half %d, gen %ld: %ld bytes of records\n", half, (long)gen, (long)(off - KV_HALF_HDR));
+	return off;
+}
+
+/**
+ * Switch to the other half and start copying records in use there.
+ */
+static bool startCompaction(KvStore *kv)
+{
+	uint8_t half = !kv->active;
+
+	ASSERT(!kv->compacting);
+	LOG_INFO("Compacting to half %d\n", half);
+	if (!writeHalfHdr(kv, half, kv->gen + 1))
+		return false;
+
+	kv->compacting = true;
+	kv->compact_pos = KV_HALF_HDR;
+	kv->compact_end = kv->head;
+	kv->pending = kv->live;
+
+	kv->active = half;
+	kv->gen++;
+	kv->head = KV_HALF_HDR;
+	return true;
+}
+
+/**
+ * Copy the next record of the other half, if still in use.
+ * \return 1 if compaction goes on, 0 if it is over, EOF on errors.
+ */
+static int compactStep(KvStore *kv)
+{
+	uint8_t old = !kv->active;
+	uint8_t hdr[KV_REC_HDR];
+	char key[CONFIG_KVSTORE_KEY_LEN];
+	kv_addr_t size, addr;
+	KvEntry *e;
+
+	if (kv->compact_pos >= kv->compact_end)
+	{
+		/* All records in use have been copied, release the old half */
+		if (!writeHalfHdr(kv, old, 0))
+			return EOF;
+		ASSERT(kv->pending == 0);
+		kv->compacting = false;
+		LOG_INFO("Compaction done, %ld bytes in use\n", (long)kv->live);
+		return 0;
+	}
+
+	size = readRecord(kv, old, 0, kv->compact_pos, hdr, key);
+	if (!size)
+		return EOF;
+
+	addr = halfBase(kv, old) + kv->compact_pos;
+	e = findEntry(kv, key, hdr[1]);
+	if (hdr[0] == KV_SET && e && e->addr == addr)
+	{
+		kv_addr_t new_addr = halfBase(kv, kv->active) + kv->head;
+
+		if (!appendRecord(kv, KV_SET, key, hdr[1], NULL, addr + KV_REC_HDR + hdr[1], e->val_len)
+		 || kblock_flush(kv->dev) != 0)
+			return EOF;
+		e->addr = new_addr;
+		kv->pending -= size;
+	}
+	kv->compact_pos += size;
+	return 1;
+}
+
+/**
+ * Make room for a record of \a size bytes in the active half,
+ * compacting the store if needed.
+ * Room for the records still to be copied is always kept.
+ */
+static int makeRoom(KvStore *kv, kv_addr_t size)
+{
+	if (kv->head + size + kv->pending <= kv->half_size)
+		return 0;
+
+	if (kv->compacting && kvstore_compact(kv, -1) == EOF)
+		return EOF;
+	if (kv->head + size <= kv->half_size)
+		return 0;
+
+	if (KV_HALF_HDR + kv->live + size > kv->half_size)
+	{
+		LOG_ERR("Store full\n");
+		return EOF;
+	}
+	return startCompaction(kv) ? 0 : EOF;
+}
+
+/**
+ * Read the value of \a key in \a val, up to \a size bytes.
+ * \return the value length, EOF if \a key is not set or on errors.
+ */
+int kvstore_get(KvStore *kv, const char *key, void *val, size_t size)
+{
+	size_t key_len = strlen(key);
+	KvEntry *e;
+
+	if (key_len > CONFIG_KVSTORE_KEY_LEN)
+		return EOF;
+
+	e = findEntry(kv, key, key_len);
+	if (!e || e->addr == KV_NO_ADDR)
+		return EOF;
+
+	if (!kvRead(kv, e->addr + KV_REC_HDR + e->key_len, val, MIN(size, (size_t)e->val_len)))
+		return EOF;
+	return e->val_len;
+}
+
+/**
+ * Set \a key to the \a len bytes of \a val.
+ * The record is on the device when the function returns.
+ * \return 0 if ok, EOF on errors or if the store is full.
+ */
+int kvstore_set(KvStore *kv, const char *key, const void *val, size_t len)
+{
+	size_t key_len = strlen(key);
+	kv_addr_t addr;
+	KvEntry *e;
+
+	ASSERT(key_len && key_len <= CONFIG_KVSTORE_KEY_LEN);
+	ASSERT(len <= 0xFFFF);
+
+	if (makeRoom(kv, REC_SIZE(key_len, len)) == EOF)
+		return EOF;
+
+	e = findEntry(kv, key, key_len);
+	if (!e && !(e = newEntry(kv, key, key_len)))
+		return EOF;
+
+	addr = halfBase(kv, kv->active) + kv->head;
+	if (!appendRecord(kv, KV_SET, key, key_len, val, 0, len)
+	 || kblock_flush(kv->dev) != 0)
+		return EOF;
+
+	dropRecord(kv, e);
+	e->addr = addr;
+	e->val_len = len;
+	kv->live += REC_SIZE(key_len, len);
+	return 0;
+}
+
+/**
+ * Remove \a key from the store.
+ * \return 0 if ok, EOF if \a key is not set or on errors.
+ */
+int kvstore_remove(KvStore *kv, const char *key)
+{
+	size_t key_len = strlen(key);
+	KvEntry *e;
+
+	if (key_len > CONFIG_KVSTORE_KEY_LEN)
+		return EOF;
+
+	e = findEntry(kv, key, key_len);
+	if (!e || e->addr == KV_NO_ADDR)
+		return EOF;
+
+	if (makeRoom(kv, REC_SIZE(key_len, 0)) == EOF
+	 || !appendRecord(kv, KV_REMOVE, key, key_len, NULL, 0, 0)
+	 || kblock_flush(kv->dev) != 0)
+		return EOF;
+
+	dropRecord(kv, e);
+	return 0;
+}
+
+/**
+ * Compact the store in background.
+ * Call it in idle time: a new compaction starts when the active half is
+ * filled over CONFIG_KVSTORE_COMPACT_THRESHOLD, then every call copies
+ * up to \a steps records (all of them if \a steps is negative).
+ * \return 1 if compaction is in progress, 0 if not, EOF on errors.
+ */
+int kvstore_compact(KvStore *kv, int steps)
+{
+	int res;
+
+	if (!kv->compacting)
+	{
+		/* Nothing to gain if there are no stale records */
+		if (kv->head <= kv->half_size / 100 * CONFIG_KVSTORE_COMPACT_THRESHOLD
+		 || kv->head - KV_HALF_HDR <= kv->live)
+			return 0;
+		if (!startCompaction(kv))
+			return EOF;
+	}
+
+	while (steps--)
+	{
+		if ((res = compactStep(kv)) != 1)
+			return res;
+	}
+	return 1;
+}
+
+/**
+ * Open the store on device \a dev, formatting it if empty.
+ * \a dev must support partial block writes.
+ * \return 0 if ok, EOF on errors.
+ */
+int kvstore_init(KvStore *kv, KBlock *dev)
+{
+	uint32_t gen[2];
+
+	ASSERT(dev);
+	ASSERT(kblock_partialWrite(dev));
+	ASSERT(dev->blk_cnt >= 2);
+
+	memset(kv, 0, sizeof(*kv));
+	kv->dev = dev;
+	kv->half_size = (kv_addr_t)(dev->blk_cnt / 2) * dev->blk_size;
+
+	kv->index.mem = kv->index_mem;
+	kv->index.max_elts_log2 = UINT32_LOG2(KV_INDEX_SIZE);
+	kv->index.flags.key_internal = false;
+	kv->index.key_data.hook = entryKey;
+	ht_init(&kv->index);
+
+	gen[0] = readHalfHdr(kv, 0);
+	gen[1] = readHalfHdr(kv, 1);
+
+	if (!gen[0] && !gen[1])
+	{
+		LOG_INFO("Formatting\n");
+		kv->gen = 1;
+		kv->head = KV_HALF_HDR;
+		return writeHalfHdr(kv, 0, kv->gen) ? 0 : EOF;
+	}
+
+	if (gen[0] && gen[1])
+	{
+		/* Compaction interrupted: load the older half first */
+		uint8_t old = gen[0] > gen[1];
+
+		kv->compacting = true;
+		kv->compact_pos = KV_HALF_HDR;
+		kv->compact_end = replay(kv, old, gen[old]);
+		kv->active = !old;
+	}
+	else
+		kv->active = gen[1] ? 1 : 0;
+
+	kv->gen = gen[kv->active];
+	kv->head = replay(kv, kv->active, kv->gen);
+
+	for (int i = 0; i < kv->entry_cnt; i++)
+	{
+		KvEntry *e = &kv->entries[i];
+
+		if (e->addr == KV_NO_ADDR)
+			continue;
+		kv->live += REC_SIZE(e->key_len, e->val_len);
+		if (e->addr / kv->half_size != kv->active)
+			kv->pending += REC_SIZE(e->key_len, e->val_len);
+	}
+	return 0;
+}
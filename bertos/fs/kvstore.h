@@ -0,0 +1,129 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Log-structured, crash-safe key/value store on a KBlock device.
+ *
+ * The device is split in two halves. Records are only appended to the
+ * active half: setting a key writes a new record, removing it writes a
+ * tombstone. Every record is protected by a CRC, so a record torn by a
+ * power loss is simply dropped at the next mount, together with all
+ * the following ones.
+ *
+ * The location of the last record of every key is kept in RAM, in a
+ * hash table: lookups do not scan the log.
+ *
+ * When the active half fills up, compaction switches to the other half
+ * and copies the records still in use there, one at a time: call
+ * kvstore_compact() in idle time to do it in background. Records not
+ * copied yet are still found in the old half, so a power loss during
+ * compaction loses nothing.
+ *
+ * Example:
+ * \code
+ * KvStore kv;
+ * uint16_t baud;
+ *
+ * // ...init the KBlock device dev
+ * kvstore_init(&kv, dev);
+ * if (kvstore_get(&kv, "baud", &baud, sizeof(baud)) != sizeof(baud))
+ * {
+ *     baud = 9600;
+ *     kvstore_set(&kv, "baud", &baud, sizeof(baud));
+ * }
+ * \endcode
+ *
+ * $WIZ$ module_name = "kvstore"
+ * $WIZ$ module_depends = "kblock", "hashtable", "crc16"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_kvstore.h"
+ */
+
+#ifndef FS_KVSTORE_H
+#define FS_KVSTORE_H
+
+#include "cfg/cfg_kvstore.h"
+
+#include <cfg/compiler.h>
+#include <cfg/macros.h>
+
+#include <io/kblock.h>
+#include <struct/hashtable.h>
+
+typedef uint32_t kv_addr_t; ///< Type for byte addresses in the store.
+
+/*
+ * Index of a key, private.
+ */
+typedef struct KvEntry
+{
+	kv_addr_t addr;     ///< Address of the last record of the key, KV_NO_ADDR if removed.
+	uint16_t val_len;   ///< Value length.
+	uint8_t key_len;    ///< Key length.
+	char key[CONFIG_KVSTORE_KEY_LEN];
+} KvEntry;
+
+/// Number of hash table slots, at least one more than the keys.
+#define KV_INDEX_SIZE (1 << (UINT32_LOG2(CONFIG_KVSTORE_KEYS) + 1))
+
+/**
+ * Key/value store context.
+ */
+typedef struct KvStore
+{
+	KBlock *dev;            ///< Block device holding the log.
+	kv_addr_t half_size;    ///< Size of a device half, in bytes.
+	uint32_t gen;           ///< Generation of the active half.
+	uint8_t active;         ///< Half where records are appended.
+	kv_addr_t head;         ///< Append position in the active half.
+	kv_addr_t live;         ///< Bytes of records in use.
+
+	bool compacting;        ///< True if the other half still holds records in use.
+	kv_addr_t compact_pos;  ///< Next record to copy from the other half.
+	kv_addr_t compact_end;  ///< End of the records in the other half.
+	kv_addr_t pending;      ///< Bytes of records in use still in the other half.
+
+	struct HashTable index;
+	const void *index_mem[KV_INDEX_SIZE];
+	KvEntry entries[CONFIG_KVSTORE_KEYS];
+	int entry_cnt;
+} KvStore;
+
+int kvstore_init(KvStore *kv, KBlock *dev);
+int kvstore_get(KvStore *kv, const char *key, void *val, size_t size);
+int kvstore_set(KvStore *kv, const char *key, const void *val, size_t len);
+int kvstore_remove(KvStore *kv, const char *key);
+int kvstore_compact(KvStore *kv, int steps);
+
+int kvstore_testSetup(void);
+int kvstore_testRun(void);
+int kvstore_testTearDown(void);
+
+#endif /* FS_KVSTORE_H */
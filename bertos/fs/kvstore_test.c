@@ -0,0 +1,299 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Key/value store test.
+ *
+ * After the basic operations, random sets, removes, compaction steps
+ * and remounts are checked against a reference copy kept in RAM. Power
+ * losses are simulated by a device that stops writing after a random
+ * number of bytes: after the remount, the interrupted operation must
+ * be either fully done or not done at all.
+ *
+ * $test$: cp bertos/cfg/cfg_kvstore.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KVSTORE_KEYS" >> $cfgdir/cfg_kvstore.h
+ * $test$: echo "#define CONFIG_KVSTORE_KEYS 8" >> $cfgdir/cfg_kvstore.h
+ */
+
+#include "kvstore.h"
+
+#include <io/kblock_ram.h>
+#include <io/kblock_posix.h>
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLK_SIZE  64
+#define BLK_CNT   16
+#define VAL_MAX   24
+#define KEYS      CONFIG_KVSTORE_KEYS
+#define LOOPS     20000
+#define FILE_NAME "kvstore_disk.bin"
+
+static uint8_t disk[BLK_SIZE * (BLK_CNT + 1)];
+static KBlockRam ram;
+static KvStore kv;
+
+/* Reference copy of the store, EOF length for keys not set */
+static uint8_t ref_val[KEYS][VAL_MAX];
+static int ref_len[KEYS];
+
+/* Power loss simulation: writes stop after crash_budget bytes */
+static KBlockVTable crash_vt;
+static kblock_write_direct_t ram_write;
+static long crash_budget;
+
+static size_t crashWrite(struct KBlock *b, block_idx_t index, const void *buf, size_t offset, size_t size)
+{
+	if (crash_budget >= 0)
+	{
+		size = MIN(size, (size_t)crash_budget);
+		crash_budget -= size;
+	}
+	return ram_write(b, index, buf, offset, size);
+}
+
+static const char *keyName(int i)
+{
+	static char name[CONFIG_KVSTORE_KEY_LEN + 1];
+
+	sprintf(name, "key%d", i);
+	return name;
+}
+
+/* Mount the store again, as after a reset */
+static void remount(bool buffered)
+{
+	kblockram_init(&ram, disk, sizeof(disk), BLK_SIZE, buffered, false);
+	ASSERT(kvstore_init(&kv, &ram.b) == 0);
+}
+
+static void format(bool buffered)
+{
+	memset(disk, 0xFF, sizeof(disk));
+	for (int i = 0; i < KEYS; i++)
+		ref_len[i] = EOF;
+	remount(buffered);
+}
+
+static bool checkKey(int i)
+{
+	uint8_t val[VAL_MAX];
+	int len = kvstore_get(&kv, keyName(i), val, sizeof(val));
+
+	return len == ref_len[i]
+		&& (len == EOF || memcmp(val, ref_val[i], len) == 0);
+}
+
+static void checkAll(void)
+{
+	for (int i = 0; i < KEYS; i++)
+		ASSERT(checkKey(i));
+}
+
+static void basic(bool buffered)
+{
+	uint16_t baud = 0;
+	char name[4];
+
+	kprintf("Basic operations, %s device\n", buffered ? "buffered" : "unbuffered");
+	format(buffered);
+
+	ASSERT(kvstore_get(&kv, "baud", &baud, sizeof(baud)) == EOF);
+	baud = 9600;
+	ASSERT(kvstore_set(&kv, "baud", &baud, sizeof(baud)) == 0);
+	baud = 0;
+	ASSERT(kvstore_get(&kv, "baud", &baud, sizeof(baud)) == sizeof(baud));
+	ASSERT(baud == 9600);
+
+	/* Values are truncated to the buffer, the full length is returned */
+	ASSERT(kvstore_set(&kv, "name", "BeRTOS", 6) == 0);
+	ASSERT(kvstore_get(&kv, "name", name, sizeof(name)) == 6);
+	ASSERT(memcmp(name, "BeRT", 4) == 0);
+
+	/* Empty values are not removed keys */
+	ASSERT(kvstore_set(&kv, "empty", NULL, 0) == 0);
+	ASSERT(kvstore_get(&kv, "empty", NULL, 0) == 0);
+
+	baud = 115;
+	ASSERT(kvstore_set(&kv, "baud", &baud, sizeof(baud)) == 0);
+	ASSERT(kvstore_remove(&kv, "name") == 0);
+	ASSERT(kvstore_remove(&kv, "name") == EOF);
+
+	remount(buffered);
+	baud = 0;
+	ASSERT(kvstore_get(&kv, "baud", &baud, sizeof(baud)) == sizeof(baud));
+	ASSERT(baud == 115);
+	ASSERT(kvstore_get(&kv, "name", name, sizeof(name)) == EOF);
+	ASSERT(kvstore_get(&kv, "empty", NULL, 0) == 0);
+}
+
+/* Fill a file, then check it from a new store with an unbuffered device */
+static void posixFile(void)
+{
+	static uint8_t blk_buf[BLK_SIZE];
+	KBlockPosix f;
+	FILE *fp;
+
+	kputs("Store in a file\n");
+	fp = fopen(FILE_NAME, "w+b");
+	ASSERT(fp);
+	memset(disk, 0xFF, sizeof(disk));
+	fwrite(disk, BLK_SIZE, BLK_CNT, fp);
+
+	kblockposix_init(&f, fp, false, blk_buf, BLK_SIZE, BLK_CNT);
+	ASSERT(kvstore_init(&kv, &f.b) == 0);
+	for (int i = 0; i < KEYS; i++)
+		ref_len[i] = EOF;
+	for (int n = 0; n < 500; n++)
+	{
+		int key = rand() % KEYS;
+		int len = rand() % (VAL_MAX + 1);
+
+		for (int i = 0; i < len; i++)
+			ref_val[key][i] = rand();
+		ASSERT(kvstore_set(&kv, keyName(key), ref_val[key], len) == 0);
+		ref_len[key] = len;
+		if (n % 50 == 0)
+			ASSERT(kvstore_compact(&kv, 2) != EOF);
+	}
+	ASSERT(kblock_close(&f.b) == 0);
+
+	fp = fopen(FILE_NAME, "r+b");
+	ASSERT(fp);
+	kblockposix_init(&f, fp, false, NULL, BLK_SIZE, BLK_CNT);
+	ASSERT(kvstore_init(&kv, &f.b) == 0);
+	checkAll();
+	ASSERT(kvstore_compact(&kv, -1) != EOF);
+	checkAll();
+	ASSERT(kblock_close(&f.b) == 0);
+}
+
+static void randomOps(void)
+{
+	uint8_t old_val[VAL_MAX];
+	uint8_t new_val[VAL_MAX];
+	int crashes = 0, torn = 0;
+	uint32_t first_gen;
+
+	kputs("Random operations with power losses\n");
+	format(false);
+	first_gen = kv.gen;
+
+	for (int n = 0; n < LOOPS; n++)
+	{
+		int op = rand() % 8;
+		int key = rand() % KEYS;
+		int old_len = ref_len[key];
+		int new_len = old_len;
+		bool crash = rand() % 4 == 0;
+		int res;
+
+		memcpy(old_val, ref_val[key], sizeof(old_val));
+		if (crash)
+		{
+			crash_vt = *ram.b.priv.vt;
+			ram_write = crash_vt.writeDirect;
+			crash_vt.writeDirect = crashWrite;
+			ram.b.priv.vt = &crash_vt;
+			crash_budget = rand() % 64;
+			crashes++;
+		}
+
+		if (op < 5)
+		{
+			new_len = rand() % (VAL_MAX + 1);
+			for (int i = 0; i < new_len; i++)
+				new_val[i] = rand();
+			res = kvstore_set(&kv, keyName(key), new_val, new_len);
+		}
+		else if (op < 6)
+		{
+			new_len = EOF;
+			res = kvstore_remove(&kv, keyName(key));
+			if (old_len == EOF)
+				ASSERT(res == EOF);
+		}
+		else
+			res = kvstore_compact(&kv, rand() % 4);
+
+		if (!crash && op < 5)
+			ASSERT(res == 0);
+
+		if (crash || op == 7)
+			remount(false);
+
+		/* After a power loss, the operation is either done or not */
+		if (op < 6)
+		{
+			memcpy(ref_val[key], new_val, sizeof(new_val));
+			ref_len[key] = new_len;
+			if (!checkKey(key))
+			{
+				ASSERT(crash);
+				memcpy(ref_val[key], old_val, sizeof(old_val));
+				ref_len[key] = old_len;
+				torn++;
+			}
+		}
+		checkAll();
+	}
+
+	kprintf("%d power losses, %d operations lost, %ld compactions\n",
+		crashes, torn, (long)(kv.gen - first_gen));
+	ASSERT(kv.gen - first_gen > 10);
+}
+
+int kvstore_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int kvstore_testRun(void)
+{
+	basic(false);
+	basic(true);
+	posixFile();
+	randomOps();
+	kputs("Key/value store test OK\n");
+	return 0;
+}
+
+int kvstore_testTearDown(void)
+{
+	return remove(FILE_NAME);
+}
+
+TEST_MAIN(kvstore);
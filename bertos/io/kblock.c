@@ -114,14 +114,12 @@ size_t kblock_read(struct KBlock *b, block_idx_t idx, void *buf, size_t offset,
 }
 
 
-int kblock_flush(struct KBlock *b)
+/*
+ * Write back the cached block, if dirty.
+ */
+static int kblock_flushBuf(struct KBlock *b)
 {
-	ASSERT(b);
-
-	if (!kblock_buffered(b))
-		return 0;
-
-	if (kblock_cacheDirty(b))
+	if (kblock_buffered(b) && kblock_cacheDirty(b))
 	{
 		LOG_INFO("flushing block %ld\n", b->priv.curr_blk);
 		if (kblock_store(b, b->priv.curr_blk) == 0)
@@ -132,6 +130,18 @@ int kblock_flush(struct KBlock *b)
 	return 0;
 }
 
+int kblock_flush(struct KBlock *b)
+{
+	ASSERT(b);
+
+	if (kblock_flushBuf(b) != 0)
+		return EOF;
+
+	if (b->priv.vt->flush)
+		return b->priv.vt->flush(b);
+	return 0;
+}
+
 
 static bool kblock_loadPage(struct KBlock *b, block_idx_t idx)
 {
@@ -140,7 +150,7 @@ static bool kblock_loadPage(struct KBlock *b, block_idx_t idx)
 	if (idx != b->priv.curr_blk)
 	{
 		LOG_INFO("loading block %ld\n", idx);
-		if (kblock_flush(b) != 0 || kblock_load(b, idx) != 0)
+		if (kblock_flushBuf(b) != 0 || kblock_load(b, idx) != 0)
 				return false;
 
 		b->priv.curr_blk = idx;
@@ -193,6 +203,58 @@ size_t kblock_write(struct KBlock *b, block_idx_t idx, const void *buf, size_t o
 	}
 }
 
+/*
+ * True if the block cached by \a b is among the \a count blocks
+ * starting from \a idx: transfers of that range must go through
+ * the cache.
+ */
+INLINE bool kblock_cacheInRange(struct KBlock *b, block_idx_t idx, block_idx_t count)
+{
+	return kblock_buffered(b) && b->priv.curr_blk >= idx && b->priv.curr_blk - idx < count;
+}
+
+block_idx_t kblock_readBlocks(struct KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	block_idx_t i;
+
+	ASSERT(b);
+	ASSERT(buf);
+	ASSERT(idx + count <= b->blk_cnt);
+
+	LOG_INFO("blk_idx %ld, count %ld\n", idx, count);
+
+	if (b->priv.vt->readBlocks && !kblock_cacheInRange(b, idx, count))
+		return b->priv.vt->readBlocks(b, b->priv.blk_start + idx, buf, count);
+
+	for (i = 0; i < count; i++)
+	{
+		if (kblock_read(b, idx + i, (uint8_t *)buf + i * b->blk_size, 0, b->blk_size) != b->blk_size)
+			break;
+	}
+	return i;
+}
+
+block_idx_t kblock_writeBlocks(struct KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	block_idx_t i;
+
+	ASSERT(b);
+	ASSERT(buf);
+	ASSERT(idx + count <= b->blk_cnt);
+
+	LOG_INFO("blk_idx %ld, count %ld\n", idx, count);
+
+	if (b->priv.vt->writeBlocks && !kblock_cacheInRange(b, idx, count))
+		return b->priv.vt->writeBlocks(b, b->priv.blk_start + idx, buf, count);
+
+	for (i = 0; i < count; i++)
+	{
+		if (kblock_write(b, idx + i, (const uint8_t *)buf + i * b->blk_size, 0, b->blk_size) != b->blk_size)
+			break;
+	}
+	return i;
+}
+
 int kblock_copy(struct KBlock *b, block_idx_t src, block_idx_t dest)
 {
 	ASSERT(b);
@@ -101,6 +101,8 @@ struct KBlock;
  */
 typedef size_t (* kblock_read_direct_t)  (struct KBlock *b, block_idx_t index, void *buf, size_t offset, size_t size);
 typedef size_t (* kblock_write_direct_t) (struct KBlock *b, block_idx_t index, const void *buf, size_t offset, size_t size);
+typedef block_idx_t (* kblock_read_blocks_t)  (struct KBlock *b, block_idx_t index, void *buf, block_idx_t count);
+typedef block_idx_t (* kblock_write_blocks_t) (struct KBlock *b, block_idx_t index, const void *buf, block_idx_t count);
 
 typedef size_t (* kblock_read_t)        (struct KBlock *b, void *buf, size_t offset, size_t size);
 typedef size_t (* kblock_write_t)       (struct KBlock *b, const void *buf, size_t offset, size_t size);
@@ -110,6 +112,7 @@ typedef int    (* kblock_store_t)       (struct KBlock *b, block_idx_t index);
 typedef int    (* kblock_error_t)       (struct KBlock *b);
 typedef void   (* kblock_clearerr_t)    (struct KBlock *b);
 typedef int    (* kblock_close_t)       (struct KBlock *b);
+typedef int    (* kblock_flush_t)       (struct KBlock *b);
 /* \} */
 
 /*
@@ -119,6 +122,8 @@ typedef struct KBlockVTable
 {
 	kblock_read_direct_t readDirect;
 	kblock_write_direct_t writeDirect;
+	kblock_read_blocks_t  readBlocks;  // Optional, \sa kblock_readBlocks()
+	kblock_write_blocks_t writeBlocks; // Optional, \sa kblock_writeBlocks()
 
 	kblock_read_t  readBuf;
 	kblock_write_t writeBuf;
@@ -129,6 +134,7 @@ typedef struct KBlockVTable
 	kblock_clearerr_t clearerr; // \sa kblock_clearerr()
 
 	kblock_close_t  close; // \sa kblock_close()
+	kblock_flush_t  flush; // Optional, flush the device own caches. \sa kblock_flush()
 } KBlockVTable;
 
 
@@ -247,6 +253,8 @@ INLINE void kblock_clearerr(struct KBlock *b)
  *
  * This function will write any pending modifications to the device.
  * If the device does not have a cache, this function will do nothing.
+ * Devices with caches of their own (like \ref kblock_cache) write them
+ * back too.
  *
  * \return 0 if all is OK, EOF on errors.
  * \sa kblock_read(), kblock_write(), kblock_buffered().
@@ -372,6 +380,41 @@ size_t kblock_read(struct KBlock *b, block_idx_t idx, void *buf, size_t offset,
  */
 size_t kblock_write(struct KBlock *b, block_idx_t idx, const void *buf, size_t offset, size_t size);
 
+/**
+ * Read \a count contiguous whole blocks, starting from block \a idx.
+ *
+ * Devices able to transfer many blocks at once (like SD cards with
+ * their multiple block commands) do it in a single operation, the
+ * others are read one block at a time.
+ *
+ * \param b KBlock device.
+ * \param idx the first block to read.
+ * \param buf a buffer of \a count * b->blk_size bytes for the data.
+ * \param count the number of blocks to read.
+ *
+ * \return the number of blocks read.
+ *
+ * \sa kblock_writeBlocks().
+ */
+block_idx_t kblock_readBlocks(struct KBlock *b, block_idx_t idx, void *buf, block_idx_t count);
+
+/**
+ * Write \a count contiguous whole blocks, starting from block \a idx.
+ *
+ * Like kblock_readBlocks(), the blocks are written in a single operation
+ * when the device supports it.
+ *
+ * \param b KBlock device.
+ * \param idx the first block to write.
+ * \param buf a pointer to \a count * b->blk_size bytes of data.
+ * \param count the number of blocks to write.
+ *
+ * \return the number of blocks written.
+ *
+ * \sa kblock_readBlocks(), kblock_write().
+ */
+block_idx_t kblock_writeBlocks(struct KBlock *b, block_idx_t idx, const void *buf, block_idx_t count);
+
 /**
  * Copy one block to another.
  *
@@ -0,0 +1,212 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief KBlock multi-block write-back cache.
+ *
+ * The cache exports an unbuffered KBlock with partial write support
+ * and talks to the cached device with whole block reads and writes
+ * only, so any device can be cached.
+ * Block lookup and LRU search are linear, the cache is meant to hold
+ * a handful of blocks.
+ *
+ * $WIZ$ module_depends = "kblock"
+ */
+
+#include "kblock_cache.h"
+#include <string.h> /* memset, memcpy */
+
+#define KBC_VALID  BV(0) ///< Entry holds a block.
+#define KBC_DIRTY  BV(1) ///< Entry modified, not yet written back.
+
+
+INLINE uint8_t *kblockcache_buf(KBlockCache *c, size_t i)
+{
+	return c->blocks + i * c->fd.blk_size;
+}
+
+static int kblockcache_writeBack(KBlockCache *c, size_t i)
+{
+	KBlockCacheEntry *e = &c->entries[i];
+
+	if (e->flags & KBC_DIRTY)
+	{
+		if (kblock_write(c->dev, e->idx, kblockcache_buf(c, i), 0, c->fd.blk_size) != c->fd.blk_size)
+			return EOF;
+		e->flags &= ~KBC_DIRTY;
+		c->writebacks++;
+	}
+	return 0;
+}
+
+/*
+ * Return the entry caching block \a idx, taking it from the device on
+ * a miss in place of the least recently used one. If \a load is false
+ * the caller is going to overwrite the whole block, so it is not read.
+ *
+ * \return the entry index, -1 on errors.
+ */
+static int kblockcache_get(KBlockCache *c, block_idx_t idx, bool load)
+{
+	KBlockCacheEntry *e;
+	size_t i, lru = 0;
+
+	c->clock++;
+	for (i = 0; i < c->count; i++)
+	{
+		e = &c->entries[i];
+		if ((e->flags & KBC_VALID) && e->idx == idx)
+		{
+			e->last_use = c->clock;
+			c->hits++;
+			return i;
+		}
+		/* Free entries have last_use 0, they go first */
+		if (e->last_use < c->entries[lru].last_use)
+			lru = i;
+	}
+
+	c->misses++;
+	e = &c->entries[lru];
+	if (kblockcache_writeBack(c, lru) != 0)
+		return -1;
+
+	e->flags = 0;
+	e->last_use = 0;
+	if (load && kblock_read(c->dev, idx, kblockcache_buf(c, lru), 0, c->fd.blk_size) != c->fd.blk_size)
+		return -1;
+
+	e->idx = idx;
+	e->flags = KBC_VALID;
+	e->last_use = c->clock;
+	return lru;
+}
+
+static size_t kblockcache_readDirect(struct KBlock *b, block_idx_t idx, void *buf, size_t offset, size_t size)
+{
+	KBlockCache *c = KBLOCKCACHE_CAST(b);
+	int i = kblockcache_get(c, idx, true);
+
+	if (i < 0)
+		return 0;
+
+	memcpy(buf, kblockcache_buf(c, i) + offset, size);
+	return size;
+}
+
+static size_t kblockcache_writeDirect(struct KBlock *b, block_idx_t idx, const void *buf, size_t offset, size_t size)
+{
+	KBlockCache *c = KBLOCKCACHE_CAST(b);
+	int i = kblockcache_get(c, idx, offset != 0 || size != b->blk_size);
+
+	if (i < 0)
+		return 0;
+
+	memcpy(kblockcache_buf(c, i) + offset, buf, size);
+	c->entries[i].flags |= KBC_DIRTY;
+	return size;
+}
+
+static int kblockcache_flush(struct KBlock *b)
+{
+	KBlockCache *c = KBLOCKCACHE_CAST(b);
+	int res = 0;
+	size_t i;
+
+	for (i = 0; i < c->count; i++)
+		res |= kblockcache_writeBack(c, i);
+
+	return res | kblock_flush(c->dev);
+}
+
+static int kblockcache_error(struct KBlock *b)
+{
+	return kblock_error(KBLOCKCACHE_CAST(b)->dev);
+}
+
+static void kblockcache_clearerr(struct KBlock *b)
+{
+	kblock_clearerr(KBLOCKCACHE_CAST(b)->dev);
+}
+
+static int kblockcache_close(struct KBlock *b)
+{
+	return kblock_close(KBLOCKCACHE_CAST(b)->dev);
+}
+
+
+static const KBlockVTable kblockcache_vt =
+{
+	.readDirect = kblockcache_readDirect,
+	.writeDirect = kblockcache_writeDirect,
+
+	.error = kblockcache_error,
+	.clearerr = kblockcache_clearerr,
+	.close = kblockcache_close,
+	.flush = kblockcache_flush,
+};
+
+
+/**
+ * Initialize a cache on top of a KBlock device.
+ *
+ * \param c           kblock cache device
+ * \param dev         kblock descriptor of the cached device
+ * \param arena       memory for the cached blocks, aligned for a block_idx_t
+ * \param arena_size  size of \a arena in bytes; the number of cached blocks
+ *                    is given by KBLOCKCACHE_ARENA_SIZE()
+ *
+ * \note Do not access \a dev directly while the cache is in use.
+ */
+void kblockcache_init(KBlockCache *c, KBlock *dev, void *arena, size_t arena_size)
+{
+	ASSERT(dev);
+	ASSERT(arena);
+	ASSERT((uintptr_t)arena % sizeof(block_idx_t) == 0);
+
+	memset(c, 0, sizeof(KBlockCache));
+
+	DB(c->fd.priv.type = KBT_KBLOCKCACHE);
+
+	c->fd.blk_size = dev->blk_size;
+	c->fd.blk_cnt = dev->blk_cnt;
+
+	c->fd.priv.flags |= KB_PARTIAL_WRITE;
+	c->fd.priv.vt = &kblockcache_vt;
+
+	c->dev = dev;
+	c->count = arena_size / (dev->blk_size + sizeof(KBlockCacheEntry));
+	ASSERT(c->count);
+
+	c->entries = (KBlockCacheEntry *)arena;
+	c->blocks = (uint8_t *)arena + c->count * sizeof(KBlockCacheEntry);
+	memset(c->entries, 0, c->count * sizeof(KBlockCacheEntry));
+}
@@ -0,0 +1,108 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief KBlock multi-block write-back cache.
+ *
+ * This module stacks on top of another KBlock device and keeps the
+ * most recently used blocks in RAM, in an arena supplied by the caller.
+ * Unlike the single block buffer of buffered KBlocks, alternating
+ * accesses to a few blocks (like a filesystem does with its allocation
+ * table, directories and data) are served from memory.
+ *
+ * Modified blocks are written back to the device when they are evicted
+ * or when kblock_flush() is called on the cache. The least recently used
+ * block is replaced.
+ *
+ * Example:
+ * \code
+ * static uint8_t arena[KBLOCKCACHE_ARENA_SIZE(512, 8)];
+ * KBlockCache cache;
+ *
+ * // ...init the KBlock device dev, with 512 bytes blocks
+ * kblockcache_init(&cache, dev, arena, sizeof(arena));
+ * kblock_read(&cache.fd, 0, buf, 0, 512);
+ * \endcode
+ *
+ * $WIZ$ module_name = "kblock_cache"
+ * $WIZ$ module_depends = "kblock"
+ */
+
+#ifndef IO_KBLOCK_CACHE_H
+#define IO_KBLOCK_CACHE_H
+
+#include "kblock.h"
+
+
+/*
+ * A cached block, private.
+ */
+typedef struct KBlockCacheEntry
+{
+	block_idx_t idx;
+	uint32_t last_use;
+	uint8_t flags;
+} KBlockCacheEntry;
+
+typedef struct KBlockCache
+{
+	KBlock  fd;
+	KBlock *dev;
+
+	KBlockCacheEntry *entries;
+	uint8_t *blocks;
+	size_t count;
+	uint32_t clock;
+
+	/* Statistics, can be reset by the user */
+	uint32_t hits;       ///< Accesses served from the cache.
+	uint32_t misses;     ///< Accesses that took a block from the device.
+	uint32_t writebacks; ///< Dirty blocks written back to the device.
+} KBlockCache;
+
+#define KBT_KBLOCKCACHE MAKE_ID('K', 'B', 'C', 'H')
+
+/**
+ * Size of the arena needed to cache \a blocks blocks of \a blk_size bytes.
+ */
+#define KBLOCKCACHE_ARENA_SIZE(blk_size, blocks) \
+	((blocks) * ((blk_size) + sizeof(KBlockCacheEntry)))
+
+
+INLINE KBlockCache *KBLOCKCACHE_CAST(KBlock *b)
+{
+	ASSERT(b->priv.type == KBT_KBLOCKCACHE);
+	return (KBlockCache *)b;
+}
+
+void kblockcache_init(KBlockCache *c, KBlock *dev, void *arena, size_t arena_size);
+
+#endif /* IO_KBLOCK_CACHE_H */
@@ -0,0 +1,197 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief KBlock cache test.
+ *
+ * Checks write-back and data coherency on a RAM device, then runs a
+ * filesystem-like access pattern (allocation table, directory and data
+ * blocks) on a POSIX file and prints the cache hit ratio.
+ */
+
+#include "kblock_cache.h"
+#include "kblock_ram.h"
+#include "kblock_posix.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <string.h>
+#include <stdio.h>
+
+/* avoid compiler warnings... */
+int kblockcache_testSetup(void);
+int kblockcache_testRun(void);
+int kblockcache_testTearDown(void);
+
+#define BLK_SIZE      64
+#define BLK_CNT       16
+#define CACHE_BLOCKS   4
+
+static uint8_t disk[BLK_SIZE * BLK_CNT];
+static uint32_t arena[KBLOCKCACHE_ARENA_SIZE(BLK_SIZE, CACHE_BLOCKS) / sizeof(uint32_t)];
+static uint8_t blk[BLK_SIZE];
+
+static KBlockRam ram;
+static KBlockCache cache;
+
+static void fill(uint8_t *buf, block_idx_t idx)
+{
+	for (int i = 0; i < BLK_SIZE; i++)
+		buf[i] = idx * BLK_SIZE + i;
+}
+
+static int kblockcache_ramTest(void)
+{
+	uint8_t expected[BLK_SIZE];
+	block_idx_t idx;
+
+	kputs("RAM device test\n");
+	memset(disk, 0, sizeof(disk));
+	kblockram_init(&ram, disk, sizeof(disk), BLK_SIZE, false, false);
+	kblockcache_init(&cache, &ram.b, arena, sizeof(arena));
+	ASSERT(cache.count == CACHE_BLOCKS);
+
+	/* Whole block writes do not read the device */
+	for (idx = 0; idx < BLK_CNT; idx++)
+	{
+		fill(blk, idx);
+		ASSERT(kblock_write(&cache.fd, idx, blk, 0, BLK_SIZE) == BLK_SIZE);
+	}
+	ASSERT(cache.writebacks == BLK_CNT - CACHE_BLOCKS);
+	ASSERT(kblock_flush(&cache.fd) == 0);
+	ASSERT(cache.writebacks == BLK_CNT);
+	for (idx = 0; idx < BLK_CNT; idx++)
+	{
+		fill(expected, idx);
+		ASSERT(memcmp(disk + idx * BLK_SIZE, expected, BLK_SIZE) == 0);
+	}
+
+	/* Partial writes stay in the cache until flushed */
+	memset(blk, 0xaa, 8);
+	ASSERT(kblock_write(&cache.fd, 5, blk, 10, 8) == 8);
+	ASSERT(kblock_read(&cache.fd, 5, expected, 0, BLK_SIZE) == BLK_SIZE);
+	ASSERT(memcmp(expected + 10, blk, 8) == 0);
+	ASSERT(disk[5 * BLK_SIZE + 10] != 0xaa);
+	ASSERT(kblock_flush(&cache.fd) == 0);
+	ASSERT(memcmp(disk + 5 * BLK_SIZE, expected, BLK_SIZE) == 0);
+
+	/* Blocks used over and over stay in the cache */
+	cache.hits = cache.misses = 0;
+	for (int i = 0; i < 100; i++)
+	{
+		ASSERT(kblock_read(&cache.fd, i % 3, blk, 0, BLK_SIZE) == BLK_SIZE);
+		fill(expected, i % 3);
+		ASSERT(memcmp(blk, expected, BLK_SIZE) == 0);
+	}
+	kprintf("hits %ld, misses %ld\n", (long)cache.hits, (long)cache.misses);
+	ASSERT(cache.misses <= 3);
+
+	/* Copy goes through the cache */
+	ASSERT(kblock_copy(&cache.fd, 1, 9) == 0);
+	ASSERT(kblock_flush(&cache.fd) == 0);
+	fill(expected, 1);
+	ASSERT(memcmp(disk + 9 * BLK_SIZE, expected, BLK_SIZE) == 0);
+
+	return 0;
+}
+
+static int kblockcache_posixTest(void)
+{
+	KBlockPosix f;
+	FILE *fp = tmpfile();
+	uint8_t expected[BLK_SIZE];
+	block_idx_t idx;
+
+	kputs("POSIX device test\n");
+	ASSERT(fp);
+	memset(blk, 0, sizeof(blk));
+	for (idx = 0; idx < BLK_CNT; idx++)
+		fwrite(blk, 1, BLK_SIZE, fp);
+
+	kblockposix_init(&f, fp, false, NULL, BLK_SIZE, BLK_CNT);
+	kblockcache_init(&cache, &f.b, arena, sizeof(arena));
+
+	/*
+	 * Append data blocks to a file: every data block written also
+	 * touches the allocation table (block 0) and the directory (block 1).
+	 */
+	for (idx = 2; idx < BLK_CNT; idx++)
+	{
+		ASSERT(kblock_read(&cache.fd, 0, blk, 0, BLK_SIZE) == BLK_SIZE);
+		blk[idx] = 1;
+		ASSERT(kblock_write(&cache.fd, 0, blk, idx, 1) == 1);
+
+		fill(blk, idx);
+		ASSERT(kblock_write(&cache.fd, idx, blk, 0, BLK_SIZE) == BLK_SIZE);
+
+		ASSERT(kblock_write(&cache.fd, 1, &idx, 0, sizeof(idx)) == sizeof(idx));
+	}
+
+	/* Everything reaches the file on flush */
+	ASSERT(kblock_flush(&cache.fd) == 0);
+	for (idx = 2; idx < BLK_CNT; idx++)
+	{
+		ASSERT(fseek(fp, (long)idx * BLK_SIZE, SEEK_SET) == 0);
+		ASSERT(fread(blk, 1, BLK_SIZE, fp) == BLK_SIZE);
+		fill(expected, idx);
+		ASSERT(memcmp(blk, expected, BLK_SIZE) == 0);
+	}
+	ASSERT(kblock_close(&cache.fd) == 0);
+	kprintf("hits %ld, misses %ld, writebacks %ld\n",
+		(long)cache.hits, (long)cache.misses, (long)cache.writebacks);
+	/* Table and directory are never evicted */
+	ASSERT(cache.misses == BLK_CNT);
+
+	return 0;
+}
+
+int kblockcache_testRun(void)
+{
+	if (kblockcache_ramTest() || kblockcache_posixTest())
+		return -1;
+
+	kputs("KBlock cache test finished..Ok!\n");
+	return 0;
+}
+
+int kblockcache_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int kblockcache_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kblockcache);
@@ -88,6 +88,22 @@ static size_t kblockposix_writeDirect(struct KBlock *b, block_idx_t index, const
 	return fwrite(buf, 1, size, f->fp);
 }
 
+static block_idx_t kblockposix_readBlocks(struct KBlock *b, block_idx_t index, void *buf, block_idx_t count)
+{
+	KBlockPosix *f = KBLOCKPOSIX_CAST(b);
+	fseek(f->fp, index * b->blk_size, SEEK_SET);
+	return fread(buf, b->blk_size, count, f->fp);
+}
+
+static block_idx_t kblockposix_writeBlocks(struct KBlock *b, block_idx_t index, const void *buf, block_idx_t count)
+{
+	KBlockPosix *f = KBLOCKPOSIX_CAST(b);
+	ASSERT(buf);
+	ASSERT(index + count <= b->blk_cnt);
+	fseek(f->fp, index * b->blk_size, SEEK_SET);
+	return fwrite(buf, b->blk_size, count, f->fp);
+}
+
 static int kblockposix_error(struct KBlock *b)
 {
 	KBlockPosix *f = KBLOCKPOSIX_CAST(b);
@@ -113,6 +129,7 @@ static int kblockposix_close(struct KBlock *b)
 static const KBlockVTable kblockposix_hwbuffered_vt =
 {
 	.readDirect = kblockposix_readDirect,
+	.readBlocks = kblockposix_readBlocks,
 
 	.readBuf = kblockposix_readBuf,
 	.writeBuf = kblockposix_writeBuf,
@@ -128,6 +145,8 @@ static const KBlockVTable kblockposix_swbuffered_vt =
 {
 	.readDirect = kblockposix_readDirect,
 	.writeDirect =kblockposix_writeDirect,
+	.readBlocks = kblockposix_readBlocks,
+	.writeBlocks = kblockposix_writeBlocks,
 
 	.readBuf = kblock_swReadBuf,
 	.writeBuf = kblock_swWriteBuf,
@@ -143,6 +162,8 @@ static const KBlockVTable kblockposix_unbuffered_vt =
 {
 	.readDirect = kblockposix_readDirect,
 	.writeDirect =kblockposix_writeDirect,
+	.readBlocks = kblockposix_readBlocks,
+	.writeBlocks = kblockposix_writeBlocks,
 
 	.error = kblockposix_error,
 	.clearerr = kblockposix_claererr,
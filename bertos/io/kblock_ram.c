@@ -90,6 +90,23 @@ static size_t kblockram_writeDirect(struct KBlock *b, block_idx_t index, const v
 	return size;
 }
 
+static block_idx_t kblockram_readBlocks(struct KBlock *b, block_idx_t index, void *buf, block_idx_t count)
+{
+	KBlockRam *r = KBLOCKRAM_CAST(b);
+	memcpy(buf, r->membuf + index * r->b.blk_size, count * r->b.blk_size);
+	return count;
+}
+
+static block_idx_t kblockram_writeBlocks(struct KBlock *b, block_idx_t index, const void *buf, block_idx_t count)
+{
+	KBlockRam *r = KBLOCKRAM_CAST(b);
+	ASSERT(buf);
+	ASSERT(index + count <= b->blk_cnt);
+
+	memcpy(r->membuf + index * r->b.blk_size, buf, count * r->b.blk_size);
+	return count;
+}
+
 static int kblockram_dummy(UNUSED_ARG(struct KBlock *,b))
 {
 	return 0;
@@ -98,6 +115,7 @@ static int kblockram_dummy(UNUSED_ARG(struct KBlock *,b))
 static const KBlockVTable kblockram_hwbuffered_vt =
 {
 	.readDirect = kblockram_readDirect,
+	.readBlocks = kblockram_readBlocks,
 
 	.readBuf = kblockram_readBuf,
 	.writeBuf = kblockram_writeBuf,
@@ -114,6 +132,8 @@ static const KBlockVTable kblockram_swbuffered_vt =
 {
 	.readDirect = kblockram_readDirect,
 	.writeDirect = kblockram_writeDirect,
+	.readBlocks = kblockram_readBlocks,
+	.writeBlocks = kblockram_writeBlocks,
 
 	.readBuf = kblock_swReadBuf,
 	.writeBuf = kblock_swWriteBuf,
@@ -129,6 +149,8 @@ static const KBlockVTable kblockram_unbuffered_vt =
 {
 	.readDirect = kblockram_readDirect,
 	.writeDirect = kblockram_writeDirect,
+	.readBlocks = kblockram_readBlocks,
+	.writeBlocks = kblockram_writeBlocks,
 
 	.error = kblockram_dummy,
 	.clearerr = (kblock_clearerr_t)kblockram_dummy,
@@ -0,0 +1,297 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief KBlock access statistics.
+ *
+ * The statistics device exports the same methods of the underlying
+ * device, so that the generic KBlock layer takes the same paths for
+ * both: each method calls the device one, timing it if needed.
+ * Buffered devices share their buffer, which is only accessed through
+ * the device methods.
+ *
+ * $WIZ$ module_depends = "kblock", "timer", "kfile"
+ */
+
+#include "kblock_stats.h"
+
+#include <drv/timer.h>
+#include <cpu/irq.h>
+#include <io/kfile.h>
+
+#include <string.h> /* memset */
+
+#define HP_TO_US(hp) \
+	((uint32_t)((uint64_t)(hp) * 1000000 / TIMER_HW_HPTICKS_PER_SEC))
+
+static const char * const op_names[KBS_CNT] = { "read", "write", "load", "store", "flush" };
+
+
+static uint32_t hpNow(void)
+{
+	uint32_t now;
+
+	ATOMIC(now = timer_hpclock_unlocked());
+	return now;
+}
+
+/*
+ * Account a call to \a op on block \a idx started at \a start.
+ */
+static void account(KBlockStats *s, KBlockStatsOp op, block_idx_t idx, uint32_t start, size_t bytes, bool ok)
+{
+	KBlockOpStats *o = &s->op[op];
+	uint32_t us = HP_TO_US(hpNow() - start);
+	uint32_t t;
+	int bucket;
+
+	o->calls++;
+	if (idx == s->last || idx == s->last + 1)
+		o->seq++;
+	s->last = idx;
+
+	if (ok)
+		o->bytes += bytes;
+	else
+		o->errors++;
+
+	o->time_us += us;
+	o->max_us = MAX(o->max_us, us);
+	for (bucket = 0, t = us; t && bucket < KBLOCKSTATS_BUCKETS - 1; t >>= 1)
+		bucket++;
+	o->hist[bucket]++;
+}
+
+static size_t kblockstats_readDirect(struct KBlock *b, block_idx_t idx, void *buf, size_t offset, size_t size)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	uint32_t start = hpNow();
+	size_t res = s->dev->priv.vt->readDirect(s->dev, s->dev->priv.blk_start + idx, buf, offset, size);
+
+	account(s, KBS_READ, idx, start, res, res == size);
+	return res;
+}
+
+static size_t kblockstats_writeDirect(struct KBlock *b, block_idx_t idx, const void *buf, size_t offset, size_t size)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	uint32_t start = hpNow();
+	size_t res = s->dev->priv.vt->writeDirect(s->dev, s->dev->priv.blk_start + idx, buf, offset, size);
+
+	account(s, KBS_WRITE, idx, start, res, res == size);
+	return res;
+}
+
+static block_idx_t kblockstats_readBlocks(struct KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	uint32_t start = hpNow();
+	block_idx_t res = s->dev->priv.vt->readBlocks(s->dev, s->dev->priv.blk_start + idx, buf, count);
+
+	account(s, KBS_READ, idx, start, res * b->blk_size, res == count);
+	s->last = idx + count - 1;
+	return res;
+}
+
+static block_idx_t kblockstats_writeBlocks(struct KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	uint32_t start = hpNow();
+	block_idx_t res = s->dev->priv.vt->writeBlocks(s->dev, s->dev->priv.blk_start + idx, buf, count);
+
+	account(s, KBS_WRITE, idx, start, res * b->blk_size, res == count);
+	s->last = idx + count - 1;
+	return res;
+}
+
+static size_t kblockstats_readBuf(struct KBlock *b, void *buf, size_t offset, size_t size)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	return s->dev->priv.vt->readBuf(s->dev, buf, offset, size);
+}
+
+static size_t kblockstats_writeBuf(struct KBlock *b, const void *buf, size_t offset, size_t size)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	return s->dev->priv.vt->writeBuf(s->dev, buf, offset, size);
+}
+
+static int kblockstats_load(struct KBlock *b, block_idx_t idx)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	uint32_t start = hpNow();
+	int res = s->dev->priv.vt->load(s->dev, s->dev->priv.blk_start + idx);
+
+	account(s, KBS_LOAD, idx, start, b->blk_size, res == 0);
+	return res;
+}
+
+static int kblockstats_store(struct KBlock *b, block_idx_t idx)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	uint32_t start = hpNow();
+	int res = s->dev->priv.vt->store(s->dev, s->dev->priv.blk_start + idx);
+
+	account(s, KBS_STORE, idx, start, b->blk_size, res == 0);
+	return res;
+}
+
+static int kblockstats_flush(struct KBlock *b)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	uint32_t start = hpNow();
+	int res = s->dev->priv.vt->flush(s->dev);
+
+	account(s, KBS_FLUSH, s->last, start, 0, res == 0);
+	return res;
+}
+
+static int kblockstats_error(struct KBlock *b)
+{
+	return kblock_error(KBLOCKSTATS_CAST(b)->dev);
+}
+
+static void kblockstats_clearerr(struct KBlock *b)
+{
+	kblock_clearerr(KBLOCKSTATS_CAST(b)->dev);
+}
+
+static int kblockstats_close(struct KBlock *b)
+{
+	KBlockStats *s = KBLOCKSTATS_CAST(b);
+	return s->dev->priv.vt->close(s->dev);
+}
+
+
+/**
+ * Reset all the statistics of \a s.
+ */
+void kblockstats_reset(KBlockStats *s)
+{
+	memset(s->op, 0, sizeof(s->op));
+}
+
+/**
+ * Print the statistics of \a s on \a fd, as a table followed by the
+ * latency histograms.
+ */
+void kblockstats_print(KBlockStats *s, struct KFile *fd)
+{
+	int op, i;
+
+	kfile_printf(fd, "%-6s%10s%10s%6s%8s%10s%10s\n",
+		"op", "calls", "bytes", "seq%", "errors", "avg[us]", "max[us]");
+	for (op = 0; op < KBS_CNT; op++)
+	{
+		KBlockOpStats *o = &s->op[op];
+
+		if (!o->calls)
+			continue;
+		kfile_printf(fd, "%-6s%10lu%10lu%6lu%8lu%10lu%10lu\n", op_names[op],
+			(unsigned long)o->calls, (unsigned long)o->bytes,
+			(unsigned long)((uint64_t)o->seq * 100 / o->calls),
+			(unsigned long)o->errors, (unsigned long)(o->time_us / o->calls),
+			(unsigned long)o->max_us);
+	}
+
+	for (op = 0; op < KBS_CNT; op++)
+	{
+		KBlockOpStats *o = &s->op[op];
+
+		if (!o->calls)
+			continue;
+		kfile_printf(fd, "%s latency [us]:", op_names[op]);
+		for (i = 0; i < KBLOCKSTATS_BUCKETS; i++)
+		{
+			if (!o->hist[i])
+				continue;
+			if (i == 0)
+				kfile_printf(fd, " <1:%lu", (unsigned long)o->hist[i]);
+			else if (i == KBLOCKSTATS_BUCKETS - 1)
+				kfile_printf(fd, " %lu+:%lu", 1UL << (i - 1), (unsigned long)o->hist[i]);
+			else if (i == 1)
+				kfile_printf(fd, " 1:%lu", (unsigned long)o->hist[i]);
+			else
+				kfile_printf(fd, " %lu-%lu:%lu", 1UL << (i - 1), (1UL << i) - 1,
+					(unsigned long)o->hist[i]);
+		}
+		kfile_printf(fd, "\n");
+	}
+}
+
+
+/**
+ * Initialize a statistics device on top of a KBlock device.
+ *
+ * \param s    kblock statistics device
+ * \param dev  kblock descriptor of the measured device
+ *
+ * \note Do not access \a dev directly while the statistics device is in use.
+ */
+void kblockstats_init(KBlockStats *s, KBlock *dev)
+{
+	const KBlockVTable *dev_vt;
+
+	ASSERT(dev);
+	ASSERT(!kblock_buffered(dev) || !kblock_cacheDirty(dev));
+
+	memset(s, 0, sizeof(KBlockStats));
+	dev_vt = dev->priv.vt;
+
+	DB(s->fd.priv.type = KBT_KBLOCKSTATS);
+
+	s->fd.blk_size = dev->blk_size;
+	s->fd.blk_cnt = dev->blk_cnt;
+
+	s->fd.priv.flags = dev->priv.flags & (KB_BUFFERED | KB_PARTIAL_WRITE);
+	s->fd.priv.buf = dev->priv.buf;
+	s->fd.priv.curr_blk = dev->priv.curr_blk;
+
+	/* Export only the methods the device has */
+	#define MIRROR(method) \
+		s->vt.method = dev_vt->method ? kblockstats_##method : NULL
+	MIRROR(readDirect);
+	MIRROR(writeDirect);
+	MIRROR(readBlocks);
+	MIRROR(writeBlocks);
+	MIRROR(readBuf);
+	MIRROR(writeBuf);
+	MIRROR(load);
+	MIRROR(store);
+	MIRROR(flush);
+	MIRROR(close);
+	#undef MIRROR
+	s->vt.error = kblockstats_error;
+	s->vt.clearerr = kblockstats_clearerr;
+	s->fd.priv.vt = &s->vt;
+
+	s->dev = dev;
+}
@@ -0,0 +1,131 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief KBlock access statistics.
+ *
+ * This module stacks on top of any KBlock device and forwards every
+ * call to it unchanged, buffered mode and partial writes included,
+ * counting calls, bytes and errors of each operation, the ratio of
+ * sequential accesses and a histogram of the latencies measured with
+ * the high resolution timer.
+ *
+ * Put it between the layers to find out where time goes: over the
+ * device to see what the device does, over a cache to see what the
+ * filesystem asks for.
+ *
+ * Example, with a CLI command printing the statistics:
+ * \code
+ * KBlockStats stats;
+ *
+ * // ...init the KBlock device dev
+ * kblockstats_init(&stats, dev);
+ * // ...use &stats.fd in place of dev
+ *
+ * MAKE_CMD(diskstat, "", "",
+ * ({
+ *     kblockstats_print(&stats, &ser.fd);
+ *     kblockstats_reset(&stats);
+ *     0;
+ * }), 0);
+ * \endcode
+ *
+ * $WIZ$ module_name = "kblock_stats"
+ * $WIZ$ module_depends = "kblock", "timer", "kfile"
+ */
+
+#ifndef IO_KBLOCK_STATS_H
+#define IO_KBLOCK_STATS_H
+
+#include "kblock.h"
+
+/**
+ * Number of latency histogram buckets.
+ * Bucket 0 counts latencies under 1 us, bucket i latencies from
+ * 2^(i-1) to 2^i - 1 us; the last bucket counts all the longer ones.
+ */
+#define KBLOCKSTATS_BUCKETS  20
+
+/**
+ * Operations with statistics.
+ */
+typedef enum KBlockStatsOp
+{
+	KBS_READ,   ///< readDirect() and readBlocks()
+	KBS_WRITE,  ///< writeDirect() and writeBlocks()
+	KBS_LOAD,   ///< load(), buffered devices only
+	KBS_STORE,  ///< store(), buffered devices only
+	KBS_FLUSH,  ///< flush() of the device caches
+
+	KBS_CNT
+} KBlockStatsOp;
+
+/**
+ * Statistics of an operation.
+ */
+typedef struct KBlockOpStats
+{
+	uint32_t calls;
+	uint32_t seq;      ///< Calls on the last accessed block or on the next one.
+	uint32_t errors;
+	uint32_t bytes;
+	uint32_t time_us;  ///< Total time spent.
+	uint32_t max_us;   ///< Longest call.
+	uint32_t hist[KBLOCKSTATS_BUCKETS];
+} KBlockOpStats;
+
+typedef struct KBlockStats
+{
+	KBlock  fd;
+	KBlock *dev;
+
+	KBlockVTable vt;   ///< Mirrors the methods \a dev has.
+	block_idx_t last;  ///< Last accessed block.
+
+	KBlockOpStats op[KBS_CNT];
+} KBlockStats;
+
+#define KBT_KBLOCKSTATS MAKE_ID('K', 'B', 'S', 'T')
+
+
+INLINE KBlockStats *KBLOCKSTATS_CAST(KBlock *b)
+{
+	ASSERT(b->priv.type == KBT_KBLOCKSTATS);
+	return (KBlockStats *)b;
+}
+
+struct KFile;
+
+void kblockstats_init(KBlockStats *s, KBlock *dev);
+void kblockstats_reset(KBlockStats *s);
+void kblockstats_print(KBlockStats *s, struct KFile *fd);
+
+#endif /* IO_KBLOCK_STATS_H */
@@ -0,0 +1,243 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief KBlock statistics test.
+ *
+ * Counts the accesses to unbuffered and buffered RAM devices and to a
+ * RAM device behind a cache, checking that data go through unchanged,
+ * then prints the statistics.
+ */
+
+#include "kblock_stats.h"
+#include "kblock_cache.h"
+#include "kblock_ram.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <drv/timer.h>
+#include <struct/kfile_mem.h>
+
+#include <string.h>
+
+/* avoid compiler warnings... */
+int kblockstats_testSetup(void);
+int kblockstats_testRun(void);
+int kblockstats_testTearDown(void);
+
+#define BLK_SIZE      64
+#define BLK_CNT       16
+#define CACHE_BLOCKS   4
+
+static uint8_t disk[BLK_SIZE * BLK_CNT];
+static uint32_t arena[KBLOCKCACHE_ARENA_SIZE(BLK_SIZE, CACHE_BLOCKS) / sizeof(uint32_t)];
+static uint8_t blk[BLK_SIZE];
+static char text[1024];
+
+static KBlockRam ram;
+static KBlockCache cache;
+static KBlockStats stats, dev_stats;
+
+static void fill(uint8_t *buf, block_idx_t idx)
+{
+	for (int i = 0; i < BLK_SIZE; i++)
+		buf[i] = idx * BLK_SIZE + i;
+}
+
+static void print(KBlockStats *s)
+{
+	KFileMem mem;
+
+	memset(text, 0, sizeof(text));
+	kfilemem_init(&mem, text, sizeof(text) - 1);
+	kblockstats_print(s, &mem.fd);
+	kputs(text);
+}
+
+static int kblockstats_directTest(void)
+{
+	uint8_t expected[BLK_SIZE];
+	block_idx_t idx;
+
+	kputs("Unbuffered device test\n");
+	memset(disk, 0, sizeof(disk));
+	kblockram_init(&ram, disk, sizeof(disk), BLK_SIZE, false, false);
+	kblockstats_init(&stats, &ram.b);
+	ASSERT(!kblock_buffered(&stats.fd));
+	ASSERT(stats.fd.blk_cnt == BLK_CNT);
+
+	/* Sequential writes */
+	for (idx = 0; idx < BLK_CNT; idx++)
+	{
+		fill(blk, idx);
+		ASSERT(kblock_write(&stats.fd, idx, blk, 0, BLK_SIZE) == BLK_SIZE);
+	}
+	ASSERT(stats.op[KBS_WRITE].calls == BLK_CNT);
+	ASSERT(stats.op[KBS_WRITE].seq == BLK_CNT);
+	ASSERT(stats.op[KBS_WRITE].bytes == BLK_CNT * BLK_SIZE);
+	for (idx = 0; idx < BLK_CNT; idx++)
+	{
+		fill(expected, idx);
+		ASSERT(memcmp(disk + idx * BLK_SIZE, expected, BLK_SIZE) == 0);
+	}
+
+	/* Strided partial reads are random */
+	for (idx = 0; idx < BLK_CNT; idx += 4)
+	{
+		ASSERT(kblock_read(&stats.fd, idx, blk, 8, 8) == 8);
+		fill(expected, idx);
+		ASSERT(memcmp(blk, expected + 8, 8) == 0);
+	}
+	ASSERT(stats.op[KBS_READ].calls == BLK_CNT / 4);
+	ASSERT(stats.op[KBS_READ].seq == 0);
+	ASSERT(stats.op[KBS_READ].bytes == BLK_CNT / 4 * 8);
+	ASSERT(stats.op[KBS_LOAD].calls == 0);
+	ASSERT(stats.op[KBS_STORE].calls == 0);
+
+	/* Histograms count every call */
+	for (int op = 0; op < KBS_CNT; op++)
+	{
+		uint32_t sum = 0;
+
+		for (int i = 0; i < KBLOCKSTATS_BUCKETS; i++)
+			sum += stats.op[op].hist[i];
+		ASSERT(sum == stats.op[op].calls);
+	}
+
+	print(&stats);
+	ASSERT(strstr(text, "write"));
+	ASSERT(!strstr(text, "load"));
+
+	kblockstats_reset(&stats);
+	ASSERT(stats.op[KBS_WRITE].calls == 0);
+
+	return 0;
+}
+
+static int kblockstats_bufferedTest(void)
+{
+	uint8_t expected[BLK_SIZE];
+
+	kputs("Buffered device test\n");
+	memset(disk, 0, sizeof(disk));
+	kblockram_init(&ram, disk, sizeof(disk), BLK_SIZE, true, false);
+	kblockstats_init(&stats, &ram.b);
+	ASSERT(kblock_buffered(&stats.fd));
+
+	/* Partial writes on the same block are merged in the buffer */
+	memset(blk, 0x55, sizeof(blk));
+	for (int i = 0; i < 8; i++)
+		ASSERT(kblock_write(&stats.fd, 3, blk, i * 8, 8) == 8);
+	ASSERT(stats.op[KBS_LOAD].calls == 1);
+	ASSERT(stats.op[KBS_STORE].calls == 0);
+	ASSERT(kblock_flush(&stats.fd) == 0);
+	ASSERT(stats.op[KBS_STORE].calls == 1);
+	/* The first block of the RAM is the buffer */
+	ASSERT(memcmp(disk + 4 * BLK_SIZE, blk, BLK_SIZE) == 0);
+
+	/* Moving to the next block is sequential */
+	ASSERT(kblock_write(&stats.fd, 4, blk, 0, 8) == 8);
+	ASSERT(stats.op[KBS_LOAD].calls == 2);
+	ASSERT(stats.op[KBS_LOAD].seq == 1);
+
+	/* Whole blocks are read directly */
+	ASSERT(kblock_read(&stats.fd, 9, expected, 0, BLK_SIZE) == BLK_SIZE);
+	ASSERT(stats.op[KBS_READ].calls == 1);
+	ASSERT(stats.op[KBS_READ].seq == 0);
+
+	print(&stats);
+	ASSERT(strstr(text, "store"));
+
+	return 0;
+}
+
+static int kblockstats_stackTest(void)
+{
+	uint8_t expected[BLK_SIZE];
+	block_idx_t idx;
+
+	kputs("Stacked devices test\n");
+	memset(disk, 0, sizeof(disk));
+	kblockram_init(&ram, disk, sizeof(disk), BLK_SIZE, false, false);
+	kblockstats_init(&dev_stats, &ram.b);
+	kblockcache_init(&cache, &dev_stats.fd, arena, sizeof(arena));
+	kblockstats_init(&stats, &cache.fd);
+
+	for (int i = 0; i < 100; i++)
+	{
+		idx = (i * 7) % BLK_CNT;
+		fill(blk, idx);
+		ASSERT(kblock_write(&stats.fd, idx, blk, 0, BLK_SIZE) == BLK_SIZE);
+		ASSERT(kblock_read(&stats.fd, (idx + 1) % 3, blk, 0, BLK_SIZE) == BLK_SIZE);
+	}
+	ASSERT(kblock_flush(&stats.fd) == 0);
+	for (idx = 0; idx < BLK_CNT; idx++)
+	{
+		fill(expected, idx);
+		ASSERT(memcmp(disk + idx * BLK_SIZE, expected, BLK_SIZE) == 0);
+	}
+
+	/* The cache only writes back what it evicts */
+	ASSERT(stats.op[KBS_WRITE].calls == 100);
+	ASSERT(stats.op[KBS_FLUSH].calls == 1);
+	ASSERT(dev_stats.op[KBS_WRITE].calls == cache.writebacks);
+	ASSERT(dev_stats.op[KBS_READ].calls <= cache.misses);
+
+	kputs("Cache:\n");
+	print(&stats);
+	kputs("Device:\n");
+	print(&dev_stats);
+
+	return 0;
+}
+
+int kblockstats_testRun(void)
+{
+	if (kblockstats_directTest() || kblockstats_bufferedTest() || kblockstats_stackTest())
+		return -1;
+
+	kputs("KBlock stats test finished..Ok!\n");
+	return 0;
+}
+
+int kblockstats_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	return 0;
+}
+
+int kblockstats_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kblockstats);
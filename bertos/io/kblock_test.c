@@ -0,0 +1,141 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief KBlock multiple block transfer test.
+ *
+ * Checks kblock_readBlocks() and kblock_writeBlocks() on devices with
+ * native multiple block transfers (RAM and POSIX, buffered or not)
+ * and on a device using the generic one block at a time fallback.
+ */
+
+#include "kblock.h"
+#include "kblock_ram.h"
+#include "kblock_posix.h"
+#include "kblock_cache.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <string.h>
+#include <stdio.h>
+
+/* avoid compiler warnings... */
+int kblock_testSetup(void);
+int kblock_testRun(void);
+int kblock_testTearDown(void);
+
+#define BLK_SIZE  64
+#define BLK_CNT   16
+
+/* One more block, used as page buffer by buffered devices */
+static uint8_t disk[BLK_SIZE * (BLK_CNT + 1)];
+static uint8_t wbuf[BLK_SIZE * BLK_CNT];
+static uint8_t rbuf[BLK_SIZE * BLK_CNT];
+static uint8_t page[BLK_SIZE];
+static uint8_t posix_buf[BLK_SIZE];
+static uint32_t arena[KBLOCKCACHE_ARENA_SIZE(BLK_SIZE, 2) / sizeof(uint32_t)];
+
+static void kblock_checkBlocks(KBlock *b, const char *name)
+{
+	int i;
+
+	kprintf("%s\n", name);
+	for (i = 0; i < (int)sizeof(wbuf); i++)
+		wbuf[i] = i * 7 + name[0];
+
+	/* Whole device, then a range in the middle */
+	ASSERT(kblock_writeBlocks(b, 0, wbuf, b->blk_cnt) == b->blk_cnt);
+	ASSERT(kblock_readBlocks(b, 0, rbuf, b->blk_cnt) == b->blk_cnt);
+	ASSERT(memcmp(wbuf, rbuf, b->blk_cnt * BLK_SIZE) == 0);
+
+	memset(wbuf, 0x55, 3 * BLK_SIZE);
+	ASSERT(kblock_writeBlocks(b, 4, wbuf, 3) == 3);
+	ASSERT(kblock_readBlocks(b, 3, rbuf, 5) == 5);
+	ASSERT(rbuf[BLK_SIZE - 1] != 0x55);
+	ASSERT(memcmp(rbuf + BLK_SIZE, wbuf, 3 * BLK_SIZE) == 0);
+	ASSERT(rbuf[4 * BLK_SIZE] != 0x55);
+
+	/* Coherency with single block accesses */
+	memset(page, 0xaa, sizeof(page));
+	ASSERT(kblock_write(b, 5, page, 0, BLK_SIZE) == BLK_SIZE);
+	ASSERT(kblock_readBlocks(b, 4, rbuf, 3) == 3);
+	ASSERT(memcmp(rbuf + BLK_SIZE, page, BLK_SIZE) == 0);
+
+	ASSERT(kblock_writeBlocks(b, 5, wbuf, 1) == 1);
+	ASSERT(kblock_read(b, 5, page, 0, BLK_SIZE) == BLK_SIZE);
+	ASSERT(memcmp(page, wbuf, BLK_SIZE) == 0);
+
+	ASSERT(kblock_flush(b) == 0);
+}
+
+int kblock_testRun(void)
+{
+	KBlockRam ram;
+	KBlockPosix f;
+	KBlockCache cache;
+	FILE *fp;
+
+	kblockram_init(&ram, disk, sizeof(disk) - BLK_SIZE, BLK_SIZE, false, false);
+	kblock_checkBlocks(&ram.b, "ram unbuffered");
+
+	kblockram_init(&ram, disk, sizeof(disk), BLK_SIZE, true, false);
+	kblock_checkBlocks(&ram.b, "ram buffered");
+
+	kblockram_init(&ram, disk, sizeof(disk) - BLK_SIZE, BLK_SIZE, false, false);
+	kblockcache_init(&cache, &ram.b, arena, sizeof(arena));
+	kblock_checkBlocks(&cache.fd, "cache (generic)");
+
+	fp = tmpfile();
+	ASSERT(fp);
+	kblockposix_init(&f, fp, false, NULL, BLK_SIZE, BLK_CNT);
+	kblock_checkBlocks(&f.b, "posix unbuffered");
+
+	kblockposix_init(&f, fp, false, posix_buf, BLK_SIZE, BLK_CNT);
+	kblock_checkBlocks(&f.b, "posix buffered");
+	ASSERT(kblock_close(&f.b) == 0);
+
+	kputs("KBlock test finished..Ok!\n");
+	return 0;
+}
+
+int kblock_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int kblock_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kblock);
@@ -38,6 +38,16 @@
  */
 
 #include "kfile_block.h"
+
+#include <cfg/depend.h>
+
+#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+	#include "cfg/cfg_proc.h"
+	#include "cfg/cfg_sem.h"
+	#include "cfg/cfg_signal.h"
+	#include <kern/signal.h>
+#endif
+
 #include <string.h>
 
 
@@ -113,6 +123,423 @@ static int kfileblock_close(struct KFile *fd)
 	return kblock_close(fb->blk);
 }
 
+#if CONFIG_KFILE_BLOCK_STREAM
+
+/*
+ * Stream buffer states. The busy ones (loading and storing) belong to
+ * the worker process, all the others to the caller.
+ */
+#define BUF_FREE     0 ///< No data.
+#define BUF_VALID    1 ///< Copy of block idx.
+#define BUF_DIRTY    2 ///< Copy of block idx, modified.
+#define BUF_LOADING  3 ///< Block idx is being read.
+#define BUF_STORING  4 ///< Block idx is being written.
+
+#define BUF_BUSY(b)  ((b)->state >= BUF_LOADING)
+
+#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+	CONFIG_DEPEND(CONFIG_KFILE_BLOCK_STREAM_ASYNC, CONFIG_KERN && CONFIG_KERN_SEMAPHORES && CONFIG_KERN_SIGNALS);
+
+	#define SIG_STREAM_KICK  SIG_USER0   ///< To the worker: new transfers.
+	#define SIG_STREAM_DONE  SIG_SYSTEM5 ///< To the waiter: transfer done.
+
+	#define STREAM_LOCK(s)    sem_obtain(&(s)->lock)
+	#define STREAM_UNLOCK(s)  sem_release(&(s)->lock)
+#else
+	#define STREAM_LOCK(s)    ((void)(s))
+	#define STREAM_UNLOCK(s)  ((void)(s))
+#endif
+
+static KFileBlockBuf *stream_find(KFileBlockStream *s, block_idx_t idx)
+{
+	size_t i;
+
+	for (i = 0; i < s->nbufs; i++)
+		if (s->bufs[i].state != BUF_FREE && s->bufs[i].idx == idx)
+			return &s->bufs[i];
+	return NULL;
+}
+
+#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+
+static void NORETURN kfileblock_worker(void)
+{
+	KFileBlock *fb = (KFileBlock *)proc_currentUserData();
+	KFileBlockStream *s = fb->stream;
+	size_t blk_size = fb->blk->blk_size;
+
+	while (1)
+	{
+		KFileBlockBuf *b = NULL;
+		bool ok;
+		size_t i;
+
+		STREAM_LOCK(s);
+		for (i = 0; i < s->nbufs && !b; i++)
+			if (BUF_BUSY(&s->bufs[i]))
+				b = &s->bufs[i];
+		STREAM_UNLOCK(s);
+
+		if (!b && s->quit)
+		{
+			/*
+			 * The closer may release the stream, and this stack with it,
+			 * as soon as it sees the worker gone: keep interrupts disabled
+			 * from here to the final context switch, so that it can run
+			 * only once nothing is left on this stack.
+			 */
+			IRQ_DISABLE;
+			s->worker = NULL;
+			if (s->waiter)
+				sig_post(s->waiter, SIG_STREAM_DONE);
+			proc_exit();
+		}
+
+		if (!b)
+		{
+			sig_wait(SIG_STREAM_KICK);
+			continue;
+		}
+
+		/* Nobody else touches a busy buffer, no need to lock */
+		if (b->state == BUF_LOADING)
+			ok = kblock_read(fb->blk, b->idx, b->data, 0, blk_size) == blk_size;
+		else
+			ok = kblock_write(fb->blk, b->idx, b->data, 0, blk_size) == blk_size;
+
+		STREAM_LOCK(s);
+		if (ok)
+			b->state = BUF_VALID;
+		else
+		{
+			b->state = BUF_FREE;
+			s->error = true;
+		}
+		if (s->waiter)
+			sig_send(s->waiter, SIG_STREAM_DONE);
+		STREAM_UNLOCK(s);
+	}
+}
+
+/*
+ * Hand buffer \a b to the worker. Called with the stream locked.
+ */
+static void stream_start(KFileBlockStream *s, KFileBlockBuf *b, uint8_t state)
+{
+	b->state = state;
+	sig_send(s->worker, SIG_STREAM_KICK);
+}
+
+/*
+ * Wait for the worker to complete a transfer.
+ * Called with the stream locked, the lock is released while waiting.
+ */
+static void stream_wait(KFileBlockStream *s)
+{
+	s->waiter = proc_current();
+	/* Completions before this point are already visible */
+	sig_check(SIG_STREAM_DONE);
+	STREAM_UNLOCK(s);
+	sig_wait(SIG_STREAM_DONE);
+	STREAM_LOCK(s);
+	s->waiter = NULL;
+}
+
+/*
+ * Start reading the blocks following \a idx in the free buffers,
+ * without replacing the ones holding modified data or \a idx itself.
+ */
+static void stream_prefetch(KFileBlock *fb, block_idx_t idx)
+{
+	KFileBlockStream *s = fb->stream;
+	block_idx_t next;
+
+	for (next = idx + 1; next < idx + s->nbufs && next < fb->blk->blk_cnt; next++)
+	{
+		KFileBlockBuf *b;
+
+		if (stream_find(s, next))
+			continue;
+
+		b = &s->bufs[s->next];
+		if (BUF_BUSY(b) || b->state == BUF_DIRTY || (b->state == BUF_VALID && b->idx == idx))
+			break;
+
+		b->idx = next;
+		s->next = (s->next + 1) % s->nbufs;
+		stream_start(s, b, BUF_LOADING);
+	}
+}
+
+#else /* !CONFIG_KFILE_BLOCK_STREAM_ASYNC */
+
+/*
+ * Write back all the modified buffers.
+ * Blocks written in sequence fill the buffers in order, so
+ * they are stored with a single transfer.
+ */
+static bool stream_drain(KFileBlock *fb)
+{
+	KFileBlockStream *s = fb->stream;
+	size_t blk_size = fb->blk->blk_size;
+	bool ok = true;
+	size_t i;
+
+	for (i = 0; i < s->nbufs; i++)
+		if (s->bufs[i].state != BUF_DIRTY || s->bufs[i].idx != s->bufs[0].idx + i)
+			break;
+
+	if (i == s->nbufs)
+	{
+		ok = kblock_writeBlocks(fb->blk, s->bufs[0].idx, s->bufs[0].data, s->nbufs) == s->nbufs;
+		for (i = 0; i < s->nbufs; i++)
+			s->bufs[i].state = ok ? BUF_VALID : BUF_FREE;
+	}
+	else
+	{
+		for (i = 0; i < s->nbufs; i++)
+		{
+			KFileBlockBuf *b = &s->bufs[i];
+
+			if (b->state != BUF_DIRTY)
+				continue;
+			if (kblock_write(fb->blk, b->idx, b->data, 0, blk_size) == blk_size)
+				b->state = BUF_VALID;
+			else
+			{
+				b->state = BUF_FREE;
+				ok = false;
+			}
+		}
+	}
+
+	s->next = 0;
+	return ok;
+}
+
+/*
+ * Read block \a idx and the following ones in all the buffers,
+ * with a single transfer.
+ */
+static KFileBlockBuf *stream_fill(KFileBlock *fb, block_idx_t idx)
+{
+	KFileBlockStream *s = fb->stream;
+	block_idx_t count, i;
+
+	if (!stream_drain(fb))
+		return NULL;
+
+	count = MIN((block_idx_t)s->nbufs, fb->blk->blk_cnt - idx);
+	count = kblock_readBlocks(fb->blk, idx, s->bufs[0].data, count);
+	for (i = 0; i < s->nbufs; i++)
+	{
+		s->bufs[i].idx = idx + i;
+		s->bufs[i].state = i < count ? BUF_VALID : BUF_FREE;
+	}
+	s->next = count % s->nbufs;
+
+	return count ? &s->bufs[0] : NULL;
+}
+
+#endif /* !CONFIG_KFILE_BLOCK_STREAM_ASYNC */
+
+/*
+ * Return a buffer holding block \a idx, replacing the oldest one if
+ * needed. The block is read only if \a load is true, otherwise the
+ * caller is going to overwrite it all.
+ *
+ * Called with the stream locked.
+ */
+static KFileBlockBuf *stream_get(KFileBlock *fb, block_idx_t idx, bool load)
+{
+	KFileBlockStream *s = fb->stream;
+	KFileBlockBuf *b;
+
+	while (1)
+	{
+		if ((b = stream_find(s, idx)))
+		{
+			if (!BUF_BUSY(b))
+				return b;
+		}
+		else
+		{
+		#if !CONFIG_KFILE_BLOCK_STREAM_ASYNC
+			if (load)
+				return stream_fill(fb, idx);
+		#endif
+
+			b = &s->bufs[s->next];
+			if (b->state == BUF_DIRTY)
+			{
+			#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+				stream_start(s, b, BUF_STORING);
+			#else
+				if (!stream_drain(fb))
+					return NULL;
+				continue;
+			#endif
+			}
+			else if (!BUF_BUSY(b))
+			{
+				b->idx = idx;
+				s->next = (s->next + 1) % s->nbufs;
+				if (!load)
+				{
+					b->state = BUF_VALID;
+					return b;
+				}
+			#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+				stream_start(s, b, BUF_LOADING);
+			#endif
+			}
+		}
+
+	#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+		stream_wait(s);
+		/* The load failed */
+		if (s->error)
+			return NULL;
+	#endif
+	}
+}
+
+static size_t kfileblock_streamRead(struct KFile *fd, void *_buf, size_t size)
+{
+	KFileBlock *fb = KFILEBLOCK_CAST(fd);
+	KFileBlockStream *s = fb->stream;
+	uint8_t *buf = (uint8_t *)_buf;
+	size_t len = 0;
+
+	STREAM_LOCK(s);
+	while (size)
+	{
+		block_idx_t id = fd->seek_pos / fb->blk->blk_size;
+		if (id >= fb->blk->blk_cnt)
+			break;
+		size_t offset = fd->seek_pos % fb->blk->blk_size;
+		size_t count = MIN(size, (size_t)(fb->blk->blk_size - offset));
+
+		KFileBlockBuf *b = stream_get(fb, id, true);
+		if (!b)
+			break;
+	#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+		stream_prefetch(fb, id);
+	#endif
+
+		/* Only the caller changes the idle buffers */
+		STREAM_UNLOCK(s);
+		memcpy(buf, b->data + offset, count);
+		STREAM_LOCK(s);
+
+		size -= count;
+		fd->seek_pos += count;
+		buf += count;
+		len += count;
+	}
+	STREAM_UNLOCK(s);
+
+	return len;
+}
+
+static size_t kfileblock_streamWrite(struct KFile *fd, const void *_buf, size_t size)
+{
+	KFileBlock *fb = KFILEBLOCK_CAST(fd);
+	KFileBlockStream *s = fb->stream;
+	const uint8_t *buf = (const uint8_t *)_buf;
+	size_t len = 0;
+
+	STREAM_LOCK(s);
+	while (size)
+	{
+		block_idx_t id = fd->seek_pos / fb->blk->blk_size;
+		if (id >= fb->blk->blk_cnt)
+			break;
+		size_t offset = fd->seek_pos % fb->blk->blk_size;
+		size_t count = MIN(size, (size_t)(fb->blk->blk_size - offset));
+
+		KFileBlockBuf *b = stream_get(fb, id, count != fb->blk->blk_size);
+		if (!b)
+			break;
+
+		STREAM_UNLOCK(s);
+		memcpy(b->data + offset, buf, count);
+		STREAM_LOCK(s);
+
+		b->state = BUF_DIRTY;
+	#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+		/* Write behind the blocks as soon as they are complete */
+		if (offset + count == fb->blk->blk_size)
+			stream_start(s, b, BUF_STORING);
+	#endif
+
+		size -= count;
+		fd->seek_pos += count;
+		buf += count;
+		len += count;
+	}
+	STREAM_UNLOCK(s);
+
+	return len;
+}
+
+static int kfileblock_streamFlush(struct KFile *fd)
+{
+	KFileBlock *fb = KFILEBLOCK_CAST(fd);
+	KFileBlockStream *s = fb->stream;
+	bool error;
+
+	STREAM_LOCK(s);
+#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+	while (1)
+	{
+		bool busy = false;
+		size_t i;
+
+		for (i = 0; i < s->nbufs; i++)
+		{
+			if (s->bufs[i].state == BUF_DIRTY)
+				stream_start(s, &s->bufs[i], BUF_STORING);
+			busy |= BUF_BUSY(&s->bufs[i]);
+		}
+		if (!busy)
+			break;
+		stream_wait(s);
+	}
+#else
+	if (!stream_drain(fb))
+		s->error = true;
+#endif
+	error = s->error;
+	s->error = false;
+	STREAM_UNLOCK(s);
+
+	if (error)
+		return EOF;
+	return kblock_flush(fb->blk);
+}
+
+static int kfileblock_streamClose(struct KFile *fd)
+{
+	KFileBlock *fb = KFILEBLOCK_CAST(fd);
+	int err = kfileblock_streamFlush(fd);
+
+#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+	KFileBlockStream *s = fb->stream;
+
+	STREAM_LOCK(s);
+	s->quit = true;
+	sig_send(s->worker, SIG_STREAM_KICK);
+	while (s->worker)
+		stream_wait(s);
+	STREAM_UNLOCK(s);
+#endif
+
+	return kblock_close(fb->blk) | err;
+}
+
+#endif /* CONFIG_KFILE_BLOCK_STREAM */
+
 void kfileblock_init(KFileBlock *fb, KBlock *blk)
 {
 	ASSERT(fb);
@@ -129,3 +556,34 @@ void kfileblock_init(KFileBlock *fb, KBlock *blk)
 	fb->fd.clearerr = kfileblock_clearerr;
 	fb->fd.close = kfileblock_close;
 }
+
+#if CONFIG_KFILE_BLOCK_STREAM
+
+void kfileblock_initStream(KFileBlock *fb, KBlock *blk, KFileBlockStream *stream, void *bufs, size_t nbufs)
+{
+	size_t i;
+
+	ASSERT(stream);
+	ASSERT(bufs);
+	ASSERT(nbufs >= 2 && nbufs <= KFILEBLOCK_STREAM_MAXBUFS);
+
+	kfileblock_init(fb, blk);
+	fb->fd.read = kfileblock_streamRead;
+	fb->fd.write = kfileblock_streamWrite;
+	fb->fd.flush = kfileblock_streamFlush;
+	fb->fd.close = kfileblock_streamClose;
+
+	memset(stream, 0, sizeof(*stream));
+	stream->nbufs = nbufs;
+	for (i = 0; i < nbufs; i++)
+		stream->bufs[i].data = (uint8_t *)bufs + i * blk->blk_size;
+	fb->stream = stream;
+
+#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+	sem_init(&stream->lock);
+	stream->worker = proc_new(kfileblock_worker, fb, sizeof(stream->stack), stream->stack);
+	ASSERT(stream->worker);
+#endif
+}
+
+#endif /* CONFIG_KFILE_BLOCK_STREAM */
@@ -60,20 +60,70 @@
  * kfile_read(&kfb.fd, buf, 20);
  * \endcode
  *
+ * When CONFIG_KFILE_BLOCK_STREAM is enabled, kfileblock_initStream()
+ * opens the device in streaming mode, for sequential accesses like
+ * firmware images or audio: a read fetches the following blocks
+ * too and writes are gathered in whole blocks, written back when the
+ * buffers are needed or on kfile_flush().
+ * With CONFIG_KFILE_BLOCK_STREAM_ASYNC the transfers are done by a
+ * kernel process, while the caller uses the other buffers.
+ *
  * \author Francesco Sacchi <batt@develer.com>
  * \author Daniele Basile <asterix@develer.com>
  *
  * $WIZ$ module_name = "kfile_block"
  * $WIZ$ module_depends = "kfile", "kblock"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_kfile_block.h"
  */
 
 #ifndef IO_KFILE_BLOCK_H
 #define IO_KFILE_BLOCK_H
 
+#include "cfg/cfg_kfile_block.h"
 #include <cfg/compiler.h>
 #include <io/kblock.h>
 #include <io/kfile.h>
 
+#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+	#include <kern/proc.h>
+	#include <kern/sem.h>
+#endif
+
+#if CONFIG_KFILE_BLOCK_STREAM
+
+/// Maximum number of buffers of a stream.
+#define KFILEBLOCK_STREAM_MAXBUFS 3
+
+/*
+ * Stream buffer, private.
+ */
+typedef struct KFileBlockBuf
+{
+	uint8_t *data;
+	block_idx_t idx;
+	uint8_t state;
+} KFileBlockBuf;
+
+/**
+ * Streaming mode context, \sa kfileblock_initStream().
+ */
+typedef struct KFileBlockStream
+{
+	KFileBlockBuf bufs[KFILEBLOCK_STREAM_MAXBUFS];
+	size_t nbufs;
+	size_t next;      ///< Next buffer to be replaced.
+	bool error;       ///< A background transfer failed.
+#if CONFIG_KFILE_BLOCK_STREAM_ASYNC
+	Semaphore lock;
+	struct Process *worker;
+	struct Process *waiter;
+	bool quit;
+	cpu_stack_t stack[(CONFIG_KFILE_BLOCK_STREAM_STACK + sizeof(cpu_stack_t) - 1) / sizeof(cpu_stack_t)];
+#endif
+} KFileBlockStream;
+
+#endif /* CONFIG_KFILE_BLOCK_STREAM */
+
 /**
  * KFileBlock context.
  */
@@ -81,6 +131,9 @@ typedef struct KFileBlock
 {
 	KFile fd;    ///< KFile context
 	KBlock *blk; ///< KBlock device
+#if CONFIG_KFILE_BLOCK_STREAM
+	KFileBlockStream *stream; ///< Streaming context, NULL if not streaming.
+#endif
 } KFileBlock;
 
 /**
@@ -95,6 +148,27 @@ typedef struct KFileBlock
  */
 void kfileblock_init(KFileBlock *fb, KBlock *blk);
 
+#if CONFIG_KFILE_BLOCK_STREAM
+/**
+ * Init a KFile over KBlock in streaming mode.
+ *
+ * Like kfileblock_init(), but the data goes through \a nbufs buffers
+ * of one block each, see the streaming notes above.
+ * The block device must be accessed only through \a fb, until
+ * kfile_close() is called.
+ *
+ * \note With CONFIG_KFILE_BLOCK_STREAM_ASYNC the processes waiting
+ *       for a transfer use the SIG_SYSTEM5 signal.
+ *
+ * \param fb KFileBlock context.
+ * \param blk block device to be accessed with a KFile interface.
+ * \param stream streaming context.
+ * \param bufs memory for the buffers, \a nbufs * blk->blk_size bytes.
+ * \param nbufs number of buffers, 2 or 3.
+ */
+void kfileblock_initStream(KFileBlock *fb, KBlock *blk, KFileBlockStream *stream, void *bufs, size_t nbufs);
+#endif
+
 /** \} */ //defgroup kfile_block
 
 #endif /* IO_KFILE_KBLOCK_H */
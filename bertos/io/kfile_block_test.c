@@ -0,0 +1,157 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief KFile over KBlock streaming mode test.
+ *
+ * Sequential and random accesses with odd sizes across the block
+ * boundaries, checked against the content of a RAM device.
+ *
+ * $test$: cp bertos/cfg/cfg_kfile_block.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KFILE_BLOCK_STREAM" >> $cfgdir/cfg_kfile_block.h
+ * $test$: echo "#define CONFIG_KFILE_BLOCK_STREAM 1" >> $cfgdir/cfg_kfile_block.h
+ * $test$: echo  "#undef CONFIG_KFILE_BLOCK_STREAM_ASYNC" >> $cfgdir/cfg_kfile_block.h
+ * $test$: echo "#define CONFIG_KFILE_BLOCK_STREAM_ASYNC 1" >> $cfgdir/cfg_kfile_block.h
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ */
+
+#include "kfile_block.h"
+#include "kblock_ram.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+
+#include <string.h>
+
+/* avoid compiler warnings... */
+int kfileblock_testSetup(void);
+int kfileblock_testRun(void);
+int kfileblock_testTearDown(void);
+
+#define BLK_SIZE  64
+#define BLK_CNT   16
+#define NBUFS      3
+
+static uint8_t disk[BLK_SIZE * BLK_CNT];
+static uint8_t data[BLK_SIZE * BLK_CNT];
+static uint8_t buf[BLK_SIZE * BLK_CNT];
+static uint8_t stream_bufs[BLK_SIZE * NBUFS];
+
+static KBlockRam ram;
+static KFileBlockStream stream;
+static KFileBlock fb;
+
+/* Transfer the whole device in \a chunk bytes pieces */
+static size_t stream_all(bool write, size_t chunk)
+{
+	size_t len = 0, done;
+
+	kfile_seek(&fb.fd, 0, KSM_SEEK_SET);
+	do
+	{
+		size_t size = MIN(chunk, sizeof(buf) - len);
+		done = write ? kfile_write(&fb.fd, data + len, size) : kfile_read(&fb.fd, buf + len, size);
+		len += done;
+	}
+	while (done);
+
+	return len;
+}
+
+int kfileblock_testRun(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 13 + 5;
+
+	kblockram_init(&ram, disk, sizeof(disk), BLK_SIZE, false, false);
+	kfileblock_initStream(&fb, &ram.b, &stream, stream_bufs, NBUFS);
+
+	/* Sequential write */
+	ASSERT(stream_all(true, 37) == sizeof(data));
+	ASSERT(kfile_flush(&fb.fd) == 0);
+	ASSERT(memcmp(disk, data, sizeof(data)) == 0);
+
+	/* Sequential read */
+	ASSERT(stream_all(false, 23) == sizeof(data));
+	ASSERT(memcmp(buf, data, sizeof(data)) == 0);
+	ASSERT(stream_all(false, BLK_SIZE) == sizeof(data));
+	ASSERT(memcmp(buf, data, sizeof(data)) == 0);
+
+	/* Random accesses */
+	memset(buf, 0xaa, 100);
+	kfile_seek(&fb.fd, 5 * BLK_SIZE - 10, KSM_SEEK_SET);
+	ASSERT(kfile_write(&fb.fd, buf, 100) == 100);
+	memset(data + 5 * BLK_SIZE - 10, 0xaa, 100);
+	kfile_seek(&fb.fd, 2 * BLK_SIZE + 3, KSM_SEEK_SET);
+	ASSERT(kfile_read(&fb.fd, buf, 3 * BLK_SIZE) == 3 * BLK_SIZE);
+	ASSERT(memcmp(buf, data + 2 * BLK_SIZE + 3, 3 * BLK_SIZE) == 0);
+	kfile_seek(&fb.fd, 11 * BLK_SIZE, KSM_SEEK_SET);
+	ASSERT(kfile_write(&fb.fd, data + 11 * BLK_SIZE, BLK_SIZE) == BLK_SIZE);
+
+	/* Past the end */
+	kfile_seek(&fb.fd, -10, KSM_SEEK_END);
+	ASSERT(kfile_read(&fb.fd, buf, 100) == 10);
+
+	ASSERT(kfile_close(&fb.fd) == 0);
+	ASSERT(memcmp(disk, data, sizeof(data)) == 0);
+
+	kputs("KFile block stream test finished..Ok!\n");
+	return 0;
+}
+
+int kfileblock_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int kfileblock_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kfileblock);
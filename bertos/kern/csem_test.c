@@ -0,0 +1,296 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Counting semaphore test.
+ *
+ * A bounded buffer shared by producers and consumers checks that no unit
+ * is lost or duplicated; then a pool of resources checks that no more
+ * users than units get in, and the timeout and priority wake up order
+ * are verified.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_PRI" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_PRI 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ * $test$: echo  "#undef CONFIG_KERN_SEM_PRI_ORDER" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEM_PRI_ORDER 1" >> $cfgdir/cfg_sem.h
+ */
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <kern/sem.h>
+#include <kern/proc.h>
+
+#include <drv/timer.h>
+
+#define TEST_TIME_OUT_MS  5000
+
+// Bounded buffer test
+#define BUF_SIZE        4
+#define PRODUCERS       3
+#define CONSUMERS       2
+#define ITEMS         100  /* per producer */
+
+static CountSemaphore empty_slots, full_slots;
+static Semaphore buf_lock;
+static int buf[BUF_SIZE];
+static int buf_head, buf_tail, buf_used, buf_max;
+static long consumed_sum;
+static int consumed;
+
+// Resource pool test
+#define POOL_SIZE   2
+#define POOL_USERS  5
+
+static CountSemaphore pool;
+static int pool_used, pool_max, pool_done;
+
+// Wake up order test
+static CountSemaphore order;
+static int wake_order[3], wake_count;
+
+#define TEST_STACK(name)  PROC_DEFINE_STACK(name, KERN_MINSTACKSIZE * 2)
+
+TEST_STACK(prod_stack0);
+TEST_STACK(prod_stack1);
+TEST_STACK(prod_stack2);
+TEST_STACK(cons_stack0);
+TEST_STACK(cons_stack1);
+TEST_STACK(user_stack0);
+TEST_STACK(user_stack1);
+TEST_STACK(user_stack2);
+TEST_STACK(user_stack3);
+TEST_STACK(user_stack4);
+
+static cpu_stack_t *prod_stacks[PRODUCERS] = { prod_stack0, prod_stack1, prod_stack2 };
+static cpu_stack_t *cons_stacks[CONSUMERS] = { cons_stack0, cons_stack1 };
+static cpu_stack_t *user_stacks[POOL_USERS] = { user_stack0, user_stack1, user_stack2, user_stack3, user_stack4 };
+
+static void producer(void)
+{
+	int base = (int)(ssize_t)proc_currentUserData() * ITEMS;
+	int i;
+
+	for (i = 1; i <= ITEMS; i++)
+	{
+		csem_obtain(&empty_slots);
+
+		sem_obtain(&buf_lock);
+		buf[buf_head] = base + i;
+		buf_head = (buf_head + 1) % BUF_SIZE;
+		buf_max = MAX(buf_max, ++buf_used);
+		sem_release(&buf_lock);
+
+		csem_release(&full_slots);
+		if (i % 7 == 0)
+			proc_yield();
+	}
+}
+
+static void consumer(void)
+{
+	for (;;)
+	{
+		csem_obtain(&full_slots);
+
+		sem_obtain(&buf_lock);
+		consumed_sum += buf[buf_tail];
+		consumed++;
+		buf_tail = (buf_tail + 1) % BUF_SIZE;
+		buf_used--;
+		sem_release(&buf_lock);
+
+		csem_release(&empty_slots);
+		if (consumed == PRODUCERS * ITEMS)
+			break;
+	}
+}
+
+static int csem_buf_test(void)
+{
+	ticks_t start = timer_clock();
+	long expected = 0;
+	int i;
+
+	kputs("> Main: bounded buffer test\n");
+	csem_init(&empty_slots, BUF_SIZE);
+	csem_init(&full_slots, 0);
+	sem_init(&buf_lock);
+
+	for (i = 0; i < PRODUCERS * ITEMS; i++)
+		expected += i + 1;
+
+	for (i = 0; i < PRODUCERS; i++)
+		proc_new(producer, (void *)(ssize_t)i, KERN_MINSTACKSIZE * 2, prod_stacks[i]);
+	/* Only one consumer sees the last item, the other one is left waiting */
+	for (i = 0; i < CONSUMERS; i++)
+		proc_new(consumer, NULL, KERN_MINSTACKSIZE * 2, cons_stacks[i]);
+
+	while (consumed < PRODUCERS * ITEMS)
+	{
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+		{
+			kprintf("> Main: timeout, %d items consumed\n", consumed);
+			return -1;
+		}
+		timer_delay(10);
+	}
+
+	kprintf("> Main: sum %ld, expected %ld, max used %d\n", consumed_sum, expected, buf_max);
+	if (consumed_sum != expected || buf_max > BUF_SIZE)
+		return -1;
+
+	return 0;
+}
+
+static void pool_user(void)
+{
+	csem_obtain(&pool);
+	pool_max = MAX(pool_max, ++pool_used);
+	timer_delay(20);
+	pool_used--;
+	csem_release(&pool);
+	pool_done++;
+}
+
+static int csem_pool_test(void)
+{
+	ticks_t start = timer_clock();
+	int i;
+
+	kputs("> Main: resource pool test\n");
+	csem_init(&pool, POOL_SIZE);
+
+	for (i = 0; i < POOL_USERS; i++)
+		proc_new(pool_user, NULL, KERN_MINSTACKSIZE * 2, user_stacks[i]);
+
+	while (pool_done < POOL_USERS)
+	{
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+			return -1;
+		timer_delay(10);
+	}
+
+	kprintf("> Main: max users %d of %d\n", pool_max, POOL_SIZE);
+	if (pool_max != POOL_SIZE)
+		return -1;
+
+	/* All the units are back */
+	for (i = 0; i < POOL_SIZE; i++)
+		if (!csem_attempt(&pool))
+			return -1;
+	if (csem_attempt(&pool))
+		return -1;
+
+	return 0;
+}
+
+static void order_waiter(void)
+{
+	csem_obtain(&order);
+	wake_order[wake_count++] = proc_current()->link.pri;
+}
+
+static int csem_timeout_test(void)
+{
+	ticks_t start;
+	int i;
+
+	kputs("> Main: timeout test\n");
+	csem_init(&order, 0);
+
+	start = timer_clock();
+	if (csem_obtainTimeout(&order, ms_to_ticks(100)))
+		return -1;
+	if (timer_clock() - start < ms_to_ticks(100))
+		return -1;
+	if (csem_obtainTimeout(&order, 0))
+		return -1;
+
+	/* Waiters queue up with mixed priorities, wake up highest first */
+	kputs("> Main: wake up order test\n");
+	for (i = 0; i < 3; i++)
+	{
+		struct Process *p = proc_new(order_waiter, NULL,
+			KERN_MINSTACKSIZE * 2, user_stacks[i]);
+		proc_setPri(p, (i * 2) % 3 - 3);
+	}
+	/* Let them all block */
+	timer_delay(10);
+
+	for (i = 0; i < 3; i++)
+	{
+		csem_release(&order);
+		timer_delay(10);
+	}
+
+	kprintf("> Main: wake up order %d %d %d\n", wake_order[0], wake_order[1], wake_order[2]);
+	if (wake_count != 3)
+		return -1;
+	#if CONFIG_KERN_SEM_PRI_ORDER
+		if (wake_order[0] < wake_order[1] || wake_order[1] < wake_order[2])
+			return -1;
+	#endif
+
+	return 0;
+}
+
+int csem_testRun(void)
+{
+	if (csem_buf_test() || csem_pool_test() || csem_timeout_test())
+	{
+		kputs("> Main: Counting semaphore test failed..\n");
+		return -1;
+	}
+
+	kputs("> Main: Counting semaphore test finished..Ok!\n");
+	return 0;
+}
+
+int csem_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int csem_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(csem);
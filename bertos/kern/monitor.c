@@ -112,14 +112,65 @@ size_t monitor_checkStack(cpu_stack_t *stack_base, size_t stack_size)
 }
 
 
+#if CONFIG_KERN_MONITOR_STATS
+
+/// Convert \a hp high precision timer units to ms.
+#define MONITOR_HP_TO_MS(hp) \
+	((unsigned long)((hp) / (TIMER_HW_HPTICKS_PER_SEC / 1000)))
+
+int monitor_stats(MonitorStats *stats, int max)
+{
+	Node *node;
+	int n = 0;
+
+	proc_forbid();
+	FOREACH_NODE(node, &MonitorProcs)
+	{
+		Process *p = containerof(node, Process, monitor.link);
+
+		if (n == max)
+			break;
+
+		stats[n].proc = p;
+		stats[n].name = p->monitor.name;
+		/* Counters are updated by the scheduler, even from interrupts */
+		ATOMIC(
+			stats[n].run_time = p->monitor.run_time;
+			stats[n].last_run = p->monitor.last_run;
+			stats[n].vol_switches = p->monitor.vol_switches;
+			stats[n].invol_switches = p->monitor.invol_switches;
+		);
+		n++;
+	}
+	proc_permit();
+
+	return n;
+}
+
+uint64_t monitor_idleTime(void)
+{
+	uint64_t idle;
+
+	ATOMIC(idle = proc_idle_time);
+	return idle;
+}
+
+#endif /* CONFIG_KERN_MONITOR_STATS */
+
 void monitor_report(void)
 {
 	Node *node;
 	int i;
 
 	proc_forbid();
+#if CONFIG_KERN_MONITOR_STATS
+	kprintf("%-9s%-9s%-9s%-9s%-9s%-9s%-9s%s\n", "TCB", "SPbase", "SPsize", "SPfree",
+		"Run[ms]", "Vol", "Invol", "Name");
+	for (i = 0; i < 83; i++)
+#else
 	kprintf("%-9s%-9s%-9s%-9s%s\n", "TCB", "SPbase", "SPsize", "SPfree", "Name");
 	for (i = 0; i < 56; i++)
+#endif
 		kputchar('-');
 	kputchar('\n');
 
@@ -127,9 +178,27 @@ void monitor_report(void)
 	{
 		Process *p = containerof(node, Process, monitor.link);
 		size_t free = monitor_checkStack(p->stack_base, p->stack_size);
+	#if CONFIG_KERN_MONITOR_STATS
+		uint64_t run_time;
+		uint32_t vol, invol;
+
+		ATOMIC(
+			run_time = p->monitor.run_time;
+			vol = p->monitor.vol_switches;
+			invol = p->monitor.invol_switches;
+		);
+		kprintf("%-9p%-9p%-9zu%-9zu%-9lu%-9lu%-9lu%s\n",
+			p, p->stack_base, p->stack_size, free,
+			MONITOR_HP_TO_MS(run_time), (unsigned long)vol,
+			(unsigned long)invol, p->monitor.name);
+	#else
 		kprintf("%-9p%-9p%-9zu%-9zu%s\n",
 			p, p->stack_base, p->stack_size, free, p->monitor.name);
+	#endif
 	}
+#if CONFIG_KERN_MONITOR_STATS
+	kprintf("Idle: %lu ms\n", MONITOR_HP_TO_MS(monitor_idleTime()));
+#endif
 	proc_permit();
 }
 
@@ -74,4 +74,42 @@ size_t monitor_checkStack(cpu_stack_t *stack_base, size_t stack_size);
 /** Print a report of the stack status through kdebug */
 void monitor_report(void);
 
+#if CONFIG_KERN_MONITOR_STATS
+
+struct Process;
+
+/**
+ * Accounting data of a monitored process.
+ *
+ * Times are expressed in high precision timer units (see
+ * TIMER_HW_HPTICKS_PER_SEC): compare two snapshots to compute the CPU
+ * usage over an interval. Run times are 64 bit wide, so they do not wrap
+ * around in practice, while last_run is a 32 bit timestamp.
+ */
+typedef struct MonitorStats
+{
+	const struct Process *proc;
+	const char *name;
+	uint64_t run_time;       ///< CPU time used so far.
+	uint32_t last_run;       ///< When the process was last running.
+	uint32_t vol_switches;   ///< Switches while waiting or yielding.
+	uint32_t invol_switches; ///< Switches by preemption.
+} MonitorStats;
+
+/**
+ * Take a snapshot of the accounting data of up to \a max monitored
+ * processes.
+ *
+ * \note The slice being used by the running process is charged at its
+ *       next context switch.
+ *
+ * \return The number of entries filled in \a stats.
+ */
+int monitor_stats(MonitorStats *stats, int max);
+
+/** Return the time spent with no process ready to run. */
+uint64_t monitor_idleTime(void);
+
+#endif /* CONFIG_KERN_MONITOR_STATS */
+
 #endif /* KERN_MONITOR_H */
@@ -0,0 +1,203 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Bounded message queues (implementation).
+ *
+ * The free and used slots are counted by two CountSemaphores, which
+ * also keep the sleeping senders and receivers. Once a process owns a
+ * unit of the right semaphore, the slot it reads or writes is guaranteed
+ * to be there, so the ring itself only needs to be protected against
+ * concurrent copies.
+ */
+
+#include "msg.h"
+
+#include <cfg/debug.h>
+
+#include <cpu/irq.h>
+
+#include <string.h> /* memcpy() */
+
+/**
+ * Initialize a message queue.
+ *
+ * \param q Queue to initialize.
+ * \param buf Storage for the slots, at least \a msg_size * \a slots bytes.
+ * \param msg_size Size of each message.
+ * \param slots Number of messages the queue can hold.
+ */
+void msgq_init(MsgQueue *q, void *buf, size_t msg_size, size_t slots)
+{
+	ASSERT(buf);
+	ASSERT(msg_size);
+	ASSERT(slots);
+
+	csem_init(&q->free, slots);
+	csem_init(&q->used, 0);
+	q->buf = (uint8_t *)buf;
+	q->msg_size = msg_size;
+	q->slots = slots;
+	q->head = q->tail = q->count = 0;
+}
+
+/* Copy \a msg in the next slot, the caller owns a free slot. */
+static void msgq_put(MsgQueue *q, const void *msg)
+{
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	ASSERT(q->count < q->slots);
+	memcpy(q->buf + q->tail * q->msg_size, msg, q->msg_size);
+	if (++q->tail == q->slots)
+		q->tail = 0;
+	q->count++;
+	KTRACE(TRACE_MSG_PUT, q, q->count);
+	IRQ_RESTORE(flags);
+}
+
+/* Copy the oldest message to \a msg, the caller owns a used slot. */
+static void msgq_get(MsgQueue *q, void *msg)
+{
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	ASSERT(q->count > 0);
+	memcpy(msg, q->buf + q->head * q->msg_size, q->msg_size);
+	if (++q->head == q->slots)
+		q->head = 0;
+	q->count--;
+	KTRACE(TRACE_MSG_GET, q, q->count);
+	IRQ_RESTORE(flags);
+}
+
+/**
+ * Copy \a msg into \a q, waiting for a free slot if the queue is full.
+ */
+void msgq_send(MsgQueue *q, const void *msg)
+{
+	csem_obtain(&q->free);
+	msgq_put(q, msg);
+	csem_release(&q->used);
+}
+
+/**
+ * Copy \a msg into \a q if there is a free slot.
+ *
+ * \return true if the message has been queued, false if the queue is full.
+ */
+bool msgq_trySend(MsgQueue *q, const void *msg)
+{
+	if (!csem_attempt(&q->free))
+		return false;
+
+	msgq_put(q, msg);
+	csem_release(&q->used);
+	return true;
+}
+
+/**
+ * Copy \a msg into \a q from IRQ context.
+ *
+ * Like msgq_trySend(), but a receiver waiting on the queue is only made
+ * ready to run.
+ *
+ * \return true if the message has been queued, false if the queue is full.
+ */
+bool msgq_post(MsgQueue *q, const void *msg)
+{
+	if (!csem_attempt(&q->free))
+		return false;
+
+	msgq_put(q, msg);
+	csem_post(&q->used);
+	return true;
+}
+
+/**
+ * Move the oldest message of \a q to \a msg, waiting for one
+ * if the queue is empty.
+ */
+void msgq_recv(MsgQueue *q, void *msg)
+{
+	csem_obtain(&q->used);
+	msgq_get(q, msg);
+	csem_release(&q->free);
+}
+
+/**
+ * Move the oldest message of \a q to \a msg, if there is one.
+ *
+ * \return true if a message has been received, false if the queue is empty.
+ */
+bool msgq_tryRecv(MsgQueue *q, void *msg)
+{
+	if (!csem_attempt(&q->used))
+		return false;
+
+	msgq_get(q, msg);
+	csem_release(&q->free);
+	return true;
+}
+
+#if CONFIG_TIMER_EVENTS
+
+/**
+ * Copy \a msg into \a q, waiting at most \a timeout ticks for a free slot.
+ *
+ * \return true if the message has been queued, false on timeout.
+ */
+bool msgq_sendTimeout(MsgQueue *q, const void *msg, ticks_t timeout)
+{
+	if (!csem_obtainTimeout(&q->free, timeout))
+		return false;
+
+	msgq_put(q, msg);
+	csem_release(&q->used);
+	return true;
+}
+
+/**
+ * Move the oldest message of \a q to \a msg, waiting at most
+ * \a timeout ticks for one.
+ *
+ * \return true if a message has been received, false on timeout.
+ */
+bool msgq_recvTimeout(MsgQueue *q, void *msg, ticks_t timeout)
+{
+	if (!csem_obtainTimeout(&q->used, timeout))
+		return false;
+
+	msgq_get(q, msg);
+	csem_release(&q->free);
+	return true;
+}
+
+#endif /* CONFIG_TIMER_EVENTS */
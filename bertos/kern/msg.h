@@ -178,10 +178,43 @@
  *	}
  * \endcode
  *
+ * <h3>Message queues</h3>
+ *
+ * A MsgQueue is a bounded alternative to message ports: messages are
+ * copied by value into a ring of fixed size slots provided by the
+ * caller, so no message is ever allocated and the sender can reuse its
+ * buffer as soon as msgq_send() returns.
+ *
+ * When the queue is full senders sleep in msgq_send() until a slot is
+ * freed, when it is empty receivers sleep in msgq_recv(). Both have
+ * timeout and non-blocking variants; interrupts can queue messages
+ * with msgq_post(), which never blocks.
+ *
+ * \code
+ *	typedef struct Sample { uint16_t ch, value; } Sample;
+ *
+ *	static Sample sample_buf[16];
+ *	static MsgQueue samples;
+ *
+ *	msgq_init(&samples, sample_buf, sizeof(Sample), countof(sample_buf));
+ *
+ *	// Interrupt handler
+ *	Sample s = { ADC_CH, adc_read() };
+ *	msgq_post(&samples, &s);
+ *
+ *	// Process
+ *	Sample s;
+ *	if (msgq_recvTimeout(&samples, &s, ms_to_ticks(100)))
+ *		process(&s);
+ * \endcode
+ *
+ * Messages are copied with interrupts disabled, so slots should be
+ * kept small: queue pointers to bigger buffers.
+ *
  * \author Bernie Innocenti <bernie@codewiz.org>
  *
  * $WIZ$ module_name = "msg"
- * $WIZ$ module_depends = "event", "signal", "kernel"
+ * $WIZ$ module_depends = "event", "signal", "kernel", "semaphores"
  */
 
 
@@ -191,6 +224,10 @@
 #include <mware/event.h>
 #include <struct/list.h>
 #include <kern/proc.h>
+#include <kern/sem.h>
+#include <kern/trace.h>
+
+#include "cfg/cfg_timer.h"
 
 typedef struct MsgPort
 {
@@ -251,6 +288,7 @@ INLINE void msg_put(MsgPort *port, Msg *msg)
 	msg_lockPort(port);
 	ADDTAIL(&port->queue, &msg->link);
 	msg_unlockPort(port);
+	KTRACE(TRACE_MSG_PUT, port, 0);
 
 	event_do(&port->event);
 }
@@ -267,6 +305,7 @@ INLINE Msg *msg_get(MsgPort *port)
 	msg_lockPort(port);
 	msg = (Msg *)list_remHead(&port->queue);
 	msg_unlockPort(port);
+	KTRACE(TRACE_MSG_GET, port, msg != NULL);
 
 	return msg;
 }
@@ -291,10 +330,57 @@ INLINE void msg_reply(Msg *msg)
 	msg_put(msg->replyPort, msg);
 }
 
+
+/**
+ * Bounded message queue.
+ *
+ * \see msgq_init()
+ */
+typedef struct MsgQueue
+{
+	CountSemaphore free;     /**< Empty slots. */
+	CountSemaphore used;     /**< Queued messages. */
+	uint8_t       *buf;      /**< Ring of slots. */
+	size_t         msg_size; /**< Size of a slot. */
+	size_t         slots;    /**< Number of slots. */
+	size_t         head;     /**< Next slot to read. */
+	size_t         tail;     /**< Next slot to write. */
+	size_t         count;    /**< Number of queued messages. */
+} MsgQueue;
+
+/**
+ * \name Message queues
+ * \{
+ */
+void msgq_init(MsgQueue *q, void *buf, size_t msg_size, size_t slots);
+
+void msgq_send(MsgQueue *q, const void *msg);
+bool msgq_trySend(MsgQueue *q, const void *msg);
+bool msgq_post(MsgQueue *q, const void *msg);
+
+void msgq_recv(MsgQueue *q, void *msg);
+bool msgq_tryRecv(MsgQueue *q, void *msg);
+
+#if CONFIG_TIMER_EVENTS
+bool msgq_sendTimeout(MsgQueue *q, const void *msg, ticks_t timeout);
+bool msgq_recvTimeout(MsgQueue *q, void *msg, ticks_t timeout);
+#endif
+
+/** Return the number of messages queued in \a q. */
+INLINE size_t msgq_count(MsgQueue *q)
+{
+	return q->count;
+}
+/* \} */
+
 /** \} */ //defgroup kern_msg
 
 int msg_testRun(void);
 int msg_testSetup(void);
 int msg_testTearDown(void);
 
+int msgq_testRun(void);
+int msgq_testSetup(void);
+int msgq_testTearDown(void);
+
 #endif /* KERN_MSG_H */
@@ -0,0 +1,264 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Bounded message queue test.
+ *
+ * Checks the FIFO order and the copy semantics of the queue, the
+ * blocking of senders on a full queue with several producers, the
+ * timeouts and the posting of messages from a timer interrupt.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ */
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <kern/msg.h>
+#include <kern/proc.h>
+
+#include <drv/timer.h>
+
+#include <string.h>
+
+#define TEST_TIME_OUT_MS  5000
+
+typedef struct TestMsg
+{
+	int  seq;
+	char text[6];
+} TestMsg;
+
+#define SLOTS      4
+#define PRODUCERS  3
+#define ITEMS    100  /* per producer */
+
+static TestMsg slots[SLOTS];
+static MsgQueue queue;
+static int sent;
+
+#define TEST_STACK(name)  PROC_DEFINE_STACK(name, KERN_MINSTACKSIZE * 2)
+
+TEST_STACK(prod_stack0);
+TEST_STACK(prod_stack1);
+TEST_STACK(prod_stack2);
+
+static cpu_stack_t *prod_stacks[PRODUCERS] = { prod_stack0, prod_stack1, prod_stack2 };
+
+static int msgq_fifo_test(void)
+{
+	TestMsg msg;
+	int i;
+
+	kputs("> Main: FIFO test\n");
+	msgq_init(&queue, slots, sizeof(TestMsg), SLOTS);
+
+	for (i = 0; i < SLOTS; i++)
+	{
+		msg.seq = i;
+		strcpy(msg.text, "hello");
+		if (!msgq_trySend(&queue, &msg))
+			return -1;
+		/* The queue keeps its own copy */
+		memset(&msg, 0, sizeof(msg));
+	}
+	if (msgq_trySend(&queue, &msg) || msgq_count(&queue) != SLOTS)
+		return -1;
+
+	for (i = 0; i < SLOTS; i++)
+	{
+		if (!msgq_tryRecv(&queue, &msg))
+			return -1;
+		if (msg.seq != i || strcmp(msg.text, "hello"))
+			return -1;
+	}
+	if (msgq_tryRecv(&queue, &msg) || msgq_count(&queue))
+		return -1;
+
+	return 0;
+}
+
+static void producer(void)
+{
+	TestMsg msg;
+	int i;
+
+	msg.seq = (int)(ssize_t)proc_currentUserData() * ITEMS;
+	for (i = 1; i <= ITEMS; i++)
+	{
+		msg.seq++;
+		msgq_send(&queue, &msg);
+		sent++;
+	}
+}
+
+static int msgq_block_test(void)
+{
+	ticks_t start = timer_clock();
+	long sum = 0, expected = 0;
+	int last[PRODUCERS] = { 0 };
+	int received, max_count = 0;
+	TestMsg msg;
+	int i;
+
+	kputs("> Main: producers/consumer test\n");
+	msgq_init(&queue, slots, sizeof(TestMsg), SLOTS);
+
+	for (i = 0; i < PRODUCERS; i++)
+		proc_new(producer, (void *)(ssize_t)i, KERN_MINSTACKSIZE * 2, prod_stacks[i]);
+
+	for (received = 0; received < PRODUCERS * ITEMS; received++)
+	{
+		/* Fall behind now and then, so that the producers block */
+		if (received % 50 == 0)
+			timer_delay(10);
+		max_count = MAX(max_count, (int)msgq_count(&queue));
+		if (!msgq_recvTimeout(&queue, &msg, ms_to_ticks(TEST_TIME_OUT_MS)))
+			return -1;
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+			return -1;
+
+		/* Messages from the same producer arrive in order */
+		i = (msg.seq - 1) / ITEMS;
+		if (msg.seq <= last[i])
+			return -1;
+		last[i] = msg.seq;
+		sum += msg.seq;
+		expected += received + 1;
+	}
+
+	kprintf("> Main: sum %ld, expected %ld, max queued %d\n", sum, expected, max_count);
+	if (sum != expected || sent != PRODUCERS * ITEMS || max_count != SLOTS)
+		return -1;
+
+	return 0;
+}
+
+static int msgq_timeout_test(void)
+{
+	ticks_t start;
+	TestMsg msg;
+	int i;
+
+	kputs("> Main: timeout test\n");
+	msgq_init(&queue, slots, sizeof(TestMsg), SLOTS);
+
+	start = timer_clock();
+	if (msgq_recvTimeout(&queue, &msg, ms_to_ticks(100)))
+		return -1;
+	if (timer_clock() - start < ms_to_ticks(100))
+		return -1;
+
+	for (i = 0; i < SLOTS; i++)
+		if (!msgq_sendTimeout(&queue, &msg, ms_to_ticks(100)))
+			return -1;
+	start = timer_clock();
+	if (msgq_sendTimeout(&queue, &msg, ms_to_ticks(100)))
+		return -1;
+	if (timer_clock() - start < ms_to_ticks(100))
+		return -1;
+
+	return 0;
+}
+
+static int posted;
+
+static void post_callback(UNUSED_ARG(iptr_t, data))
+{
+	TestMsg msg;
+
+	msg.seq = ++posted;
+	msgq_post(&queue, &msg);
+}
+
+static int msgq_post_test(void)
+{
+	Timer t;
+	TestMsg msg;
+	int i;
+
+	kputs("> Main: post from interrupt test\n");
+	msgq_init(&queue, slots, sizeof(TestMsg), SLOTS);
+	timer_setSoftint(&t, post_callback, NULL);
+
+	for (i = 1; i <= 3; i++)
+	{
+		timer_setDelay(&t, ms_to_ticks(20));
+		timer_add(&t);
+		msgq_recv(&queue, &msg);
+		if (msg.seq != i)
+			return -1;
+	}
+
+	/* A full queue drops the message */
+	for (i = 0; i < SLOTS; i++)
+		if (!msgq_trySend(&queue, &msg))
+			return -1;
+	timer_setDelay(&t, ms_to_ticks(20));
+	timer_add(&t);
+	timer_delay(50);
+	if (posted != 4 || msgq_count(&queue) != SLOTS)
+		return -1;
+
+	return 0;
+}
+
+int msgq_testRun(void)
+{
+	if (msgq_fifo_test() || msgq_block_test() || msgq_timeout_test()
+			|| msgq_post_test())
+	{
+		kputs("> Main: Message queue test failed..\n");
+		return -1;
+	}
+
+	kputs("> Main: Message queue test finished..Ok!\n");
+	return 0;
+}
+
+int msgq_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int msgq_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(msgq);
@@ -103,6 +103,8 @@
 #include <cpu/attr.h>
 #include <cpu/frame.h>
 
+#include <kern/trace.h>
+
 #if CONFIG_KERN_HEAP
 	#include <struct/heap.h>
 #endif
@@ -111,13 +113,22 @@
 
 #define PROC_SIZE_WORDS (ROUND_UP2(sizeof(Process), sizeof(cpu_stack_t)) / sizeof(cpu_stack_t))
 
+/* Size of the memory block holding the stack and the PCB of \a proc */
+#define PROC_ALLOC_SIZE(proc) ((proc)->stack_size + PROC_SIZE_WORDS * sizeof(cpu_stack_t))
+
+CONFIG_DEPEND(CONFIG_KERN_STACK_POOL, CONFIG_KERN_HEAP);
+
 /*
  * The scheduer tracks ready processes by enqueuing them in the
  * ready list.
  *
  * \note Access to the list must occur while interrupts are disabled.
  */
+#if CONFIG_KERN_PRI && CONFIG_KERN_PRI_BITMAP
+REGISTER ReadyQueue proc_ready_queue;
+#else
 REGISTER List proc_ready_list;
+#endif
 
 /*
  * Holds a pointer to the TCB of the currently running process.
@@ -145,6 +156,21 @@ static Heap proc_heap;
  */
 static List zombie_list;
 
+#if CONFIG_KERN_STACK_POOL
+/*
+ * Stacks of exited processes waiting to be reused, one list for each
+ * stack size. The sizes are assigned to the entries in order of
+ * appearance, so the unused entries are at the end.
+ *
+ * \note Access to the lists must occur while kernel preemption is disabled.
+ */
+static struct
+{
+	size_t size;
+	List   free;
+} stack_pool[CONFIG_KERN_STACK_POOL_SIZES];
+#endif
+
 #endif /* CONFIG_KERN_HEAP */
 
 /*
@@ -160,6 +186,62 @@ static List zombie_list;
  */
 #define CONTEXT_SWITCH_FROM_ISR()	(!IRQ_RUNNING())
 
+#if CONFIG_KERN_MONITOR && CONFIG_KERN_MONITOR_STATS
+
+/* Start of the time slice not yet charged to anybody */
+static uint32_t proc_stats_stamp;
+
+/* Set when the running process is being switched out by preemption */
+static bool proc_stats_preempted;
+
+uint64_t proc_idle_time;
+
+/*
+ * Charge the time elapsed since the last call to \a proc, or to the
+ * idle time if \a proc is NULL.
+ */
+INLINE void proc_statsCharge(Process *proc)
+{
+	uint32_t now = timer_hpclock_unlocked();
+
+	if (proc)
+	{
+		proc->monitor.run_time += now - proc_stats_stamp;
+		proc->monitor.last_run = now;
+	}
+	else
+		proc_idle_time += now - proc_stats_stamp;
+
+	proc_stats_stamp = now;
+}
+
+/*
+ * Account a context switch from \a prev to \a next, once the time has
+ * been charged.
+ */
+INLINE void proc_statsSwitch(Process *next, Process *prev)
+{
+	if (prev)
+	{
+		if (proc_stats_preempted)
+			prev->monitor.invol_switches++;
+		else
+			prev->monitor.vol_switches++;
+	}
+	proc_stats_preempted = false;
+	next->monitor.last_run = proc_stats_stamp;
+}
+
+#define PROC_STATS_PREEMPT()  (proc_stats_preempted = true)
+
+#else
+
+#define proc_statsCharge(proc)        do { (void)(proc); } while (0)
+#define proc_statsSwitch(next, prev)  do {} while (0)
+#define PROC_STATS_PREEMPT()          do {} while (0)
+
+#endif /* CONFIG_KERN_MONITOR && CONFIG_KERN_MONITOR_STATS */
+
 /*
  * Save context of old process and switch to new process.
   */
@@ -199,6 +281,16 @@ static void proc_initStruct(Process *proc)
 	proc->inh_blocked_by = NULL;
 	LIST_INIT(&proc->inh_list);
 # endif
+# if CONFIG_KERN_PRI_BITMAP
+	proc->ready_level = SCHED_LEVEL_NONE;
+# endif
+#endif
+
+#if CONFIG_KERN_MONITOR && CONFIG_KERN_MONITOR_STATS
+	proc->monitor.run_time = 0;
+	proc->monitor.last_run = 0;
+	proc->monitor.vol_switches = 0;
+	proc->monitor.invol_switches = 0;
 #endif
 }
 
@@ -206,11 +298,28 @@ MOD_DEFINE(proc);
 
 void proc_init(void)
 {
+#if (CONFIG_KERN_PRI && CONFIG_KERN_PRI_BITMAP) || CONFIG_KERN_STACK_POOL
+	int i;
+#endif
+
+#if CONFIG_KERN_PRI && CONFIG_KERN_PRI_BITMAP
+	proc_ready_queue.bitmap = 0;
+	for (i = 0; i < CONFIG_KERN_PRI_LEVELS; i++)
+		LIST_INIT(&proc_ready_queue.level[i]);
+#else
 	LIST_INIT(&proc_ready_list);
+#endif
 
 #if CONFIG_KERN_HEAP
 	LIST_INIT(&zombie_list);
 	heap_init(&proc_heap, heap_buf, sizeof(heap_buf));
+#endif
+#if CONFIG_KERN_STACK_POOL
+	for (i = 0; i < CONFIG_KERN_STACK_POOL_SIZES; i++)
+	{
+		stack_pool[i].size = 0;
+		LIST_INIT(&stack_pool[i].free);
+	}
 #endif
 	/*
 	 * We "promote" the current context into a real process. The only thing we have
@@ -223,6 +332,9 @@ void proc_init(void)
 #if CONFIG_KERN_MONITOR
 	monitor_init();
 	monitor_add(current_process, "main");
+#endif
+#if CONFIG_KERN_MONITOR && CONFIG_KERN_MONITOR_STATS
+	ATOMIC(proc_stats_stamp = timer_hpclock_unlocked());
 #endif
 	MOD_INIT(proc);
 }
@@ -247,11 +359,123 @@ static void proc_freeZombies(void)
 		if (proc->flags & PF_FREESTACK)
 		{
 			PROC_ATOMIC(heap_freemem(&proc_heap, proc->stack_base,
-				proc->stack_size + PROC_SIZE_WORDS * sizeof(cpu_stack_t)));
+				PROC_ALLOC_SIZE(proc)));
 		}
 	}
 }
 
+#if CONFIG_KERN_STACK_POOL
+
+/*
+ * Return the list of free stacks of \a size bytes, taking a free
+ * entry of the pool if \a add is true and there is no such list yet.
+ */
+static List *stack_poolFind(size_t size, bool add)
+{
+	size_t i;
+
+	for (i = 0; i < countof(stack_pool); i++)
+	{
+		if (stack_pool[i].size == size)
+			return &stack_pool[i].free;
+		if (!stack_pool[i].size)
+		{
+			if (!add)
+				break;
+			stack_pool[i].size = size;
+			return &stack_pool[i].free;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Take a stack of \a size bytes from the pool.
+ *
+ * \return The stack or NULL if there are no stacks of that size.
+ */
+static cpu_stack_t *stack_poolGet(size_t size)
+{
+	cpu_stack_t *stack_base = NULL;
+	List *free;
+	Process *proc;
+
+	proc_forbid();
+	if ((free = stack_poolFind(size, false))
+			&& (proc = (Process *)list_remHead(free)))
+		stack_base = proc->stack_base;
+	proc_permit();
+
+	return stack_base;
+}
+
+/*
+ * Keep the stack of the exited process \a proc for reuse,
+ * \a node is its scheduling list node.
+ *
+ * \return false if there is no room for its size.
+ */
+static bool stack_poolPut(Process *proc, Node *node)
+{
+	List *free = stack_poolFind(PROC_ALLOC_SIZE(proc), true);
+
+	if (!free)
+		return false;
+
+	ADDHEAD(free, node);
+	return true;
+}
+
+/*
+ * Give all the pooled stacks back to the heap.
+ */
+static void stack_poolFlush(void)
+{
+	Process *proc;
+	size_t i;
+
+	for (i = 0; i < countof(stack_pool); i++)
+	{
+		while (1)
+		{
+			PROC_ATOMIC(proc = (Process *)list_remHead(&stack_pool[i].free));
+			if (proc == NULL)
+				break;
+
+			PROC_ATOMIC(heap_freemem(&proc_heap, proc->stack_base,
+				PROC_ALLOC_SIZE(proc)));
+		}
+	}
+}
+
+#endif /* CONFIG_KERN_STACK_POOL */
+
+/*
+ * Allocate the memory for the stack and the PCB of a new process.
+ */
+static cpu_stack_t *proc_allocStack(size_t size)
+{
+	cpu_stack_t *stack_base;
+
+#if CONFIG_KERN_STACK_POOL
+	if ((stack_base = stack_poolGet(size)))
+		return stack_base;
+#endif
+
+	PROC_ATOMIC(stack_base = (cpu_stack_t *)heap_allocmem(&proc_heap, size));
+
+#if CONFIG_KERN_STACK_POOL
+	/* The memory may be sitting in the pool in stacks of other sizes */
+	if (!stack_base)
+	{
+		stack_poolFlush();
+		PROC_ATOMIC(stack_base = (cpu_stack_t *)heap_allocmem(&proc_heap, size));
+	}
+#endif
+
+	return stack_base;
+}
+
 /**
  * Enqueue a process in the zombie list.
  */
@@ -266,6 +490,10 @@ static void proc_addZombie(Process *proc)
 	node = &(proc)->link.link;
 #else
 	node = &(proc)->link;
+#endif
+#if CONFIG_KERN_STACK_POOL
+	if ((proc->flags & PF_FREESTACK) && stack_poolPut(proc, node))
+		return;
 #endif
 	LIST_ASSERT_VALID(&zombie_list);
 	ADDTAIL(&zombie_list, node);
@@ -317,9 +545,8 @@ struct Process *proc_new_with_name(UNUSED_ARG(const char *, name), void (*entry)
 		if (!stack_size)
 			stack_size = KERN_MINSTACKSIZE;
 
-		/* Allocate stack dinamically */
-		PROC_ATOMIC(stack_base =
-			(cpu_stack_t *)heap_allocmem(&proc_heap, stack_size));
+		/* Allocate stack dinamically, or recycle a pooled one */
+		stack_base = proc_allocStack(stack_size);
 		if (stack_base == NULL)
 			return NULL;
 
@@ -442,6 +669,10 @@ void proc_rename(struct Process *proc, const char *name)
  * To avoid interfering with system background activities such as input
  * processing, application processes should remain within the range -10
  * and +10.
+ *
+ * \note With CONFIG_KERN_PRI_BITMAP, priorities outside the range
+ * SCHED_PRI_MIN..SCHED_PRI_MAX share the lowest or the highest ready queue
+ * level and are scheduled in FIFO order among themselves.
  */
 void proc_setPri(struct Process *proc, int pri)
 {
@@ -535,13 +766,22 @@ void proc_exit(void)
 static void proc_schedule(void)
 {
 	Process *old_process = current_process;
+	Process *charged = old_process;
 
 	IRQ_ASSERT_DISABLED();
 
 	/* Poll on the ready queue for the first ready process */
-	LIST_ASSERT_VALID(&proc_ready_list);
-	while (!(current_process = (struct Process *)list_remHead(&proc_ready_list)))
+	SCHED_ASSERT_VALID();
+	while (!(current_process = sched_dequeue()))
 	{
+		/* Time spent idle-spinning is not charged to any process */
+		if (charged)
+		{
+			proc_statsCharge(charged);
+			KTRACE(TRACE_SWITCH, NULL, 0);
+			charged = NULL;
+		}
+
 		/*
 		 * Make sure we physically reenable interrupts here, no matter what
 		 * the current task status is. This is important because if we
@@ -562,6 +802,13 @@ static void proc_schedule(void)
 		MEMORY_BARRIER;
 		IRQ_DISABLE;
 	}
+	proc_statsCharge(charged);
+	if (current_process != old_process)
+		proc_statsSwitch(current_process, old_process);
+	/* Coming back from idle is a switch too */
+	if (current_process != old_process || !charged)
+		KTRACE(TRACE_SWITCH, current_process, 0);
+
 	if (CONTEXT_SWITCH_FROM_ISR())
 		proc_context_switch(current_process, old_process);
 	/* This RET resumes the execution on the new process */
@@ -588,7 +835,7 @@ bool proc_needPreempt(void)
 		return false;
 	if (!proc_preemptAllowed())
 		return false;
-	if (LIST_EMPTY(&proc_ready_list))
+	if (SCHED_EMPTY())
 		return false;
 	return preempt_quantum() ? prio_next() > prio_curr() :
 			prio_next() >= prio_curr();
@@ -607,6 +854,8 @@ void proc_preempt(void)
 	/* We are inside a IRQ context, so ATOMIC is not needed here */
 	SCHED_ENQUEUE(current_process);
 	preempt_reset_quantum();
+	PROC_STATS_PREEMPT();
+	KTRACE(TRACE_PREEMPT, current_process, 0);
 	proc_schedule();
 }
 #endif /* CONFIG_KERN_PREEMPT */
@@ -619,6 +868,9 @@ static void proc_switchTo(Process *proc)
 	SCHED_ENQUEUE(current_process);
 	preempt_reset_quantum();
 	current_process = proc;
+	proc_statsCharge(old_process);
+	proc_statsSwitch(current_process, old_process);
+	KTRACE(TRACE_SWITCH, current_process, 0);
 	proc_context_switch(current_process, old_process);
 }
 
@@ -649,7 +901,10 @@ void proc_wakeup(Process *proc)
 	IRQ_ASSERT_DISABLED();
 
 	if (prio_proc(proc) >= prio_curr())
+	{
+		PROC_STATS_PREEMPT();
 		proc_switchTo(proc);
+	}
 	else
 		SCHED_ENQUEUE_HEAD(proc);
 }
@@ -671,7 +926,7 @@ void proc_yield(void)
 	IRQ_ASSERT_ENABLED();
 
 	IRQ_DISABLE;
-	proc = (struct Process *)list_remHead(&proc_ready_list);
+	proc = sched_dequeue();
 	if (proc)
 		proc_switchTo(proc);
 	IRQ_ENABLE;
@@ -111,6 +111,15 @@
 #ifndef CONFIG_KERN_PRI_INHERIT
 #define CONFIG_KERN_PRI_INHERIT 0
 #endif
+#ifndef CONFIG_KERN_PRI_BITMAP
+#define CONFIG_KERN_PRI_BITMAP 0
+#endif
+#ifndef CONFIG_KERN_MONITOR_STATS
+#define CONFIG_KERN_MONITOR_STATS 0
+#endif
+#ifndef CONFIG_KERN_STACK_POOL
+#define CONFIG_KERN_STACK_POOL 0
+#endif
 
 /*
  * WARNING: struct Process is considered private, so its definition can change any time
@@ -126,9 +135,12 @@ typedef struct Process
 # if CONFIG_KERN_PRI_INHERIT
 	PriNode      inh_link;    /**< Link Process into priority inheritance lists */
 	List         inh_list;    /**< Priority inheritance list for this Process */
-	Semaphore    *inh_blocked_by;  /**< Semaphore blocking this Process */
+	struct Process **inh_blocked_by; /**< Owner field of the lock blocking this Process */
 	int          orig_pri;    /**< Process priority without considering inheritance */
 # endif
+# if CONFIG_KERN_PRI_BITMAP
+	uint8_t      ready_level; /**< Ready queue level, SCHED_LEVEL_NONE if not ready */
+# endif
 #else
 	Node         link;        /**< Link Process into scheduler lists */
 #endif
@@ -156,6 +168,12 @@ typedef struct Process
 	{
 		Node        link;
 		const char *name;
+	# if CONFIG_KERN_MONITOR_STATS
+		uint64_t    run_time;       /**< Accumulated run time [hp timer units] */
+		uint32_t    last_run;       /**< When the process last ran [hp timer units] */
+		uint32_t    vol_switches;   /**< Switches while waiting or yielding */
+		uint32_t    invol_switches; /**< Switches by preemption */
+	# endif
 	} monitor;
 #endif
 
@@ -239,6 +257,10 @@ int proc_testSetup(void);
 int proc_testRun(void);
 int proc_testTearDown(void);
 
+int stackpool_testSetup(void);
+int stackpool_testRun(void);
+int stackpool_testTearDown(void);
+
 /**
  * Return the context structure of the currently running process.
  *
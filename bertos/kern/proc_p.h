@@ -43,12 +43,24 @@
 #include "cfg/cfg_monitor.h"
 
 #include <cfg/compiler.h>
+#include <cfg/macros.h>       // BV32()
 
 #include <cpu/types.h>        /* for cpu_stack_t */
 #include <cpu/irq.h>          // IRQ_ASSERT_DISABLED()
 
 #include <kern/proc.h>   // struct Process
 
+#if CONFIG_KERN_MONITOR && CONFIG_KERN_MONITOR_STATS
+	#include <drv/timer.h> // timer_hpclock_unlocked()
+#endif
+
+#if CONFIG_KERN_PREEMPT
+	#include "cfg/cfg_timer.h"
+#endif
+#if CONFIG_KERN_PREEMPT && CONFIG_TIMER_TICKLESS
+	#include <drv/timer.h> // timer_armQuantum()
+#endif
+
 #ifndef asm_switch_context
 /**
  * CPU dependent context switching routines.
@@ -70,6 +82,37 @@ EXTERN_C void asm_switch_context(cpu_stack_t **new_sp, cpu_stack_t **save_sp);
 /** Track running processes. */
 extern REGISTER Process	*current_process;
 
+#if CONFIG_KERN_PRI && CONFIG_KERN_PRI_BITMAP
+
+/** Lowest priority with a dedicated level in the ready queue. */
+#define SCHED_PRI_MIN     (-(CONFIG_KERN_PRI_LEVELS / 2))
+/** Highest priority with a dedicated level in the ready queue. */
+#define SCHED_PRI_MAX     (SCHED_PRI_MIN + CONFIG_KERN_PRI_LEVELS - 1)
+/** Process::ready_level of a process that is not in the ready queue. */
+#define SCHED_LEVEL_NONE  0xFF
+
+/**
+ * Bitmap-indexed priority ready queue.
+ *
+ * Each priority level has its own FIFO of ready processes; bit \a n of
+ * \a bitmap is set when level \a n is not empty, so the highest ready
+ * priority is found with a single find-last-set.
+ */
+typedef struct ReadyQueue
+{
+	uint32_t bitmap;                        /**< Non-empty levels */
+	List     level[CONFIG_KERN_PRI_LEVELS]; /**< Ready processes of each level */
+} ReadyQueue;
+
+/**
+ * Track ready processes.
+ *
+ * Access to the queue must be performed with interrupts disabled
+ */
+extern REGISTER ReadyQueue proc_ready_queue;
+
+#else
+
 /**
  * Track ready processes.
  *
@@ -77,6 +120,8 @@ extern REGISTER Process	*current_process;
  */
 extern REGISTER List     proc_ready_list;
 
+#endif
+
 #if CONFIG_KERN_PRI
 # if CONFIG_KERN_PRI_INHERIT
 	#define __prio_orig(proc) (proc->orig_pri)
@@ -85,15 +130,113 @@ extern REGISTER List     proc_ready_list;
 	#define __prio_proc(proc) (__prio_inh(proc) > __prio_orig(proc) ? \
 					__prio_inh(proc) : __prio_orig(proc))
 # endif
-	#define prio_next()	(LIST_EMPTY(&proc_ready_list) ? INT_MIN : \
-					((PriNode *)LIST_HEAD(&proc_ready_list))->pri)
 	#define prio_proc(proc)	(proc->link.pri)
 	#define prio_curr()	prio_proc(current_process)
 
+# if CONFIG_KERN_PRI_BITMAP
+	STATIC_ASSERT(CONFIG_KERN_PRI_LEVELS >= 2 && CONFIG_KERN_PRI_LEVELS <= 32);
+
+	/** Return the ready queue level of priority \a pri. */
+	INLINE int sched_level(int pri)
+	{
+		if (pri < SCHED_PRI_MIN)
+			return 0;
+		if (pri > SCHED_PRI_MAX)
+			return CONFIG_KERN_PRI_LEVELS - 1;
+		return pri - SCHED_PRI_MIN;
+	}
+
+	/** Return the index of the most significant bit set in \a mask (not 0). */
+	INLINE int sched_fls(uint32_t mask)
+	{
+	#if GNUC_PREREQ(3,4)
+		return (int)(sizeof(unsigned long) * CPU_BITS_PER_CHAR) - 1
+			- __builtin_clzl((unsigned long)mask);
+	#else
+		int n = 0;
+
+		if (mask & 0xFFFF0000UL) { mask >>= 16; n += 16; }
+		if (mask & 0xFF00) { mask >>= 8; n += 8; }
+		if (mask & 0xF0) { mask >>= 4; n += 4; }
+		if (mask & 0xC) { mask >>= 2; n += 2; }
+		if (mask & 0x2) n += 1;
+		return n;
+	#endif
+	}
+
+	/** Return the highest non-empty level of the ready queue (not empty). */
+	#define sched_topLevel() \
+			(&proc_ready_queue.level[sched_fls(proc_ready_queue.bitmap)])
+
+	#define prio_next()	(proc_ready_queue.bitmap ? \
+					((PriNode *)LIST_HEAD(sched_topLevel()))->pri : INT_MIN)
+
+	INLINE void sched_enqueueLevel(struct Process *proc, bool head)
+	{
+		int level = sched_level(proc->link.pri);
+
+		if (head)
+			ADDHEAD(&proc_ready_queue.level[level], &proc->link.link);
+		else
+			ADDTAIL(&proc_ready_queue.level[level], &proc->link.link);
+		proc_ready_queue.bitmap |= BV32(level);
+		proc->ready_level = level;
+	}
+
+	INLINE void sched_removeLevel(struct Process *proc)
+	{
+		int level = proc->ready_level;
+
+		REMOVE(&proc->link.link);
+		if (LIST_EMPTY(&proc_ready_queue.level[level]))
+			proc_ready_queue.bitmap &= ~BV32(level);
+		proc->ready_level = SCHED_LEVEL_NONE;
+	}
+
+	#define SCHED_ENQUEUE_INTERNAL(proc) sched_enqueueLevel(proc, false)
+	#define SCHED_ENQUEUE_HEAD_INTERNAL(proc) sched_enqueueLevel(proc, true)
+	#define SCHED_EMPTY() (!proc_ready_queue.bitmap)
+
+	#ifdef _DEBUG
+		#define SCHED_ASSERT_VALID() \
+			do { \
+				int __l; \
+				for (__l = 0; __l < CONFIG_KERN_PRI_LEVELS; __l++) \
+				{ \
+					LIST_ASSERT_VALID(&proc_ready_queue.level[__l]); \
+					ASSERT(!(proc_ready_queue.bitmap & BV32(__l)) \
+						== LIST_EMPTY(&proc_ready_queue.level[__l])); \
+				} \
+			} while (0)
+	#else
+		#define SCHED_ASSERT_VALID() do {} while (0)
+	#endif
+
+	/**
+	 * Remove the first process of the highest ready priority from the
+	 * ready queue.
+	 *
+	 * \return the process or NULL if no process is ready.
+	 */
+	INLINE struct Process *sched_dequeue(void)
+	{
+		struct Process *proc;
+
+		if (!proc_ready_queue.bitmap)
+			return NULL;
+		proc = (struct Process *)LIST_HEAD(sched_topLevel());
+		sched_removeLevel(proc);
+		return proc;
+	}
+# else
+	#define prio_next()	(LIST_EMPTY(&proc_ready_list) ? INT_MIN : \
+					((PriNode *)LIST_HEAD(&proc_ready_list))->pri)
+
 	#define SCHED_ENQUEUE_INTERNAL(proc) \
 			LIST_ENQUEUE(&proc_ready_list, &(proc)->link)
 	#define SCHED_ENQUEUE_HEAD_INTERNAL(proc) \
 			LIST_ENQUEUE_HEAD(&proc_ready_list, &(proc)->link)
+# endif
 #else
 	#define prio_next()	0
 	#define prio_proc(proc)	0
@@ -103,6 +246,35 @@ extern REGISTER List     proc_ready_list;
 	#define SCHED_ENQUEUE_HEAD_INTERNAL(proc) ADDHEAD(&proc_ready_list, &(proc)->link)
 #endif
 
+#if !(CONFIG_KERN_PRI && CONFIG_KERN_PRI_BITMAP)
+	#define SCHED_EMPTY() LIST_EMPTY(&proc_ready_list)
+	#define SCHED_ASSERT_VALID() LIST_ASSERT_VALID(&proc_ready_list)
+
+	/**
+	 * Remove the first process from the ready list.
+	 *
+	 * \return the process or NULL if no process is ready.
+	 */
+	INLINE struct Process *sched_dequeue(void)
+	{
+		return (struct Process *)list_remHead(&proc_ready_list);
+	}
+#endif
+
+#if CONFIG_KERN_PREEMPT && CONFIG_TIMER_TICKLESS
+	/*
+	 * Without a periodic tick, the running process quantum is only
+	 * counted when somebody else is ready to run: start it when the
+	 * first process enters the ready list.
+	 */
+	#define SCHED_ARM_QUANTUM()  do { \
+			if (SCHED_EMPTY()) \
+				timer_armQuantum(); \
+		} while (0)
+#else
+	#define SCHED_ARM_QUANTUM()  do {} while (0)
+#endif
+
 /**
  * Enqueue a process in the ready list.
  *
@@ -114,18 +286,41 @@ extern REGISTER List     proc_ready_list;
  */
 #define SCHED_ENQUEUE(proc)  do { \
 		IRQ_ASSERT_DISABLED(); \
-		LIST_ASSERT_VALID(&proc_ready_list); \
+		SCHED_ASSERT_VALID(); \
+		SCHED_ARM_QUANTUM(); \
 		SCHED_ENQUEUE_INTERNAL(proc); \
 	} while (0)
 
 #define SCHED_ENQUEUE_HEAD(proc)  do { \
 		IRQ_ASSERT_DISABLED(); \
-		LIST_ASSERT_VALID(&proc_ready_list); \
+		SCHED_ASSERT_VALID(); \
+		SCHED_ARM_QUANTUM(); \
 		SCHED_ENQUEUE_HEAD_INTERNAL(proc); \
 	} while (0)
 
 
 #if CONFIG_KERN_PRI
+# if CONFIG_KERN_PRI_BITMAP
+/**
+ * Changes the priority of an already enqueued process.
+ *
+ * The process keeps track of its ready queue level, so it is moved to the
+ * tail of its new level in constant time.
+ *
+ * No action is performed for processes that aren't in the ready list, eg. in semaphore queues.
+ */
+INLINE void sched_reenqueue(struct Process *proc)
+{
+	IRQ_ASSERT_DISABLED();
+	SCHED_ASSERT_VALID();
+
+	if (proc->ready_level != SCHED_LEVEL_NONE)
+	{
+		sched_removeLevel(proc);
+		sched_enqueueLevel(proc, false);
+	}
+}
+# else
 /**
  * Changes the priority of an already enqueued process.
  *
@@ -134,7 +329,8 @@ extern REGISTER List     proc_ready_list;
  *
  * No action is performed for processes that aren't in the ready list, eg. in semaphore queues.
  *
- * \note Performance could be improved with a different implementation of priority list.
+ * \note Performance could be improved with a different implementation of
+ *       priority list, see CONFIG_KERN_PRI_BITMAP.
  */
 INLINE void sched_reenqueue(struct Process *proc)
 {
@@ -159,6 +355,7 @@ INLINE void sched_reenqueue(struct Process *proc)
 		LIST_ENQUEUE(&proc_ready_list, &proc->link);
 	}
 }
+# endif
 #endif //CONFIG_KERN_PRI
 
 /* Process trampoline */
@@ -185,6 +382,11 @@ void proc_schedInit(void);
 
 	/** Rename a process */
 	void monitor_rename(Process *proc, const char *name);
+
+	#if CONFIG_KERN_MONITOR_STATS
+		/** Time spent with no process to run [hp timer units] */
+		extern uint64_t proc_idle_time;
+	#endif
 #endif /* CONFIG_KERN_MONITOR */
 
 /*
@@ -198,6 +198,54 @@ static int worker_test(void)
 	return 0;
 }
 
+#if CONFIG_KERN_MONITOR && CONFIG_KERN_MONITOR_STATS
+static MonitorStats stats[TASKS + 4];
+
+#if CONFIG_KERN_PREEMPT
+static bool stats_preempted;
+
+/*
+ * Record whether any process but the current one has been preempted.
+ */
+static void stats_sample(void)
+{
+	int i, n = monitor_stats(stats, countof(stats));
+
+	for (i = 0; i < n; i++)
+		if (stats[i].proc != proc_current() && stats[i].invol_switches)
+			stats_preempted = true;
+}
+#endif /* CONFIG_KERN_PREEMPT */
+
+static int stats_test(void)
+{
+	int i, n = monitor_stats(stats, countof(stats));
+
+	kputs("Run accounting test..\n");
+	for (i = 0; i < n; i++)
+	{
+		if (stats[i].proc != proc_current())
+			continue;
+		if (!stats[i].vol_switches || !stats[i].run_time)
+		{
+			kputs("> Main: accounting test finished..fail!\n");
+			return -1;
+		}
+	}
+	#if CONFIG_KERN_PREEMPT
+		if (!stats_preempted)
+		{
+			kputs("> Main: no preemption accounted..fail!\n");
+			return -1;
+		}
+	#endif
+	kputs("> Main: accounting test finished..ok!\n");
+	return 0;
+}
+#else
+#define stats_sample() do {} while (0)
+#endif /* CONFIG_KERN_MONITOR && CONFIG_KERN_MONITOR_STATS */
+
 #if CONFIG_KERN_PREEMPT
 static void preempt_worker(void)
 {
@@ -279,6 +327,7 @@ static int preempt_worker_test(void)
 		if (i == TASKS)
 			break;
 		monitor_report();
+		stats_sample();
 		timer_delay(1000);
 	}
 	for (i = 0; i < TASKS; i++)
@@ -289,6 +338,61 @@ static int preempt_worker_test(void)
 }
 #endif /* CONFIG_KERN_PREEMPT */
 
+#if CONFIG_KERN_PREEMPT && CONFIG_KERN_SIGNALS
+static struct Process *main_proc, *wakeup_proc;
+static ticks_t wakeup_posted, wakeup_run;
+static volatile bool wakeup_done;
+
+static void wakeup_sleeper(void)
+{
+	sig_wait(SIG_USER0);
+	wakeup_run = timer_clock();
+	wakeup_done = true;
+	sig_send(main_proc, SIG_USER0);
+}
+
+static void wakeup_spinner(void)
+{
+	ticks_t start = timer_clock();
+
+	/* Run alone for a while, then wake up a process without yielding */
+	while (timer_clock() - start < ms_to_ticks(50))
+		IRQ_ASSERT_ENABLED();
+
+	wakeup_posted = timer_clock();
+	sig_post(wakeup_proc, SIG_USER0);
+
+	while (!wakeup_done && timer_clock() - wakeup_posted < ms_to_ticks(1000))
+		IRQ_ASSERT_ENABLED();
+}
+
+/*
+ * A process woken up while another one is running alone must get the
+ * CPU when the running quantum expires, with no timer pending to do it.
+ */
+static int preempt_wakeup_test(void)
+{
+	kputs("Run Wakeup preemption test..\n");
+	main_proc = proc_current();
+	wakeup_done = false;
+	wakeup_proc = proc_new(wakeup_sleeper, NULL, WORKER_STACK_SIZE, WORKER_STACK(0));
+	proc_new(wakeup_spinner, NULL, WORKER_STACK_SIZE, WORKER_STACK(1));
+
+	sig_wait(SIG_USER0);
+	kprintf("> Main: woken up process ran after %ld ticks\n",
+			(long)(wakeup_run - wakeup_posted));
+	if (wakeup_run - wakeup_posted > CONFIG_KERN_QUANTUM + 2)
+	{
+		kputs("> Main: wakeup preemption test finished..fail!\n");
+		return -1;
+	}
+	/* Let the spinner terminate before reusing its stack */
+	timer_delay(10);
+	kputs("> Main: wakeup preemption test finished..ok!\n");
+	return 0;
+}
+#endif /* CONFIG_KERN_PREEMPT && CONFIG_KERN_SIGNALS */
+
 #if CONFIG_KERN_SIGNALS & CONFIG_KERN_PRI
 
 // Define params to test priority
@@ -364,6 +468,97 @@ out:
 		kputs("Priority test failed.\n");
 	return ret;
 }
+
+static int prio_reenqueue_test(void)
+{
+	struct Process *curr = proc_current();
+	struct Process *p0, *p1, *p2;
+	int orig_pri = curr->link.pri;
+	sigmask_t signals;
+	int ret = 0;
+
+	proc_setPri(proc_current(), 10);
+
+	kputs("Run Priority change test..\n");
+	p0 = proc_new(proc_pri_test0, curr, WORKER_STACK_SIZE, WORKER_STACK(0));
+	p1 = proc_new(proc_pri_test1, curr, WORKER_STACK_SIZE, WORKER_STACK(1));
+	p2 = proc_new(proc_pri_test2, curr, WORKER_STACK_SIZE, WORKER_STACK(2));
+	proc_setPri(p0, 1);
+	proc_setPri(p1, 2);
+	proc_setPri(p2, 3);
+
+	// raise the priority of a process that is waiting in the ready queue
+	proc_setPri(p0, 4);
+
+	// signals must be: USER0, 2, 1 in order
+	signals = sig_wait(SIG_USER0 | SIG_USER1 | SIG_USER2);
+	if (!(signals & SIG_USER0))
+		ret = -1;
+	signals = sig_wait(SIG_USER0 | SIG_USER1 | SIG_USER2);
+	if (!(signals & SIG_USER2))
+		ret = -1;
+	signals = sig_wait(SIG_USER0 | SIG_USER1 | SIG_USER2);
+	if (!(signals & SIG_USER1))
+		ret = -1;
+
+	proc_setPri(proc_current(), orig_pri);
+	if (ret != 0)
+		kputs("Priority change test failed.\n");
+	else
+		kputs("Priority change test successfull.\n");
+	return ret;
+}
+
+/* Time to measure the switch rate (in ms) */
+#define SWITCH_BENCH_TIME	1000
+
+static volatile bool switch_bench_stop;
+static unsigned long switch_bench_count[TASKS];
+
+static void switch_bench_worker(void)
+{
+	size_t id = (size_t)proc_currentUserData();
+
+	while (!switch_bench_stop)
+	{
+		switch_bench_count[id]++;
+		proc_yield();
+	}
+}
+
+/*
+ * Context switch benchmark: TASKS processes of the same priority yield
+ * to each other, so every switch re-enqueues a process behind the others.
+ */
+static int prio_switch_bench(void)
+{
+	int orig_pri = proc_current()->link.pri;
+	unsigned long switches = 0;
+	size_t i;
+
+	proc_setPri(proc_current(), 10);
+	switch_bench_stop = false;
+	memset(switch_bench_count, 0, sizeof(switch_bench_count));
+	for (i = 0; i < TASKS; i++)
+	{
+		struct Process *p = proc_new(switch_bench_worker, (iptr_t)i,
+				WORKER_STACK_SIZE, WORKER_STACK(i));
+		proc_setPri(p, 1);
+	}
+
+	timer_delay(SWITCH_BENCH_TIME);
+	for (i = 0; i < TASKS; i++)
+		switches += switch_bench_count[i];
+	switch_bench_stop = true;
+	/* Let the workers exit */
+	timer_delay(DELAY * 10);
+	proc_setPri(proc_current(), orig_pri);
+
+	kprintf("> Switch bench (%s ready queue): %lu switches/s\n",
+		CONFIG_KERN_PRI_BITMAP ? "bitmap" : "sorted list",
+		switches * 1000 / SWITCH_BENCH_TIME);
+	return 0;
+}
 #endif /* CONFIG_KERN_SIGNALS & CONFIG_KERN_PRI */
 
 /**
@@ -373,12 +568,22 @@ int proc_testRun(void)
 {
 	/* Start tests */
 	worker_test();
+#if CONFIG_KERN_PREEMPT && CONFIG_KERN_SIGNALS
+	if (preempt_wakeup_test())
+		return -1;
+#endif
 #if CONFIG_KERN_PREEMPT
 	preempt_worker_test();
 #endif /* CONFIG_KERN_PREEMPT */
 #if CONFIG_KERN_SIGNALS & CONFIG_KERN_PRI
 	prio_worker_test();
+	prio_reenqueue_test();
+	prio_switch_bench();
 #endif /* CONFIG_KERN_SIGNALS & CONFIG_KERN_PRI */
+#if CONFIG_KERN_MONITOR && CONFIG_KERN_MONITOR_STATS
+	if (stats_test())
+		return -1;
+#endif
 	return 0;
 }
 
@@ -0,0 +1,288 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Read/write lock test.
+ *
+ * Readers and writers share a table: readers check it is never seen
+ * half written and that they actually share the lock, writers check
+ * they are alone. Then writer preference, timeouts and priority
+ * inheritance are verified.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_PRI" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_PRI 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_PRI_INHERIT" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_PRI_INHERIT 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ */
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <kern/sem.h>
+#include <kern/proc.h>
+
+#include <drv/timer.h>
+
+#define TEST_TIME_OUT_MS  5000
+
+#define READERS     4
+#define WRITERS     2
+#define LOOPS      10
+#define TABLE_SIZE  8
+
+static RWLock lock;
+static int table[TABLE_SIZE];
+static int readers_in, readers_max, writers_in;
+static int done, errors;
+
+#define TEST_STACK(name)  PROC_DEFINE_STACK(name, KERN_MINSTACKSIZE * 2)
+
+TEST_STACK(stack0);
+TEST_STACK(stack1);
+TEST_STACK(stack2);
+TEST_STACK(stack3);
+TEST_STACK(stack4);
+TEST_STACK(stack5);
+
+static cpu_stack_t *stacks[READERS + WRITERS] = { stack0, stack1, stack2, stack3, stack4, stack5 };
+
+static void reader(void)
+{
+	int i, j;
+
+	for (i = 0; i < LOOPS; i++)
+	{
+		rwlock_readObtain(&lock);
+		readers_max = MAX(readers_max, ++readers_in);
+		if (writers_in)
+			errors++;
+		/* Sleep in the middle of the reading */
+		for (j = 0; j < TABLE_SIZE; j++)
+		{
+			if (table[j] != table[0])
+				errors++;
+			if (j == TABLE_SIZE / 2)
+				timer_delay(10);
+		}
+		readers_in--;
+		rwlock_readRelease(&lock);
+		timer_delay(5);
+	}
+	done++;
+}
+
+static void writer(void)
+{
+	int i, j;
+
+	for (i = 0; i < LOOPS; i++)
+	{
+		rwlock_writeObtain(&lock);
+		if (writers_in++ || readers_in)
+			errors++;
+		/* Sleep in the middle of the writing */
+		for (j = 0; j < TABLE_SIZE; j++)
+		{
+			table[j]++;
+			if (j == TABLE_SIZE / 2)
+				timer_delay(10);
+		}
+		writers_in--;
+		rwlock_writeRelease(&lock);
+		timer_delay(20);
+	}
+	done++;
+}
+
+static int rwlock_share_test(void)
+{
+	ticks_t start = timer_clock();
+	int i;
+
+	kputs("> Main: readers/writers test\n");
+	for (i = 0; i < READERS; i++)
+		proc_new(reader, NULL, KERN_MINSTACKSIZE * 2, stacks[i]);
+	for (i = 0; i < WRITERS; i++)
+		proc_new(writer, NULL, KERN_MINSTACKSIZE * 2, stacks[READERS + i]);
+
+	while (done < READERS + WRITERS)
+	{
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+			return -1;
+		timer_delay(10);
+	}
+
+	kprintf("> Main: errors %d, max readers %d, table %d\n", errors, readers_max, table[0]);
+	if (errors || readers_max < 2 || table[0] != WRITERS * LOOPS)
+		return -1;
+
+	return 0;
+}
+
+static bool got_lock;
+static bool reader_got_lock;
+static bool attempt_failed;
+
+static void blocked_writer(void)
+{
+	got_lock = rwlock_writeObtainTimeout(&lock, (ticks_t)(ssize_t)proc_currentUserData());
+	if (got_lock)
+		rwlock_writeRelease(&lock);
+}
+
+static void blocked_reader(void)
+{
+	rwlock_readObtain(&lock);
+	reader_got_lock = true;
+	rwlock_readRelease(&lock);
+}
+
+static int rwlock_timeout_test(void)
+{
+	kputs("> Main: writer preference and timeout test\n");
+	got_lock = false;
+
+	/* A waiting writer keeps new readers out */
+	rwlock_readObtain(&lock);
+	proc_new(blocked_writer, (void *)(ssize_t)ms_to_ticks(1000), KERN_MINSTACKSIZE * 2, stacks[0]);
+	timer_delay(10);
+	attempt_failed = !rwlock_readAttempt(&lock);
+	rwlock_readRelease(&lock);
+	timer_delay(10);
+	if (!attempt_failed || !got_lock)
+		return -1;
+
+	/* Locks taken by someone else time out */
+	rwlock_writeObtain(&lock);
+	got_lock = true;
+	proc_new(blocked_writer, (void *)(ssize_t)ms_to_ticks(50), KERN_MINSTACKSIZE * 2, stacks[0]);
+	timer_delay(100);
+	rwlock_writeRelease(&lock);
+	if (got_lock)
+		return -1;
+
+	/* Readers queued behind a writer that timed out get in */
+	rwlock_readObtain(&lock);
+	proc_new(blocked_writer, (void *)(ssize_t)ms_to_ticks(50), KERN_MINSTACKSIZE * 2, stacks[0]);
+	timer_delay(10);
+	reader_got_lock = false;
+	proc_new(blocked_reader, NULL, KERN_MINSTACKSIZE * 2, stacks[1]);
+	timer_delay(10);
+	if (reader_got_lock)
+		return -1;
+	timer_delay(100);
+	if (got_lock || !reader_got_lock)
+		return -1;
+	rwlock_readRelease(&lock);
+
+	if (!rwlock_writeAttempt(&lock))
+		return -1;
+	rwlock_writeRelease(&lock);
+
+	return 0;
+}
+
+#if CONFIG_KERN_PRI_INHERIT
+
+static void boosting_reader(void)
+{
+	rwlock_readObtain(&lock);
+	rwlock_readRelease(&lock);
+	done++;
+}
+
+static int rwlock_inherit_test(void)
+{
+	int orig_pri = proc_current()->link.pri;
+	struct Process *p;
+
+	kputs("> Main: priority inheritance test\n");
+	done = 0;
+
+	rwlock_writeObtain(&lock);
+	p = proc_new(boosting_reader, NULL, KERN_MINSTACKSIZE * 2, stacks[0]);
+	proc_setPri(p, orig_pri + 5);
+	timer_delay(10);
+
+	/* The high priority reader is blocked on us */
+	kprintf("> Main: priority %d while blocking\n", proc_current()->link.pri);
+	if (proc_current()->link.pri != orig_pri + 5 || done)
+		return -1;
+
+	rwlock_writeRelease(&lock);
+	if (proc_current()->link.pri != orig_pri || !done)
+		return -1;
+
+	return 0;
+}
+
+#else
+
+static int rwlock_inherit_test(void)
+{
+	return 0;
+}
+
+#endif /* CONFIG_KERN_PRI_INHERIT */
+
+int rwlock_testRun(void)
+{
+	rwlock_init(&lock);
+
+	if (rwlock_share_test() || rwlock_timeout_test() || rwlock_inherit_test())
+	{
+		kputs("> Main: Read/write lock test failed..\n");
+		return -1;
+	}
+
+	kputs("> Main: Read/write lock test finished..Ok!\n");
+	return 0;
+}
+
+int rwlock_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int rwlock_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(rwlock);
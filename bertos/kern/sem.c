@@ -43,6 +43,16 @@
 #include <kern/proc.h>
 #include <kern/proc_p.h>
 #include <kern/signal.h>
+#include <kern/trace.h>
+
+#include <cfg/depend.h>
+
+#if CONFIG_TIMER_EVENTS
+	#include <drv/timer.h>
+#endif
+
+// Check config dependencies
+CONFIG_DEPEND(CONFIG_KERN_SEM_PRI_ORDER, CONFIG_KERN_PRI);
 
 INLINE void sem_verify(struct Semaphore *s)
 {
@@ -61,7 +71,7 @@ INLINE void sem_verify(struct Semaphore *s)
 /**
  * Priority inheritance update algorithm.
  *
- * The algorithm checks and boosts the priority of the semaphore's
+ * The algorithm checks and boosts the priority of the lock's
  * current owner and also processes in that block the owner, which
  * form a chain of blocking processes.
  *
@@ -70,10 +80,12 @@ INLINE void sem_verify(struct Semaphore *s)
  * before in the chain. See the diagram below:
  * P1  --. S1 ---> P2 --. S2 ---> P3
  * prio_proc(P2) >= prio_proc(P1) always.
+ *
+ * \param lock Owner field of the lock, which also identifies it.
  */
-INLINE void pri_inheritBlock(Semaphore *s)
+INLINE void pri_inheritBlock(Process **lock)
 {
-	Process *owner = s->owner;
+	Process *owner = *lock;
 
 	/*
 	 * Enqueue the blocking process in the owner's inheritance
@@ -82,7 +94,7 @@ INLINE void pri_inheritBlock(Semaphore *s)
 	 */
 	current_process->inh_link.pri = __prio_proc(current_process);
 	LIST_ENQUEUE(&owner->inh_list, &current_process->inh_link);
-	current_process->inh_blocked_by = s;
+	current_process->inh_blocked_by = lock;
 
 	/*
 	 * As long as a process has the power of boosting the priority
@@ -106,7 +118,7 @@ INLINE void pri_inheritBlock(Semaphore *s)
 		 */
 		REMOVE(&p->inh_link.link);
 		p->inh_link.pri = prio_proc(p);
-		owner = p->inh_blocked_by->owner;
+		owner = *p->inh_blocked_by;
 		LIST_ENQUEUE(&owner->inh_list, &p->inh_link);
 	}
 }
@@ -116,14 +128,17 @@ INLINE void pri_inheritBlock(Semaphore *s)
  * Priority inheritance unblock algorithm.
  *
  * Pass the priority inheritance list from the current owner to the
- * process that will take ownership of the semaphore next, potentially
+ * process that will take ownership of the lock next, potentially
  * boosting its priority.
  *
- * \param proc The process that will take ownership of the semaphore.
+ * \param lock Owner field of the lock, still pointing to the current owner.
+ * \param proc The process that will take ownership of the lock,
+ *             NULL if the lock will have no owner (read/write locks
+ *             taken by readers).
  */
-INLINE void pri_inheritUnblock(Semaphore *s, Process *proc)
+INLINE void pri_inheritUnblock(Process **lock, Process *proc)
 {
-	Process *owner = s->owner;
+	Process *owner = *lock;
 	Node *n, *temp;
 	Process *p;
 
@@ -131,21 +146,28 @@ INLINE void pri_inheritUnblock(Semaphore *s, Process *proc)
 	 * This process has nothing more to do on a priority
 	 * inheritance list.
 	 */
-	REMOVE(&proc->inh_link.link);
-	proc->inh_blocked_by = NULL;
+	if (proc && proc->inh_blocked_by == lock)
+	{
+		REMOVE(&proc->inh_link.link);
+		proc->inh_blocked_by = NULL;
+	}
 
 	/*
 	 * Each process in the former owner's priority inheritance
-	 * list that is blocked on 's' needs to be removed from
+	 * list that is blocked on 'lock' needs to be removed from
 	 * there and added to the priority inheritance list of
 	 * this process, since it's going to be the new owner for
-	 * that semaphore.
+	 * that lock.
 	 */
 	FOREACH_NODE_SAFE(n, temp, &owner->inh_list) {
 		p = containerof(n, Process, inh_link.link);
-		/* Ensures only the processes blocked on 's' are affected! */
-		if (p->inh_blocked_by == s) {
+		/* Ensures only the processes blocked on 'lock' are affected! */
+		if (p->inh_blocked_by == lock) {
 			REMOVE(&p->inh_link.link);
+			if (!proc) {
+				p->inh_blocked_by = NULL;
+				continue;
+			}
 			LIST_ENQUEUE(&proc->inh_list, &p->inh_link);
 
 			/* And again, update the priority of the new owner */
@@ -156,16 +178,70 @@ INLINE void pri_inheritUnblock(Semaphore *s, Process *proc)
 
 	proc_updatePri(owner);
 }
+
+/**
+ * Make all the processes waiting on \a queue boost the priority of
+ * the new owner of \a lock, which had no owner before.
+ */
+INLINE void pri_inheritAdopt(Process **lock, List *queue)
+{
+	Process *owner = *lock;
+	Process *p;
+
+	FOREACH_NODE(p, queue)
+	{
+		p->inh_link.pri = __prio_proc(p);
+		LIST_ENQUEUE(&owner->inh_list, &p->inh_link);
+		p->inh_blocked_by = lock;
+
+		if (p->inh_link.pri > prio_proc(owner))
+			proc_updatePri(owner);
+	}
+}
+
+/**
+ * Remove the current process, which gave up waiting, from the
+ * priority inheritance list of the owner of \a lock.
+ */
+INLINE void pri_inheritCancel(Process **lock)
+{
+	if (current_process->inh_blocked_by == lock)
+	{
+		REMOVE(&current_process->inh_link.link);
+		current_process->inh_blocked_by = NULL;
+		proc_updatePri(*lock);
+	}
+}
 #else
-INLINE void pri_inheritBlock(UNUSED_ARG(Semaphore *, s))
+INLINE void pri_inheritBlock(UNUSED_ARG(Process **, lock))
 {
 }
 
-INLINE void pri_inheritUnblock(UNUSED_ARG(Semaphore *, s), UNUSED_ARG(Process *, proc))
+INLINE void pri_inheritUnblock(UNUSED_ARG(Process **, lock), UNUSED_ARG(Process *, proc))
+{
+}
+
+INLINE void pri_inheritAdopt(UNUSED_ARG(Process **, lock), UNUSED_ARG(List *, queue))
+{
+}
+
+INLINE void pri_inheritCancel(UNUSED_ARG(Process **, lock))
 {
 }
 #endif /* CONFIG_KERN_PRI_INHERIT */
 
+/**
+ * Append \a proc to the wait \a queue of a lock.
+ */
+INLINE void sem_enqueue(List *queue, Process *proc)
+{
+#if CONFIG_KERN_SEM_PRI_ORDER
+	LIST_ENQUEUE(queue, &proc->link);
+#else
+	ADDTAIL(queue, (Node *)proc);
+#endif
+}
+
 
 /**
  * \brief Initialize a Semaphore structure.
@@ -232,11 +308,13 @@ void sem_obtain(struct Semaphore *s)
 	/* Is the semaphore already locked by another process? */
 	if (UNLIKELY(s->owner && (s->owner != current_process)))
 	{
+		KTRACE(TRACE_SEM_OBTAIN, s, 1);
+
 		/* Append calling process to the wait queue */
-		ADDTAIL(&s->wait_queue, (Node *)current_process);
+		sem_enqueue(&s->wait_queue, current_process);
 
 		/* Trigger priority inheritance logic, if enabled */
-		pri_inheritBlock(s);
+		pri_inheritBlock(&s->owner);
 
 		/*
 		 * We will wake up only when the current owner calls
@@ -249,6 +327,7 @@ void sem_obtain(struct Semaphore *s)
 	else
 	{
 		ASSERT(LIST_EMPTY(&s->wait_queue));
+		KTRACE(TRACE_SEM_OBTAIN, s, 0);
 
 		/* The semaphore was free: lock it */
 		s->owner = current_process;
@@ -290,7 +369,7 @@ void sem_release(struct Semaphore *s)
 		if (UNLIKELY((proc = (Process *)list_remHead(&s->wait_queue))))
 		{
 			/* Undo the effects of priority inheritance, if enabled */
-			pri_inheritUnblock(s, proc);
+			pri_inheritUnblock(&s->owner, proc);
 
 			s->nest_count = 1;
 			s->owner = proc;
@@ -299,8 +378,437 @@ void sem_release(struct Semaphore *s)
 			s->owner = NULL;
 		}
 	}
+	KTRACE(TRACE_SEM_RELEASE, s, proc != NULL);
 	proc_permit();
 
 	if (proc)
 		ATOMIC(proc_wakeup(proc));
 }
+
+
+#if CONFIG_TIMER_EVENTS
+/* Context of a process waiting on a lock with a timeout */
+typedef struct SemWait
+{
+	Timer    timer;
+	List    *queue;
+	Process *proc;
+	bool     fired;
+	bool     expired;
+} SemWait;
+
+/*
+ * Timer callback: if the process is still waiting, take it out
+ * of the wait queue and make it ready again.
+ */
+static void sem_timeout(iptr_t data)
+{
+	SemWait *w = (SemWait *)data;
+	Node *n;
+
+	w->fired = true;
+	FOREACH_NODE(n, w->queue)
+	{
+		if (n == (Node *)w->proc)
+		{
+			REMOVE(n);
+			w->expired = true;
+			SCHED_ENQUEUE(w->proc);
+			break;
+		}
+	}
+}
+#endif /* CONFIG_TIMER_EVENTS */
+
+#define SEM_FOREVER  ((ticks_t)-1)
+
+/**
+ * Put the current process to sleep on \a queue.
+ *
+ * The process that hands the lock over removes the sleeping process from
+ * the queue and wakes it up with proc_wakeup(). If \a timeout is not
+ * SEM_FOREVER, after \a timeout ticks the sleeping process is taken out
+ * of the queue by a timer.
+ *
+ * \note Interrupts must be disabled, they protect the queue against the
+ *       timer.
+ * \return true if the lock has been handed over, false on timeout.
+ */
+static bool sem_block(List *queue, ticks_t timeout)
+{
+	IRQ_ASSERT_DISABLED();
+
+	/* Try variants must work from interrupts too */
+	if (!timeout)
+		return false;
+
+	ASSERT(proc_preemptAllowed());
+	if (timeout == SEM_FOREVER)
+	{
+		sem_enqueue(queue, current_process);
+		proc_switch();
+		return true;
+	}
+#if CONFIG_TIMER_EVENTS
+	else
+	{
+		SemWait w;
+
+		w.queue = queue;
+		w.proc = current_process;
+		w.fired = w.expired = false;
+		timer_setSoftint(&w.timer, sem_timeout, (iptr_t)&w);
+		timer_setDelay(&w.timer, timeout);
+		timer_add(&w.timer);
+
+		sem_enqueue(queue, current_process);
+		proc_switch();
+
+		if (!w.fired)
+			timer_abort(&w.timer);
+		return !w.expired;
+	}
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Initialize a counting semaphore with \a count units available.
+ */
+void csem_init(struct CountSemaphore *s, int count)
+{
+	ASSERT(count >= 0);
+
+	LIST_INIT(&s->wait_queue);
+	s->count = count;
+}
+
+static bool csem_wait(struct CountSemaphore *s, ticks_t timeout)
+{
+	bool result = true;
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	KTRACE(TRACE_SEM_OBTAIN, s, s->count == 0);
+	if (s->count > 0)
+		s->count--;
+	else
+		/* A unit is handed over directly by csem_release() */
+		result = sem_block(&s->wait_queue, timeout);
+	IRQ_RESTORE(flags);
+
+	return result;
+}
+
+/**
+ * \brief Take a unit from a counting semaphore without waiting.
+ *
+ * \return true in case of success, false if no unit was available.
+ */
+bool csem_attempt(struct CountSemaphore *s)
+{
+	return csem_wait(s, 0);
+}
+
+/**
+ * \brief Take a unit from a counting semaphore.
+ *
+ * If no unit is available, the calling process sleeps until
+ * someone calls csem_release().
+ */
+void csem_obtain(struct CountSemaphore *s)
+{
+	csem_wait(s, SEM_FOREVER);
+}
+
+#if CONFIG_TIMER_EVENTS
+/**
+ * \brief Take a unit from a counting semaphore, waiting at most \a timeout ticks.
+ *
+ * \return true in case of success, false on timeout.
+ */
+bool csem_obtainTimeout(struct CountSemaphore *s, ticks_t timeout)
+{
+	ASSERT(timeout >= 0);
+	return csem_wait(s, timeout);
+}
+#endif
+
+INLINE void __csem_release(struct CountSemaphore *s, bool wakeup)
+{
+	Process *proc;
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	proc = (Process *)list_remHead(&s->wait_queue);
+	KTRACE(TRACE_SEM_RELEASE, s, proc != NULL);
+	if (!proc)
+		s->count++;
+	else if (wakeup)
+		proc_wakeup(proc);
+	else
+		SCHED_ENQUEUE_HEAD(proc);
+	IRQ_RESTORE(flags);
+}
+
+/**
+ * \brief Give a unit back to a counting semaphore.
+ *
+ * If some process is waiting, the unit goes straight to the first one.
+ *
+ * \note This function can't be called from IRQ context, use csem_post()
+ *       instead.
+ */
+void csem_release(struct CountSemaphore *s)
+{
+	__csem_release(s, true);
+}
+
+/**
+ * \brief Give a unit back to a counting semaphore from IRQ context.
+ *
+ * Like csem_release(), but the process that gets the unit is only made
+ * ready to run: it is not dispatched on the spot.
+ */
+void csem_post(struct CountSemaphore *s)
+{
+	__csem_release(s, false);
+}
+
+
+/**
+ * \brief Initialize a read/write lock.
+ */
+void rwlock_init(struct RWLock *rw)
+{
+	rw->writer = NULL;
+	rw->readers = 0;
+	LIST_INIT(&rw->read_queue);
+	LIST_INIT(&rw->write_queue);
+}
+
+/*
+ * Hand the lock over to all the waiting readers.
+ * The first one is dispatched at once, if it has the priority to.
+ */
+static void rwlock_wakeReaders(struct RWLock *rw)
+{
+	Process *first, *proc;
+
+	if (!(first = (Process *)list_remHead(&rw->read_queue)))
+		return;
+
+	rw->readers++;
+	while ((proc = (Process *)list_remHead(&rw->read_queue)))
+	{
+		rw->readers++;
+		SCHED_ENQUEUE(proc);
+	}
+	proc_wakeup(first);
+}
+
+static bool rwlock_readWait(struct RWLock *rw, ticks_t timeout)
+{
+	bool result = true;
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	ASSERT(rw->writer != current_process);
+
+	/* Stay behind the waiting writers, so they can't starve */
+	if (rw->writer || !LIST_EMPTY(&rw->write_queue))
+	{
+		KTRACE(TRACE_SEM_OBTAIN, rw, 1);
+		if (timeout && rw->writer)
+			pri_inheritBlock(&rw->writer);
+		if (!(result = sem_block(&rw->read_queue, timeout)))
+			pri_inheritCancel(&rw->writer);
+	}
+	else
+	{
+		KTRACE(TRACE_SEM_OBTAIN, rw, 0);
+		rw->readers++;
+	}
+	IRQ_RESTORE(flags);
+
+	return result;
+}
+
+static bool rwlock_writeWait(struct RWLock *rw, ticks_t timeout)
+{
+	bool result = true;
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	ASSERT(rw->writer != current_process);
+
+	if (rw->writer || rw->readers)
+	{
+		KTRACE(TRACE_SEM_OBTAIN, rw, 1);
+		if (timeout && rw->writer)
+			pri_inheritBlock(&rw->writer);
+		if (!(result = sem_block(&rw->write_queue, timeout)))
+		{
+			pri_inheritCancel(&rw->writer);
+
+			/* The readers were waiting just for us */
+			if (!rw->writer && LIST_EMPTY(&rw->write_queue))
+				rwlock_wakeReaders(rw);
+		}
+	}
+	else
+	{
+		KTRACE(TRACE_SEM_OBTAIN, rw, 0);
+		rw->writer = current_process;
+	}
+	IRQ_RESTORE(flags);
+
+	return result;
+}
+
+/**
+ * \brief Take a read lock without waiting.
+ *
+ * \return true in case of success, false if the lock is owned or
+ *         requested by a writer.
+ */
+bool rwlock_readAttempt(struct RWLock *rw)
+{
+	return rwlock_readWait(rw, 0);
+}
+
+/**
+ * \brief Take a read lock.
+ *
+ * Sleeps while a writer owns the lock or is waiting for it.
+ *
+ * \note Read locks are not recursive: taking the same lock twice can
+ *       deadlock when a writer arrives in the middle.
+ */
+void rwlock_readObtain(struct RWLock *rw)
+{
+	rwlock_readWait(rw, SEM_FOREVER);
+}
+
+/**
+ * \brief Take a write lock without waiting.
+ *
+ * \return true in case of success, false if the lock is taken.
+ */
+bool rwlock_writeAttempt(struct RWLock *rw)
+{
+	return rwlock_writeWait(rw, 0);
+}
+
+/**
+ * \brief Take a write lock.
+ *
+ * Sleeps until all the readers and the writer have released the lock.
+ */
+void rwlock_writeObtain(struct RWLock *rw)
+{
+	rwlock_writeWait(rw, SEM_FOREVER);
+}
+
+#if CONFIG_TIMER_EVENTS
+/**
+ * \brief Take a read lock, waiting at most \a timeout ticks.
+ *
+ * \return true in case of success, false on timeout.
+ */
+bool rwlock_readObtainTimeout(struct RWLock *rw, ticks_t timeout)
+{
+	ASSERT(timeout >= 0);
+	return rwlock_readWait(rw, timeout);
+}
+
+/**
+ * \brief Take a write lock, waiting at most \a timeout ticks.
+ *
+ * \return true in case of success, false on timeout.
+ */
+bool rwlock_writeObtainTimeout(struct RWLock *rw, ticks_t timeout)
+{
+	ASSERT(timeout >= 0);
+	return rwlock_writeWait(rw, timeout);
+}
+#endif
+
+/*
+ * Hand the lock over to the first waiting writer, when there are
+ * no readers left.
+ */
+static void rwlock_wakeWriter(struct RWLock *rw)
+{
+	Process *proc = (Process *)list_remHead(&rw->write_queue);
+
+	if (proc)
+	{
+		rw->writer = proc;
+		pri_inheritAdopt(&rw->writer, &rw->read_queue);
+		pri_inheritAdopt(&rw->writer, &rw->write_queue);
+		proc_wakeup(proc);
+	}
+}
+
+/**
+ * \brief Release a read lock.
+ *
+ * The last reader hands the lock over to the first waiting writer.
+ */
+void rwlock_readRelease(struct RWLock *rw)
+{
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	ASSERT(rw->readers > 0);
+	ASSERT(!rw->writer);
+
+	KTRACE(TRACE_SEM_RELEASE, rw, rw->readers == 1 && !LIST_EMPTY(&rw->write_queue));
+	if (--rw->readers == 0)
+		rwlock_wakeWriter(rw);
+	IRQ_RESTORE(flags);
+}
+
+/**
+ * \brief Release a write lock.
+ *
+ * All the waiting readers get the lock, or the first waiting writer
+ * if there are no readers (or, with CONFIG_KERN_SEM_PRI_ORDER, if it has
+ * an higher priority than all of them).
+ */
+void rwlock_writeRelease(struct RWLock *rw)
+{
+	Process *proc;
+	bool readers;
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	ASSERT(rw->writer == current_process);
+
+	readers = !LIST_EMPTY(&rw->read_queue);
+#if CONFIG_KERN_SEM_PRI_ORDER
+	if (readers && !LIST_EMPTY(&rw->write_queue))
+		readers = ((PriNode *)LIST_HEAD(&rw->read_queue))->pri
+			>= ((PriNode *)LIST_HEAD(&rw->write_queue))->pri;
+#endif
+	KTRACE(TRACE_SEM_RELEASE, rw, readers || !LIST_EMPTY(&rw->write_queue));
+
+	if (readers)
+	{
+		pri_inheritUnblock(&rw->writer, NULL);
+		rw->writer = NULL;
+		rwlock_wakeReaders(rw);
+	}
+	else if ((proc = (Process *)list_remHead(&rw->write_queue)))
+	{
+		pri_inheritUnblock(&rw->writer, proc);
+		rw->writer = proc;
+		proc_wakeup(proc);
+	}
+	else
+		rw->writer = NULL;
+	IRQ_RESTORE(flags);
+}
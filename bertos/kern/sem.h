@@ -34,8 +34,38 @@
  * \defgroup kern_sem Mutually exclusive semaphores
  * \ingroup kern
  * \{
- * \brief Mutually exclusive semaphores.
- *        Shared locking not supported in this implementation.
+ * \brief Mutually exclusive semaphores, counting semaphores and
+ *        read/write locks.
+ *
+ * Semaphore is a recursive mutex with priority inheritance.
+ *
+ * CountSemaphore is a classic counting semaphore: it holds a number of
+ * units, csem_obtain() takes one and sleeps while there are none left,
+ * csem_release() gives one back. It has no owner, so it can be released
+ * by a process other than the one that obtained it, or by an interrupt
+ * with csem_post(); for the same reason it does not take part in
+ * priority inheritance. csem_attempt() can be called from interrupts too.
+ *
+ * RWLock lets any number of readers share the lock, or a single writer
+ * own it. Readers arriving while a writer is waiting queue up behind
+ * it, so writers can not be starved. Processes blocking on a lock
+ * owned by a writer boost the writer priority like a Semaphore does,
+ * the readers are not boosted. Neither side is recursive.
+ *
+ * All the waiting queues are FIFO, or ordered by priority with
+ * CONFIG_KERN_SEM_PRI_ORDER.
+ * The timeout variants need CONFIG_TIMER_EVENTS.
+ *
+ * Known limits:
+ * \li a CountSemaphore holder is never boosted, so a high priority process
+ *     waiting for a unit can be delayed by medium priority ones (unbounded
+ *     priority inversion): use a Semaphore to protect critical sections;
+ * \li when a timed wait expires, the timer interrupt looks for the process
+ *     in the wait queue, which takes time proportional to the number of
+ *     waiters;
+ * \li with CONFIG_KERN_SEM_PRI_ORDER, a process is placed in the wait queue
+ *     with the priority it has when it starts waiting: if its priority is
+ *     boosted later by inheritance, it keeps its place in the queue.
  *
  *
  * \author Bernie Innocenti <bernie@codewiz.org>
@@ -49,9 +79,16 @@
 #ifndef KERN_SEM_H
 #define KERN_SEM_H
 
+#include "cfg/cfg_sem.h"
+#include "cfg/cfg_timer.h"
+
 #include <cfg/compiler.h>
 #include <struct/list.h>
 
+#ifndef CONFIG_KERN_SEM_PRI_ORDER
+	#define CONFIG_KERN_SEM_PRI_ORDER 0
+#endif
+
 /* Fwd decl */
 struct Process;
 
@@ -63,6 +100,20 @@ typedef struct Semaphore
 	int             nest_count;
 } Semaphore;
 
+typedef struct CountSemaphore
+{
+	List            wait_queue;
+	int             count;
+} CountSemaphore;
+
+typedef struct RWLock
+{
+	struct Process *writer;      ///< Process owning the write lock
+	int             readers;     ///< Number of read locks held
+	List            read_queue;
+	List            write_queue;
+} RWLock;
+
 /**
  * \name Process synchronization services
  * \{
@@ -72,10 +123,49 @@ bool sem_attempt(struct Semaphore *s);
 void sem_obtain(struct Semaphore *s);
 void sem_release(struct Semaphore *s);
 /* \} */
+
+/**
+ * \name Counting semaphores
+ * \{
+ */
+void csem_init(struct CountSemaphore *s, int count);
+bool csem_attempt(struct CountSemaphore *s);
+void csem_obtain(struct CountSemaphore *s);
+void csem_release(struct CountSemaphore *s);
+void csem_post(struct CountSemaphore *s);
+#if CONFIG_TIMER_EVENTS
+bool csem_obtainTimeout(struct CountSemaphore *s, ticks_t timeout);
+#endif
+/* \} */
+
+/**
+ * \name Read/write locks
+ * \{
+ */
+void rwlock_init(struct RWLock *rw);
+bool rwlock_readAttempt(struct RWLock *rw);
+void rwlock_readObtain(struct RWLock *rw);
+void rwlock_readRelease(struct RWLock *rw);
+bool rwlock_writeAttempt(struct RWLock *rw);
+void rwlock_writeObtain(struct RWLock *rw);
+void rwlock_writeRelease(struct RWLock *rw);
+#if CONFIG_TIMER_EVENTS
+bool rwlock_readObtainTimeout(struct RWLock *rw, ticks_t timeout);
+bool rwlock_writeObtainTimeout(struct RWLock *rw, ticks_t timeout);
+#endif
+/* \} */
 /* \} */ //defgroup kern_sem
 
 int sem_testRun(void);
 int sem_testSetup(void);
 int sem_testTearDown(void);
 
+int csem_testRun(void);
+int csem_testSetup(void);
+int csem_testTearDown(void);
+
+int rwlock_testRun(void);
+int rwlock_testSetup(void);
+int rwlock_testTearDown(void);
+
 #endif /* KERN_SEM_H */
@@ -134,6 +134,7 @@
 #include <cpu/irq.h>
 #include <kern/proc.h>
 #include <kern/proc_p.h>
+#include <kern/trace.h>
 
 
 #if CONFIG_KERN_SIGNALS
@@ -159,6 +160,7 @@ sigmask_t sig_waitSignal(Signal *s, sigmask_t sigs)
 	 * process never being reinserted into the ready list.
 	 */
 	IRQ_DISABLE;
+	KTRACE(TRACE_SIG_WAIT, s, sigs);
 
 	/* Loop until we get at least one of the signals */
 	while (!(result = s->recv & sigs))
@@ -227,6 +229,7 @@ INLINE void __sig_signal(Signal *s, Process *proc, sigmask_t sigs, bool wakeup)
 	cpu_flags_t flags;
 
 	IRQ_SAVE_DISABLE(flags);
+	KTRACE(TRACE_SIG_SEND, s, sigs);
 
 	/* Set the signals */
 	s->recv |= sigs;
@@ -0,0 +1,170 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Process stack pool test.
+ *
+ * Checks that the stacks of exited processes are reused by the next
+ * processes asking for the same stack size, and that the pooled stacks
+ * go back to the heap when it runs out of memory.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_HEAP" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_HEAP 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_HEAP_SIZE" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_HEAP_SIZE 1048576L" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_STACK_POOL" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_STACK_POOL 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_STACK_POOL_SIZES" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_STACK_POOL_SIZES 2" >> $cfgdir/cfg_proc.h
+ */
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <kern/proc.h>
+
+#include <drv/timer.h>
+
+#define SMALL_STACK  (KERN_MINSTACKSIZE * 2)
+#define BIG_STACK    (KERN_MINSTACKSIZE * 4)
+#define OTHER_STACK  (KERN_MINSTACKSIZE * 3)
+
+#define MAX_PROCS    (CONFIG_KERN_HEAP_SIZE / SMALL_STACK + 1)
+
+static volatile bool hold;
+static int exited;
+
+static void worker(void)
+{
+	while (hold)
+		timer_delay(10);
+	exited++;
+}
+
+/* Spawn a process with a kernel allocated stack, return its stack */
+static cpu_stack_t *spawn(size_t size)
+{
+	struct Process *p = proc_new(worker, NULL, size, NULL);
+
+	return p ? p->stack_base : NULL;
+}
+
+static int stackpool_reuse_test(void)
+{
+	cpu_stack_t *small, *big;
+
+	kputs("> Main: stack reuse test\n");
+	hold = false;
+
+	small = spawn(SMALL_STACK);
+	big = spawn(BIG_STACK);
+	timer_delay(10);
+	if (exited != 2)
+		return -1;
+
+	/* Same size, same stack */
+	if (spawn(BIG_STACK) != big || spawn(SMALL_STACK) != small)
+		return -1;
+	timer_delay(10);
+
+	/* A third size does not fit in the pool, but it still works */
+	if (!spawn(OTHER_STACK))
+		return -1;
+	timer_delay(10);
+	if (spawn(SMALL_STACK) != small)
+		return -1;
+	timer_delay(10);
+
+	return 0;
+}
+
+static int stackpool_flush_test(void)
+{
+	int i, n;
+
+	kputs("> Main: heap exhaustion test\n");
+
+	/* Fill up the heap with small stacks */
+	hold = true;
+	for (n = 0; n < MAX_PROCS; n++)
+		if (!spawn(SMALL_STACK))
+			break;
+	kprintf("> Main: %d processes\n", n);
+	if (n == 0 || n == MAX_PROCS)
+		return -1;
+
+	/* Let them exit: all their stacks are pooled */
+	exited = 0;
+	hold = false;
+	for (i = 0; exited < n && i < 100; i++)
+		timer_delay(10);
+	if (exited != n)
+		return -1;
+
+	/* Bigger stacks need the memory held by the pool */
+	hold = true;
+	for (i = 0; i < n / 3; i++)
+		if (!spawn(BIG_STACK))
+			return -1;
+	hold = false;
+	timer_delay(100);
+
+	return 0;
+}
+
+int stackpool_testRun(void)
+{
+	if (stackpool_reuse_test() || stackpool_flush_test())
+	{
+		kputs("> Main: Stack pool test failed..\n");
+		return -1;
+	}
+
+	kputs("> Main: Stack pool test finished..Ok!\n");
+	return 0;
+}
+
+int stackpool_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int stackpool_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(stackpool);
@@ -0,0 +1,118 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Kernel event trace (implementation).
+ */
+
+#include "trace.h"
+
+#if CONFIG_KERN_TRACE
+
+#include <cfg/compiler.h>
+#include <cfg/macros.h>
+
+#include <cpu/irq.h>
+
+#include <drv/timer.h>
+
+#include <io/kfile.h>
+
+STATIC_ASSERT(IS_POW2(CONFIG_KERN_TRACE_SIZE));
+STATIC_ASSERT(sizeof(TraceEvent) == 16);
+
+static TraceEvent trace_buf[CONFIG_KERN_TRACE_SIZE];
+
+/* Number of events recorded since the last reset */
+static uint32_t trace_pos;
+
+static bool trace_on = true;
+
+void trace_event(uint16_t type, const void *obj, uint32_t arg)
+{
+	TraceEvent *ev;
+	cpu_flags_t flags;
+
+	if (!trace_on)
+		return;
+
+	IRQ_SAVE_DISABLE(flags);
+	ev = &trace_buf[trace_pos++ & (CONFIG_KERN_TRACE_SIZE - 1)];
+	ev->time = timer_hpclock_unlocked();
+	ev->obj = (uint32_t)(uintptr_t)obj;
+	ev->arg = arg;
+	ev->type = type;
+	ev->_pad = 0;
+	IRQ_RESTORE(flags);
+}
+
+void trace_enable(bool enable)
+{
+	trace_on = enable;
+}
+
+void trace_reset(void)
+{
+	ATOMIC(trace_pos = 0);
+}
+
+int trace_dump(struct KFile *fd)
+{
+	TraceHeader hdr;
+	uint32_t pos;
+	bool was_on = trace_on;
+	int err = 0;
+
+	/* Stop recording so the events are not overwritten while writing */
+	trace_on = false;
+	ATOMIC(pos = trace_pos);
+
+	hdr.magic = TRACE_MAGIC;
+	hdr.version = TRACE_VERSION;
+	hdr.count = MIN(pos, (uint32_t)CONFIG_KERN_TRACE_SIZE);
+	hdr.lost = pos - hdr.count;
+	hdr.freq = TIMER_HW_HPTICKS_PER_SEC;
+
+	if (kfile_write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+		err = EOF;
+
+	for (pos = hdr.lost; !err && pos != hdr.lost + hdr.count; pos++)
+	{
+		const TraceEvent *ev = &trace_buf[pos & (CONFIG_KERN_TRACE_SIZE - 1)];
+
+		if (kfile_write(fd, ev, sizeof(*ev)) != sizeof(*ev))
+			err = EOF;
+	}
+
+	trace_on = was_on;
+	return err;
+}
+
+#endif /* CONFIG_KERN_TRACE */
@@ -0,0 +1,157 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \defgroup kern_trace Kernel event trace
+ * \ingroup kern
+ * \{
+ *
+ * \brief Kernel event trace.
+ *
+ * Records timestamped kernel events (context switches, signals,
+ * semaphores, messages, timers and interrupts) into a fixed size
+ * circular buffer in RAM. When the buffer is full the oldest events
+ * are overwritten, so after a crash or a hang the buffer holds the
+ * latest history of the system.
+ *
+ * Recording an event takes a few instructions with interrupts disabled
+ * and never blocks, so it is safe from interrupt context.
+ * With CONFIG_KERN_TRACE disabled the KTRACE() calls compile to nothing.
+ *
+ * The buffer can be saved to any KFile with trace_dump() and converted
+ * to a Chrome trace (chrome://tracing or Perfetto) JSON timeline
+ * by test/trace2json.py.
+ *
+ * $WIZ$ module_name = "trace"
+ * $WIZ$ module_depends = "kernel", "timer", "kfile"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_trace.h"
+ */
+
+#ifndef KERN_TRACE_H
+#define KERN_TRACE_H
+
+#include "cfg/cfg_trace.h"
+
+#include <cfg/compiler.h>
+
+/* Fwd decl */
+struct KFile;
+
+/**
+ * Event types.
+ *
+ * The meaning of the \a obj and \a arg fields depends on the type.
+ * Values are part of the dump format, append new types at the end.
+ */
+typedef enum TraceType
+{
+	TRACE_SWITCH = 1,  ///< Context switch, obj: next process (NULL: idle)
+	TRACE_PREEMPT,     ///< Quantum expired, obj: preempted process
+	TRACE_SIG_SEND,    ///< obj: signal, arg: signal mask
+	TRACE_SIG_WAIT,    ///< obj: signal, arg: signal mask
+	TRACE_SEM_OBTAIN,  ///< obj: semaphore, arg: 1 if the caller has to wait
+	TRACE_SEM_RELEASE, ///< obj: semaphore, arg: 1 if handed over to a waiter
+	TRACE_MSG_PUT,     ///< obj: message port, arg: unused
+	TRACE_MSG_GET,     ///< obj: message port, arg: 1 if a message was found
+	TRACE_TIMER_FIRE,  ///< obj: expired timer
+	TRACE_IRQ_ENTER,   ///< arg: interrupt number, 0 for the system timer
+	TRACE_IRQ_EXIT,    ///< arg: interrupt number, 0 for the system timer
+
+	TRACE_USER = 0x100 ///< First event type free for the application
+} TraceType;
+
+/**
+ * A trace record, as stored in memory and in the dump.
+ */
+typedef struct TraceEvent
+{
+	uint32_t time;  ///< Timestamp [hp timer units], see timer_hpclock_unlocked()
+	uint32_t obj;   ///< Address of the object involved
+	uint32_t arg;   ///< Event dependent argument, wide enough for a sigmask_t
+	uint16_t type;  ///< One of TraceType
+	uint16_t _pad;  ///< Always 0
+} TraceEvent;
+
+/** Magic number at the beginning of a dump: "BTRC" */
+#define TRACE_MAGIC    0x42545243UL
+#define TRACE_VERSION  2
+
+/**
+ * Dump header, followed by \a count TraceEvent from the oldest to the newest.
+ * All the fields are in the target byte order, use the magic number to
+ * find it out.
+ */
+typedef struct TraceHeader
+{
+	uint32_t magic;    ///< TRACE_MAGIC
+	uint32_t version;  ///< TRACE_VERSION
+	uint32_t count;    ///< Number of events in the dump
+	uint32_t lost;     ///< Events overwritten since the last trace_reset()
+	uint32_t freq;     ///< Timestamp frequency [Hz]
+} TraceHeader;
+
+#if CONFIG_KERN_TRACE
+
+/**
+ * Record an event in the trace buffer.
+ * Use the KTRACE() macro instead of calling this directly.
+ */
+void trace_event(uint16_t type, const void *obj, uint32_t arg);
+
+/** Record an event of type \a type about \a obj. */
+#define KTRACE(type, obj, arg)  trace_event((type), (const void *)(obj), (uint32_t)(arg))
+
+/**
+ * Start or stop recording events.
+ * Recording is enabled at startup, stop it to freeze the buffer
+ * content when something interesting happens.
+ */
+void trace_enable(bool enable);
+
+/** Discard all the recorded events. */
+void trace_reset(void);
+
+/**
+ * Write the content of the trace buffer to \a fd.
+ *
+ * Recording is suspended while writing.
+ * \return 0 if all OK, EOF on write errors.
+ */
+int trace_dump(struct KFile *fd);
+
+#else /* !CONFIG_KERN_TRACE */
+
+#define KTRACE(type, obj, arg)  do {} while (0)
+
+#endif /* CONFIG_KERN_TRACE */
+
+/** \} */ //defgroup kern_trace
+
+#endif /* KERN_TRACE_H */
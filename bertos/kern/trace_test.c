@@ -0,0 +1,205 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Kernel event trace test.
+ *
+ * A worker process and the main process exchange signals and messages
+ * while contending a semaphore; the trace is then dumped to memory and
+ * checked for all the expected events, in timestamp order.
+ * The loop is long enough to wrap the trace buffer around.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ * $test$: cp bertos/cfg/cfg_trace.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_TRACE" >> $cfgdir/cfg_trace.h
+ * $test$: echo "#define CONFIG_KERN_TRACE 1" >> $cfgdir/cfg_trace.h
+ * $test$: echo  "#undef CONFIG_KERN_TRACE_SIZE" >> $cfgdir/cfg_trace.h
+ * $test$: echo "#define CONFIG_KERN_TRACE_SIZE 64" >> $cfgdir/cfg_trace.h
+ */
+
+#include "cfg/cfg_sem.h"
+#include "cfg/cfg_signal.h"
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <kern/trace.h>
+#include <kern/proc.h>
+#include <kern/signal.h>
+#include <kern/sem.h>
+#include <kern/msg.h>
+
+#include <drv/timer.h>
+
+#include <struct/kfile_mem.h>
+
+#include <string.h>
+
+#if CONFIG_KERN_TRACE && CONFIG_KERN_SIGNALS && CONFIG_KERN_SEMAPHORES
+
+#define TEST_LOOPS  20
+
+static Semaphore sem;
+static MsgPort port;
+static Msg msg;
+static struct Process *main_proc;
+
+static struct
+{
+	TraceHeader hdr;
+	TraceEvent ev[CONFIG_KERN_TRACE_SIZE];
+} dump;
+
+PROC_DEFINE_STACK(worker_stack, KERN_MINSTACKSIZE * 2);
+
+static void worker(void)
+{
+	int i;
+
+	for (i = 0; i < TEST_LOOPS; i++)
+	{
+		sig_wait(SIG_USER0);
+		/* Main holds the semaphore here, we have to wait */
+		sem_obtain(&sem);
+		msg_get(&port);
+		sem_release(&sem);
+		sig_send(main_proc, SIG_USER1);
+	}
+}
+
+int trace_testRun(void)
+{
+	KFileMem km;
+	struct Process *worker_proc;
+	unsigned count[TRACE_IRQ_EXIT + 1];
+	unsigned contended = 0, single = 0;
+	uint32_t i;
+
+	main_proc = proc_current();
+	sem_init(&sem);
+	msg_initPort(&port, event_createNone());
+
+	worker_proc = proc_new(worker, NULL, sizeof(worker_stack), worker_stack);
+	trace_reset();
+
+	for (i = 0; i < TEST_LOOPS; i++)
+	{
+		sem_obtain(&sem);
+		msg_put(&port, &msg);
+		sig_send(worker_proc, SIG_USER0);
+		timer_delay(2);
+		sem_release(&sem);
+		sig_wait(SIG_USER1);
+	}
+
+	trace_enable(false);
+	kfilemem_init(&km, &dump, sizeof(dump));
+	ASSERT(trace_dump(&km.fd) == 0);
+	trace_enable(true);
+
+	kprintf("Trace: %lu events, %lu lost\n",
+		(unsigned long)dump.hdr.count, (unsigned long)dump.hdr.lost);
+	ASSERT(dump.hdr.magic == TRACE_MAGIC);
+	ASSERT(dump.hdr.version == TRACE_VERSION);
+	ASSERT(dump.hdr.freq == TIMER_HW_HPTICKS_PER_SEC);
+	/* The buffer has wrapped around */
+	ASSERT(dump.hdr.count == CONFIG_KERN_TRACE_SIZE);
+	ASSERT(dump.hdr.lost > 0);
+
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < dump.hdr.count; i++)
+	{
+		const TraceEvent *ev = &dump.ev[i];
+
+		if (i)
+			ASSERT((int32_t)(ev->time - dump.ev[i - 1].time) >= 0);
+
+		ASSERT(ev->type >= TRACE_SWITCH && ev->type <= TRACE_IRQ_EXIT);
+		count[ev->type]++;
+
+		if (ev->type == TRACE_SEM_OBTAIN)
+		{
+			ASSERT(ev->obj == (uint32_t)(uintptr_t)&sem);
+			contended += ev->arg;
+		}
+		if (ev->type == TRACE_MSG_GET)
+			ASSERT(ev->obj == (uint32_t)(uintptr_t)&port && ev->arg == 1);
+		/* The whole mask is recorded, system signals included */
+		if (ev->type == TRACE_SIG_SEND || ev->type == TRACE_SIG_WAIT)
+			ASSERT(ev->arg && ev->arg == (sigmask_t)ev->arg);
+		if (ev->type == TRACE_SIG_WAIT && (ev->arg & SIG_SINGLE))
+			single++;
+	}
+
+	ASSERT(count[TRACE_SWITCH]);
+	ASSERT(count[TRACE_SIG_SEND]);
+	ASSERT(count[TRACE_SIG_WAIT]);
+	ASSERT(count[TRACE_SEM_RELEASE]);
+	ASSERT(count[TRACE_MSG_PUT]);
+	ASSERT(count[TRACE_MSG_GET]);
+	ASSERT(count[TRACE_TIMER_FIRE]);
+	ASSERT(count[TRACE_IRQ_ENTER]);
+	ASSERT(count[TRACE_IRQ_EXIT]);
+	ASSERT(contended);
+	ASSERT(single);
+
+	return 0;
+}
+
+#else /* !(CONFIG_KERN_TRACE && CONFIG_KERN_SIGNALS && CONFIG_KERN_SEMAPHORES) */
+
+int trace_testRun(void)
+{
+	return 0;
+}
+
+#endif
+
+int trace_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int trace_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(trace);
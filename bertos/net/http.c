@@ -39,6 +39,18 @@
  * Quering from browser the /status page, the server return a json dictionary where are store
  * some board status info, like board temperature, up-time, etc.
  *
+ * Each connection has its own request buffer, where the request is read
+ * until the end of its header and its body (if any). Requests after the
+ * first one on a persistent connection are read from the same buffer, so
+ * pipelined requests are served in order. With CONFIG_HTTP_WORKERS,
+ * http_poll() only accepts the clients, which are queued to a pool of
+ * worker processes.
+ *
+ * The CGI table is compiled by http_init() in two hash tables, one for
+ * the whole names and one for the extensions, plus the list of the
+ * substring entries, so that a lookup does not compare the name against
+ * the whole table.
+ *
  * notest: avr
  */
 
@@ -54,29 +66,65 @@
 #define LOG_VERBOSITY     HTTP_LOG_FORMAT
 #include <cfg/log.h>
 
+#include <struct/hashtable.h>
+
+#include <lwip/tcp.h>
+#include <lwip/tcpip.h>
+
+#if CONFIG_HTTP_WORKERS
+	#include <kern/proc.h>
+	#include <kern/msg.h>
+#endif
+
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static struct {	const char *key; const char *content; } http_content_type[] =
+#if CONFIG_HTTP_KEEPALIVE_TIMEOUT && !LWIP_SO_RCVTIMEO
+	#error "Persistent connections need LWIP_SO_RCVTIMEO"
+#endif
+
+static const struct { const char *key; const char *mime; } http_content_type[] =
 {
-	{"",    "Content-type: application/json\r\n\r\n"},
-	{"htm", "Content-type: text/html\r\n\r\n"},
-	{"css", "Content-type: text/css\r\n\r\n"},
-	{"js",  "Content-type: text/javascript\r\n\r\n"},
-	{"png", "Content-type: image/png\r\n\r\n"},
-	{"jpg", "Content-type: image/jpeg\r\n\r\n"},
-	{"gif", "Content-type: image/gif\r\n\r\n"},
-	{"txt", "Content-type: text/plain\r\n\r\n"},
+	{"",    "application/json"},
+	{"htm", "text/html"},
+	{"css", "text/css"},
+	{"js",  "text/javascript"},
+	{"png", "image/png"},
+	{"jpg", "image/jpeg"},
+	{"gif", "image/gif"},
+	{"txt", "text/plain"},
 };
 
-static const char http_html_hdr_200[] = "HTTP/1.0 200 OK\r\n";
-static const char http_html_hdr_404[] = "HTTP/1.0 404 Not Found\r\n";
-static const char http_html_hdr_500[] = "HTTP/1.0 500 Internal Server Error\r\n";
+/* Longest extra header lines of http_sendHeaderExtra() */
+#define HTTP_HDR_EXTRA  128
+/* Longest response header */
+#define HTTP_HDR_SIZE   (160 + HTTP_HDR_EXTRA)
+
+#if CONFIG_HTTP_WORKERS
+	#define HTTP_CONNS  CONFIG_HTTP_WORKERS
+#else
+	#define HTTP_CONNS  1
+#endif
+
+/* State of a client connection */
+typedef struct HttpConn
+{
+	struct netconn *client;
+	struct netbuf *rx;      ///< Received data not copied in req yet
+	u16_t rx_off;           ///< Bytes of rx already copied
+	size_t len;             ///< Bytes in req
+	bool keep_alive;        ///< Keep the connection after the response
+	bool framed;            ///< The response had a content length
+	char page[80];          ///< Page name of the current request
+	char req[CONFIG_HTTP_REQ_SIZE + 1];
+} HttpConn;
+
+static HttpConn http_conns[HTTP_CONNS];
 
 static HttpCGI *cgi_table;
 static http_handler_t http_callback;
-static char decoded_str[80];
 
 /**
  * Get key value from tokenized buffer
@@ -88,6 +136,7 @@ int http_getValue(char *tolenized_buf, size_t tolenized_buf_len, const char *key
 
 	char *p = tolenized_buf;
 	size_t value_len = 0;
+	char decoded_str[80];
 
 	memset(value, 0, len);
 
@@ -251,17 +300,92 @@ int http_searchContentType(const char *name)
 }
 
 
+static const char *http_reason(int status)
+{
+	switch (status)
+	{
+	case 200:
+		return "OK";
+	case 304:
+		return "Not Modified";
+	case 404:
+		return "Not Found";
+	default:
+		return "Internal Server Error";
+	}
+}
+
+static HttpConn *http_conn(struct netconn *client)
+{
+	for (int i = 0; i < HTTP_CONNS; i++)
+		if (http_conns[i].client == client)
+			return &http_conns[i];
+
+	return NULL;
+}
+
+/**
+ * Send on \param client socket the http header with \param status code and
+ * select \param content_type, followed by the \param extra header lines,
+ * each one ending with "\r\n".
+ *
+ * If \param len is the length of the content that follows, the connection
+ * is kept open for the next request; with HTTP_LEN_UNKNOWN the connection
+ * is closed at the end of the response. 304 responses have no content.
+ */
+void http_sendHeaderExtra(struct netconn *client, int status, int content_type, size_t len, const char *extra)
+{
+	HttpConn *conn = http_conn(client);
+	char hdr[HTTP_HDR_SIZE];
+	int n;
+
+	ASSERT(content_type < HTTP_CONTENT_CNT);
+	ASSERT(!extra || strlen(extra) < HTTP_HDR_EXTRA);
+
+	n = sprintf(hdr, "HTTP/1.1 %d %s\r\n", status, http_reason(status));
+
+	if (status != 304)
+	{
+		n += sprintf(hdr + n, "Content-type: %s\r\n", http_content_type[content_type].mime);
+		if (len != HTTP_LEN_UNKNOWN)
+			n += sprintf(hdr + n, "Content-Length: %lu\r\n", (unsigned long)len);
+	}
+
+	if (extra)
+		n += sprintf(hdr + n, "%s", extra);
+
+	if (conn)
+	{
+		conn->framed = (status == 304 || len != HTTP_LEN_UNKNOWN);
+		if (!conn->framed)
+			conn->keep_alive = false;
+	}
+
+	n += sprintf(hdr + n, "Connection: %s\r\n\r\n",
+			conn && conn->keep_alive ? "keep-alive" : "close");
+	ASSERT(n < HTTP_HDR_SIZE);
+
+	netconn_write(client, hdr, n, NETCONN_COPY);
+}
+
+/**
+ * Send on \param client socket the http header with \param status code and
+ * select \param content_type.
+ *
+ * \see http_sendHeaderExtra()
+ */
+void http_sendHeader(struct netconn *client, int status, int content_type, size_t len)
+{
+	http_sendHeaderExtra(client, status, content_type, len, NULL);
+}
+
 /**
  * Send on \param client socket the 200 Ok http header with
  * select \param content_type
  */
 void http_sendOk(struct netconn *client, int content_type)
 {
-	ASSERT(content_type < HTTP_CONTENT_CNT);
-
-	netconn_write(client, http_html_hdr_200, sizeof(http_html_hdr_200) - 1, NETCONN_NOCOPY);
-	netconn_write(client, http_content_type[content_type].content,
-			strlen(http_content_type[content_type].content), NETCONN_NOCOPY);
+	http_sendHeader(client, 200, content_type, HTTP_LEN_UNKNOWN);
 }
 
 
@@ -271,11 +395,7 @@ void http_sendOk(struct netconn *client, int content_type)
  */
 void http_sendFileNotFound(struct netconn *client, int content_type)
 {
-	ASSERT(content_type < HTTP_CONTENT_CNT);
-
-	netconn_write(client, http_html_hdr_404, sizeof(http_html_hdr_404) - 1, NETCONN_NOCOPY);
-	netconn_write(client, http_content_type[content_type].content,
-			strlen(http_content_type[content_type].content), NETCONN_NOCOPY);
+	http_sendHeader(client, 404, content_type, HTTP_LEN_UNKNOWN);
 }
 
 /**
@@ -284,18 +404,132 @@ void http_sendFileNotFound(struct netconn *client, int content_type)
  */
 void http_sendInternalErr(struct netconn *client, int content_type)
 {
-	ASSERT(content_type < HTTP_CONTENT_CNT);
+	http_sendHeader(client, 500, content_type, HTTP_LEN_UNKNOWN);
+}
+
+static int asset_cmp(const void *name, const void *asset)
+{
+	return strcmp((const char *)name, ((const HttpAsset *)asset)->name);
+}
+
+/**
+ * Look for the page \param name in \param bundle.
+ *
+ * \return the asset, NULL if missing.
+ */
+const HttpAsset *http_bundleFind(const HttpBundle *bundle, const char *name)
+{
+	return (const HttpAsset *)bsearch(name, bundle->assets, bundle->count,
+			sizeof(HttpAsset), asset_cmp);
+}
+
+/**
+ * Send \param asset on \param client socket, replying to the request in
+ * \param recv_buf.
+ *
+ * The content is written straight from the bundle, without copying it.
+ * The compressed content is sent to the clients accepting gzip (to all of
+ * them if there is no plain one), and only the 304 Not Modified header to
+ * the clients that already have the asset (If-None-Match).
+ */
+void http_sendAsset(struct netconn *client, const HttpAsset *asset, const char *recv_buf, size_t recv_len)
+{
+	char value[80];
+	char extra[HTTP_HDR_EXTRA];
+	const uint8_t *data = asset->data;
+	size_t len = asset->len;
+	int n;
+
+	/* Leave room for the other lines */
+	ASSERT(strlen(asset->etag) < HTTP_HDR_EXTRA / 2);
+	n = sprintf(extra, "ETag: %s\r\n", asset->etag);
+
+	if (http_getHeader(recv_buf, recv_len, "If-None-Match", value, sizeof(value)) > 0
+		&& (strstr(value, asset->etag) || !strcmp(value, "*")))
+	{
+		http_sendHeaderExtra(client, 304, asset->type, 0, extra);
+		return;
+	}
+
+	if (asset->gz_data)
+	{
+		if (asset->data)
+			n += sprintf(extra + n, "Vary: Accept-Encoding\r\n");
+
+		if (!asset->data
+			|| (http_getHeader(recv_buf, recv_len, "Accept-Encoding", value, sizeof(value)) > 0
+				&& strstr(value, "gzip")))
+		{
+			data = asset->gz_data;
+			len = asset->gz_len;
+			sprintf(extra + n, "Content-Encoding: gzip\r\n");
+		}
+	}
 
-	netconn_write(client, http_html_hdr_500, sizeof(http_html_hdr_500) - 1, NETCONN_NOCOPY);
-	netconn_write(client, http_content_type[content_type].content,
-			strlen(http_content_type[content_type].content), NETCONN_NOCOPY);
+	http_sendHeaderExtra(client, 200, asset->type, len, extra);
+	if (len)
+		netconn_write(client, data, len, NETCONN_NOCOPY);
 }
 
-static http_handler_t cgi_search(const char *name,  HttpCGI *table)
+static const void *cgi_getKey(const void *data, uint8_t *key_length)
 {
+	const HttpCGI *cgi = (const HttpCGI *)data;
+
+	*key_length = strlen(cgi->name);
+	return cgi->name;
+}
+
+DECLARE_HASHTABLE_STATIC(cgi_words, CONFIG_HTTP_CGI_SLOTS, cgi_getKey);
+DECLARE_HASHTABLE_STATIC(cgi_exts, CONFIG_HTTP_CGI_SLOTS, cgi_getKey);
+
+/* Entries matching a substring, in table order */
+static const HttpCGI *cgi_names[CONFIG_HTTP_CGI_SLOTS + 1];
+static const HttpCGI *cgi_end;
+static bool cgi_compiled;
+
+static bool cgi_add(struct HashTable *ht, const HttpCGI *cgi)
+{
+	/* Keep the first entry of the table with the same name */
+	if (ht_find_str(ht, cgi->name))
+		return true;
+
+	return ht_insert(ht, cgi);
+}
+
+static void cgi_compile(const HttpCGI *table)
+{
+	const HttpCGI *cgi;
+	int names = 0;
+
+	ht_init(&cgi_words);
+	ht_init(&cgi_exts);
+	cgi_compiled = false;
+
 	if (!table)
-		return NULL;
+		return;
 
+	for (cgi = table; cgi->name; cgi++)
+	{
+		if (cgi->type == CGI_MATCH_NAME)
+		{
+			if (names == CONFIG_HTTP_CGI_SLOTS)
+				goto full;
+			cgi_names[names++] = cgi;
+		}
+		else if (!cgi_add(cgi->type == CGI_MATCH_EXT ? &cgi_exts : &cgi_words, cgi))
+			goto full;
+	}
+	cgi_names[names] = NULL;
+	cgi_end = cgi;
+	cgi_compiled = true;
+	return;
+
+full:
+	LOG_WARN("CGI table too big, increase CONFIG_HTTP_CGI_SLOTS\n");
+}
+
+static http_handler_t cgi_walk(const char *name,  HttpCGI *table)
+{
 	int i = 0;
 	const char *ext = get_ext(name);
 
@@ -335,56 +569,387 @@ static http_handler_t cgi_search(const char *name,  HttpCGI *table)
 	return table[i].handler;
 }
 
-static char req_string[80];
+/*
+ * Same result of cgi_walk(): the first entry of the table matching \a name.
+ * Extension entries are compared with the whole name when it has no
+ * extension.
+ */
+static http_handler_t cgi_search(const char *name)
+{
+	const HttpCGI *cgi, *match;
+
+	if (!cgi_table)
+		return NULL;
+
+	if (!cgi_compiled)
+		return cgi_walk(name, cgi_table);
+
+	const char *ext = get_ext(name);
+
+	match = (const HttpCGI *)ht_find_str(&cgi_words, name);
+	cgi = (const HttpCGI *)ht_find_str(&cgi_exts, ext ? ext : name);
+	if (cgi && (!match || cgi < match))
+		match = cgi;
+
+	for (int i = 0; cgi_names[i] && (!match || cgi_names[i] < match); i++)
+	{
+		if (strstr(name, cgi_names[i]->name))
+		{
+			match = cgi_names[i];
+			break;
+		}
+	}
+
+	if (!match)
+		return cgi_end->handler;
+
+	LOG_INFO("Match: %s\n", match->name);
+	return match->handler;
+}
+
+/*
+ * Copy the next received data in the request buffer.
+ *
+ * \return false if the connection has been closed by the client or it has
+ * been idle for CONFIG_HTTP_KEEPALIVE_TIMEOUT ms.
+ */
+static bool http_recv(HttpConn *conn)
+{
+	u16_t n;
+
+	if (!conn->rx)
+	{
+		conn->rx = netconn_recv(conn->client);
+		if (!conn->rx)
+			return false;
+		conn->rx_off = 0;
+	}
+
+	n = netbuf_copy_partial(conn->rx, conn->req + conn->len,
+			CONFIG_HTTP_REQ_SIZE - conn->len, conn->rx_off);
+	conn->len += n;
+	conn->rx_off += n;
+
+	if (conn->rx_off == netbuf_len(conn->rx))
+	{
+		netbuf_delete(conn->rx);
+		conn->rx = NULL;
+	}
+
+	return true;
+}
+
+/*
+ * Return the length of the request header up to the empty line, 0 if it
+ * has not been received yet. \a scanned keeps track of the bytes already
+ * searched.
+ */
+static size_t http_headerLen(const char *buf, size_t len, size_t *scanned)
+{
+	for (size_t i = *scanned; i + 1 < len; i++)
+	{
+		if (buf[i] != '\n')
+			continue;
+		if (buf[i + 1] == '\n')
+			return i + 2;
+		if (buf[i + 1] == '\r' && i + 2 < len && buf[i + 2] == '\n')
+			return i + 3;
+	}
+
+	*scanned = len > 2 ? len - 2 : 0;
+	return 0;
+}
+
+/* Case insensitive search of \a token (in lower case) between \a p and \a end */
+static bool http_hasToken(const char *p, const char *end, const char *token)
+{
+	size_t len = strlen(token);
+
+	for (; p + len <= end; p++)
+	{
+		size_t i;
+
+		for (i = 0; i < len; i++)
+			if (tolower((unsigned char)p[i]) != token[i])
+				break;
+		if (i == len)
+			return true;
+	}
+
+	return false;
+}
+
+/* Return the value of the header \a line if it is the \a name one */
+static const char *http_headerValue(const char *line, const char *end, const char *name)
+{
+	for (; *name; name++, line++)
+		if (line == end || tolower((unsigned char)*line) != tolower((unsigned char)*name))
+			return NULL;
+
+	if (line == end || *line++ != ':')
+		return NULL;
+
+	while (line < end && (*line == ' ' || *line == '\t'))
+		line++;
+
+	return line;
+}
 
 /**
- * Http polling function.
+ * Get the value of the header \param name of the request in \param recv_buf.
+ * The header names are compared ignoring the case.
  *
- * Call this functions to process each client connections.
+ * \return the length of the value copied in \param value, -1 if the header
+ * is missing or its value does not fit in \param len bytes.
+ */
+int http_getHeader(const char *recv_buf, size_t recv_len, const char *name, char *value, size_t len)
+{
+	const char *line, *eol, *p;
+	const char *end = recv_buf + recv_len;
+	size_t value_len;
+
+	for (line = recv_buf; (eol = memchr(line, '\n', end - line)); line = eol + 1)
+	{
+		/* Empty line, end of the header */
+		if (line == eol || (line[0] == '\r' && line + 1 == eol))
+			break;
+
+		if (!(p = http_headerValue(line, eol, name)))
+			continue;
+
+		value_len = eol - p;
+		if (value_len && p[value_len - 1] == '\r')
+			value_len--;
+		if (value_len >= len)
+			return -1;
+
+		memcpy(value, p, value_len);
+		value[value_len] = '\0';
+		return value_len;
+	}
+
+	return -1;
+}
+
+/*
+ * Look for the headers we are interested in: HTTP/1.1 connections are
+ * persistent unless the client asks to close them.
  *
+ * \return the length of the request body.
  */
-void http_poll(struct netconn *server)
+static size_t http_parseHeader(HttpConn *conn, size_t hdr_len)
 {
-	struct netconn *client;
-	struct netbuf *rx_buf_conn;
-	char *rx_buf;
-	uint16_t len;
+	const char *line, *eol, *value;
+	const char *end = conn->req + hdr_len;
+	size_t body_len = 0;
 
-	client = netconn_accept(server);
-	if (!client)
-		return;
+	for (line = conn->req; (eol = memchr(line, '\n', end - line)); line = eol + 1)
+	{
+		if (line == conn->req)
+			conn->keep_alive = http_hasToken(line, eol, "http/1.1");
+		else if ((value = http_headerValue(line, eol, "connection")))
+		{
+			if (http_hasToken(value, eol, "close"))
+				conn->keep_alive = false;
+			else if (http_hasToken(value, eol, "keep-alive"))
+				conn->keep_alive = true;
+		}
+		else if ((value = http_headerValue(line, eol, "content-length")))
+			body_len = strtoul(value, NULL, 10);
+	}
+
+	return body_len;
+}
+
+/*
+ * Read the next request in the connection buffer, it can be split over
+ * several segments or follow the previous one in the same segment.
+ *
+ * \return the length of the request, header and body, or 0 if the
+ * connection has to be closed.
+ */
+static size_t http_readRequest(HttpConn *conn)
+{
+	size_t hdr_len = 0, body_len = 0, scanned = 0;
 
-	rx_buf_conn = netconn_recv(client);
-	if (rx_buf_conn)
+	for (;;)
 	{
-		netbuf_data(rx_buf_conn, (void **)&rx_buf, &len);
-		if (rx_buf)
+		if (!hdr_len)
 		{
-			memset(req_string, 0, sizeof(req_string));
-			http_getPageName(rx_buf, len, req_string, sizeof(req_string));
+			hdr_len = http_headerLen(conn->req, conn->len, &scanned);
+			if (hdr_len)
+				body_len = http_parseHeader(conn, hdr_len);
+		}
 
-			if (req_string[0] == '\0')
-				strcpy(req_string, HTTP_DEFAULT_PAGE);
+		if (hdr_len)
+		{
+			if (body_len > CONFIG_HTTP_REQ_SIZE - hdr_len)
+				break;
+			if (conn->len >= hdr_len + body_len)
+				return hdr_len + body_len;
+		}
+		else if (conn->len == CONFIG_HTTP_REQ_SIZE)
+			break;
 
-			http_handler_t cgi = cgi_search(req_string, cgi_table);
-			if (cgi)
-			{
-				if (cgi(client, req_string, rx_buf, len) < 0)
-				{
-					LOG_ERR("Internal server error\n");
-					http_sendInternalErr(client, HTTP_CONTENT_HTML);
-					netconn_write(client, http_server_error, http_server_error_len - 1, NETCONN_NOCOPY);
-				}
-			}
-			else
-			{
-				http_callback(client, req_string, rx_buf, len);
-			}
+		if (!http_recv(conn))
+			return 0;
+	}
+
+	LOG_ERR("Request too long\n");
+	return 0;
+}
+
+static void http_dispatch(HttpConn *conn, size_t req_len)
+{
+	struct netconn *client = conn->client;
+
+	http_getPageName(conn->req, req_len, conn->page, sizeof(conn->page));
+
+	if (conn->page[0] == '\0')
+		strcpy(conn->page, HTTP_DEFAULT_PAGE);
+
+	http_handler_t cgi = cgi_search(conn->page);
+	if (cgi)
+	{
+		if (cgi(client, conn->page, conn->req, req_len) < 0)
+		{
+			LOG_ERR("Internal server error\n");
+			conn->keep_alive = false;
+			http_sendHeader(client, 500, HTTP_CONTENT_HTML, http_server_error_len - 1);
+			netconn_write(client, http_server_error, http_server_error_len - 1, NETCONN_NOCOPY);
 		}
-		netconn_close(client);
-		netbuf_delete(rx_buf_conn);
 	}
+	else
+	{
+		http_callback(client, conn->page, conn->req, req_len);
+	}
+}
+
+/* Disable Nagle on \a arg connection, called in the tcpip thread */
+static void http_noDelay(void *arg)
+{
+	struct netconn *client = (struct netconn *)arg;
+
+	/* The pcb is gone if the connection has been reset meanwhile */
+	if (client->pcb.tcp)
+		tcp_nagle_disable(client->pcb.tcp);
+}
+
+/* Serve all the requests of \a client, then close the connection */
+static void http_serve(HttpConn *conn, struct netconn *client)
+{
+	size_t req_len;
+	char next;
+
+	conn->client = client;
+	conn->rx = NULL;
+	conn->len = 0;
+	#if LWIP_SO_RCVTIMEO
+		client->recv_timeout = CONFIG_HTTP_KEEPALIVE_TIMEOUT;
+	#endif
+	/*
+	 * Responses are written in pieces, don't wait the ack of the header
+	 * to send the content. The pcb belongs to the tcpip thread, so the
+	 * option is set from there; the message is handled before the ones
+	 * of the following netconn calls.
+	 */
+	tcpip_callback(http_noDelay, client);
+
+	for (int requests = 1; (req_len = http_readRequest(conn)); requests++)
+	{
+		if (!CONFIG_HTTP_KEEPALIVE_TIMEOUT || requests >= CONFIG_HTTP_KEEPALIVE_MAX)
+			conn->keep_alive = false;
+		conn->framed = false;
+
+		/* Handlers can use the request as a string */
+		next = conn->req[req_len];
+		conn->req[req_len] = '\0';
+		http_dispatch(conn, req_len);
+		conn->req[req_len] = next;
+
+		/* Responses without a length end with the connection */
+		if (!conn->keep_alive || !conn->framed)
+			break;
+
+		conn->len -= req_len;
+		memmove(conn->req, conn->req + req_len, conn->len);
+	}
+
+	netconn_close(client);
+	if (conn->rx)
+		netbuf_delete(conn->rx);
 	netconn_delete(client);
+	conn->client = NULL;
+}
+
+#if CONFIG_HTTP_WORKERS
+
+static MsgQueue http_accepted;
+static struct netconn *http_accepted_buf[CONFIG_HTTP_ACCEPT_QUEUE];
+static bool http_started;
+
+#if !CONFIG_KERN_HEAP
+	STATIC_ASSERT(CONFIG_HTTP_WORKER_STACK >= KERN_MINSTACKSIZE);
+	static cpu_stack_t http_stacks[CONFIG_HTTP_WORKERS]
+		[(CONFIG_HTTP_WORKER_STACK + sizeof(cpu_stack_t) - 1) / sizeof(cpu_stack_t)];
+#endif
+
+static void http_worker(void)
+{
+	HttpConn *conn = (HttpConn *)proc_currentUserData();
+	struct netconn *client;
+
+	for (;;)
+	{
+		msgq_recv(&http_accepted, &client);
+		http_serve(conn, client);
+	}
+}
+
+static void http_startWorkers(void)
+{
+	if (http_started)
+		return;
+
+	msgq_init(&http_accepted, http_accepted_buf, sizeof(http_accepted_buf[0]), CONFIG_HTTP_ACCEPT_QUEUE);
+
+	for (int i = 0; i < CONFIG_HTTP_WORKERS; i++)
+	{
+		#if CONFIG_KERN_HEAP
+			struct Process *p = proc_new_with_name("http", http_worker, (iptr_t)&http_conns[i],
+					CONFIG_HTTP_WORKER_STACK, NULL);
+		#else
+			struct Process *p = proc_new_with_name("http", http_worker, (iptr_t)&http_conns[i],
+					sizeof(http_stacks[i]), http_stacks[i]);
+		#endif
+		ASSERT(p);
+		(void)p;
+	}
+	http_started = true;
+}
+
+#endif /* CONFIG_HTTP_WORKERS */
+
+/**
+ * Http polling function.
+ *
+ * Call this functions to process each client connections.
+ * With CONFIG_HTTP_WORKERS the accepted client is queued to the
+ * workers, otherwise it is served before returning.
+ */
+void http_poll(struct netconn *server)
+{
+	struct netconn *client;
+
+	client = netconn_accept(server);
+	if (!client)
+		return;
+
+	#if CONFIG_HTTP_WORKERS
+		msgq_send(&http_accepted, &client);
+	#else
+		http_serve(&http_conns[0], client);
+	#endif
 }
 
 /**
@@ -396,6 +961,8 @@ void http_poll(struct netconn *server)
  * In this way the user could filter some client request and redirect they to custom callback, i.e.
  * the client could request status of the device only loading the particular page name.
  *
+ * With CONFIG_HTTP_WORKERS the worker processes are started here.
+ *
  * \param default_callback fuction that server call for all request, that does'nt match cgi table.
  * \param table of callcack to call when client request a particular page.
  */
@@ -404,6 +971,11 @@ void http_init(http_handler_t default_callback, struct HttpCGI *table)
 	ASSERT(default_callback);
 
 	cgi_table = table;
+	cgi_compile(table);
 	http_callback = default_callback;
+
+	#if CONFIG_HTTP_WORKERS
+		http_startWorkers();
+	#endif
 }
 
@@ -32,11 +32,21 @@
  *
  * \brief Simple HTTP server
  *
+ * Requests are read in a per connection buffer, so they can span several
+ * TCP segments and be pipelined. The response headers sent with a content
+ * length (http_sendHeader()) keep the connection open for the next request
+ * when CONFIG_HTTP_KEEPALIVE_TIMEOUT is set; the other ones close it after
+ * the response, which is delimited by the end of the connection.
+ *
+ * Static pages can be packed in a bundle by bertos/net/http_bundle.py
+ * and served from flash with http_sendAsset(), without copying them and
+ * answering 304 Not Modified to the clients that already have them.
+ *
  * \author Daniele Basile <asterix@develer.com>
  *
  * $WIZ$ module_name = "http"
  * $WIZ$ module_configuration = "bertos/cfg/cfg_http.h"
- * $WIZ$ module_depends = "lwip", "kfile", "sd"
+ * $WIZ$ module_depends = "lwip", "kfile", "sd", "hashtable", "kernel", "msg"
  * $WIZ$ module_hw = "bertos/hw/hw_http.h", "bertos/hw/hw_http.c"
  */
 
@@ -74,16 +84,48 @@ enum
 #define CGI_MATCH_EXT    2  ///< Select item in table if the extention match
 #define CGI_MATCH_NAME   3  ///< Select item in table if the string is content
 
+/// Content length of responses delimited by the end of the connection.
+#define HTTP_LEN_UNKNOWN  ((size_t)-1)
+
+/**
+ * Static page of a bundle, generated by http_bundle.py.
+ */
+typedef struct HttpAsset
+{
+	const char *name;       ///< Page name, without the leading '/'
+	int type;               ///< Content type, HTTP_CONTENT_*
+	const char *etag;       ///< Entity tag, quoted
+	const uint8_t *data;    ///< Plain content, NULL if only compressed
+	size_t len;             ///< Length of the plain content
+	const uint8_t *gz_data; ///< Gzip compressed content, NULL if not smaller
+	size_t gz_len;          ///< Length of the compressed content
+} HttpAsset;
+
+/**
+ * Bundle of static pages, sorted by name.
+ */
+typedef struct HttpBundle
+{
+	const HttpAsset *assets;
+	size_t count;
+} HttpBundle;
+
 int http_getValue(char *tolenized_buf, size_t tolenized_buf_len, const char *key, char *value, size_t len);
 int http_tokenizeGetRequest(char *raw_buf, size_t raw_len);
 void http_getPageName(const char *recv_buf, size_t recv_len, char *page_name, size_t len);
 size_t http_decodeUrl(const char *raw_buf, size_t raw_len, char *decodec_buf, size_t len);
 int http_searchContentType(const char *name);
+int http_getHeader(const char *recv_buf, size_t recv_len, const char *name, char *value, size_t len);
 
+void http_sendHeader(struct netconn *client, int status, int content_type, size_t len);
+void http_sendHeaderExtra(struct netconn *client, int status, int content_type, size_t len, const char *extra);
 void http_sendOk(struct netconn *client, int content_type);
 void http_sendFileNotFound(struct netconn *client, int content_type);
 void http_sendInternalErr(struct netconn *client, int content_type);
 
+const HttpAsset *http_bundleFind(const HttpBundle *bundle, const char *name);
+void http_sendAsset(struct netconn *client, const HttpAsset *asset, const char *recv_buf, size_t recv_len);
+
 void http_poll(struct netconn *server);
 void http_init(http_handler_t default_callback, struct HttpCGI *table);
 
@@ -0,0 +1,158 @@
+#!/usr/bin/env python
+# This file is part of BeRTOS.
+#
+# Bertos is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As a special exception, you may use this file as part of a free software
+# library without restriction.  Specifically, if other files instantiate
+# templates or use macros or inline functions from this file, or you compile
+# this file and link it with other files to produce an executable, this
+# file does not by itself cause the resulting executable to be covered by
+# the GNU General Public License.  This exception does not however
+# invalidate any other reasons why the executable file might be covered by
+# the GNU General Public License.
+#
+# Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+#
+# Pack a directory of static web pages in a C source file, to be served
+# by the HTTP server straight from flash (see http_sendAsset() in
+# bertos/net/http.c).
+#
+# Usage: http_bundle.py [-n NAME] [-o out.c] [--gzip-only] DIR
+#
+# Each file gets the content type http_searchContentType() would pick,
+# its length and an ETag. When gzip makes it smaller, the compressed body
+# is stored too and sent to the clients accepting it; with --gzip-only
+# the plain body is dropped for those files, to save flash, and they are
+# sent compressed to every client.
+#
+# The generated file defines "const HttpBundle NAME" (www_bundle by default).
+
+import gzip
+import io
+import os
+import sys
+import zlib
+from optparse import OptionParser
+
+# Mirrors http_content_type[] and http_searchContentType() in http.c
+CONTENT_TYPES = {
+	"htm": "HTTP_CONTENT_HTML",
+	"css": "HTTP_CONTENT_CSS",
+	"js":  "HTTP_CONTENT_JS",
+	"png": "HTTP_CONTENT_PNG",
+	"jpg": "HTTP_CONTENT_JPEG",
+	"gif": "HTTP_CONTENT_GIF",
+	"txt": "HTTP_CONTENT_PLAIN",
+	"ico": "HTTP_CONTENT_JPEG",
+}
+
+def content_type(name):
+	# The extension starts at the first dot, as in get_ext()
+	dot = name.find(".")
+	if dot < 0:
+		return "HTTP_CONTENT_JSON"
+	return CONTENT_TYPES.get(name[dot + 1:], "HTTP_CONTENT_JSON")
+
+def compress(data):
+	buf = io.BytesIO()
+	# No name nor time in the header, so that the output is reproducible
+	f = gzip.GzipFile(filename="", mode="wb", compresslevel=9, fileobj=buf, mtime=0)
+	f.write(data)
+	f.close()
+	return buf.getvalue()
+
+def scan(root):
+	files = []
+	for dirpath, dirnames, filenames in os.walk(root):
+		dirnames[:] = [d for d in dirnames if not d.startswith(".")]
+		for f in filenames:
+			if f.startswith("."):
+				continue
+			path = os.path.join(dirpath, f)
+			name = os.path.relpath(path, root).replace(os.sep, "/")
+			files.append((name, path))
+	# The server looks them up with a binary search
+	files.sort(key=lambda f: f[0].encode("utf-8"))
+	return files
+
+def c_array(out, name, data):
+	out.write("static const uint8_t %s[] =\n{\n" % name)
+	for i in range(0, len(data), 12):
+		out.write("\t" + " ".join("0x%02x," % b for b in bytearray(data[i:i + 12])) + "\n")
+	out.write("};\n\n")
+
+def c_string(s):
+	return '"%s"' % s.replace("\\", "\\\\").replace('"', '\\"')
+
+def pack(out, root, name, gzip_only):
+	files = scan(root)
+	assets = []
+	plain_size = stored_size = 0
+
+	out.write("/* Generated by http_bundle.py from %s, do not edit. */\n\n" % root)
+	out.write("#include <net/http.h>\n\n")
+
+	for i, (file_name, path) in enumerate(files):
+		with open(path, "rb") as f:
+			data = f.read()
+		etag = '"%08x"' % (zlib.crc32(data) & 0xffffffff)
+
+		gz = compress(data)
+		if len(gz) >= len(data):
+			gz = None
+
+		plain = "NULL"
+		if not gz or not gzip_only:
+			plain = "%s_asset%d" % (name, i)
+			c_array(out, plain, data)
+			stored_size += len(data)
+		compressed = "NULL"
+		if gz:
+			compressed = "%s_asset%d_gz" % (name, i)
+			c_array(out, compressed, gz)
+			stored_size += len(gz)
+		plain_size += len(data)
+
+		assets.append("\t{ %s, %s, %s, %s, %d, %s, %d },\n" % (c_string(file_name),
+			content_type(file_name), c_string(etag), plain,
+			len(data) if plain != "NULL" else 0, compressed, len(gz) if gz else 0))
+
+	out.write("static const HttpAsset %s_assets[] =\n{\n" % name)
+	out.writelines(assets)
+	out.write("};\n\n")
+	out.write("const HttpBundle %s = { %s_assets, %d };\n" % (name, name, len(assets)))
+
+	return len(assets), plain_size, stored_size
+
+def main():
+	parser = OptionParser(usage="%prog [-n NAME] [-o out.c] [--gzip-only] DIR")
+	parser.add_option("-n", "--name", default="www_bundle",
+		help="name of the HttpBundle variable")
+	parser.add_option("-o", "--output", help="output file, stdout if missing")
+	parser.add_option("--gzip-only", action="store_true", default=False,
+		help="drop the plain body of the compressed files")
+	options, args = parser.parse_args()
+	if len(args) != 1 or not os.path.isdir(args[0]):
+		parser.error("a directory to pack is needed")
+
+	out = open(options.output, "w") if options.output else sys.stdout
+	count, plain_size, stored_size = pack(out, args[0], options.name, options.gzip_only)
+	if options.output:
+		out.close()
+	sys.stderr.write("%d files, %d bytes, %d stored\n" % (count, plain_size, stored_size))
+
+if __name__ == "__main__":
+	main()
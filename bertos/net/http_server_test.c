@@ -0,0 +1,637 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief HTTP server over the loopback interface test.
+ *
+ * Clients connect to the server through the lwIP loopback interface,
+ * checking persistent connections, pipelined and split requests, the
+ * CGI table dispatch and that a slow client does not stall the other
+ * ones. Pages of a bundle packed by http_bundle.py are served compressed
+ * or not and revalidated. Then the requests per second with and without
+ * persistent connections are measured.
+ *
+ * notest: avr
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ * $test$: cp bertos/cfg/cfg_lwip.h $cfgdir/
+ * $test$: echo  "#undef LWIP_HAVE_LOOPIF" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define LWIP_HAVE_LOOPIF 1" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef LWIP_NETIF_LOOPBACK" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define LWIP_NETIF_LOOPBACK 1" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef LWIP_SO_RCVTIMEO" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define LWIP_SO_RCVTIMEO 1" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef MEM_SIZE" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define MEM_SIZE 16000" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef MEMP_NUM_NETCONN" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define MEMP_NUM_NETCONN 8" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef MEMP_NUM_TCP_PCB" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define MEMP_NUM_TCP_PCB 8" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef MEMP_NUM_NETBUF" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define MEMP_NUM_NETBUF 8" >> $cfgdir/cfg_lwip.h
+ * $test$: cp bertos/cfg/cfg_http.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_HTTP_WORKERS" >> $cfgdir/cfg_http.h
+ * $test$: echo "#define CONFIG_HTTP_WORKERS 2" >> $cfgdir/cfg_http.h
+ * $test$: echo  "#undef CONFIG_HTTP_KEEPALIVE_TIMEOUT" >> $cfgdir/cfg_http.h
+ * $test$: echo "#define CONFIG_HTTP_KEEPALIVE_TIMEOUT 1000" >> $cfgdir/cfg_http.h
+ * $test$: echo  "#undef HTTP_LOG_LEVEL" >> $cfgdir/cfg_http.h
+ * $test$: echo "#define HTTP_LOG_LEVEL LOG_LVL_WARN" >> $cfgdir/cfg_http.h
+ * $test$: mkdir -p $testdir/www/css
+ * $test$: for i in $(seq 50); do echo "<p>BeRTOS</p>"; done > $testdir/www/app.htm
+ * $test$: printf 'GIF89a\001\002' > $testdir/www/logo.gif
+ * $test$: echo "body { color: red; }" > $testdir/www/css/style.css
+ * $test$: python bertos/net/http_bundle.py -n test_bundle -o $testdir/test_bundle.c $testdir/www
+ * $test$: python bertos/net/http_bundle.py -n gz_bundle --gzip-only -o $testdir/gz_bundle.c $testdir/www
+ */
+
+#include "lwip.c"
+#include "hw/hw_http.c"
+/* Generated by the $test$ commands */
+#include "test_bundle.c"
+#include "gz_bundle.c"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+
+#include <net/http.h>
+
+#include "cfg/cfg_http.h"
+
+#include <lwip/tcpip.h>
+#include <netif/loopif.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HTTP_PORT     80
+#define RECV_TIMEOUT  2000
+#define BENCH_REQS    1000
+
+/* The ethernet driver wants it, even if we only use the loopback */
+uint8_t mac_addr[6];
+
+static struct netif loop_netif;
+static struct netconn *server;
+static int accepted;
+
+PROC_DEFINE_STACK(acceptor_stack, KERN_MINSTACKSIZE * 4);
+
+typedef struct Client
+{
+	struct netconn *conn;
+	struct netbuf *rx;
+	char buf[1024];
+	char hdr[256];     ///< Header of the last response
+	size_t len;
+	bool closed;
+	bool keep_alive;   ///< The last response keeps the connection
+} Client;
+
+/* Reply with \a body as content of known length */
+static int reply(struct netconn *client, const char *body)
+{
+	http_sendHeader(client, 200, HTTP_CONTENT_PLAIN, strlen(body));
+	netconn_write(client, body, strlen(body), NETCONN_COPY);
+	return 0;
+}
+
+static int word_cgi(struct netconn *client, UNUSED_ARG(const char *, name), UNUSED_ARG(char *, buf), UNUSED_ARG(size_t, len))
+{
+	return reply(client, "word");
+}
+
+static int ext_cgi(struct netconn *client, UNUSED_ARG(const char *, name), UNUSED_ARG(char *, buf), UNUSED_ARG(size_t, len))
+{
+	return reply(client, "ext");
+}
+
+static int name_cgi(struct netconn *client, UNUSED_ARG(const char *, name), UNUSED_ARG(char *, buf), UNUSED_ARG(size_t, len))
+{
+	return reply(client, "name");
+}
+
+static int close_cgi(struct netconn *client, UNUSED_ARG(const char *, name), UNUSED_ARG(char *, buf), UNUSED_ARG(size_t, len))
+{
+	/* Length not known, the end of the connection ends the content */
+	http_sendOk(client, HTTP_CONTENT_PLAIN);
+	netconn_write(client, "closed", 6, NETCONN_NOCOPY);
+	return 0;
+}
+
+static int fail_cgi(UNUSED_ARG(struct netconn *, client), UNUSED_ARG(const char *, name), UNUSED_ARG(char *, buf), UNUSED_ARG(size_t, len))
+{
+	return -1;
+}
+
+static int default_page(struct netconn *client, const char *name, char *buf, size_t len)
+{
+	const HttpAsset *asset;
+	char body[100];
+
+	if (!strncmp(name, "gz/", 3))
+		asset = http_bundleFind(&gz_bundle, name + 3);
+	else
+		asset = http_bundleFind(&test_bundle, name);
+	if (asset)
+	{
+		http_sendAsset(client, asset, buf, len);
+		return 0;
+	}
+
+	snprintf(body, sizeof(body), "default %s", name);
+	return reply(client, body);
+}
+
+static HttpCGI cgi_table[] =
+{
+	{ CGI_MATCH_WORD, "status",      word_cgi  },
+	{ CGI_MATCH_EXT,  "png",         ext_cgi   },
+	/* Matches "cgi-word" before the next entry */
+	{ CGI_MATCH_NAME, "cgi-",        name_cgi  },
+	{ CGI_MATCH_WORD, "cgi-word",    word_cgi  },
+	/* Without extension, compared with the whole name */
+	{ CGI_MATCH_EXT,  "json",        ext_cgi   },
+	{ CGI_MATCH_WORD, "close",       close_cgi },
+	{ CGI_MATCH_WORD, "fail",        fail_cgi  },
+	/* Shadowed by the first "status" entry */
+	{ CGI_MATCH_WORD, "status",      fail_cgi  },
+	{ CGI_MATCH_NONE, NULL,          NULL      },
+};
+
+static void acceptor(void)
+{
+	for (;;)
+	{
+		http_poll(server);
+		accepted++;
+	}
+}
+
+static int client_open(Client *c)
+{
+	struct ip_addr addr;
+
+	memset(c, 0, sizeof(*c));
+	IP4_ADDR(&addr, 127, 0, 0, 1);
+	c->conn = netconn_new(NETCONN_TCP);
+	if (!c->conn)
+		return -1;
+	c->conn->recv_timeout = RECV_TIMEOUT;
+	if (netconn_connect(c->conn, &addr, HTTP_PORT) != ERR_OK)
+		return -1;
+	tcp_nagle_disable(c->conn->pcb.tcp);
+
+	return 0;
+}
+
+static void client_close(Client *c)
+{
+	if (c->rx)
+		netbuf_delete(c->rx);
+	netconn_close(c->conn);
+	netconn_delete(c->conn);
+}
+
+static int client_send(Client *c, const char *req)
+{
+	return netconn_write(c->conn, req, strlen(req), NETCONN_COPY) == ERR_OK ? 0 : -1;
+}
+
+/* Receive some more data, false when the connection is over */
+static bool client_recv(Client *c)
+{
+	struct netbuf *rx;
+	u16_t n;
+
+	if (c->closed)
+		return false;
+
+	rx = netconn_recv(c->conn);
+	if (!rx)
+	{
+		c->closed = true;
+		return false;
+	}
+	n = netbuf_copy(rx, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+	c->len += n;
+	c->buf[c->len] = '\0';
+	netbuf_delete(rx);
+
+	return true;
+}
+
+/*
+ * Read a response, checking its status and content. Without a length the
+ * content ends with the connection.
+ */
+static int client_body(Client *c, int status, const void *content, size_t content_len)
+{
+	char *end, *len_hdr;
+	size_t hdr_len, body_len;
+	int code = 0;
+
+	while (!(end = strstr(c->buf, "\r\n\r\n")))
+		if (!client_recv(c))
+			goto error;
+	hdr_len = end + 4 - c->buf;
+	memcpy(c->hdr, c->buf, MIN(hdr_len, sizeof(c->hdr) - 1));
+	c->hdr[MIN(hdr_len, sizeof(c->hdr) - 1)] = '\0';
+
+	sscanf(c->buf, "HTTP/1.1 %d", &code);
+	c->keep_alive = !memcmp(strstr(c->buf, "Connection: "), "Connection: keep-alive", 22);
+	len_hdr = strstr(c->buf, "Content-Length: ");
+	if (code == 304)
+		body_len = 0;
+	else if (len_hdr && len_hdr < end)
+	{
+		body_len = strtoul(len_hdr + 16, NULL, 10);
+		while (c->len < hdr_len + body_len)
+			if (!client_recv(c))
+				goto error;
+	}
+	else
+	{
+		while (client_recv(c))
+			;
+		body_len = c->len - hdr_len;
+	}
+
+	if (code != status || (content && (body_len != content_len
+			|| memcmp(c->buf + hdr_len, content, body_len))))
+		goto error;
+
+	/* Next response */
+	c->len -= hdr_len + body_len;
+	memmove(c->buf, c->buf + hdr_len + body_len, c->len + 1);
+	return 0;
+
+error:
+	kprintf("Unexpected response (%d): %s\n", code, c->buf);
+	return -1;
+}
+
+static int client_response(Client *c, int status, const char *content)
+{
+	return client_body(c, status, content, content ? strlen(content) : 0);
+}
+
+static int request(Client *c, const char *page, const char *content)
+{
+	char req[64];
+
+	sprintf(req, "GET /%s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", page);
+	if (client_send(c, req))
+		return -1;
+	return client_response(c, 200, content);
+}
+
+static int keepalive_test(void)
+{
+	Client c;
+	int start = accepted;
+
+	kputs("Persistent connection\n");
+	if (client_open(&c))
+		return -1;
+	for (int i = 0; i < 3; i++)
+		if (request(&c, "status", "word"))
+			return -1;
+	/* Default page and dispatch of the CGI table */
+	if (request(&c, "", "default index.htm")
+			|| request(&c, "image.png", "ext")
+			|| request(&c, "my-cgi-page", "name")
+			|| request(&c, "cgi-word", "name")
+			|| request(&c, "json", "ext")
+			|| request(&c, "page.htm", "default page.htm"))
+		return -1;
+	client_close(&c);
+
+	return accepted - start == 1 ? 0 : -1;
+}
+
+static int pipeline_test(void)
+{
+	Client c;
+
+	kputs("Pipelined and split requests\n");
+	if (client_open(&c))
+		return -1;
+
+	if (client_send(&c, "GET /status HTTP/1.1\r\n\r\nGET /a.png HTTP/1.1\r\n\r\nGET /x HTTP/1.1\r\n\r\n")
+			|| client_response(&c, 200, "word")
+			|| client_response(&c, 200, "ext")
+			|| client_response(&c, 200, "default x"))
+		return -1;
+
+	/* A request in pieces, and a body to skip */
+	if (client_send(&c, "GET /sta"))
+		return -1;
+	timer_delay(20);
+	if (client_send(&c, "tus HTTP/1.1\r\nContent-Length: 10\r\n"))
+		return -1;
+	timer_delay(20);
+	if (client_send(&c, "\r\n01234"))
+		return -1;
+	timer_delay(20);
+	if (client_send(&c, "56789GET /a.png HTTP/1.1\r\n\r\n")
+			|| client_response(&c, 200, "word")
+			|| client_response(&c, 200, "ext"))
+		return -1;
+	client_close(&c);
+
+	return 0;
+}
+
+static int close_test(void)
+{
+	Client c;
+
+	kputs("Closed connections\n");
+
+	/* HTTP/1.0 closes after the response */
+	if (client_open(&c)
+			|| client_send(&c, "GET /status HTTP/1.0\r\n\r\n")
+			|| client_response(&c, 200, "word")
+			|| client_recv(&c))
+		return -1;
+	client_close(&c);
+
+	/* So does an HTTP/1.1 client asking it */
+	if (client_open(&c)
+			|| client_send(&c, "GET /status HTTP/1.1\r\nConnection: Close\r\n\r\n")
+			|| client_response(&c, 200, "word")
+			|| client_recv(&c))
+		return -1;
+	client_close(&c);
+
+	/* And a response without length */
+	if (client_open(&c)
+			|| client_send(&c, "GET /close HTTP/1.1\r\n\r\nGET /status HTTP/1.1\r\n\r\n")
+			|| client_response(&c, 200, "closed"))
+		return -1;
+	client_close(&c);
+
+	/* Or a failed CGI */
+	if (client_open(&c)
+			|| client_send(&c, "GET /fail HTTP/1.1\r\n\r\n")
+			|| client_response(&c, 500, NULL)
+			|| client_recv(&c))
+		return -1;
+	client_close(&c);
+
+	/* Idle connections time out */
+	if (client_open(&c)
+			|| request(&c, "status", "word"))
+		return -1;
+	timer_delay(CONFIG_HTTP_KEEPALIVE_TIMEOUT + 200);
+	if (client_recv(&c))
+		return -1;
+	client_close(&c);
+
+	return 0;
+}
+
+static int get(Client *c, const char *page, const char *headers)
+{
+	char req[128];
+
+	sprintf(req, "GET /%s HTTP/1.1\r\n%s\r\n", page, headers);
+	return client_send(c, req);
+}
+
+static int bundle_test(void)
+{
+	const HttpAsset *app = http_bundleFind(&test_bundle, "app.htm");
+	const HttpAsset *css = http_bundleFind(&test_bundle, "css/style.css");
+	const HttpAsset *logo = http_bundleFind(&test_bundle, "logo.gif");
+	char etag[64];
+	Client c;
+
+	kputs("Bundle\n");
+	/* Only the page that gzip makes smaller is compressed */
+	if (!app || !css || !logo || !app->gz_data || app->gz_len >= app->len
+			|| css->gz_data || logo->gz_data || logo->len != 8
+			|| http_bundleFind(&test_bundle, "missing.htm"))
+		return -1;
+
+	if (client_open(&c))
+		return -1;
+
+	/* Compressed to the clients accepting it */
+	if (get(&c, "app.htm", "Accept-Encoding: gzip, deflate\r\n")
+			|| client_body(&c, 200, app->gz_data, app->gz_len)
+			|| !strstr(c.hdr, "Content-Encoding: gzip\r\n")
+			|| !strstr(c.hdr, "Content-type: text/html\r\n"))
+		return -1;
+	sprintf(etag, "ETag: %s\r\n", app->etag);
+	if (!strstr(c.hdr, etag))
+		return -1;
+
+	if (get(&c, "app.htm", "")
+			|| client_body(&c, 200, app->data, app->len)
+			|| strstr(c.hdr, "Content-Encoding"))
+		return -1;
+
+	/* Revalidation, on the same connection */
+	sprintf(etag, "If-None-Match: %s\r\n", app->etag);
+	if (get(&c, "app.htm", etag)
+			|| client_body(&c, 304, NULL, 0)
+			|| !c.keep_alive
+			|| get(&c, "app.htm", "if-none-match: \"00000000\"\r\n")
+			|| client_body(&c, 200, app->data, app->len))
+		return -1;
+
+	if (get(&c, "css/style.css", "Accept-Encoding: gzip\r\n")
+			|| client_body(&c, 200, css->data, css->len)
+			|| !strstr(c.hdr, "Content-type: text/css\r\n")
+			|| get(&c, "logo.gif", "")
+			|| client_body(&c, 200, logo->data, logo->len)
+			|| !strstr(c.hdr, "Content-type: image/gif\r\n"))
+		return -1;
+
+	/* Only compressed, sent to everybody */
+	app = http_bundleFind(&gz_bundle, "app.htm");
+	if (!app || app->data
+			|| get(&c, "gz/app.htm", "")
+			|| client_body(&c, 200, app->gz_data, app->gz_len)
+			|| !strstr(c.hdr, "Content-Encoding: gzip\r\n"))
+		return -1;
+
+	if (request(&c, "missing.htm", "default missing.htm"))
+		return -1;
+	client_close(&c);
+
+	return 0;
+}
+
+static int slow_client_test(void)
+{
+	Client slow, fast;
+
+	kputs("Slow client\n");
+	if (client_open(&slow) || client_send(&slow, "GET /sta"))
+		return -1;
+
+	/* Served by the other worker meanwhile */
+	if (client_open(&fast)
+			|| request(&fast, "status", "word")
+			|| request(&fast, "a.png", "ext"))
+		return -1;
+	client_close(&fast);
+
+	if (client_send(&slow, "tus HTTP/1.1\r\n\r\n")
+			|| client_response(&slow, 200, "word"))
+		return -1;
+	client_close(&slow);
+
+	return 0;
+}
+
+static int bench_test(void)
+{
+	Client c;
+	ticks_t start;
+	mtime_t keepalive, close, asset;
+	const HttpAsset *app = http_bundleFind(&test_bundle, "app.htm");
+
+	if (client_open(&c))
+		return -1;
+	start = timer_clock();
+	for (int i = 0; i < BENCH_REQS; i++)
+	{
+		if (request(&c, "status", "word"))
+			return -1;
+		/* Every CONFIG_HTTP_KEEPALIVE_MAX requests */
+		if (!c.keep_alive)
+		{
+			client_close(&c);
+			if (client_open(&c))
+				return -1;
+		}
+	}
+	keepalive = ticks_to_ms(timer_clock() - start);
+	client_close(&c);
+
+	start = timer_clock();
+	for (int i = 0; i < BENCH_REQS; i++)
+	{
+		if (client_open(&c)
+				|| client_send(&c, "GET /status HTTP/1.1\r\nConnection: close\r\n\r\n")
+				|| client_response(&c, 200, "word"))
+			return -1;
+		client_close(&c);
+	}
+	close = ticks_to_ms(timer_clock() - start);
+
+	if (client_open(&c))
+		return -1;
+	start = timer_clock();
+	for (int i = 0; i < BENCH_REQS; i++)
+	{
+		if (get(&c, "app.htm", "Accept-Encoding: gzip\r\n")
+				|| client_body(&c, 200, app->gz_data, app->gz_len))
+			return -1;
+		if (!c.keep_alive)
+		{
+			client_close(&c);
+			if (client_open(&c))
+				return -1;
+		}
+	}
+	asset = ticks_to_ms(timer_clock() - start);
+	client_close(&c);
+
+	kprintf("%d requests: persistent %ld ms (%ld req/s), closed %ld ms (%ld req/s)\n",
+		BENCH_REQS, (long)keepalive, BENCH_REQS * 1000L / MAX(keepalive, 1),
+		(long)close, BENCH_REQS * 1000L / MAX(close, 1));
+	kprintf("%d bundle pages: %ld ms (%ld req/s)\n",
+		BENCH_REQS, (long)asset, BENCH_REQS * 1000L / MAX(asset, 1));
+
+	return 0;
+}
+
+int http_server_testRun(void)
+{
+	if (keepalive_test() || pipeline_test() || close_test()
+			|| bundle_test() || slow_client_test() || bench_test())
+	{
+		kputs("HTTP server test failed\n");
+		return -1;
+	}
+
+	kputs("HTTP server test finished..Ok!\n");
+	return 0;
+}
+
+int http_server_testSetup(void)
+{
+	struct ip_addr ipaddr, netmask, gw;
+
+	kdbg_init();
+	timer_init();
+	proc_init();
+
+	tcpip_init(NULL, NULL);
+
+	IP4_ADDR(&ipaddr, 127, 0, 0, 1);
+	IP4_ADDR(&netmask, 255, 0, 0, 0);
+	IP4_ADDR(&gw, 127, 0, 0, 1);
+	netif_add(&loop_netif, &ipaddr, &netmask, &gw, NULL, loopif_init, tcpip_input);
+	netif_set_up(&loop_netif);
+
+	server = netconn_new(NETCONN_TCP);
+	netconn_bind(server, IP_ADDR_ANY, HTTP_PORT);
+	netconn_listen(server);
+
+	http_init(default_page, cgi_table);
+	proc_new(acceptor, NULL, sizeof(acceptor_stack), acceptor_stack);
+
+	return 0;
+}
+
+int http_server_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(http_server);
@@ -79,15 +79,16 @@ void mutex_init(struct Mutex *s)
 
 /****************************************************************************/
 
-typedef struct SemNode
+/*
+ * Counting semaphores are kernel CountSemaphores taken from a static pool.
+ */
+typedef struct SysSem
 {
 	Node node;
-	Mutex sem;
-} SemNode;
-
-#define MAX_SEM_CNT 16
+	CountSemaphore sem;
+} SysSem;
 
-static struct SemNode sem_pool[MAX_SEM_CNT];
+static struct SysSem sem_pool[SYS_SEM_POOL_SIZE];
 static List free_sem;
 
 /**
@@ -98,31 +99,27 @@ static List free_sem;
  */
 sys_sem_t sys_sem_new(u8_t count)
 {
-	SemNode *sem;
+	SysSem *sem;
 
-	PROC_ATOMIC(sem = (SemNode *)list_remHead(&free_sem));
+	PROC_ATOMIC(sem = (SysSem *)list_remHead(&free_sem));
 	if (UNLIKELY(!sem))
 	{
 		LOG_ERR("Out of semaphores!\n");
 		return SYS_SEM_NULL;
 	}
 
-	mutex_init(&sem->sem);
-	// must obtain semaphore depending on the parameter
-	// NOTE: count == 1 means that the semaphore is unlocked
-	if (count <= 0)
-		mutex_obtain(&sem->sem);
-	return (sys_sem_t)&sem->sem;
+	csem_init(&sem->sem, count);
+	return sem;
 }
 
 /**
  * Frees a semaphore created by sys_sem_new.
  *
- * \param semaphore Mutex to be freed
+ * \param sem Semaphore to be freed
  */
-void sys_sem_free(sys_sem_t semaphore)
+void sys_sem_free(sys_sem_t sem)
 {
-	SemNode *sem = containerof(semaphore, SemNode, sem);
+	ASSERT(LIST_EMPTY(&sem->sem.wait_queue));
 	PROC_ATOMIC(ADDHEAD(&free_sem, &sem->node));
 }
 
@@ -131,7 +128,7 @@ void sys_sem_free(sys_sem_t semaphore)
  */
 void sys_sem_signal(sys_sem_t sem)
 {
-	mutex_release(sem);
+	csem_release(&sem->sem);
 }
 
 /**
@@ -146,22 +143,14 @@ void sys_sem_signal(sys_sem_t sem)
  */
 u32_t sys_arch_sem_wait(sys_sem_t sem, u32_t timeout)
 {
-	ticks_t end, start = timer_clock();
-
-	if (timeout == 0)
-	{
-		mutex_obtain(sem);
-		return ticks_to_ms(timer_clock() - start);
-	}
+	ticks_t start = timer_clock();
 
-	do
-	{
-		cpu_relax();
-		end = timer_clock();
-	} while ((end - start < ms_to_ticks(timeout) && !mutex_attempt(sem)));
+	if (!timeout)
+		csem_obtain(&sem->sem);
+	else if (!csem_obtainTimeout(&sem->sem, ms_to_ticks(timeout)))
+		return SYS_ARCH_TIMEOUT;
 
-	return (end - start > ms_to_ticks(timeout)) ?
-			SYS_ARCH_TIMEOUT : (u32_t)ticks_to_ms(end - start);
+	return ticks_to_ms(timer_clock() - start);
 }
 
 /* Mbox functions */
@@ -416,7 +405,7 @@ void sys_init(void)
 	LIST_INIT(&free_thread);
 	LIST_INIT(&used_thread);
 
-	for (int i = 0; i < MAX_SEM_CNT; ++i)
+	for (int i = 0; i < SYS_SEM_POOL_SIZE; ++i)
 		ADDHEAD(&free_sem, &sem_pool[i].node);
 
 	for (int i = 0; i < MAX_PORT_CNT; ++i)
@@ -669,6 +669,27 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   struct netif *netif;
   u32_t *opts;
 
+  if (seg->p->ref != 1) {
+    /* This segment is still queued by a zero-copy netif driver: don't
+       touch its headers, send a private copy instead. */
+    struct pbuf *q;
+    u16_t offset = (u16_t)((u8_t *)seg->tcphdr - (u8_t *)seg->p->payload);
+
+    q = pbuf_alloc(PBUF_IP, seg->p->tot_len - offset, PBUF_RAM);
+    if (q == NULL) {
+      /* Lost for now, the retransmission timer will send it again. */
+      LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_output_segment: no memory to copy segment\n"));
+      if (pcb->rtime == -1)
+        pcb->rtime = 0;
+      return;
+    }
+    pbuf_copy_partial(seg->p, q->payload, q->tot_len, offset);
+    pbuf_free(seg->p);
+    seg->p = q;
+    seg->tcphdr = q->payload;
+    seg->dataptr = (u8_t *)q->payload + TCPH_HDRLEN(seg->tcphdr) * 4;
+  }
+
   /** @bug Exclude retransmitted segments from this count. */
   snmp_inc_tcpoutsegs();
 
@@ -72,7 +72,9 @@ void mutex_release(struct Mutex *s);
 
 /****************************************************************************/
 
-typedef Mutex *sys_sem_t;
+struct SysSem;
+
+typedef struct SysSem *sys_sem_t;
 typedef MsgPort *sys_mbox_t;
 typedef struct Process *sys_thread_t;
 // TODO: what does it mean?
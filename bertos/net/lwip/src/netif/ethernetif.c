@@ -79,6 +79,8 @@
 #include <drv/eth.h>
 #include <drv/timer.h>
 
+#include <cfg/macros.h>
+
 #include <cpu/irq.h>
 
 #include <kern/proc.h>
@@ -95,10 +97,45 @@
 
 #include <netif/ethernetif.h>
 
+#include <string.h>
+
 /* Define those to better describe your network interface. */
 #define IFNAME0 'e'
 #define IFNAME1 '0'
 
+#if CONFIG_ETH_ZEROCOPY
+
+#if ETH_PAD_SIZE
+	#error "The zero-copy interface does not support ETH_PAD_SIZE"
+#endif
+
+/*
+ * A receive DMA buffer lent by the driver, wrapped in a pbuf that gives it
+ * back when freed.
+ */
+typedef struct RxPbuf
+{
+	struct pbuf_custom pc;
+	uint8_t *data;
+	struct RxPbuf *next_free;
+} RxPbuf;
+
+static RxPbuf rx_pbufs[CONFIG_ETH_RX_LENT];
+static RxPbuf *rx_free;
+
+static void rx_pbufFree(struct pbuf *p)
+{
+	RxPbuf *rp = (RxPbuf *)p;
+
+	proc_forbid();
+	eth_rxPut(rp->data);
+	rp->next_free = rx_free;
+	rx_free = rp;
+	proc_permit();
+}
+
+#endif /* CONFIG_ETH_ZEROCOPY */
+
 /**
  * Helper struct to hold private data used to operate your ethernet interface.
  * Keeping the ethernet address of the MAC in this struct is not necessary
@@ -138,6 +175,19 @@ static void low_level_init(struct netif *netif)
 	/* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
 	netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
 
+	#if CONFIG_ETH_ZEROCOPY
+	{
+		int i;
+
+		rx_free = NULL;
+		for (i = 0; i < CONFIG_ETH_RX_LENT; i++)
+		{
+			rx_pbufs[i].next_free = rx_free;
+			rx_free = &rx_pbufs[i];
+		}
+	}
+	#endif
+
 	eth_init();
 }
 
@@ -157,6 +207,80 @@ static void low_level_init(struct netif *netif)
  *       dropped because of memory failure (except for the TCP timers).
  */
 
+#if CONFIG_ETH_ZEROCOPY
+
+/* Free the pbufs of the frames already sent */
+static void tx_collect(void)
+{
+	struct pbuf *p;
+
+	while ((p = eth_txGet(false)) != NULL)
+		pbuf_free(p);
+}
+
+static err_t low_level_output(UNUSED_ARG(struct netif *, netif), struct pbuf *p)
+{
+	EthBuf buf[ETH_FRAME_BUFS];
+	struct pbuf *q;
+	int count = 0;
+
+	/*
+	 * The frame is sent from the pbufs, referenced until the driver is
+	 * done with them. ROM pbufs may not be reachable by the DMA, the
+	 * memory of REF pbufs may be reused by the caller as soon as we
+	 * return and very fragmented frames do not fit the descriptors:
+	 * copy them. Our own receive buffers can be sent back as they are.
+	 */
+	for (q = p; q != NULL; q = q->next)
+	{
+		if (q->type == PBUF_ROM || count == ETH_FRAME_BUFS
+				|| (q->type == PBUF_REF && !(q->flags & PBUF_FLAG_IS_CUSTOM)))
+			break;
+		if (q->len)
+		{
+			buf[count].data = q->payload;
+			buf[count].len = q->len;
+			count++;
+		}
+	}
+
+	if (q)
+	{
+		q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+		if (!q)
+		{
+			LINK_STATS_INC(link.memerr);
+			LINK_STATS_INC(link.drop);
+			return ERR_MEM;
+		}
+		pbuf_copy(q, p);
+		buf[0].data = q->payload;
+		buf[0].len = q->len;
+		count = 1;
+	}
+	else
+	{
+		pbuf_ref(p);
+		q = p;
+	}
+
+	/* Wait for room in the transmit ring */
+	tx_collect();
+	while (eth_txPut(buf, count, q) < 0)
+	{
+		struct pbuf *sent = eth_txGet(true);
+
+		if (sent)
+			pbuf_free(sent);
+	}
+
+	LINK_STATS_INC(link.xmit);
+
+	return ERR_OK;
+}
+
+#else /* !CONFIG_ETH_ZEROCOPY */
+
 static err_t low_level_output(UNUSED_ARG(struct netif *, netif), struct pbuf *p)
 {
 	struct pbuf *q;
@@ -180,6 +304,8 @@ static err_t low_level_output(UNUSED_ARG(struct netif *, netif), struct pbuf *p)
 	return ERR_OK;
 }
 
+#endif /* CONFIG_ETH_ZEROCOPY */
+
 /**
  * Should allocate a pbuf and transfer the bytes of the incoming
  * packet from the interface into the pbuf.
@@ -188,6 +314,93 @@ static err_t low_level_output(UNUSED_ARG(struct netif *, netif), struct pbuf *p)
  * @return a pbuf filled with the received packet (including MAC header)
  *         NULL on memory error
  */
+#if CONFIG_ETH_ZEROCOPY
+
+/* Copy the frame held in the DMA buffers to a pool pbuf chain */
+static struct pbuf *rx_copy(const EthBuf *buf, int count, size_t len)
+{
+	struct pbuf *p, *q;
+	size_t offset = 0, done, size;
+	int i;
+
+	p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+	for (i = 0, q = p; q && i < count; i++)
+	{
+		for (done = 0; done < buf[i].len; done += size)
+		{
+			size = MIN(buf[i].len - done, q->len - offset);
+			memcpy((u8_t *)q->payload + offset, buf[i].data + done, size);
+			offset += size;
+			if (offset == q->len)
+			{
+				q = q->next;
+				offset = 0;
+			}
+		}
+	}
+	return p;
+}
+
+static struct pbuf *low_level_input(UNUSED_ARG(struct netif *, netif))
+{
+	EthBuf buf[ETH_FRAME_BUFS];
+	struct pbuf *p = NULL, *q;
+	RxPbuf *rp;
+	size_t len = 0;
+	int count, i;
+
+	count = eth_rxGet(buf, countof(buf));
+	if (!count)
+	{
+		/* Woken up by a transmission */
+		tx_collect();
+		return NULL;
+	}
+
+	/* Chain the DMA buffers, if there are enough pbufs to wrap them */
+	proc_forbid();
+	for (i = 0, rp = rx_free; i < count && rp; i++)
+		rp = rp->next_free;
+	if (i == count)
+	{
+		for (i = 0; i < count; i++)
+		{
+			rp = rx_free;
+			rx_free = rp->next_free;
+			rp->pc.custom_free_function = rx_pbufFree;
+			rp->data = buf[i].data;
+			q = pbuf_alloced_custom(PBUF_RAW, buf[i].len, PBUF_REF,
+				&rp->pc, buf[i].data, buf[i].len);
+			if (p)
+				pbuf_cat(p, q);
+			else
+				p = q;
+		}
+	}
+	proc_permit();
+
+	/* Too many buffers lent: copy the frame, so the hardware gets them back */
+	if (!p)
+	{
+		for (i = 0; i < count; i++)
+			len += buf[i].len;
+		p = rx_copy(buf, count, len);
+		for (i = 0; i < count; i++)
+			eth_rxPut(buf[i].data);
+		if (!p)
+		{
+			LINK_STATS_INC(link.memerr);
+			LINK_STATS_INC(link.drop);
+			return NULL;
+		}
+	}
+
+	LINK_STATS_INC(link.recv);
+	return p;
+}
+
+#else /* !CONFIG_ETH_ZEROCOPY */
+
 static struct pbuf *low_level_input(UNUSED_ARG(struct netif *, netif))
 {
 	struct pbuf *p, *q;
@@ -229,6 +442,8 @@ static struct pbuf *low_level_input(UNUSED_ARG(struct netif *, netif))
 	return p;
 }
 
+#endif /* CONFIG_ETH_ZEROCOPY */
+
 /**
  * This function should be called when a packet is ready to be read
  * from the interface. It uses the function low_level_input() that
@@ -0,0 +1,186 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief lwIP system layer semaphores test.
+ *
+ * Checks the counting, the timeouts and the wakeup by another process of
+ * the semaphores lwIP waits on. Then measures how much CPU time a process
+ * spinning next to a timed wait gets, compared to a plain timer_delay().
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ */
+
+#include "lwip.c"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+
+#include <lwip/sys.h>
+
+#define WAIT_MS  100
+
+/* The ethernet driver wants it, even if we do not use it */
+uint8_t mac_addr[6];
+
+static sys_sem_t sem;
+static volatile unsigned long spins;
+static volatile bool spinning;
+
+PROC_DEFINE_STACK(helper_stack, KERN_MINSTACKSIZE * 2);
+
+static void signaler(void)
+{
+	timer_delay(20);
+	sys_sem_signal(sem);
+}
+
+static void spinner(void)
+{
+	while (spinning)
+	{
+		spins++;
+		proc_yield();
+	}
+}
+
+static int count_test(void)
+{
+	int i;
+
+	kputs("Counting\n");
+	for (i = 0; i < 3; i++)
+		sys_sem_signal(sem);
+	for (i = 0; i < 3; i++)
+		if (sys_arch_sem_wait(sem, WAIT_MS) == SYS_ARCH_TIMEOUT)
+			return -1;
+
+	return sys_arch_sem_wait(sem, 1) == SYS_ARCH_TIMEOUT ? 0 : -1;
+}
+
+static int timeout_test(void)
+{
+	ticks_t start = timer_clock();
+	u32_t waited;
+
+	kputs("Timeout\n");
+	if (sys_arch_sem_wait(sem, WAIT_MS) != SYS_ARCH_TIMEOUT
+			|| timer_clock() - start < ms_to_ticks(WAIT_MS))
+		return -1;
+
+	/* Signaled by another process while we sleep */
+	proc_new(signaler, NULL, sizeof(helper_stack), helper_stack);
+	waited = sys_arch_sem_wait(sem, 1000);
+	kprintf("Signaled after %ld ms\n", (long)waited);
+	if (waited == SYS_ARCH_TIMEOUT || waited < 10 || waited > 500)
+		return -1;
+
+	return 0;
+}
+
+/* Spins counted while the main process waits in \a wait */
+static unsigned long spins_while(void (*wait)(void))
+{
+	spins = 0;
+	spinning = true;
+	proc_new(spinner, NULL, sizeof(helper_stack), helper_stack);
+	wait();
+	spinning = false;
+	/* Let the spinner exit before reusing its stack */
+	timer_delay(10);
+
+	return spins;
+}
+
+static void delay_wait(void)
+{
+	timer_delay(WAIT_MS);
+}
+
+static void timed_wait(void)
+{
+	sys_arch_sem_wait(sem, WAIT_MS);
+}
+
+static int idle_test(void)
+{
+	unsigned long delay_spins, sem_spins;
+
+	kputs("Idle time\n");
+	delay_spins = spins_while(delay_wait);
+	sem_spins = spins_while(timed_wait);
+	kprintf("Spins in %d ms: timer_delay %lu, sem wait %lu\n", WAIT_MS, delay_spins, sem_spins);
+
+	/* The waiter leaves the CPU to the others as a sleeping process does */
+	return sem_spins >= delay_spins / 2 ? 0 : -1;
+}
+
+int lwip_sys_testRun(void)
+{
+	if (count_test() || timeout_test() || idle_test())
+	{
+		kputs("lwIP sys test failed\n");
+		return -1;
+	}
+
+	kputs("lwIP sys test finished..Ok!\n");
+	return 0;
+}
+
+int lwip_sys_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	sys_init();
+
+	sem = sys_sem_new(0);
+	return sem == SYS_SEM_NULL ? -1 : 0;
+}
+
+int lwip_sys_testTearDown(void)
+{
+	sys_sem_free(sem);
+	return 0;
+}
+
+TEST_MAIN(lwip_sys);
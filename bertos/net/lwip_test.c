@@ -0,0 +1,636 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief lwIP over the emulated ethernet controller test.
+ *
+ * Frames are injected in the controller and collected from it, checking
+ * that ARP, ICMP, UDP and TCP work through the ethernet driver and that all
+ * the DMA buffers are given back. Then a burst of frames is received to
+ * measure the cost of each frame and how much of it is spent copying.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ */
+
+#include "lwip.c"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <drv/timer.h>
+
+#include <emul/eth_emul.h>
+
+#include <lwip/tcp.h>
+#include <lwip/tcpip.h>
+#include <lwip/udp.h>
+#include <netif/ethernetif.h>
+
+#include <string.h>
+
+#define TEST_TIME_OUT_MS  5000
+
+#define UDP_PORT     1234
+#define TCP_PORT     80
+#define TCP_LEN      100
+#if CONFIG_ETH_ZEROCOPY
+	/* More than the buffers the driver can lend */
+	#define HELD_FRAMES  (CONFIG_ETH_RX_LENT + 2)
+#else
+	#define HELD_FRAMES  8
+#endif
+#define BENCH_FRAMES 10000
+#define BENCH_LEN    1024
+
+#define ETH_HLEN  14
+#define IP_HLEN   20
+#define UDP_HLEN   8
+
+/* Our address, used by the driver */
+uint8_t mac_addr[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+static const uint8_t host_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t host_ip[4] = { 10, 0, 0, 1 };
+static const uint8_t dev_ip[4] = { 10, 0, 0, 2 };
+
+static struct netif netif;
+static struct udp_pcb *pcb;
+
+static uint8_t frame[ETH_FRAME_LEN];
+static uint8_t data[BENCH_LEN];
+
+static volatile int rx_count;
+static size_t rx_len;
+static bool rx_ok;
+static bool hold;
+static struct pbuf *held[HELD_FRAMES];
+
+static void udp_rx(UNUSED_ARG(void *, arg), UNUSED_ARG(struct udp_pcb *, upcb),
+	struct pbuf *p, UNUSED_ARG(struct ip_addr *, addr), UNUSED_ARG(u16_t, port))
+{
+	uint8_t buf[BENCH_LEN];
+	u16_t len = pbuf_copy_partial(p, buf, sizeof(buf), 0);
+
+	rx_len = p->tot_len;
+	rx_ok = (len == p->tot_len) && !memcmp(buf, data, len);
+	if (hold && rx_count < HELD_FRAMES)
+		held[rx_count] = p;
+	else
+		pbuf_free(p);
+	rx_count++;
+}
+
+static uint16_t csum(const uint8_t *buf, size_t len)
+{
+	uint32_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < len; i += 2)
+		sum += (buf[i] << 8) | (i + 1 < len ? buf[i + 1] : 0);
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+INLINE void put16(uint8_t *buf, uint16_t val)
+{
+	buf[0] = val >> 8;
+	buf[1] = val;
+}
+
+INLINE void put32(uint8_t *buf, uint32_t val)
+{
+	put16(buf, val >> 16);
+	put16(buf + 2, val);
+}
+
+INLINE uint32_t get32(const uint8_t *buf)
+{
+	return (uint32_t)buf[0] << 24 | (uint32_t)buf[1] << 16 | buf[2] << 8 | buf[3];
+}
+
+/* Fill the ethernet and IP headers of a frame from the host */
+static size_t ipFrame(uint8_t proto, size_t len)
+{
+	uint8_t *ip = frame + ETH_HLEN;
+
+	memcpy(frame, mac_addr, 6);
+	memcpy(frame + 6, host_mac, 6);
+	put16(frame + 12, ETHTYPE_IP);
+
+	memset(ip, 0, IP_HLEN);
+	ip[0] = 0x45;
+	put16(ip + 2, IP_HLEN + len);
+	ip[8] = 64;
+	ip[9] = proto;
+	memcpy(ip + 12, host_ip, 4);
+	memcpy(ip + 16, dev_ip, 4);
+	put16(ip + 10, csum(ip, IP_HLEN));
+
+	return ETH_HLEN + IP_HLEN + len;
+}
+
+static size_t udpFrame(size_t len)
+{
+	uint8_t *udp = frame + ETH_HLEN + IP_HLEN;
+	size_t frame_len = ipFrame(IP_PROTO_UDP, UDP_HLEN + len);
+
+	put16(udp, UDP_PORT);
+	put16(udp + 2, UDP_PORT);
+	put16(udp + 4, UDP_HLEN + len);
+	/* No checksum */
+	put16(udp + 6, 0);
+	memcpy(udp + UDP_HLEN, data, len);
+
+	/* Short frames are padded */
+	if (frame_len < 60)
+	{
+		memset(frame + frame_len, 0, 60 - frame_len);
+		frame_len = 60;
+	}
+	return frame_len;
+}
+
+/* Checksum of the TCP segment of \a len bytes in frame, with its pseudo header */
+static uint16_t tcpCsum(size_t len)
+{
+	static uint8_t buf[12 + ETH_FRAME_LEN];
+	const uint8_t *ip = frame + ETH_HLEN;
+
+	memcpy(buf, ip + 12, 8);
+	buf[8] = 0;
+	buf[9] = IP_PROTO_TCP;
+	put16(buf + 10, len);
+	memcpy(buf + 12, ip + IP_HLEN, len);
+	return csum(buf, 12 + len);
+}
+
+static size_t tcpFrame(uint8_t flags, uint32_t seqno, uint32_t ackno)
+{
+	uint8_t *tcp = frame + ETH_HLEN + IP_HLEN;
+	size_t frame_len = ipFrame(IP_PROTO_TCP, TCP_HLEN);
+
+	memset(tcp, 0, TCP_HLEN);
+	put16(tcp, TCP_PORT + 1);
+	put16(tcp + 2, TCP_PORT);
+	put32(tcp + 4, seqno);
+	put32(tcp + 8, ackno);
+	tcp[12] = (TCP_HLEN / 4) << 4;
+	tcp[13] = flags;
+	put16(tcp + 14, 8192);
+	put16(tcp + 16, tcpCsum(TCP_HLEN));
+
+	memset(frame + frame_len, 0, 60 - frame_len);
+	return 60;
+}
+
+/* Receive a frame, waiting for a free buffer */
+static int rxFrame(size_t len)
+{
+	ticks_t start = timer_clock();
+
+	while (eth_emulRxFrame(frame, len) < 0)
+	{
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+			return -1;
+		proc_yield();
+	}
+	return 0;
+}
+
+/* Wait for the next frame sent by the device */
+static size_t txFrame(void)
+{
+	ticks_t start = timer_clock();
+	size_t len;
+
+	while (!(len = eth_emulTxFrame(frame, sizeof(frame))))
+	{
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+			return 0;
+		proc_yield();
+	}
+	return len;
+}
+
+static int waitRx(int count)
+{
+	ticks_t start = timer_clock();
+
+	while (rx_count < count)
+	{
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+			return -1;
+		proc_yield();
+	}
+	return 0;
+}
+
+/* Wait until the stack is done with all the receive buffers */
+static int waitRxFree(void)
+{
+	ticks_t start = timer_clock();
+
+	while (eth_emulRxFree() != ETH_EMUL_RX_BUFFERS)
+	{
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+			return -1;
+		proc_yield();
+	}
+	return 0;
+}
+
+static void customFree(UNUSED_ARG(struct pbuf *, p))
+{
+}
+
+static int pbuf_custom_test(void)
+{
+	struct pbuf_custom pc;
+	struct pbuf *p;
+
+	/* Headers can be revealed again only up to the start of the buffer */
+	kputs("> Custom pbuf headers\n");
+	pc.custom_free_function = customFree;
+	p = pbuf_alloced_custom(PBUF_RAW, 60, PBUF_REF, &pc, frame, 60);
+	if (!p || pbuf_header(p, -ETH_HLEN) || !pbuf_header(p, ETH_HLEN + 1)
+			|| p->payload != frame + ETH_HLEN || pbuf_header(p, ETH_HLEN)
+			|| p->payload != frame || p->len != 60 || !pbuf_header(p, 1))
+		return -1;
+	pbuf_free(p);
+	return 0;
+}
+
+static int arp_test(void)
+{
+	size_t len;
+
+	kputs("> ARP request\n");
+	memset(frame, 0xff, 6);
+	memcpy(frame + 6, host_mac, 6);
+	put16(frame + 12, ETHTYPE_ARP);
+	put16(frame + 14, 1);
+	put16(frame + 16, ETHTYPE_IP);
+	frame[18] = 6;
+	frame[19] = 4;
+	put16(frame + 20, 1);
+	memcpy(frame + 22, host_mac, 6);
+	memcpy(frame + 28, host_ip, 4);
+	memset(frame + 32, 0, 6);
+	memcpy(frame + 38, dev_ip, 4);
+	memset(frame + 42, 0, 18);
+	if (rxFrame(60) < 0)
+		return -1;
+
+	len = txFrame();
+	if (len < 42 || memcmp(frame, host_mac, 6) || frame[12] != 0x08 || frame[13] != 0x06
+			|| frame[21] != 2 || memcmp(frame + 22, mac_addr, 6)
+			|| memcmp(frame + 28, dev_ip, 4))
+		return -1;
+
+	return waitRxFree();
+}
+
+static int ping_test(void)
+{
+	uint8_t *icmp = frame + ETH_HLEN + IP_HLEN;
+	size_t len;
+
+	kputs("> ICMP echo\n");
+	len = ipFrame(IP_PROTO_ICMP, 8 + 56);
+	memset(icmp, 0, 8);
+	icmp[0] = 8;
+	put16(icmp + 4, 0x4242);
+	put16(icmp + 6, 1);
+	memcpy(icmp + 8, data, 56);
+	put16(icmp + 2, csum(icmp, 8 + 56));
+	if (rxFrame(len) < 0)
+		return -1;
+
+	len = txFrame();
+	if (len != ETH_HLEN + IP_HLEN + 8 + 56 || memcmp(frame, host_mac, 6)
+			|| frame[ETH_HLEN + 9] != IP_PROTO_ICMP || icmp[0] != 0
+			|| memcmp(icmp + 8, data, 56) || csum(icmp, 8 + 56))
+		return -1;
+
+	return waitRxFree();
+}
+
+static int udp_rx_test(void)
+{
+	static const size_t sizes[] = { 4, 100, 600, BENCH_LEN };
+	size_t i;
+
+	kputs("> UDP receive\n");
+	rx_count = 0;
+	for (i = 0; i < countof(sizes); i++)
+	{
+		if (rxFrame(udpFrame(sizes[i])) < 0 || waitRx(i + 1) < 0)
+			return -1;
+		kprintf("  %d bytes: %s\n", (int)rx_len, rx_ok ? "ok" : "corrupted");
+		if (rx_len != sizes[i] || !rx_ok)
+			return -1;
+	}
+
+	return waitRxFree();
+}
+
+static int udp_hold_test(void)
+{
+	int i;
+
+	/*
+	 * In zero-copy mode frames received while too many buffers are lent
+	 * are copied, so that the hardware can go on receiving.
+	 */
+	kputs("> UDP receive, holding the frames\n");
+	rx_count = 0;
+	hold = true;
+	for (i = 0; i < HELD_FRAMES; i++)
+		if (rxFrame(udpFrame(16)) < 0 || waitRx(i + 1) < 0)
+			return -1;
+	hold = false;
+
+	#if CONFIG_ETH_ZEROCOPY
+		if (eth_emulRxFree() != ETH_EMUL_RX_BUFFERS - CONFIG_ETH_RX_LENT)
+			return -1;
+	#endif
+
+	for (i = 0; i < HELD_FRAMES; i++)
+		pbuf_free(held[i]);
+
+	return waitRxFree();
+}
+
+static volatile int tx_sent;
+
+static void udp_tx(void *arg)
+{
+	size_t len = (size_t)arg;
+	struct ip_addr addr;
+	struct pbuf *p;
+
+	IP4_ADDR(&addr, host_ip[0], host_ip[1], host_ip[2], host_ip[3]);
+	p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+	if (p)
+	{
+		pbuf_take(p, data, len);
+		udp_sendto(pcb, p, &addr, UDP_PORT);
+		pbuf_free(p);
+	}
+	tx_sent++;
+}
+
+static int udp_tx_test(void)
+{
+	static const size_t sizes[] = { 32, 1000 };
+	uint8_t *udp = frame + ETH_HLEN + IP_HLEN;
+	size_t i, len;
+
+	kputs("> UDP send\n");
+	tx_sent = 0;
+	for (i = 0; i < countof(sizes); i++)
+		tcpip_callback(udp_tx, (void *)sizes[i]);
+
+	for (i = 0; i < countof(sizes); i++)
+	{
+		len = txFrame();
+		if (len != ETH_HLEN + IP_HLEN + UDP_HLEN + sizes[i]
+				|| memcmp(frame, host_mac, 6) || memcmp(frame + 6, mac_addr, 6)
+				|| frame[ETH_HLEN + 9] != IP_PROTO_UDP
+				|| memcmp(udp + UDP_HLEN, data, sizes[i]))
+			return -1;
+	}
+	return tx_sent == countof(sizes) ? 0 : -1;
+}
+
+static struct tcp_pcb *tcp_listener;
+static struct tcp_pcb *tcp_conn;
+static volatile int tcp_step;
+
+static err_t tcpAccept(UNUSED_ARG(void *, arg), struct tcp_pcb *newpcb, UNUSED_ARG(err_t, err))
+{
+	tcp_conn = newpcb;
+	tcp_step++;
+	return ERR_OK;
+}
+
+static void tcpSetup(UNUSED_ARG(void *, arg))
+{
+	struct tcp_pcb *p = tcp_new();
+
+	tcp_bind(p, IP_ADDR_ANY, TCP_PORT);
+	tcp_listener = tcp_listen(p);
+	tcp_accept(tcp_listener, tcpAccept);
+	tcp_step++;
+}
+
+static void tcpSend(UNUSED_ARG(void *, arg))
+{
+	tcp_write(tcp_conn, data, TCP_LEN, TCP_WRITE_FLAG_COPY);
+	tcp_output(tcp_conn);
+	tcp_step++;
+}
+
+static void tcpRetransmit(UNUSED_ARG(void *, arg))
+{
+	tcp_rexmit_rto(tcp_conn);
+	tcp_step++;
+}
+
+static void tcpCleanup(UNUSED_ARG(void *, arg))
+{
+	tcp_abort(tcp_conn);
+	tcp_close(tcp_listener);
+	tcp_step++;
+}
+
+static int waitTcpStep(int step)
+{
+	ticks_t start = timer_clock();
+
+	while (tcp_step < step)
+	{
+		if (timer_clock() - start > ms_to_ticks(TEST_TIME_OUT_MS))
+			return -1;
+		proc_yield();
+	}
+	return 0;
+}
+
+static int tcp_rexmit_test(void)
+{
+	uint8_t *tcp = frame + ETH_HLEN + IP_HLEN;
+	ticks_t start;
+	uint32_t iss;
+	int i;
+
+	/*
+	 * In zero-copy mode the retransmitted segment is still queued by the
+	 * driver: it has to be sent anyway, without touching the queued one.
+	 */
+	kputs("> TCP retransmission of a segment still queued\n");
+	tcp_step = 0;
+	tcpip_callback(tcpSetup, NULL);
+	if (waitTcpStep(1) < 0)
+		return -1;
+
+	/* Handshake */
+	if (rxFrame(tcpFrame(TCP_SYN, 1000, 0)) < 0 || !txFrame()
+			|| tcp[13] != (TCP_SYN | TCP_ACK) || get32(tcp + 8) != 1001)
+		return -1;
+	iss = get32(tcp + 4);
+	if (rxFrame(tcpFrame(TCP_ACK, 1001, iss + 1)) < 0)
+		return -1;
+	if (waitTcpStep(2) < 0)
+		return -1;
+
+	/* Leave the segment in the driver while it is retransmitted */
+	tcpip_callback(tcpSend, NULL);
+	if (waitTcpStep(3) < 0)
+		return -1;
+	tcpip_callback(tcpRetransmit, NULL);
+	#if CONFIG_ETH_ZEROCOPY
+		if (waitTcpStep(4) < 0)
+			return -1;
+	#endif
+
+	/*
+	 * In copy mode the driver waits for the first frame to be sent.
+	 * The copy has to be sent at once, not by the retransmission timer.
+	 */
+	start = timer_clock();
+	for (i = 0; i < 2; i++)
+	{
+		if (txFrame() != ETH_HLEN + IP_HLEN + TCP_HLEN + TCP_LEN
+				|| frame[ETH_HLEN + 9] != IP_PROTO_TCP
+				|| get32(tcp + 4) != iss + 1
+				|| memcmp(tcp + TCP_HLEN, data, TCP_LEN)
+				|| tcpCsum(TCP_HLEN + TCP_LEN))
+			return -1;
+	}
+	if (timer_clock() - start > ms_to_ticks(TCP_TMR_INTERVAL)
+			|| waitTcpStep(4) < 0)
+		return -1;
+
+	tcpip_callback(tcpCleanup, NULL);
+	if (waitTcpStep(5) < 0)
+		return -1;
+	/* Drop the reset */
+	txFrame();
+
+	return waitRxFree();
+}
+
+static int bench_test(void)
+{
+	unsigned long copied = eth_emul_stats.copied;
+	ticks_t start;
+	mtime_t elapsed;
+	int i;
+
+	kprintf("> Receiving %d frames of %d bytes\n", BENCH_FRAMES, BENCH_LEN);
+	rx_count = 0;
+	start = timer_clock();
+	for (i = 0; i < BENCH_FRAMES; i++)
+		if (rxFrame(udpFrame(BENCH_LEN)) < 0)
+			return -1;
+	if (waitRx(BENCH_FRAMES) < 0)
+		return -1;
+	elapsed = ticks_to_ms(timer_clock() - start);
+
+	kprintf("  %lu us/frame, driver copied %lu bytes/frame\n",
+		(unsigned long)(elapsed * 1000 / BENCH_FRAMES),
+		(eth_emul_stats.copied - copied) / BENCH_FRAMES);
+
+	#if CONFIG_ETH_ZEROCOPY
+		if (eth_emul_stats.copied)
+			return -1;
+	#endif
+	return waitRxFree();
+}
+
+int lwip_testRun(void)
+{
+	if (pbuf_custom_test() || arp_test() || ping_test() || udp_rx_test() || udp_hold_test()
+			|| udp_tx_test() || tcp_rexmit_test() || bench_test())
+	{
+		kprintf("> lwIP test failed, %lu frames dropped\n", eth_emul_stats.rx_dropped);
+		return -1;
+	}
+
+	kputs("> lwIP test finished..Ok!\n");
+	return 0;
+}
+
+int lwip_testSetup(void)
+{
+	struct ip_addr ipaddr, netmask, gw;
+	size_t i;
+
+	kdbg_init();
+	timer_init();
+	proc_init();
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 7;
+
+	tcpip_init(NULL, NULL);
+
+	IP4_ADDR(&ipaddr, dev_ip[0], dev_ip[1], dev_ip[2], dev_ip[3]);
+	IP4_ADDR(&netmask, 255, 255, 255, 0);
+	IP4_ADDR(&gw, 0, 0, 0, 0);
+	netif_add(&netif, &ipaddr, &netmask, &gw, NULL, ethernetif_init, tcpip_input);
+	netif_set_default(&netif);
+	netif_set_up(&netif);
+	/* Drop the gratuitous ARP announcing us */
+	txFrame();
+
+	pcb = udp_new();
+	udp_bind(pcb, IP_ADDR_ANY, UDP_PORT);
+	udp_recv(pcb, udp_rx, NULL);
+
+	return 0;
+}
+
+int lwip_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(lwip);
@@ -41,8 +41,14 @@
 
 #include "cfg/cfg_syslog.h"
 
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
 #include <cpu/byteorder.h> // host_to_net16
 
+#include <kern/proc.h>
+#include <kern/signal.h>
+
 #include <lwip/ip_addr.h>
 #include <lwip/netif.h>
 #include <lwip/netbuf.h>
@@ -50,18 +56,55 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+
+/* Wakes up the sender */
+#define SIG_SYSLOG  SIG_USER0
+
+/*
+ * Ring of messages to send.
+ *
+ * Slots are taken in order with preemption disabled, just the time to move
+ * the tail, then the message is formatted in place and marked ready.
+ * The sender sends the ready messages from the head.
+ */
+typedef struct SysLogRecord
+{
+	volatile bool ready;    ///< Formatted, can be sent
+	size_t len;
+	char msg[CONFIG_SYSLOG_BUFSIZE];
+} SysLogRecord;
+
+static SysLogRecord syslog_ring[CONFIG_SYSLOG_RING];
+static size_t ring_head, ring_tail;
+static volatile size_t ring_used;
 
-static char syslog_message[CONFIG_SYSLOG_BUFSIZE];
 static SysLog *local_syslog_ctx;
 
+#if CONFIG_KERN_HEAP
+	#define SENDER_STACK  NULL
+#else
+	PROC_DEFINE_STACK(syslog_stack, CONFIG_SYSLOG_STACK);
+	#define SENDER_STACK  syslog_stack
+#endif
+
 /**
- * Return the number of log message has been sent.
+ * Return the number of log message has been queued.
  */
 uint32_t syslog_count(void)
 {
 	return local_syslog_ctx->syslog_cnt;
 }
 
+/**
+ * Return the number of log message has been dropped, because too many
+ * messages were waiting to be sent.
+ */
+uint32_t syslog_dropped(void)
+{
+	return local_syslog_ctx->dropped;
+}
+
 /**
  * Get the current syslog server address, in lwip ip_address format.
  */
@@ -79,22 +122,56 @@ void syslog_setIp(struct ip_addr addr)
 	local_syslog_ctx->server_addr = addr;
 }
 
+/* Send all the ready messages */
+static void syslog_flush(SysLog *ctx)
+{
+	SysLogRecord *rec;
+
+	while (ring_used)
+	{
+		rec = &syslog_ring[ring_head];
+		/* Still being formatted, we'll be woken up again */
+		if (!rec->ready)
+			break;
+
+		netbuf_ref(ctx->send_buf, rec->msg, rec->len);
+		if (netconn_sendto(ctx->syslog_server, ctx->send_buf,
+							&ctx->server_addr, CONFIG_SYSLOG_PORT) != ERR_OK)
+		{
+			kputs("Unable to send log!\n");
+		}
+		ctx->sent++;
+
+		ring_head = (ring_head + 1) % CONFIG_SYSLOG_RING;
+		PROC_ATOMIC(ring_used--);
+	}
+}
+
+static void syslog_sender(void)
+{
+	SysLog *ctx = (SysLog *)proc_currentUserData();
+
+	for (;;)
+	{
+		sig_wait(SIG_SYSLOG);
+		ctx->batches++;
+		syslog_flush(ctx);
+	}
+}
 
 /**
- * Print the log message on upd socket and serial if you configure the
- * macro CONFIG_SYSLOG_SERIAL in cfg_syslog.h,
+ * Queue the log message to be sent on upd socket, and print it on serial
+ * if you configure the macro CONFIG_SYSLOG_SERIAL in cfg_syslog.h.
+ *
+ * The message is dropped if too many ones are waiting to be sent.
+ *
+ * \return the message length, -1 if it has been dropped.
  */
 int syslog_printf(const char *fmt, ...)
 {
+	SysLogRecord *rec = NULL;
 	va_list ap;
-	va_start(ap, fmt);
-	int len = vsnprintf(syslog_message, sizeof(syslog_message), fmt, ap);
-	va_end(ap);
-	syslog_message[sizeof(syslog_message) - 1] = 0;
-
-	#if CONFIG_SYSLOG_SERIAL
-		kputs(syslog_message);
-	#endif
+	int len;
 
 	if (local_syslog_ctx == NULL)
 	{
@@ -102,22 +179,35 @@ int syslog_printf(const char *fmt, ...)
 		return -1;
 	}
 
-	local_syslog_ctx->syslog_server = netconn_new(NETCONN_UDP);
-	if (local_syslog_ctx->syslog_server == NULL)
+	proc_forbid();
+	if (ring_used < CONFIG_SYSLOG_RING)
 	{
-		kputs("Unable to alloc UDP connetions\n");
-		return -1;
+		rec = &syslog_ring[ring_tail];
+		rec->ready = false;
+		ring_tail = (ring_tail + 1) % CONFIG_SYSLOG_RING;
+		ring_used++;
+		local_syslog_ctx->syslog_cnt++;
 	}
+	else
+		local_syslog_ctx->dropped++;
+	proc_permit();
 
-	netbuf_ref(local_syslog_ctx->send_buf, syslog_message, len);
-	if (netconn_sendto(local_syslog_ctx->syslog_server, local_syslog_ctx->send_buf,
-						&(local_syslog_ctx->server_addr), CONFIG_SYSLOG_PORT) != ERR_OK)
-	{
-		kputs("Unable to send log!\n");
-	}
+	if (!rec)
+		return -1;
+
+	va_start(ap, fmt);
+	len = vsnprintf(rec->msg, sizeof(rec->msg), fmt, ap);
+	va_end(ap);
+	len = MIN(len, (int)sizeof(rec->msg) - 1);
+
+	#if CONFIG_SYSLOG_SERIAL
+		kputs(rec->msg);
+	#endif
 
-	local_syslog_ctx->syslog_cnt++;
-	netconn_delete(local_syslog_ctx->syslog_server);
+	rec->len = MAX(len, 0);
+	MEMORY_BARRIER;
+	rec->ready = true;
+	sig_post(local_syslog_ctx->sender, SIG_SYSLOG);
 
 	return len;
 }
@@ -125,14 +215,27 @@ int syslog_printf(const char *fmt, ...)
 /**
  * Init the syslog message.
  *
+ * Open the UDP connection used to send the messages and start the
+ * process sending them.
+ *
  * \param syslog_ctx syslog context
  * \param addr lwip ip_address (you could use the macro IP4_ADDR() to get it form ip address)
  */
 void syslog_init(SysLog *syslog_ctx, struct ip_addr addr)
 {
-	memset(syslog_ctx, 0, sizeof(syslog_ctx));
+	memset(syslog_ctx, 0, sizeof(*syslog_ctx));
 	syslog_ctx->server_addr = addr;
 	syslog_ctx->send_buf = netbuf_new();
+	syslog_ctx->syslog_server = netconn_new(NETCONN_UDP);
+	if (syslog_ctx->syslog_server == NULL)
+	{
+		kputs("Unable to alloc UDP connetions\n");
+		return;
+	}
+
+	ring_head = ring_tail = ring_used = 0;
+	syslog_ctx->sender = proc_new(syslog_sender, syslog_ctx, CONFIG_SYSLOG_STACK, SENDER_STACK);
+	ASSERT(syslog_ctx->sender);
 
 	local_syslog_ctx = syslog_ctx;
 }
@@ -41,6 +41,12 @@
  * ip address of the remote syslog server, then the syslog module redirect all LOG_* (INFO, WARN, ERR)
  * message to syslog server, optionally we can send both message on serial and on syslog.
  *
+ * Messages are formatted in a ring of CONFIG_SYSLOG_RING slots and sent
+ * by a dedicated process, which sends all the queued ones each time it
+ * runs, on a single UDP connection. Logging never blocks: when the ring is
+ * full the message is dropped and counted (see syslog_dropped()), so any
+ * process, lwIP included, can log.
+ *
  * The usage pattern is as follows:
  * \code
  * //Init the network, es using dhcp:
@@ -75,7 +81,7 @@
  *
  * $WIZ$ module_name = "syslog"
  * $WIZ$ module_configuration = "bertos/cfg/cfg_syslog.h"
- * $WIZ$ module_depends = "lwip", "debug"
+ * $WIZ$ module_depends = "lwip", "debug", "kernel", "signal"
  */
 
 #ifndef NET_SYSLOG_H
@@ -89,12 +95,17 @@ typedef struct SysLog
 	struct netconn *syslog_server;
 	struct netbuf *send_buf;
 	struct ip_addr server_addr;
+	struct Process *sender;
 
-	uint32_t syslog_cnt;
+	uint32_t syslog_cnt;    ///< Messages queued
+	uint32_t dropped;       ///< Messages dropped, the ring was full
+	uint32_t sent;          ///< Messages sent
+	uint32_t batches;       ///< Sender wakeups
 } SysLog;
 
 
 uint32_t syslog_count(void);
+uint32_t syslog_dropped(void);
 struct ip_addr syslog_ip(void);
 void syslog_setIp(struct ip_addr addr);
 
@@ -0,0 +1,286 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Syslog over the loopback interface test.
+ *
+ * Messages are received by a local UDP listener, checking their content
+ * and order, that messages are dropped and counted when the ring is full
+ * and that several producers can log at the same time. Then the cost of
+ * logging and the number of messages sent per sender wakeup are measured.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ * $test$: cp bertos/cfg/cfg_lwip.h $cfgdir/
+ * $test$: echo  "#undef LWIP_HAVE_LOOPIF" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define LWIP_HAVE_LOOPIF 1" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef LWIP_NETIF_LOOPBACK" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define LWIP_NETIF_LOOPBACK 1" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef LWIP_SO_RCVTIMEO" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define LWIP_SO_RCVTIMEO 1" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef MEM_SIZE" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define MEM_SIZE 8000" >> $cfgdir/cfg_lwip.h
+ * $test$: cp bertos/cfg/cfg_syslog.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_SYSLOG_SERIAL" >> $cfgdir/cfg_syslog.h
+ * $test$: echo "#define CONFIG_SYSLOG_SERIAL 0" >> $cfgdir/cfg_syslog.h
+ */
+
+#include "lwip.c"
+#include "syslog.c"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+
+#include <lwip/tcpip.h>
+#include <netif/loopif.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRODUCERS      3
+#define PRODUCER_MSGS  20
+#define BENCH_MSGS     1000
+
+/* The ethernet driver wants it, even if we only use the loopback */
+uint8_t mac_addr[6];
+
+static struct netif loop_netif;
+static struct netconn *listener;
+static SysLog syslog;
+static char msg[CONFIG_SYSLOG_BUFSIZE + 1];
+static int producers_done;
+
+#define TEST_STACK(name)  PROC_DEFINE_STACK(name, KERN_MINSTACKSIZE * 2)
+
+TEST_STACK(stack0);
+TEST_STACK(stack1);
+TEST_STACK(stack2);
+
+static cpu_stack_t *stacks[PRODUCERS] = { stack0, stack1, stack2 };
+
+/* Receive a message in msg, return its length or -1 if none arrived */
+static int recv_msg(int timeout)
+{
+	struct netbuf *rx;
+	u16_t len;
+
+	listener->recv_timeout = timeout;
+	rx = netconn_recv(listener);
+	if (!rx)
+		return -1;
+
+	len = netbuf_copy(rx, msg, sizeof(msg) - 1);
+	msg[len] = '\0';
+	netbuf_delete(rx);
+
+	return len;
+}
+
+static int order_test(void)
+{
+	char expected[32];
+	int i;
+
+	kputs("Order\n");
+	for (i = 0; i < 5; i++)
+		if (syslog_printf("<182>message %d", i) < 0)
+			return -1;
+
+	for (i = 0; i < 5; i++)
+	{
+		sprintf(expected, "<182>message %d", i);
+		if (recv_msg(500) < 0 || strcmp(msg, expected))
+			return -1;
+	}
+
+	/* Too long, cut */
+	memset(msg, 'x', sizeof(msg) - 1);
+	msg[sizeof(msg) - 1] = '\0';
+	if (syslog_printf("%s", msg) != CONFIG_SYSLOG_BUFSIZE - 1
+			|| recv_msg(500) != CONFIG_SYSLOG_BUFSIZE - 1)
+		return -1;
+
+	return syslog_count() == 6 && syslog_dropped() == 0 ? 0 : -1;
+}
+
+static int drop_test(void)
+{
+	uint32_t batches = syslog.batches;
+	char expected[32];
+	int i;
+
+	kputs("Ring full\n");
+	/* The sender can't run until we sleep */
+	for (i = 0; i < CONFIG_SYSLOG_RING + 4; i++)
+	{
+		int len = syslog_printf("<182>burst %d", i);
+
+		if ((i < CONFIG_SYSLOG_RING) != (len > 0))
+			return -1;
+	}
+	if (syslog_dropped() != 4)
+		return -1;
+
+	for (i = 0; i < CONFIG_SYSLOG_RING; i++)
+	{
+		sprintf(expected, "<182>burst %d", i);
+		if (recv_msg(500) < 0 || strcmp(msg, expected))
+			return -1;
+	}
+	if (recv_msg(100) >= 0)
+		return -1;
+
+	/* All of them in one go */
+	kprintf("Sent %d messages in %ld wakeups\n", CONFIG_SYSLOG_RING, (long)(syslog.batches - batches));
+	return syslog.batches - batches == 1 ? 0 : -1;
+}
+
+static void producer(void)
+{
+	int id = (int)(ssize_t)proc_currentUserData();
+
+	for (int i = 0; i < PRODUCER_MSGS; i++)
+	{
+		syslog_printf("<182>p%d %d", id, i);
+		proc_yield();
+	}
+	producers_done++;
+}
+
+static int producers_test(void)
+{
+	int last[PRODUCERS];
+	int received = 0, id, n, i;
+	uint32_t dropped = syslog_dropped();
+
+	kputs("Producers\n");
+	for (i = 0; i < PRODUCERS; i++)
+	{
+		last[i] = -1;
+		proc_new(producer, (void *)(ssize_t)i, KERN_MINSTACKSIZE * 2, stacks[i]);
+	}
+
+	/* Each producer messages arrive in order */
+	while (recv_msg(200) >= 0)
+	{
+		if (sscanf(msg, "<182>p%d %d", &id, &n) != 2 || id >= PRODUCERS || n <= last[id])
+			return -1;
+		last[id] = n;
+		received++;
+	}
+
+	kprintf("Received %d messages, dropped %ld\n", received, (long)(syslog_dropped() - dropped));
+	if (producers_done != PRODUCERS
+			|| received + syslog_dropped() - dropped != PRODUCERS * PRODUCER_MSGS)
+		return -1;
+
+	return 0;
+}
+
+static int bench_test(void)
+{
+	uint32_t batches = syslog.batches, sent = syslog.sent;
+	ticks_t start, logging = 0;
+	int received = 0;
+
+	start = timer_clock();
+	for (int i = 0; i < BENCH_MSGS; i += CONFIG_SYSLOG_RING)
+	{
+		ticks_t t = timer_clock();
+
+		for (int j = 0; j < CONFIG_SYSLOG_RING; j++)
+			syslog_printf("<182>%d-bench: message %d", (int)syslog_count(), i + j);
+		logging += timer_clock() - t;
+
+		while (received < i + CONFIG_SYSLOG_RING && recv_msg(500) >= 0)
+			received++;
+	}
+
+	kprintf("%d messages: %ld ms, %ld ms logging, %ld messages per wakeup\n",
+		BENCH_MSGS, (long)ticks_to_ms(timer_clock() - start), (long)ticks_to_ms(logging),
+		(long)((syslog.sent - sent) / MAX(syslog.batches - batches, (uint32_t)1)));
+
+	return received >= BENCH_MSGS ? 0 : -1;
+}
+
+int syslog_testRun(void)
+{
+	if (order_test() || drop_test() || producers_test() || bench_test())
+	{
+		kputs("Syslog test failed\n");
+		return -1;
+	}
+
+	kputs("Syslog test finished..Ok!\n");
+	return 0;
+}
+
+int syslog_testSetup(void)
+{
+	struct ip_addr ipaddr, netmask, gw;
+
+	kdbg_init();
+	timer_init();
+	proc_init();
+
+	tcpip_init(NULL, NULL);
+
+	IP4_ADDR(&ipaddr, 127, 0, 0, 1);
+	IP4_ADDR(&netmask, 255, 0, 0, 0);
+	IP4_ADDR(&gw, 127, 0, 0, 1);
+	netif_add(&loop_netif, &ipaddr, &netmask, &gw, NULL, loopif_init, tcpip_input);
+	netif_set_up(&loop_netif);
+
+	listener = netconn_new(NETCONN_UDP);
+	netconn_bind(listener, IP_ADDR_ANY, CONFIG_SYSLOG_PORT);
+
+	syslog_init(&syslog, ipaddr);
+
+	return 0;
+}
+
+int syslog_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(syslog);
@@ -53,13 +53,15 @@
 #include <lwip/netbuf.h>
 #include <lwip/tcpip.h>
 
+#include <string.h>
+
 
 INLINE void close_socket(TcpSocket *socket)
 {
 	/* Clean all previuos states */
 	netbuf_delete(socket->rx_buf_conn);
 	socket->rx_buf_conn = NULL;
-	socket->remaning_data_len = 0;
+	socket->rx_offset = 0;
 
 	if (!socket->sock)
 		return;
@@ -131,95 +133,137 @@ static KFile *tcpsocket_reopen(KFile *fd)
 }
 
 /*
- * Read data from socket.
+ * Make the next received data available in rx_buf_conn.
  *
- * The read return the bytes that had been received if they are less than we request too.
- * Otherwise if the byte that we want read are less that the received bytes, we return only
- * the requested bytes. To get the remaning bytes we need to make an others read, until the
- * buffer is empty.
- * When there are not any more bytes, a new read takes data from remote socket.
+ * If the current netbuf has been fully consumed it is freed and a new one
+ * is taken from the remote socket, blocking until it arrives.
  */
-static size_t tcpsocket_read(KFile *fd, void *buf, size_t len)
+static bool tcpsocket_fill(TcpSocket *socket)
 {
-	TcpSocket *socket = TCPSOCKET_CAST(fd);
+	if (socket->rx_buf_conn)
+		return true;
+
+	/* Try reconnecting if our socket isn't valid */
+	if ((socket->sock == NULL) && !tcpsocket_reconnect(socket))
+		return false;
 
-	char *data;
-	uint16_t read_len = 0;
+	LOG_INFO("Get bytes from socket.\n");
+	socket->rx_buf_conn = netconn_recv(socket->sock);
+	socket->rx_offset = 0;
 
-	if (socket->remaning_data_len <= 0)
+	socket->error = netconn_err(socket->sock);
+	if (socket->error != ERR_OK)
 	{
-		LOG_INFO("No byte left.\n");
-		netbuf_delete(socket->rx_buf_conn);
+		LOG_ERR("While recv %d\n", socket->error);
+		close_socket(socket);
+		return false;
 	}
-	else /* We had byte into buffer use that */
+
+	return socket->rx_buf_conn != NULL;
+}
+
+/**
+ * Borrow a view over the received data, without copying it.
+ *
+ * The view covers what is left of the current fragment of the received
+ * netbuf chain: when it is empty a new netbuf is received from the remote
+ * socket, blocking until some data arrives.
+ * The data stays valid until tcpsocket_release() is called, any other
+ * read on the socket in the meantime is not allowed.
+ *
+ * \param fd tcp socket kfile context.
+ * \param data where to store the pointer to the received data.
+ * \return number of bytes available at \a data, 0 on error or if the
+ *         connection has been closed.
+ */
+size_t tcpsocket_borrow(KFile *fd, const void **data)
+{
+	TcpSocket *socket = TCPSOCKET_CAST(fd);
+	void *ptr;
+	uint16_t data_len;
+
+	for (;;)
 	{
-		LOG_INFO("Read stored bytes.\n");
-		if (!socket->rx_buf_conn)
-		{
-			LOG_ERR("Byte stored are corrupted!\n");
-			socket->remaning_data_len = 0;
+		if (!tcpsocket_fill(socket))
 			return 0;
-		}
-		uint16_t tot_data_len = 0;
-		netbuf_data(socket->rx_buf_conn, (void **)&data, &tot_data_len);
 
-		if (data)
+		if (netbuf_data(socket->rx_buf_conn, &ptr, &data_len) == ERR_OK
+				&& socket->rx_offset < data_len)
 		{
-			ASSERT(((int)tot_data_len - (int)socket->remaning_data_len) >= 0);
-			size_t chunk_len = MIN((size_t)(socket->remaning_data_len), len);
-			memcpy((char *)buf, &data[tot_data_len - socket->remaning_data_len], chunk_len);
-
-			socket->remaning_data_len -= chunk_len;
-			return chunk_len;
-		}
-		else
-		{
-			LOG_ERR("No valid data to read\n");
-			socket->remaning_data_len = 0;
-			netbuf_delete(socket->rx_buf_conn);
-			return 0;
+			*data = (const char *)ptr + socket->rx_offset;
+			return data_len - socket->rx_offset;
 		}
+
+		/* Empty fragment, skip it */
+		tcpsocket_release(fd, 0);
 	}
+}
 
-	/* Try reconnecting if our socket isn't valid */
-	if ((socket->sock == NULL) && !tcpsocket_reconnect(socket))
-		return 0;
+/**
+ * Give back \a len bytes of the view returned by tcpsocket_borrow().
+ *
+ * The next borrow starts after them; when the whole netbuf has been
+ * consumed it is freed.
+ *
+ * \param fd tcp socket kfile context.
+ * \param len number of bytes consumed, at most the borrowed length.
+ */
+void tcpsocket_release(KFile *fd, size_t len)
+{
+	TcpSocket *socket = TCPSOCKET_CAST(fd);
+	void *ptr;
+	uint16_t data_len;
+
+	if (!socket->rx_buf_conn)
+		return;
+
+	if (netbuf_data(socket->rx_buf_conn, &ptr, &data_len) != ERR_OK)
+		data_len = 0;
+
+	socket->rx_offset += len;
+	ASSERT(socket->rx_offset <= data_len);
+	if (socket->rx_offset < data_len)
+		return;
+
+	/* Current fragment is over, go on with the chain */
+	socket->rx_offset = 0;
+	if (netbuf_next(socket->rx_buf_conn) < 0)
+	{
+		LOG_INFO("No byte left.\n");
+		netbuf_delete(socket->rx_buf_conn);
+		socket->rx_buf_conn = NULL;
+	}
+}
+
+/*
+ * Read data from socket.
+ *
+ * The read copies the received data walking the whole netbuf chain, and
+ * returns less bytes than requested if the received netbuf ends before.
+ * The bytes that do not fit in the buffer are kept for the next reads.
+ * When there are not any more bytes, a new read takes data from remote socket.
+ */
+static size_t tcpsocket_read(KFile *fd, void *buf, size_t len)
+{
+	TcpSocket *socket = TCPSOCKET_CAST(fd);
+	size_t read_len = 0;
 
 	while (len)
 	{
-		LOG_INFO("Get bytes from socket.\n");
-		socket->rx_buf_conn = netconn_recv(socket->sock);
+		const void *data;
+		size_t chunk_len;
 
-		socket->error = netconn_err(socket->sock);
-		if (socket->error != ERR_OK)
-		{
-			LOG_ERR("While recv %d\n", socket->error);
-			close_socket(socket);
-			return 0;
-		}
+		/* Do not wait for new data if we already have something */
+		if (read_len && !socket->rx_buf_conn)
+			break;
 
-		size_t chunk_len = 0;
-		uint16_t data_len = 0;
-		if (socket->rx_buf_conn)
-		{
-			netbuf_data(socket->rx_buf_conn, (void **)&data, &data_len);
-
-			if (data)
-			{
-				chunk_len = MIN((size_t)data_len, len);
-				memcpy(buf, data, chunk_len);
-
-				socket->remaning_data_len = data_len - chunk_len;
-			}
-
-			if (socket->remaning_data_len <= 0)
-			{
-				netbuf_delete(socket->rx_buf_conn);
-				socket->rx_buf_conn = NULL;
-				socket->remaning_data_len = 0;
-				return chunk_len;
-			}
-		}
+		chunk_len = tcpsocket_borrow(fd, &data);
+		if (!chunk_len)
+			break;
+
+		chunk_len = MIN(chunk_len, len);
+		memcpy((char *)buf + read_len, data, chunk_len);
+		tcpsocket_release(fd, chunk_len);
 
 		len -= chunk_len;
 		read_len += chunk_len;
@@ -32,6 +32,10 @@
  *
  * \brief TCP sockect with kfile interface.
  *
+ * Besides kfile_read(), received data can be accessed without copying it
+ * with tcpsocket_borrow() and tcpsocket_release(), which walk the whole
+ * chain of the received lwIP netbufs.
+ *
  * \author Luca Ottaviano <lottaviano@develer.com>
  * \author Daniele Basile <asterix@develer.com>
  *
@@ -60,7 +64,7 @@ typedef struct TcpSocket
 	KFile fd;                         ///< KFile context.
 	struct netconn *sock;             ///< Current socket connection.
 	struct netbuf *rx_buf_conn;       ///< Current received buffer from socket.
-	size_t remaning_data_len;         ///< Number of bytes to read from the received buffer.
+	size_t rx_offset;                 ///< Bytes already read from the current fragment of the received buffer.
 
 	struct ip_addr *local_addr;       ///< Device Ip.
 	struct ip_addr *remote_addr;      ///< Ip address which we want to connect.
@@ -82,6 +86,9 @@ INLINE TcpSocket *TCPSOCKET_CAST(KFile *fd)
 
 void tcpsocket_init(TcpSocket *socket, struct ip_addr *local_addr, struct ip_addr *remote_addr, uint16_t port);
 
+size_t tcpsocket_borrow(KFile *fd, const void **data);
+void tcpsocket_release(KFile *fd, size_t len);
+
 void tcpsocket_serverPoll(KFile *fd);
 void tcpsocket_serverInit(TcpSocket *socket, struct ip_addr *local_addr, struct ip_addr *remote_addr, uint16_t port, tcphandler_t handler);
 
@@ -0,0 +1,272 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TCP socket kfile test over the loopback interface.
+ *
+ * A local server streams a known pattern to the socket, which is read
+ * with kfile_read() in odd sized chunks and then borrowed without copying
+ * it. Chained netbufs are injected to check they are walked entirely.
+ * Then bulk receive through kfile_read() and through the borrow API are
+ * measured.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ * $test$: cp bertos/cfg/cfg_lwip.h $cfgdir/
+ * $test$: echo  "#undef LWIP_HAVE_LOOPIF" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define LWIP_HAVE_LOOPIF 1" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef LWIP_NETIF_LOOPBACK" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define LWIP_NETIF_LOOPBACK 1" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef MEM_SIZE" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define MEM_SIZE 16000" >> $cfgdir/cfg_lwip.h
+ * $test$: echo  "#undef MEMP_NUM_NETBUF" >> $cfgdir/cfg_lwip.h
+ * $test$: echo "#define MEMP_NUM_NETBUF 8" >> $cfgdir/cfg_lwip.h
+ */
+
+#include "tcp_socket.c"
+/* lwIP sys_arch sets its own log level */
+#undef LOG_LEVEL
+#undef LOG_FORMAT
+#include "lwip.c"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+
+#include <net/tcp_socket.h>
+
+#include <lwip/tcpip.h>
+#include <netif/loopif.h>
+
+#include <string.h>
+
+#define TEST_PORT    8080
+#define CHUNK_SIZE   1024
+#define READ_SIZE    (16 * 1024L)
+#define BORROW_SIZE  (16 * 1024L)
+#define BENCH_SIZE   (512 * 1024L)
+#define TOTAL_SIZE   (READ_SIZE + BORROW_SIZE + 2 * BENCH_SIZE)
+
+/* The ethernet driver wants it, even if we only use the loopback */
+uint8_t mac_addr[6];
+
+/*
+ * The server listens on 127.0.0.1 and the socket binds 127.0.0.2, since
+ * the socket uses the same port for both ends of the connection.
+ */
+static struct netif server_netif, client_netif;
+static struct ip_addr server_addr, client_addr;
+static struct netconn *server;
+static TcpSocket sock;
+
+/* Every byte of the stream is its offset modulo 256 */
+static uint8_t pattern[CHUNK_SIZE];
+static uint32_t rx_pos;
+static uint8_t rx_buf[512];
+
+PROC_DEFINE_STACK(server_stack, KERN_MINSTACKSIZE * 4);
+
+static void streamer(void)
+{
+	struct netconn *conn = netconn_accept(server);
+
+	for (long sent = 0; conn && sent < TOTAL_SIZE; sent += CHUNK_SIZE)
+		if (netconn_write(conn, pattern, CHUNK_SIZE, NETCONN_COPY) != ERR_OK)
+			break;
+
+	if (conn)
+	{
+		netconn_close(conn);
+		netconn_delete(conn);
+	}
+}
+
+static bool check(const uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		if (data[i] != (uint8_t)rx_pos++)
+			return false;
+
+	return true;
+}
+
+static int read_stream(size_t chunk, long total)
+{
+	long received = 0;
+
+	while (received < total)
+	{
+		size_t len = kfile_read(&sock.fd, rx_buf, MIN(chunk, (size_t)(total - received)));
+
+		if (!len || !check(rx_buf, len))
+			return -1;
+		received += len;
+	}
+	return 0;
+}
+
+static int borrow_stream(long total, bool split)
+{
+	long received = 0;
+
+	while (received < total)
+	{
+		const void *data;
+		size_t len = tcpsocket_borrow(&sock.fd, &data);
+
+		if (!len)
+			return -1;
+		len = MIN(len, (size_t)(total - received));
+
+		/* Consume it in two steps, the rest is kept for the next borrow */
+		if (split && len > 1)
+			len /= 2;
+
+		if (!check(data, len))
+			return -1;
+		tcpsocket_release(&sock.fd, len);
+		received += len;
+	}
+	return 0;
+}
+
+static int chain_test(void)
+{
+	struct netbuf *head = netbuf_new();
+	struct netbuf *tail = netbuf_new();
+	char out[16];
+
+	kputs("Chained netbuf\n");
+	netbuf_ref(head, "Be", 2);
+	netbuf_ref(tail, "RTOS", 4);
+	netbuf_chain(head, tail);
+	sock.rx_buf_conn = head;
+
+	/* Across the fragments, and without waiting for more data at the end */
+	if (kfile_read(&sock.fd, out, 3) != 3 || memcmp(out, "BeR", 3))
+		return -1;
+	if (kfile_read(&sock.fd, out, sizeof(out)) != 3 || memcmp(out, "TOS", 3))
+		return -1;
+
+	return sock.rx_buf_conn == NULL ? 0 : -1;
+}
+
+static int stream_test(void)
+{
+	kputs("Read and borrow\n");
+	if (read_stream(100, READ_SIZE) || borrow_stream(BORROW_SIZE, true))
+		return -1;
+
+	return 0;
+}
+
+static int bench_test(void)
+{
+	const void *data;
+	ticks_t start, read_time, borrow_time;
+
+	start = timer_clock();
+	if (read_stream(sizeof(rx_buf), BENCH_SIZE))
+		return -1;
+	read_time = timer_clock() - start;
+
+	start = timer_clock();
+	if (borrow_stream(BENCH_SIZE, false))
+		return -1;
+	borrow_time = timer_clock() - start;
+
+	kprintf("%ld bytes: kfile_read %ld ms, borrow %ld ms\n", BENCH_SIZE,
+		(long)ticks_to_ms(read_time), (long)ticks_to_ms(borrow_time));
+
+	/* The server is done */
+	return tcpsocket_borrow(&sock.fd, &data) == 0 ? 0 : -1;
+}
+
+int tcp_socket_testRun(void)
+{
+	if (chain_test() || stream_test() || bench_test())
+	{
+		kputs("TCP socket test failed\n");
+		return -1;
+	}
+
+	kputs("TCP socket test finished..Ok!\n");
+	return 0;
+}
+
+int tcp_socket_testSetup(void)
+{
+	struct ip_addr netmask, host_netmask;
+
+	kdbg_init();
+	timer_init();
+	proc_init();
+
+	tcpip_init(NULL, NULL);
+
+	IP4_ADDR(&server_addr, 127, 0, 0, 1);
+	IP4_ADDR(&client_addr, 127, 0, 0, 2);
+	IP4_ADDR(&netmask, 255, 0, 0, 0);
+	IP4_ADDR(&host_netmask, 255, 255, 255, 255);
+	netif_add(&server_netif, &server_addr, &netmask, &server_addr, NULL, loopif_init, tcpip_input);
+	netif_set_up(&server_netif);
+	netif_add(&client_netif, &client_addr, &host_netmask, &client_addr, NULL, loopif_init, tcpip_input);
+	netif_set_up(&client_netif);
+
+	for (int i = 0; i < CHUNK_SIZE; i++)
+		pattern[i] = i;
+
+	server = netconn_new(NETCONN_TCP);
+	netconn_bind(server, &server_addr, TEST_PORT);
+	netconn_listen(server);
+	proc_new(streamer, NULL, sizeof(server_stack), server_stack);
+
+	tcpsocket_init(&sock, &client_addr, &server_addr, TEST_PORT);
+
+	return 0;
+}
+
+int tcp_socket_testTearDown(void)
+{
+	kfile_close(&sock.fd);
+	return 0;
+}
+
+TEST_MAIN(tcp_socket);
@@ -43,6 +43,12 @@
 #define FREE_FILL_CODE     0xDEAD
 #define ALLOC_FILL_CODE    0xBEEF
 
+/// Block size of slab class \a cls.
+#define SLAB_SIZE(cls)  (sizeof(MemChunk) * ((cls) + 1))
+
+/// Biggest block served by the slab classes.
+#define SLAB_MAX        SLAB_SIZE(CONFIG_HEAP_SLAB_CLASSES - 1)
+
 
 /*
  * This function prototype is deprecated, will change in:
@@ -62,6 +68,12 @@ void heap_init(struct Heap* h, void* memory, size_t size)
 	h->FreeList = (MemChunk *)memory;
 	h->FreeList->next = NULL;
 	h->FreeList->size = size;
+
+	#if CONFIG_HEAP_SLAB
+		memset(h->slab, 0, sizeof(h->slab));
+		memset(h->slab_used, 0, sizeof(h->slab_used));
+		memset(h->slab_total, 0, sizeof(h->slab_total));
+	#endif
 }
 
 
@@ -192,6 +204,9 @@ void heap_freemem(struct Heap* h, void *mem, size_t size)
  *       Those regions are likely to be *not* contiguous,
  *       so a successive allocation may fail even if the
  *       requested amount of memory is lower than the current free space.
+ *       With CONFIG_HEAP_SLAB, the free blocks parked in the size classes
+ *       are counted too, even if only heap_malloc() requests of their
+ *       class can use them before heap_slabReclaim() is called.
  */
 size_t heap_freeSpace(struct Heap *h)
 {
@@ -199,11 +214,123 @@ size_t heap_freeSpace(struct Heap *h)
 	for (MemChunk *chunk = h->FreeList; chunk; chunk = chunk->next)
 		free_mem += chunk->size;
 
+	#if CONFIG_HEAP_SLAB
+		for (int cls = 0; cls < CONFIG_HEAP_SLAB_CLASSES; cls++)
+			free_mem += (h->slab_total[cls] - h->slab_used[cls]) * SLAB_SIZE(cls);
+	#endif
+
 	return free_mem;
 }
 
 #if CONFIG_HEAP_MALLOC
 
+#if CONFIG_HEAP_SLAB
+
+/**
+ * Return the smallest class fitting \a size bytes.
+ */
+INLINE int heap_slabClass(size_t size)
+{
+	ASSERT(size && size <= SLAB_MAX);
+	return (size - 1) / sizeof(MemChunk);
+}
+
+/**
+ * Allocate \a size bytes from the end of the last free chunk big enough,
+ * keeping slab blocks at the top of the heap, away from the big
+ * allocations served first-fit from the bottom.
+ */
+static void *heap_allocTop(struct Heap *h, size_t size)
+{
+	MemChunk *chunk, *prev, *fit = NULL, *fit_prev = NULL;
+
+	for (prev = (MemChunk *)&h->FreeList, chunk = h->FreeList;
+		chunk;
+		prev = chunk, chunk = chunk->next)
+	{
+		if (chunk->size >= size)
+		{
+			fit = chunk;
+			fit_prev = prev;
+		}
+	}
+
+	if (!fit)
+		return NULL;
+
+	if (fit->size == size)
+	{
+		fit_prev->next = fit->next;
+		return fit;
+	}
+	fit->size -= size;
+	return (uint8_t *)fit + fit->size;
+}
+
+/**
+ * Carve a new batch of blocks of class \a cls from the heap.
+ *
+ * When the heap cannot fit a whole batch, a single block is tried.
+ */
+static bool heap_slabRefill(struct Heap *h, int cls)
+{
+	size_t count = CONFIG_HEAP_SLAB_BATCH;
+	uint8_t *mem;
+
+	while (!(mem = (uint8_t *)heap_allocTop(h, count * SLAB_SIZE(cls))))
+	{
+		if (count == 1)
+			return false;
+		count = 1;
+	}
+
+	h->slab_total[cls] += count;
+	while (count--)
+	{
+		MemChunk *chunk = (MemChunk *)(mem + count * SLAB_SIZE(cls));
+
+		chunk->next = h->slab[cls];
+		h->slab[cls] = chunk;
+	}
+	return true;
+}
+
+/**
+ * Give all the free slab blocks back to the heap.
+ *
+ * This is done automatically when the heap runs out of memory, but it can
+ * also be called to defragment the heap after a burst of small allocations.
+ */
+void heap_slabReclaim(struct Heap *h)
+{
+	MemChunk *chunk;
+	int cls;
+
+	for (cls = 0; cls < CONFIG_HEAP_SLAB_CLASSES; cls++)
+	{
+		while ((chunk = h->slab[cls]))
+		{
+			h->slab[cls] = chunk->next;
+			h->slab_total[cls]--;
+			heap_freemem(h, chunk, SLAB_SIZE(cls));
+		}
+	}
+}
+
+/**
+ * Fill \a info with the occupancy of slab class \a cls.
+ */
+void heap_slabInfo(struct Heap *h, int cls, HeapSlabInfo *info)
+{
+	ASSERT(cls >= 0 && cls < CONFIG_HEAP_SLAB_CLASSES);
+
+	info->size = SLAB_SIZE(cls);
+	info->used = h->slab_used[cls];
+	info->total = h->slab_total[cls];
+}
+
+#endif /* CONFIG_HEAP_SLAB */
+
 /**
  * Standard malloc interface
  */
@@ -212,8 +339,40 @@ void *heap_malloc(struct Heap* h, size_t size)
 	size_t *mem;
 
 	size += sizeof(size_t);
+
+#if CONFIG_HEAP_SLAB
+	if (size <= SLAB_MAX)
+	{
+		int cls = heap_slabClass(size);
+
+		if (!h->slab[cls] && !heap_slabRefill(h, cls))
+		{
+			heap_slabReclaim(h);
+			if (!heap_slabRefill(h, cls))
+				return NULL;
+		}
+
+		mem = (size_t *)h->slab[cls];
+		h->slab[cls] = h->slab[cls]->next;
+		h->slab_used[cls]++;
+
+		/* Slab blocks are told apart by their size, never above SLAB_MAX */
+		*mem++ = SLAB_SIZE(cls);
+		return mem;
+	}
+
+	if (!(mem = (size_t *)heap_allocmem(h, size)))
+	{
+		heap_slabReclaim(h);
+		mem = (size_t *)heap_allocmem(h, size);
+	}
+
+	if (mem)
+		*mem++ = size;
+#else
 	if ((mem = (size_t*)heap_allocmem(h, size)))
 		*mem++ = size;
+#endif
 
 	return mem;
 }
@@ -251,6 +410,19 @@ void heap_free(struct Heap *h, void *mem)
 	if (_mem)
 	{
 		--_mem;
+	#if CONFIG_HEAP_SLAB
+		if (*_mem <= SLAB_MAX)
+		{
+			int cls = heap_slabClass(*_mem);
+			MemChunk *chunk = (MemChunk *)_mem;
+
+			ASSERT(h->slab_used[cls]);
+			h->slab_used[cls]--;
+			chunk->next = h->slab[cls];
+			h->slab[cls] = chunk;
+			return;
+		}
+	#endif
 		heap_freemem(h, _mem, *_mem);
 	}
 }
@@ -64,10 +64,24 @@ STATIC_ASSERT(IS_POW2(sizeof(MemChunk)));
 
 typedef MemChunk heap_buf_t;
 
+/* Fallback for project configurations older than the slab allocator */
+#ifndef CONFIG_HEAP_SLAB
+	#define CONFIG_HEAP_SLAB 0
+#endif
+
+#if CONFIG_HEAP_SLAB && !CONFIG_HEAP_MALLOC
+	#error CONFIG_HEAP_SLAB requires CONFIG_HEAP_MALLOC
+#endif
+
 /// A heap
 typedef struct Heap
 {
 	struct _MemChunk *FreeList;     ///< Head of the free list
+#if CONFIG_HEAP_SLAB
+	struct _MemChunk *slab[CONFIG_HEAP_SLAB_CLASSES];  ///< Free blocks of each size class
+	size_t slab_used[CONFIG_HEAP_SLAB_CLASSES];        ///< Allocated blocks of each class
+	size_t slab_total[CONFIG_HEAP_SLAB_CLASSES];       ///< Blocks carved for each class
+#endif
 } Heap;
 
 /**
@@ -114,6 +128,21 @@ void *heap_calloc(struct Heap* heap, size_t size);
 void heap_free(struct Heap* heap, void * mem);
 /** \} */
 
+#if CONFIG_HEAP_SLAB
+
+/// Occupancy of a slab size class.
+typedef struct HeapSlabInfo
+{
+	size_t size;   ///< Block size of the class, malloc header included.
+	size_t used;   ///< Blocks currently allocated.
+	size_t total;  ///< Blocks carved from the heap, allocated or free.
+} HeapSlabInfo;
+
+void heap_slabInfo(struct Heap *heap, int cls, HeapSlabInfo *info);
+void heap_slabReclaim(struct Heap *heap);
+
+#endif /* CONFIG_HEAP_SLAB */
+
 #endif
 
 /** \} */ //defgroup heap
@@ -43,6 +43,8 @@
 #include <cfg/test.h>
 #include <cfg/debug.h>
 
+#include <string.h> // memset()
+
 #define TEST_LEN 31
 #define ALLOC_SIZE 113
 
@@ -90,6 +92,113 @@ static void alloc_test(size_t size, size_t test_len)
 	ASSERT(heap_freeSpace(&h) == HEAP_SIZE);
 }
 
+#if CONFIG_HEAP_MALLOC
+
+#define STRESS_HEAP_SIZE 16384
+#define STRESS_SLOTS     64
+#define STRESS_ITER      5000
+
+HEAP_DEFINE_BUF(stress_buf, STRESS_HEAP_SIZE);
+static Heap stress_heap;
+
+static unsigned stress_rand(void)
+{
+	static uint32_t seed = 12345;
+
+	seed = seed * 1103515245 + 12345;
+	return seed >> 16;
+}
+
+/*
+ * Return the share of free memory not in the largest free chunk [%].
+ * 0 means that all the free memory can be allocated at once.
+ */
+static int heap_fragmentation(void)
+{
+	size_t free_mem = 0, largest = 0;
+
+	for (MemChunk *chunk = stress_heap.FreeList; chunk; chunk = chunk->next)
+	{
+		free_mem += chunk->size;
+		largest = MAX(largest, chunk->size);
+	}
+	return free_mem ? 100 - (int)(largest * 100 / free_mem) : 0;
+}
+
+static void stress_check(uint8_t *mem, size_t len, int n)
+{
+	for (size_t j = 0; j < len; j++)
+		ASSERT(mem[j] == n);
+}
+
+/*
+ * Randomized mix of small, pbuf sized, buffers and big, stack sized,
+ * ones allocated and freed in random order.
+ */
+static void stress_test(void)
+{
+	uint8_t *mem[STRESS_SLOTS];
+	size_t len[STRESS_SLOTS];
+	int frag = 0, samples = 0, failures = 0;
+
+	heap_init(&stress_heap, stress_buf, sizeof(stress_buf));
+	memset(mem, 0, sizeof(mem));
+	for (int i = 0; i < STRESS_ITER; i++)
+	{
+		int n = stress_rand() % STRESS_SLOTS;
+
+		if (mem[n])
+		{
+			stress_check(mem[n], len[n], n);
+			heap_free(&stress_heap, mem[n]);
+			mem[n] = NULL;
+		}
+		else
+		{
+			len[n] = (stress_rand() % 8) ? 1 + stress_rand() % 128 : 256 + stress_rand() % 512;
+			if ((mem[n] = heap_malloc(&stress_heap, len[n])))
+				memset(mem[n], n, len[n]);
+			else
+				failures++;
+		}
+
+		if (i % 64 == 0)
+		{
+			frag += heap_fragmentation();
+			samples++;
+		}
+	}
+	kprintf("Stress test: %d allocation failures, average fragmentation %d%%\n",
+		failures, frag / samples);
+
+	for (int n = 0; n < STRESS_SLOTS; n++)
+	{
+		if (mem[n])
+		{
+			stress_check(mem[n], len[n], n);
+			heap_free(&stress_heap, mem[n]);
+		}
+	}
+
+#if CONFIG_HEAP_SLAB
+	for (int cls = 0; cls < CONFIG_HEAP_SLAB_CLASSES; cls++)
+	{
+		HeapSlabInfo info;
+
+		heap_slabInfo(&stress_heap, cls, &info);
+		kprintf("Slab class %d: size %lu, %lu/%lu blocks used\n", cls,
+			(unsigned long)info.size, (unsigned long)info.used, (unsigned long)info.total);
+		ASSERT(info.used == 0);
+	}
+	/* Free blocks parked in the classes are free space too */
+	ASSERT(heap_freeSpace(&stress_heap) == STRESS_HEAP_SIZE);
+	heap_slabReclaim(&stress_heap);
+#endif
+	ASSERT(heap_freeSpace(&stress_heap) == STRESS_HEAP_SIZE);
+}
+
+#endif /* CONFIG_HEAP_MALLOC */
+
 int heap_testRun(void)
 {
 	alloc_test(ALLOC_SIZE, TEST_LEN);
@@ -112,6 +221,9 @@ int heap_testRun(void)
 	heap_freemem(&h, b, HEAP_SIZE);
 	ASSERT(heap_freeSpace(&h) == HEAP_SIZE);
 
+#if CONFIG_HEAP_MALLOC
+	stress_test();
+#endif
 	return 0;
 }
 
@@ -34,12 +34,16 @@ SRC_LIST="
 	bertos/algo/crc_ccitt.c
 	bertos/algo/crc.c
 	bertos/algo/fletcher32.c
+	bertos/algo/hamming.c
 	bertos/drv/kdebug.c
 	bertos/drv/timer.c
+	bertos/drv/nand.c
 	bertos/kern/monitor.c
 	bertos/kern/proc.c
 	bertos/kern/signal.c
+	bertos/kern/msg.c
 	bertos/kern/sem.c
+	bertos/kern/trace.c
 	bertos/kern/preempt.c
 	bertos/kern/rtask.c
 	bertos/mware/event.c
@@ -54,8 +58,11 @@ SRC_LIST="
 	bertos/struct/bitarray.c
 	bertos/fs/fatfs/ff.c
 	bertos/emul/diskio_emul.c
+	bertos/emul/nand_emul.c
+	bertos/emul/eth_emul.c
 	bertos/fs/fat.c
 	bertos/fs/battfs.c
+	bertos/fs/kvstore.c
 	bertos/emul/switch_ctx_emul.S
 	bertos/mware/ini_reader.c
 	bertos/emul/kfile_posix.c
@@ -69,7 +76,10 @@ SRC_LIST="
 	bertos/io/kblock.c
 	bertos/io/kblock_ram.c
 	bertos/io/kblock_posix.c
+	bertos/io/kblock_cache.c
+	bertos/io/kblock_stats.c
 	bertos/io/kfile.c
+	bertos/io/kfile_block.c
 	bertos/sec/cipher.c
 	bertos/sec/cipher/blowfish.c
 	bertos/sec/cipher/aes.c
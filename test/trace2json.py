@@ -0,0 +1,172 @@
+#!/usr/bin/env python
+# This file is part of BeRTOS.
+#
+# Bertos is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As a special exception, you may use this file as part of a free software
+# library without restriction.  Specifically, if other files instantiate
+# templates or use macros or inline functions from this file, or you compile
+# this file and link it with other files to produce an executable, this
+# file does not by itself cause the resulting executable to be covered by
+# the GNU General Public License.  This exception does not however
+# invalidate any other reasons why the executable file might be covered by
+# the GNU General Public License.
+#
+# Copyright 2011 Develer S.r.l. (http://www.develer.com/)
+#
+# Convert a kernel event trace dump (see bertos/kern/trace.h) into a
+# Chrome trace JSON file, viewable with chrome://tracing or Perfetto.
+#
+# Usage: trace2json.py [-n ADDR=NAME ...] [-o out.json] dump.bin
+#
+# The dump is the output of trace_dump(), written to a file by the
+# emulator (through a KFilePosix) or read back from a target KFile.
+# Processes are shown as threads named after their address, use -n
+# to give them a name (e.g. -n 0x2000a1c0=main).
+
+import json
+import struct
+import sys
+from optparse import OptionParser
+
+TRACE_MAGIC = 0x42545243
+TRACE_VERSION = 2
+
+HEADER_FMT = "IIIII"
+EVENT_FMT = "IIIHxx"
+
+EVENT_NAMES = {
+	1: "switch",
+	2: "preempt",
+	3: "sig_send",
+	4: "sig_wait",
+	5: "sem_obtain",
+	6: "sem_release",
+	7: "msg_put",
+	8: "msg_get",
+	9: "timer_fire",
+	10: "irq_enter",
+	11: "irq_exit",
+}
+TRACE_SWITCH = 1
+TRACE_IRQ_ENTER = 10
+TRACE_IRQ_EXIT = 11
+
+PID = 1
+IDLE_TID = 0
+IRQ_TID = 1
+
+def parse(data):
+	for endian in "<>":
+		hdr = struct.unpack_from(endian + HEADER_FMT, data)
+		if hdr[0] == TRACE_MAGIC:
+			break
+	else:
+		raise ValueError("bad magic, not a trace dump")
+
+	magic, version, count, lost, freq = hdr
+	if version != TRACE_VERSION:
+		raise ValueError("unsupported trace version %d" % version)
+
+	off = struct.calcsize(HEADER_FMT)
+	size = struct.calcsize(EVENT_FMT)
+	events = []
+	for i in range(count):
+		events.append(struct.unpack_from(endian + EVENT_FMT, data, off + i * size))
+	return lost, freq, events
+
+def convert(lost, freq, events, names):
+	out = []
+	threads = {IDLE_TID: "idle", IRQ_TID: "irq"}
+
+	def tid_of(obj):
+		if obj == 0:
+			return IDLE_TID
+		if obj not in threads:
+			threads[obj] = names.get(obj, "proc 0x%08x" % obj)
+		return obj
+
+	# Unwrap the 32 bit timestamps
+	base = events[0][0] if events else 0
+	now = 0
+	last = base
+	current = None
+	in_irq = 0
+
+	for time, obj, arg, type in events:
+		now += (time - last) & 0xffffffff
+		last = time
+		ts = now * 1e6 / freq
+		name = EVENT_NAMES.get(type, "user_%d" % type)
+
+		if type == TRACE_SWITCH:
+			if current is not None:
+				out.append({"ph": "E", "pid": PID, "tid": current, "ts": ts})
+			current = tid_of(obj)
+			out.append({"ph": "B", "pid": PID, "tid": current, "ts": ts,
+				"name": threads[current]})
+		elif type == TRACE_IRQ_ENTER:
+			in_irq += 1
+			out.append({"ph": "B", "pid": PID, "tid": IRQ_TID, "ts": ts,
+				"name": "irq %d" % arg})
+		elif type == TRACE_IRQ_EXIT:
+			# The dump may start in the middle of an interrupt
+			if in_irq:
+				in_irq -= 1
+				out.append({"ph": "E", "pid": PID, "tid": IRQ_TID, "ts": ts})
+		else:
+			if in_irq:
+				tid = IRQ_TID
+			elif current is not None:
+				tid = current
+			else:
+				tid = IDLE_TID
+			out.append({"ph": "i", "s": "t", "pid": PID, "tid": tid, "ts": ts,
+				"name": name, "args": {"obj": "0x%08x" % obj, "arg": arg}})
+
+	if current is not None:
+		out.append({"ph": "E", "pid": PID, "tid": current, "ts": ts})
+
+	for tid, tname in threads.items():
+		out.append({"ph": "M", "pid": PID, "tid": tid, "name": "thread_name",
+			"args": {"name": tname}})
+	out.append({"ph": "M", "pid": PID, "name": "process_name",
+		"args": {"name": "BeRTOS (%d events lost)" % lost}})
+
+	return {"traceEvents": out, "displayTimeUnit": "ns"}
+
+def main():
+	parser = OptionParser(usage="%prog [options] dump.bin")
+	parser.add_option("-o", "--output", help="output file (default: stdout)")
+	parser.add_option("-n", "--name", action="append", default=[],
+		metavar="ADDR=NAME", help="name the process at address ADDR")
+	opts, args = parser.parse_args()
+	if len(args) != 1:
+		parser.error("missing trace dump")
+
+	names = {}
+	for n in opts.name:
+		addr, name = n.split("=", 1)
+		names[int(addr, 0) & 0xffffffff] = name
+
+	lost, freq, events = parse(open(args[0], "rb").read())
+	trace = convert(lost, freq, events, names)
+
+	out = open(opts.output, "w") if opts.output else sys.stdout
+	json.dump(trace, out, indent=1)
+	out.write("\n")
+
+if __name__ == "__main__":
+	main()